@@ -20,9 +20,94 @@
 #include <grub/misc.h>
 #include <grub/command.h>
 #include <grub/i18n.h>
+#include <grub/mm.h>
+#include <grub/trace.h>
+#ifdef GRUB_MACHINE_EFI
+#include <grub/loader.h>
+#include <grub/efi/api.h>
+#include <grub/efi/efi.h>
+#include <grub/efi/memory.h>
+#include <grub/cpu/efi/memory.h>
+#endif
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
+/* How deep spans are matched.  */
+#define MAX_OPEN_SPANS	64
+
+/* Print how many spans of each category there were and how long they took,
+   and the counters.  */
+static void
+print_trace (void)
+{
+  static const char *category_names[] = GRUB_TRACE_CATEGORY_NAMES;
+  grub_uint64_t total[GRUB_TRACE_NCATEGORIES] = { 0 };
+  grub_uint32_t count[GRUB_TRACE_NCATEGORIES] = { 0 };
+  struct grub_trace_record *open[MAX_OPEN_SPANS];
+  struct grub_trace_header *header;
+  struct grub_trace_counter_record *counters;
+  struct grub_trace_record *records;
+  const char *strings;
+  grub_uint32_t nevents, i;
+  grub_size_t size;
+  int depth = 0;
+
+  header = grub_trace_export (&size);
+  if (! header)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+
+  counters = (struct grub_trace_counter_record *) (header + 1);
+  records = (struct grub_trace_record *)
+    (counters + grub_le_to_cpu32 (header->ncounters));
+  strings = (const char *) header + grub_le_to_cpu32 (header->strings);
+  nevents = grub_le_to_cpu32 (header->nevents);
+
+  /* An end closes the latest begin with the same name, everything opened
+     after it is dropped.  */
+  for (i = 0; i < nevents; i++)
+    {
+      struct grub_trace_record *r = &records[i];
+      int j;
+
+      if (r->category >= GRUB_TRACE_NCATEGORIES)
+	continue;
+      if (r->type == GRUB_TRACE_BEGIN)
+	{
+	  if (depth == MAX_OPEN_SPANS)
+	    grub_memmove (open, open + 1, sizeof (open[0]) * --depth);
+	  open[depth++] = r;
+	  continue;
+	}
+      if (r->type != GRUB_TRACE_END)
+	continue;
+      for (j = depth - 1; j >= 0; j--)
+	if (open[j]->name == r->name && open[j]->category == r->category)
+	  break;
+      if (j < 0)
+	continue;
+      total[r->category] += grub_le_to_cpu64 (r->time)
+	- grub_le_to_cpu64 (open[j]->time);
+      count[r->category]++;
+      depth = j;
+    }
+
+  for (i = 0; i < GRUB_TRACE_NCATEGORIES; i++)
+    if (count[i])
+      grub_printf ("%-10s %6u spans %6llu ms\n", category_names[i], count[i],
+		   (unsigned long long) total[i] / 1000);
+  for (i = 0; i < grub_le_to_cpu32 (header->ncounters); i++)
+    grub_printf ("%-20s %llu\n", strings + grub_le_to_cpu32 (counters[i].name),
+		 (unsigned long long) grub_le_to_cpu64 (counters[i].value));
+  if (header->dropped)
+    grub_printf_ (N_("%u older events were dropped\n"),
+		  grub_le_to_cpu32 (header->dropped));
+
+  grub_free (header);
+}
+
 
 static grub_err_t
 grub_cmd_boottime (struct grub_command *cmd __attribute__ ((unused)),
@@ -47,9 +132,70 @@ grub_cmd_boottime (struct grub_command *cmd __attribute__ ((unused)),
 		   tmabs / 1000, tmabs % 1000, tmrel / 1000, tmrel % 1000, cur->file, cur->line,
 		   cur->msg);
     }
+  print_trace ();
  return 0;
 }
 
+#ifdef GRUB_MACHINE_EFI
+/* The trace is handed to the OS as an EFI configuration table.  */
+static struct grub_preboot *preboot_handle;
+static void *trace_table;
+static grub_efi_uintn_t trace_table_pages;
+
+static grub_err_t
+install_trace_table (int noreturn __attribute__ ((unused)))
+{
+  grub_efi_guid_t guid = GRUB_EFI_GRUB_TRACE_GUID;
+  grub_efi_boot_services_t *b = grub_efi_system_table->boot_services;
+  void *trace;
+  grub_size_t size;
+
+  grub_boot_time ("Installing trace table");
+  trace = grub_trace_export (&size);
+  if (! trace)
+    goto fail;
+
+  trace_table_pages = GRUB_EFI_BYTES_TO_PAGES (size);
+  trace_table = grub_efi_allocate_pages_real (GRUB_EFI_MAX_USABLE_ADDRESS,
+					      trace_table_pages,
+					      GRUB_EFI_ALLOCATE_MAX_ADDRESS,
+					      GRUB_EFI_ACPI_RECLAIM_MEMORY);
+  if (! trace_table)
+    {
+      grub_free (trace);
+      goto fail;
+    }
+  grub_memcpy (trace_table, trace, size);
+  grub_free (trace);
+
+  if (efi_call_2 (b->install_configuration_table, &guid, trace_table)
+      != GRUB_EFI_SUCCESS)
+    {
+      grub_efi_free_pages ((grub_addr_t) trace_table, trace_table_pages);
+      trace_table = NULL;
+    }
+
+ fail:
+  /* The trace is not worth failing the boot for.  */
+  grub_errno = GRUB_ERR_NONE;
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+remove_trace_table (void)
+{
+  grub_efi_guid_t guid = GRUB_EFI_GRUB_TRACE_GUID;
+  grub_efi_boot_services_t *b = grub_efi_system_table->boot_services;
+
+  if (! trace_table)
+    return GRUB_ERR_NONE;
+  efi_call_2 (b->install_configuration_table, &guid, NULL);
+  grub_efi_free_pages ((grub_addr_t) trace_table, trace_table_pages);
+  trace_table = NULL;
+  return GRUB_ERR_NONE;
+}
+#endif
+
 static grub_command_t cmd_boottime;
 
 GRUB_MOD_INIT(boottime)
@@ -57,9 +203,17 @@ GRUB_MOD_INIT(boottime)
   cmd_boottime =
     grub_register_command ("boottime", grub_cmd_boottime,
 			   0, N_("Show boot time statistics."));
+#ifdef GRUB_MACHINE_EFI
+  preboot_handle =
+    grub_loader_register_preboot_hook (install_trace_table, remove_trace_table,
+				       GRUB_LOADER_PREBOOT_HOOK_PRIO_NORMAL);
+#endif
 }
 
 GRUB_MOD_FINI(boottime)
 {
+#ifdef GRUB_MACHINE_EFI
+  grub_loader_unregister_preboot_hook (preboot_handle);
+#endif
   grub_unregister_command (cmd_boottime);
 }
@@ -0,0 +1,156 @@
+/* lsheap.c - show what the heap is used for */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/command.h>
+#include <grub/i18n.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+static void
+print_tag (grub_mm_tag_t tag, int depth)
+{
+  grub_mm_tag_t child;
+  int i;
+
+  for (i = 0; i < depth; i++)
+    grub_printf ("  ");
+  grub_printf_ (N_("%s: %llu KiB in %llu blocks, at most %llu KiB"),
+		tag->name,
+		(unsigned long long) (tag->live >> 10),
+		(unsigned long long) tag->count,
+		(unsigned long long) (tag->peak >> 10));
+  if (tag->limit)
+    grub_printf_ (N_(", limited to %llu KiB"),
+		  (unsigned long long) (tag->limit >> 10));
+  grub_printf ("\n");
+
+  for (child = grub_mm_tags; child; child = child->next)
+    if (child->parent == tag)
+      print_tag (child, depth + 1);
+}
+
+static grub_err_t
+grub_cmd_lsheap (grub_command_t cmd __attribute__ ((unused)),
+		 int argc __attribute__ ((unused)),
+		 char **args __attribute__ ((unused)))
+{
+  print_tag (grub_mm_tags, 0);
+  return GRUB_ERR_NONE;
+}
+
+/* Find the tag at PATH, the names of its ancestors below the root and its
+   own separated by slashes.  */
+static grub_mm_tag_t
+find_tag (const char *path)
+{
+  grub_mm_tag_t tag = grub_mm_tags, t;
+  const char *end;
+
+  while (*path)
+    {
+      end = grub_strchr (path, '/');
+      if (! end)
+	end = path + grub_strlen (path);
+
+      for (t = grub_mm_tags; t; t = t->next)
+	if (t->parent == tag
+	    && grub_strncmp (t->name, path, end - path) == 0
+	    && t->name[end - path] == '\0')
+	  break;
+      if (! t)
+	return NULL;
+
+      tag = t;
+      path = *end ? end + 1 : end;
+    }
+
+  return tag == grub_mm_tags ? NULL : tag;
+}
+
+static grub_err_t
+grub_cmd_heaplimit (grub_command_t cmd __attribute__ ((unused)),
+		    int argc, char **args)
+{
+  grub_mm_tag_t tag;
+  unsigned long long limit;
+  const char *end;
+
+  if (argc < 1)
+    return grub_error (GRUB_ERR_BAD_ARGUMENT, N_("one argument expected"));
+
+  tag = find_tag (args[0]);
+  if (! tag)
+    return grub_error (GRUB_ERR_BAD_ARGUMENT, N_("no heap tag `%s'"),
+		       args[0]);
+
+  if (argc < 2)
+    {
+      if (tag->limit)
+	grub_printf ("%llu\n", (unsigned long long) tag->limit);
+      return GRUB_ERR_NONE;
+    }
+
+  limit = grub_strtoull (args[1], &end, 0);
+  if (grub_errno)
+    return grub_errno;
+  switch (*end)
+    {
+    case 'g':
+    case 'G':
+      limit <<= 10;
+      /* Fallthrough.  */
+    case 'm':
+    case 'M':
+      limit <<= 10;
+      /* Fallthrough.  */
+    case 'k':
+    case 'K':
+      limit <<= 10;
+      end++;
+      break;
+    }
+  if (*end)
+    return grub_error (GRUB_ERR_BAD_NUMBER, N_("unrecognized number"));
+
+  tag->limit = limit;
+  return GRUB_ERR_NONE;
+}
+
+static grub_command_t cmd_lsheap, cmd_heaplimit;
+
+GRUB_MOD_INIT(lsheap)
+{
+  cmd_lsheap = grub_register_command ("lsheap", grub_cmd_lsheap, 0,
+				      N_("Show what the heap is used for."));
+  cmd_heaplimit =
+    grub_register_command ("heaplimit", grub_cmd_heaplimit,
+			   N_("TAG [SIZE]"),
+			   N_("Limit the heap memory charged to TAG to SIZE"
+			      " bytes, 0 for no limit."));
+}
+
+GRUB_MOD_FINI(lsheap)
+{
+  grub_unregister_command (cmd_lsheap);
+  grub_unregister_command (cmd_heaplimit);
+}
@@ -72,13 +72,15 @@ static struct
 
 /* Add a menu entry to the current menu context (as given by the environment
    variable data slot `menu').  As the configuration file is read, the script
-   parser calls this when a menu entry is to be created.  */
+   parser calls this when a menu entry is to be created.  SCRIPT, if not NULL,
+   is the parsed SOURCECODE: the entry keeps a reference to it so that booting
+   it doesn't parse it again.  */
 grub_err_t
 grub_normal_add_menu_entry (int argc, const char **args,
 			    char **classes, const char *id,
 			    const char *users, const char *hotkey,
 			    const char *prefix, const char *sourcecode,
-			    int submenu)
+			    struct grub_script *script, int submenu)
 {
   int menu_hotkey = 0;
   char **menu_args = NULL;
@@ -187,6 +189,7 @@ grub_normal_add_menu_entry (int argc, const char **args,
   (*last)->argc = argc;
   (*last)->args = menu_args;
   (*last)->sourcecode = menu_sourcecode;
+  (*last)->script = grub_script_ref (script);
   (*last)->submenu = submenu;
 
   menu->size++;
@@ -285,7 +288,7 @@ grub_cmd_menuentry (grub_extcmd_context_t ctxt, int argc, char **args)
 				       ctxt->state[4].arg,
 				       users,
 				       ctxt->state[2].arg, 0,
-				       ctxt->state[3].arg,
+				       ctxt->state[3].arg, NULL,
 				       ctxt->extcmd->cmd->name[0] == 's');
 
   src = args[argc - 1];
@@ -302,7 +305,7 @@ grub_cmd_menuentry (grub_extcmd_context_t ctxt, int argc, char **args)
   r = grub_normal_add_menu_entry (argc - 1, (const char **) args,
 				  ctxt->state[0].args, ctxt->state[4].arg,
 				  users,
-				  ctxt->state[2].arg, prefix, src + 1,
+				  ctxt->state[2].arg, prefix, src + 1, ctxt->script,
 				  ctxt->extcmd->cmd->name[0] == 's');
 
   src[len - 1] = ch;
@@ -271,6 +271,10 @@ grub_cmd_nativedisk (grub_command_t cmd __attribute__ ((unused)),
 	goto fail;
     }
 
+  /* The firmware disks are going away, together with whatever was mounted
+     from them.  */
+  grub_fs_cache_invalidate (0);
+
   for (i = 0; i < argc; i++)
     if (mods[i])
       grub_dl_init (mods[i]);
@@ -32,6 +32,7 @@
 #include <grub/env.h>
 #include <grub/extcmd.h>
 #include <grub/i18n.h>
+#include <grub/devindex.h>
 #include <grub/i386/pc/boot.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
@@ -57,6 +58,7 @@ grub_cmd_probe (grub_extcmd_context_t ctxt, int argc, char **args)
   struct grub_arg_list *state = ctxt->state;
   grub_device_t dev;
   grub_fs_t fs;
+  const struct grub_devindex_entry *e;
   char *ptr;
   grub_err_t err;
 
@@ -151,6 +153,30 @@ grub_cmd_probe (grub_extcmd_context_t ctxt, int argc, char **args)
       grub_device_close (dev);
       return GRUB_ERR_NONE;
     }
+  /* Use what is known about the device if possible, and probe it for the
+     errors otherwise.  */
+  e = grub_devindex_get_device (dev);
+  grub_errno = GRUB_ERR_NONE;
+  if (e && e->fs)
+    {
+      const char *val = 0;
+
+      if (state[3].set)
+	val = e->fs;
+      else if (state[4].set)
+	val = e->uuid;
+      else if (state[5].set)
+	val = e->label;
+      if (val)
+	{
+	  if (state[0].set)
+	    grub_env_set (state[0].arg, val);
+	  else
+	    grub_printf ("%s", val);
+	  grub_device_close (dev);
+	  return GRUB_ERR_NONE;
+	}
+    }
   fs = grub_fs_probe (dev);
   if (! fs)
     return grub_errno;
@@ -30,6 +30,7 @@
 #include <grub/i18n.h>
 #include <grub/disk.h>
 #include <grub/partition.h>
+#include <grub/devindex.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -93,35 +94,22 @@ iterate_device (const char *name, void *data)
 #else
     {
       /* SEARCH_FS_UUID or SEARCH_LABEL */
-      grub_device_t dev;
-      grub_fs_t fs;
-      char *quid;
-
-      dev = grub_device_open (name);
-      if (dev)
-	{
-	  fs = grub_fs_probe (dev);
+      const struct grub_devindex_entry *e;
 
 #ifdef DO_SEARCH_FS_UUID
-#define read_fn fs_uuid
+#define read_fn uuid
 #else
-#define read_fn fs_label
+#define read_fn label
 #endif
 
-	  if (fs && fs->read_fn)
-	    {
-	      fs->read_fn (dev, &quid);
-
-	      if (grub_errno == GRUB_ERR_NONE && quid)
-		{
-		  if (compare_fn (quid, ctx->key) == 0)
-		    found = 1;
-
-		  grub_free (quid);
-		}
-	    }
-
-	  grub_device_close (dev);
+      e = grub_devindex_get (name, 0);
+      if (e && e->read_fn && compare_fn (e->read_fn, ctx->key) == 0)
+	{
+	  /* Make sure it's still there before picking it.  */
+	  grub_devindex_forget (name);
+	  e = grub_devindex_get (name, 0);
+	  if (e && e->read_fn && compare_fn (e->read_fn, ctx->key) == 0)
+	    found = 1;
 	}
     }
 #endif
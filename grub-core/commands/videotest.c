@@ -27,6 +27,7 @@
 #include <grub/i18n.h>
 #include <grub/gfxmenu_view.h>
 #include <grub/env.h>
+#include <grub/time.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -211,7 +212,131 @@ grub_cmd_videotest (grub_command_t cmd __attribute__ ((unused)),
   return grub_errno;
 }
 
-static grub_command_t cmd;
+enum
+  {
+    BENCH_FILL,
+    BENCH_REPLACE_RGB,
+    BENCH_REPLACE_RGBA,
+    BENCH_BLEND_RGBA,
+    BENCH_SWAP,
+    BENCH_COUNT
+  };
+
+static const char *bench_names[BENCH_COUNT] =
+  {
+    [BENCH_FILL] = "fill",
+    [BENCH_REPLACE_RGB] = "replace RGB",
+    [BENCH_REPLACE_RGBA] = "replace RGBA",
+    [BENCH_BLEND_RGBA] = "blend RGBA",
+    [BENCH_SWAP] = "swap buffers"
+  };
+
+/* Minimum time each kernel is run for.  */
+#define BENCH_MS 1000
+
+static grub_err_t
+grub_cmd_videobench (grub_command_t cmd __attribute__ ((unused)),
+		     int argc, char **args)
+{
+  grub_err_t err;
+  unsigned int x;
+  unsigned int y;
+  unsigned int width;
+  unsigned int height;
+  struct grub_video_render_target *rgb = NULL, *rgba = NULL;
+  grub_uint64_t pixels[BENCH_COUNT];
+  grub_uint64_t elapsed[BENCH_COUNT];
+  const char *mode = NULL;
+  int i;
+
+  mode = grub_env_get ("gfxmode");
+  if (argc)
+    mode = args[0];
+  if (!mode)
+    mode = "auto";
+
+  err = grub_video_set_mode (mode, GRUB_VIDEO_MODE_TYPE_PURE_TEXT, 0);
+  if (err)
+    return err;
+
+  grub_video_get_viewport (&x, &y, &width, &height);
+
+  if (grub_video_create_render_target (&rgb, width, height,
+				       GRUB_VIDEO_MODE_TYPE_RGB)
+      || grub_video_create_render_target (&rgba, width, height,
+					  GRUB_VIDEO_MODE_TYPE_RGB
+					  | GRUB_VIDEO_MODE_TYPE_ALPHA))
+    goto fail;
+
+  grub_video_set_active_render_target (rgb);
+  grub_video_fill_rect (grub_video_map_rgb (40, 80, 120), 0, 0, width, height);
+  /* Half-transparent so that blending can't take the opaque shortcut.  */
+  grub_video_set_active_render_target (rgba);
+  grub_video_fill_rect (grub_video_map_rgba (200, 100, 50, 128),
+			0, 0, width, height);
+  grub_video_set_active_render_target (GRUB_VIDEO_RENDER_TARGET_DISPLAY);
+
+  for (i = 0; i < BENCH_COUNT; i++)
+    {
+      grub_uint64_t start = grub_get_time_ms ();
+      grub_uint64_t iter = 0;
+
+      do
+	{
+	  switch (i)
+	    {
+	    case BENCH_FILL:
+	      grub_video_fill_rect (grub_video_map_rgb (iter & 0xff, 33, 77),
+				    0, 0, width, height);
+	      break;
+	    case BENCH_REPLACE_RGB:
+	      grub_video_blit_render_target (rgb, GRUB_VIDEO_BLIT_REPLACE,
+					     0, 0, 0, 0, width, height);
+	      break;
+	    case BENCH_REPLACE_RGBA:
+	      grub_video_blit_render_target (rgba, GRUB_VIDEO_BLIT_REPLACE,
+					     0, 0, 0, 0, width, height);
+	      break;
+	    case BENCH_BLEND_RGBA:
+	      grub_video_blit_render_target (rgba, GRUB_VIDEO_BLIT_BLEND,
+					     0, 0, 0, 0, width, height);
+	      break;
+	    case BENCH_SWAP:
+	      grub_video_swap_buffers ();
+	      break;
+	    }
+	  iter++;
+	  elapsed[i] = grub_get_time_ms () - start;
+	}
+      while (elapsed[i] < BENCH_MS);
+      pixels[i] = iter * width * height;
+    }
+
+  grub_video_delete_render_target (rgba);
+  grub_video_delete_render_target (rgb);
+  grub_video_restore ();
+
+  grub_printf ("%ux%u\n", width, height);
+  for (i = 0; i < BENCH_COUNT; i++)
+    {
+      /* Hundredths of megapixels per second.  */
+      grub_uint64_t rate = grub_divmod64 (pixels[i] * 100, elapsed[i] * 1000,
+					  0);
+      grub_printf ("%-14s %4" PRIuGRUB_UINT64_T ".%02u Mpix/s\n",
+		   bench_names[i], grub_divmod64 (rate, 100, 0),
+		   (unsigned) (rate % 100));
+    }
+
+  return GRUB_ERR_NONE;
+
+ fail:
+  grub_video_delete_render_target (rgba);
+  grub_video_delete_render_target (rgb);
+  grub_video_restore ();
+  return grub_errno;
+}
+
+static grub_command_t cmd, cmd_bench;
 #ifdef GRUB_MACHINE_PCBIOS
 static grub_command_t cmd_vbe;
 #endif
@@ -226,6 +351,9 @@ GRUB_MOD_INIT(videotest)
 			       /* TRANSLATORS: Here, on the other hand, it's
 				  nicer to use unicode cross instead of x.  */
 			       N_("Test video subsystem in mode WxH."));
+  cmd_bench = grub_register_command ("videobench", grub_cmd_videobench,
+				     N_("[WxH]"),
+				     N_("Measure blitting speed in mode WxH."));
 #ifdef GRUB_MACHINE_PCBIOS
   cmd_vbe = grub_register_command ("vbetest", grub_cmd_videotest,
 			       0, N_("Test video subsystem."));
@@ -235,6 +363,7 @@ GRUB_MOD_INIT(videotest)
 GRUB_MOD_FINI(videotest)
 {
   grub_unregister_command (cmd);
+  grub_unregister_command (cmd_bench);
 #ifdef GRUB_MACHINE_PCBIOS
   grub_unregister_command (cmd_vbe);
 #endif
@@ -26,6 +26,7 @@
 #include <grub/file.h>
 #include <grub/procfs.h>
 #include <grub/partition.h>
+#include <grub/trace.h>
 
 #ifdef GRUB_UTIL
 #include <grub/emu/hostdisk.h>
@@ -900,6 +901,9 @@ grub_cryptodisk_insert (grub_cryptodisk_t newdev, const char *name,
   newdev->next = cryptodisk_list;
   cryptodisk_list = newdev;
 
+  /* What was probed on the source is hidden behind the new disk now.  */
+  grub_fs_cache_invalidate (source);
+
   return GRUB_ERR_NONE;
 }
 
@@ -1015,7 +1019,11 @@ grub_cryptodisk_scan_device_real (const char *name, grub_disk_t source)
     if (!dev)
       continue;
     
+    grub_trace_begin (GRUB_TRACE_CRYPTO, grub_trace_intern (dev->modname),
+		      0);
     err = cr->recover_key (source, dev);
+    grub_trace_end (GRUB_TRACE_CRYPTO, grub_trace_intern (dev->modname),
+		    err == GRUB_ERR_NONE);
     if (err)
     {
       cryptodisk_close (dev);
@@ -21,6 +21,7 @@
 #include <grub/misc.h>
 #include <grub/file.h>
 #include <grub/disk.h>
+#include <grub/fs.h>
 #include <grub/mm.h>
 #include <grub/extcmd.h>
 #include <grub/i18n.h>
@@ -65,6 +66,8 @@ delete_loopback (const char *name)
 
   /* Remove the device from the list.  */
   *prev = dev->next;
+  /* Another file may be attached under the same name later.  */
+  grub_fs_cache_invalidate (0);
 
   grub_free (dev->devname);
   grub_file_close (dev->file);
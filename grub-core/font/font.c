@@ -56,6 +56,18 @@ struct char_index_entry
 #define FONT_WEIGHT_BOLD 200
 #define ASCII_BITMAP_SIZE 16
 
+/* DATA sections up to this size are read in whole at load time.  */
+#define FONT_PRELOAD_MAX (8 << 20)
+
+/* Size of the chunks glyphs of preloaded fonts are allocated from.  */
+#define FONT_GLYPH_ARENA_SIZE 16384
+
+/* Size in bytes of the glyph header in the DATA section.  */
+#define FONT_GLYPH_HEADER_SIZE 10
+
+/* First code point past the astral planes covered by astral_idx.  */
+#define FONT_ASTRAL_END 0x110000
+
 /* Definition of font registry.  */
 struct grub_font_node *grub_font_list;
 
@@ -111,6 +123,14 @@ static struct grub_font null_font;
 /* Flag to ensure module is initialized only once.  */
 static grub_uint8_t font_loader_initialized;
 
+/* What the cache of rendered glyphs is charged to.  It is flushed when
+   memory runs out.  */
+static grub_mm_tag_t rendered_glyphs_tag;
+static struct grub_mm_evictor rendered_glyphs_evictor =
+  {
+    .evict = grub_font_flush_rendered_glyphs
+  };
+
 #if HAVE_FONT_SOURCE
 static struct grub_font_glyph *ascii_font_glyph[0x80];
 #endif
@@ -184,9 +204,24 @@ grub_font_loader_init (void)
   null_font.max_char_width = unknown_glyph->width;
   null_font.max_char_height = unknown_glyph->height;
 
+  rendered_glyphs_tag = grub_mm_tag_get ("glyphs",
+					 grub_mm_tag_get ("caches", NULL));
+  rendered_glyphs_evictor.tag = rendered_glyphs_tag;
+  grub_mm_evictor_register (&rendered_glyphs_evictor);
+
   font_loader_initialized = 1;
 }
 
+void
+grub_font_loader_fini (void)
+{
+  if (!font_loader_initialized)
+    return;
+
+  grub_mm_evictor_unregister (&rendered_glyphs_evictor);
+  grub_font_flush_rendered_glyphs ();
+}
+
 /* Initialize the font object with initial default values.  */
 static void
 font_init (grub_font_t font)
@@ -207,6 +242,13 @@ font_init (grub_font_t font)
   font->num_chars = 0;
   font->char_index = 0;
   font->bmp_idx = 0;
+  font->astral_idx = 0;
+  font->astral_blocks = 0;
+  font->data = 0;
+  font->data_start = 0;
+  font->data_size = 0;
+  font->glyph_arena = 0;
+  font->glyph_arena_left = 0;
 }
 
 /* Open the next section in the file.
@@ -264,6 +306,43 @@ open_section (grub_file_t file, struct font_file_section *section)
    entry in the font file.  */
 #define FONT_CHAR_INDEX_ENTRY_SIZE (4 + 1 + 4)
 
+/* Build the index of code points outside of the BMP, so that looking them
+   up only needs to search the few entries of one 256-code-point block.
+   Returns 0 upon success, nonzero for failure.  */
+static int
+load_astral_index (grub_font_t font)
+{
+  grub_uint32_t max_code = 0;
+  grub_uint32_t i, j, b;
+
+  for (i = font->num_chars; i > 0; i--)
+    if (font->char_index[i - 1].code < FONT_ASTRAL_END)
+      {
+	max_code = font->char_index[i - 1].code;
+	break;
+      }
+
+  if (max_code < 0x10000)
+    return 0;
+
+  font->astral_blocks = ((max_code - 0x10000) >> 8) + 1;
+  font->astral_idx = grub_calloc (font->astral_blocks + 1,
+				  sizeof (font->astral_idx[0]));
+  if (!font->astral_idx)
+    return 1;
+
+  for (b = 0, j = 0; b <= font->astral_blocks; b++)
+    {
+      grub_uint32_t start = 0x10000 + (b << 8);
+
+      while (j < font->num_chars && font->char_index[j].code < start)
+	j++;
+      font->astral_idx[b] = j;
+    }
+
+  return 0;
+}
+
 /* Load the character index (CHIX) section contents from the font file.  This
    presumes that the position of FILE is positioned immediately after the
    section length for the CHIX section (i.e., at the start of the section
@@ -352,7 +431,7 @@ load_font_index (grub_file_t file, grub_uint32_t sect_length, struct
 #endif
     }
 
-  return 0;
+  return load_astral_index (font);
 }
 
 /* Read the contents of the specified section as a string, which is
@@ -407,6 +486,44 @@ read_section_as_short (struct font_file_section *section,
   return 0;
 }
 
+/* Read the whole DATA section, which FILE is positioned at the start of, if
+   it is small enough.  Glyphs are then decoded straight from memory and the
+   file is no longer needed.  Returns 0 upon success, nonzero upon
+   failure.  */
+static int
+load_font_data (grub_file_t file, grub_font_t font)
+{
+  grub_off_t start = grub_file_tell (file);
+  grub_off_t size = grub_file_size (file);
+  grub_uint8_t *data;
+
+  if (size == GRUB_FILE_SIZE_UNKNOWN || size <= start
+      || size - start > FONT_PRELOAD_MAX)
+    return 0;
+
+  data = grub_malloc (size - start);
+  if (!data)
+    {
+      /* Glyphs can still be read one by one.  */
+      grub_errno = GRUB_ERR_NONE;
+      return 0;
+    }
+
+  if (grub_file_read (file, data, size - start) != (grub_ssize_t) (size - start))
+    {
+      grub_free (data);
+      if (!grub_errno)
+	grub_error (GRUB_ERR_BAD_FONT, "premature end of font file");
+      return 1;
+    }
+
+  font->data = data;
+  font->data_start = start;
+  font->data_size = size - start;
+
+  return 0;
+}
+
 /* Load a font and add it to the beginning of the global font list.
    Returns 0 upon success, nonzero upon failure.  */
 grub_font_t
@@ -608,6 +725,8 @@ grub_font_load (const char *filename)
 			    sizeof (FONT_FORMAT_SECTION_NAMES_DATA) - 1) == 0)
 	{
 	  /* When the DATA section marker is reached, we stop reading.  */
+	  if (load_font_data (file, font) != 0)
+	    goto fail;
 	  break;
 	}
       else
@@ -646,6 +765,14 @@ grub_font_load (const char *filename)
       goto fail;
     }
 
+  /* Everything is in memory already.  */
+  if (font->data)
+    {
+      grub_file_close (file);
+      font->file = 0;
+      file = 0;
+    }
+
   /* Add the font to the global font registry.  */
   if (register_font (font) != 0)
     goto fail;
@@ -662,23 +789,27 @@ fail:
   return 0;
 }
 
-/* Read a 16-bit big-endian integer from FILE, convert it to native byte
-   order, and store it in *VALUE.
-   Returns 0 on success, 1 on failure.  */
-static int
-read_be_uint16 (grub_file_t file, grub_uint16_t * value)
+/* Search the entries [LO, HI) of the character index of FONT, which is
+   ordered by code point, for CODE.  */
+static inline struct char_index_entry *
+search_glyph (const grub_font_t font, grub_uint32_t code,
+	      grub_size_t lo, grub_size_t hi)
 {
-  if (grub_file_read (file, value, 2) != 2)
-    return 1;
-  *value = grub_be_to_cpu16 (*value);
-  return 0;
-}
+  struct char_index_entry *table = font->char_index;
 
-static int
-read_be_int16 (grub_file_t file, grub_int16_t * value)
-{
-  /* For the signed integer version, use the same code as for unsigned.  */
-  return read_be_uint16 (file, (grub_uint16_t *) value);
+  while (lo < hi)
+    {
+      grub_size_t mid = lo + (hi - lo) / 2;
+
+      if (code < table[mid].code)
+	hi = mid;
+      else if (code > table[mid].code)
+	lo = mid + 1;
+      else
+	return &table[mid];
+    }
+
+  return 0;
 }
 
 /* Return a pointer to the character index entry for the glyph corresponding to
@@ -686,40 +817,89 @@ read_be_int16 (grub_file_t file, grub_int16_t * value)
 static inline struct char_index_entry *
 find_glyph (const grub_font_t font, grub_uint32_t code)
 {
-  struct char_index_entry *table;
-  grub_size_t lo;
-  grub_size_t hi;
-  grub_size_t mid;
-
-  table = font->char_index;
+  if (!font->char_index)
+    return 0;
 
   /* Use BMP index if possible.  */
   if (code < 0x10000 && font->bmp_idx)
     {
       if (font->bmp_idx[code] == 0xffff)
 	return 0;
-      return &table[font->bmp_idx[code]];
+      return &font->char_index[font->bmp_idx[code]];
+    }
+
+  /* Then the astral one.  */
+  if (code >= 0x10000 && code < FONT_ASTRAL_END && font->astral_idx)
+    {
+      grub_uint32_t block = (code - 0x10000) >> 8;
+
+      if (block >= font->astral_blocks)
+	return 0;
+      return search_glyph (font, code, font->astral_idx[block],
+			   font->astral_idx[block + 1]);
     }
 
   /* Do a binary search in `char_index', which is ordered by code point.  */
-  lo = 0;
-  hi = font->num_chars - 1;
+  return search_glyph (font, code, 0, font->num_chars);
+}
 
-  if (!table)
-    return 0;
+/* Whether alloc_glyph gets a glyph of SIZE bytes of FONT from the heap
+   rather than from an arena chunk.  */
+static inline int
+glyph_on_heap (grub_font_t font, grub_size_t size)
+{
+  return !font->data || size > FONT_GLYPH_ARENA_SIZE / 4;
+}
 
-  while (lo <= hi)
+/* Allocate SIZE bytes for a glyph of FONT.  Glyphs are never freed, so
+   those of fonts whose data is in memory are carved out of larger chunks.  */
+static struct grub_font_glyph *
+alloc_glyph (grub_font_t font, grub_size_t size)
+{
+  struct grub_font_glyph *glyph;
+
+  if (glyph_on_heap (font, size))
+    return grub_malloc (size);
+
+  size = ALIGN_UP (size, sizeof (void *));
+  if (font->glyph_arena_left < size)
     {
-      mid = lo + (hi - lo) / 2;
-      if (code < table[mid].code)
-	hi = mid - 1;
-      else if (code > table[mid].code)
-	lo = mid + 1;
-      else
-	return &table[mid];
+      font->glyph_arena = grub_malloc (FONT_GLYPH_ARENA_SIZE);
+      if (!font->glyph_arena)
+	{
+	  font->glyph_arena_left = 0;
+	  return 0;
+	}
+      font->glyph_arena_left = FONT_GLYPH_ARENA_SIZE;
     }
 
-  return 0;
+  glyph = (struct grub_font_glyph *) font->glyph_arena;
+  font->glyph_arena += size;
+  font->glyph_arena_left -= size;
+  return glyph;
+}
+
+/* Read LEN bytes at OFFSET of the font file of FONT into BUF.
+   Returns 0 on success, 1 on failure.  */
+static int
+read_glyph_data (grub_font_t font, grub_off_t offset, void *buf,
+		 grub_size_t len)
+{
+  if (font->data)
+    {
+      if (offset < font->data_start
+	  || offset - font->data_start > font->data_size
+	  || len > font->data_size - (offset - font->data_start))
+	return 1;
+      grub_memcpy (buf, font->data + (offset - font->data_start), len);
+      return 0;
+    }
+
+  if (!font->file)
+    return 1;
+  if (grub_file_seek (font->file, offset) == (grub_off_t) -1)
+    return 1;
+  return grub_file_read (font->file, buf, len) != (grub_ssize_t) len;
 }
 
 /* Get a glyph for the Unicode character CODE in FONT.  The glyph is loaded
@@ -734,18 +914,16 @@ grub_font_get_glyph_internal (grub_font_t font, grub_uint32_t code)
   if (index_entry)
     {
       struct grub_font_glyph *glyph = 0;
+      grub_uint8_t header[FONT_GLYPH_HEADER_SIZE];
       grub_uint16_t width;
       grub_uint16_t height;
-      grub_int16_t xoff;
-      grub_int16_t yoff;
-      grub_int16_t dwidth;
       int len;
 
       if (index_entry->glyph)
 	/* Return cached glyph.  */
 	return index_entry->glyph;
 
-      if (!font->file)
+      if (!font->file && !font->data)
 	/* No open file, can't load any glyphs.  */
 	return 0;
 
@@ -753,21 +931,18 @@ grub_font_get_glyph_internal (grub_font_t font, grub_uint32_t code)
          error message to error stack and reset error message.  */
       grub_error_push ();
 
-      grub_file_seek (font->file, index_entry->offset);
-
-      /* Read the glyph width, height, and baseline.  */
-      if (read_be_uint16 (font->file, &width) != 0
-	  || read_be_uint16 (font->file, &height) != 0
-	  || read_be_int16 (font->file, &xoff) != 0
-	  || read_be_int16 (font->file, &yoff) != 0
-	  || read_be_int16 (font->file, &dwidth) != 0)
+      /* Read the glyph width, height, baseline and device width.  */
+      if (read_glyph_data (font, index_entry->offset, header, sizeof (header)))
 	{
 	  remove_font (font);
 	  return 0;
 	}
 
+      width = grub_be_to_cpu16 (grub_get_unaligned16 (header + 0));
+      height = grub_be_to_cpu16 (grub_get_unaligned16 (header + 2));
+
       len = (width * height + 7) / 8;
-      glyph = grub_malloc (sizeof (struct grub_font_glyph) + len);
+      glyph = alloc_glyph (font, sizeof (struct grub_font_glyph) + len);
       if (!glyph)
 	{
 	  remove_font (font);
@@ -777,17 +952,20 @@ grub_font_get_glyph_internal (grub_font_t font, grub_uint32_t code)
       glyph->font = font;
       glyph->width = width;
       glyph->height = height;
-      glyph->offset_x = xoff;
-      glyph->offset_y = yoff;
-      glyph->device_width = dwidth;
+      glyph->offset_x = grub_be_to_cpu16 (grub_get_unaligned16 (header + 4));
+      glyph->offset_y = grub_be_to_cpu16 (grub_get_unaligned16 (header + 6));
+      glyph->device_width = grub_be_to_cpu16 (grub_get_unaligned16 (header + 8));
 
       /* Don't try to read empty bitmaps (e.g., space characters).  */
       if (len != 0)
 	{
-	  if (grub_file_read (font->file, glyph->bitmap, len) != len)
+	  if (read_glyph_data (font, index_entry->offset + sizeof (header),
+			       glyph->bitmap, len))
 	    {
 	      remove_font (font);
-	      grub_free (glyph);
+	      /* Glyphs of preloaded fonts may be part of an arena chunk.  */
+	      if (glyph_on_heap (font, sizeof (struct grub_font_glyph) + len))
+		grub_free (glyph);
 	      return 0;
 	    }
 	}
@@ -819,6 +997,8 @@ free_font (grub_font_t font)
       grub_free (font->family);
       grub_free (font->char_index);
       grub_free (font->bmp_idx);
+      grub_free (font->astral_idx);
+      grub_free (font->data);
       grub_free (font);
     }
 }
@@ -839,6 +1019,9 @@ register_font (grub_font_t font)
   node->next = grub_font_list;
   grub_font_list = node;
 
+  /* Glyphs rendered so far may have come from a fallback font.  */
+  grub_font_flush_rendered_glyphs ();
+
   return 0;
 }
 
@@ -1609,3 +1792,287 @@ grub_font_draw_glyph (struct grub_font_glyph * glyph,
 				 bitmap_left, bitmap_top,
 				 0, 0, glyph->width, glyph->height);
 }
+
+/* Glyphs already rendered in the pixel format of the target they are drawn
+   to, so that drawing them again is a plain blit.  Only glyphs without
+   combining characters or joining attributes are cached; the rest is
+   rendered every time.  */
+struct rendered_glyph
+{
+  struct rendered_glyph *next;
+
+  grub_font_t font;
+  grub_uint32_t code;
+
+  /* Mapped colors for indexed targets, packed RGBA otherwise.  */
+  grub_uint32_t fg;
+  grub_uint32_t bg;
+  int indexed;
+
+  /* Cell size and baseline or 0 if only the glyph itself is rendered.  */
+  unsigned cell_width;
+  unsigned cell_height;
+  int ascent;
+
+  /* Position of the rendered box relative to the pen position on the
+     baseline.  */
+  int offset_x;
+  int offset_y;
+  unsigned width;
+  unsigned height;
+  int device_width;
+
+  /* NULL for empty glyphs.  */
+  struct grub_video_render_target *target;
+};
+
+#define RENDERED_GLYPH_HASH_SIZE 256
+#define RENDERED_GLYPH_CACHE_SIZE (4 << 20)
+
+static struct rendered_glyph *rendered_glyphs[RENDERED_GLYPH_HASH_SIZE];
+static grub_size_t rendered_glyphs_size;
+
+void
+grub_font_flush_rendered_glyphs (void)
+{
+  unsigned i;
+
+  for (i = 0; i < RENDERED_GLYPH_HASH_SIZE; i++)
+    while (rendered_glyphs[i])
+      {
+	struct rendered_glyph *next = rendered_glyphs[i]->next;
+
+	if (rendered_glyphs[i]->target)
+	  grub_video_delete_render_target (rendered_glyphs[i]->target);
+	grub_free (rendered_glyphs[i]);
+	rendered_glyphs[i] = next;
+      }
+  rendered_glyphs_size = 0;
+}
+
+static inline unsigned
+rendered_glyph_hash (grub_font_t font, grub_uint32_t code,
+		     grub_uint32_t fg, grub_uint32_t bg)
+{
+  grub_uint32_t h = code * 0x9e3779b1;
+
+  h ^= fg * 31 + bg + (grub_uint32_t) (grub_addr_t) font;
+  return (h ^ (h >> 16)) % RENDERED_GLYPH_HASH_SIZE;
+}
+
+static grub_uint32_t
+pack_color (grub_video_color_t color)
+{
+  grub_uint8_t r, g, b, a;
+
+  grub_video_unmap_color (color, &r, &g, &b, &a);
+  return r | (g << 8) | (b << 16) | ((grub_uint32_t) a << 24);
+}
+
+static grub_video_color_t
+unpack_color (grub_uint32_t color)
+{
+  return grub_video_map_rgba (color & 0xff, (color >> 8) & 0xff,
+			      (color >> 16) & 0xff, color >> 24);
+}
+
+/* Find or render GLYPH_ID in colors FG and BG for the active target.  With
+   CELL_WIDTH of 0 only the glyph box is rendered over a transparent
+   background, otherwise the whole cell is filled with BG first.  Returns
+   NULL if the glyph can't be cached.  */
+static struct rendered_glyph *
+get_rendered_glyph (grub_font_t font,
+		    const struct grub_unicode_glyph *glyph_id,
+		    grub_video_color_t fg, grub_video_color_t bg,
+		    unsigned cell_width, unsigned cell_height, int ascent)
+{
+  struct grub_video_mode_info mode_info;
+  struct grub_video_render_target *old_target;
+  struct grub_font_glyph *glyph;
+  struct rendered_glyph *entry;
+  grub_uint32_t fg_key, bg_key;
+  grub_mm_tag_t old_tag;
+  grub_size_t size;
+  grub_err_t err;
+  unsigned h;
+  int indexed;
+
+  if (glyph_id->ncomb || glyph_id->attributes)
+    return NULL;
+
+  if (grub_video_get_info (&mode_info))
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return NULL;
+    }
+
+  indexed = !!(mode_info.mode_type & GRUB_VIDEO_MODE_TYPE_INDEX_COLOR);
+  if (indexed)
+    {
+      fg_key = fg;
+      bg_key = bg;
+    }
+  else
+    {
+      fg_key = pack_color (fg);
+      bg_key = cell_width ? pack_color (bg) : 0;
+    }
+
+  h = rendered_glyph_hash (font, glyph_id->base, fg_key, bg_key);
+  for (entry = rendered_glyphs[h]; entry; entry = entry->next)
+    if (entry->font == font && entry->code == glyph_id->base
+	&& entry->fg == fg_key && entry->bg == bg_key
+	&& entry->indexed == indexed
+	&& entry->cell_width == cell_width
+	&& entry->cell_height == cell_height
+	&& entry->ascent == ascent)
+      return entry;
+
+  glyph = grub_font_construct_glyph (font, glyph_id);
+  if (!glyph)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return NULL;
+    }
+
+  old_tag = grub_mm_tag_set (rendered_glyphs_tag);
+  entry = grub_zalloc (sizeof (*entry));
+  grub_mm_tag_set (old_tag);
+  if (!entry)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return NULL;
+    }
+
+  entry->font = font;
+  entry->code = glyph_id->base;
+  entry->fg = fg_key;
+  entry->bg = bg_key;
+  entry->indexed = indexed;
+  entry->cell_width = cell_width;
+  entry->cell_height = cell_height;
+  entry->ascent = ascent;
+  entry->device_width = glyph->device_width;
+  if (cell_width)
+    {
+      entry->offset_y = -ascent;
+      entry->width = cell_width;
+      entry->height = cell_height;
+    }
+  else
+    {
+      entry->offset_x = glyph->offset_x;
+      entry->offset_y = -(glyph->offset_y + glyph->height);
+      entry->width = glyph->width;
+      entry->height = glyph->height;
+    }
+
+  size = entry->width * entry->height * (indexed ? 1 : 4);
+  if (size > RENDERED_GLYPH_CACHE_SIZE / 16)
+    {
+      grub_free (entry);
+      return NULL;
+    }
+
+  if (size)
+    {
+      old_tag = grub_mm_tag_set (rendered_glyphs_tag);
+      err = grub_video_create_render_target (&entry->target,
+					     entry->width, entry->height,
+					     indexed
+					     ? (GRUB_VIDEO_MODE_TYPE_INDEX_COLOR
+						| GRUB_VIDEO_MODE_TYPE_ALPHA)
+					     : GRUB_VIDEO_MODE_TYPE_RGB);
+      grub_mm_tag_set (old_tag);
+      if (err)
+	{
+	  grub_free (entry);
+	  grub_errno = GRUB_ERR_NONE;
+	  return NULL;
+	}
+
+      grub_video_get_active_render_target (&old_target);
+      grub_video_set_active_render_target (entry->target);
+      if (!indexed)
+	{
+	  fg = unpack_color (fg_key);
+	  bg = unpack_color (bg_key);
+	}
+      if (cell_width)
+	grub_video_fill_rect (bg, 0, 0, entry->width, entry->height);
+      grub_font_draw_glyph (glyph, fg, -entry->offset_x, -entry->offset_y);
+      grub_video_set_active_render_target (old_target);
+    }
+
+  if (rendered_glyphs_size + size > RENDERED_GLYPH_CACHE_SIZE)
+    grub_font_flush_rendered_glyphs ();
+  rendered_glyphs_size += size;
+
+  entry->next = rendered_glyphs[h];
+  rendered_glyphs[h] = entry;
+
+  return entry;
+}
+
+/* Draw the glyph for GLYPH_ID on a WIDTH x HEIGHT cell with its top left
+   corner at (X, Y), filling the cell with BG first.  The baseline is
+   ASCENT pixels below Y.  */
+grub_err_t
+grub_font_draw_glyph_cell (grub_font_t font,
+			   const struct grub_unicode_glyph *glyph_id,
+			   grub_video_color_t fg, grub_video_color_t bg,
+			   int x, int y, unsigned width, unsigned height,
+			   int ascent)
+{
+  struct rendered_glyph *entry;
+  struct grub_font_glyph *glyph;
+
+  entry = get_rendered_glyph (font, glyph_id, fg, bg, width, height, ascent);
+  if (entry)
+    {
+      if (!entry->target)
+	return GRUB_ERR_NONE;
+      return grub_video_blit_render_target (entry->target,
+					    GRUB_VIDEO_BLIT_REPLACE, x, y,
+					    0, 0, width, height);
+    }
+
+  glyph = grub_font_construct_glyph (font, glyph_id);
+  if (!glyph)
+    return grub_errno;
+  grub_video_fill_rect (bg, x, y, width, height);
+  return grub_font_draw_glyph (glyph, fg, x, y + ascent);
+}
+
+/* Like grub_font_draw_glyph but for GLYPH_ID in FONT, going through the
+   cache of rendered glyphs.  The device width of the glyph is stored in
+   *DEVICE_WIDTH.  */
+grub_err_t
+grub_font_draw_glyph_cached (grub_font_t font,
+			     const struct grub_unicode_glyph *glyph_id,
+			     grub_video_color_t color,
+			     int left_x, int baseline_y, int *device_width)
+{
+  struct rendered_glyph *entry;
+  struct grub_font_glyph *glyph;
+
+  entry = get_rendered_glyph (font, glyph_id, color, 0, 0, 0, 0);
+  if (entry)
+    {
+      *device_width = entry->device_width;
+      if (!entry->target)
+	return GRUB_ERR_NONE;
+      return grub_video_blit_render_target (entry->target,
+					    GRUB_VIDEO_BLIT_BLEND,
+					    left_x + entry->offset_x,
+					    baseline_y + entry->offset_y,
+					    0, 0, entry->width,
+					    entry->height);
+    }
+
+  glyph = grub_font_construct_glyph (font, glyph_id);
+  if (!glyph)
+    return grub_errno;
+  *device_width = glyph->device_width;
+  return grub_font_draw_glyph (glyph, color, left_x, baseline_y);
+}
@@ -89,4 +89,5 @@ GRUB_MOD_FINI(font)
 
   grub_unregister_command (cmd_loadfont);
   grub_unregister_command (cmd_lsfonts);
+  grub_font_loader_fini ();
 }
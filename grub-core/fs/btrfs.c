@@ -107,8 +107,6 @@ struct grub_btrfs_device_desc
 struct grub_btrfs_data
 {
   struct grub_btrfs_superblock sblock;
-  grub_uint64_t tree;
-  grub_uint64_t inode;
 
   struct grub_btrfs_device_desc *devices_attached;
   unsigned n_devices_attached;
@@ -123,6 +121,13 @@ struct grub_btrfs_data
   struct grub_btrfs_extent_data *extent;
 };
 
+/* What a file opened on a shared mount needs of its own.  */
+struct grub_btrfs_file
+{
+  grub_uint64_t tree;
+  grub_uint64_t inode;
+};
+
 struct grub_btrfs_chunk_item
 {
   grub_uint64_t size;
@@ -2059,48 +2064,58 @@ out:
   return -r;
 }
 
+static grub_err_t
+grub_btrfs_fs_mount (grub_device_t device, void **data)
+{
+  *data = grub_btrfs_mount (device);
+  return grub_errno;
+}
+
+static void
+grub_btrfs_fs_unmount (void *data)
+{
+  grub_btrfs_unmount (data);
+}
+
+/* The filesystem is mounted already and shared, so FILE only keeps which
+   inode of which tree it is.  */
 static grub_err_t
 grub_btrfs_open (struct grub_file *file, const char *name)
 {
-  struct grub_btrfs_data *data = grub_btrfs_mount (file->device);
+  struct grub_btrfs_data *data = file->mount;
+  struct grub_btrfs_file *bfile;
   grub_err_t err;
   struct grub_btrfs_inode inode;
   grub_uint8_t type;
   struct grub_btrfs_key key_in;
+  grub_uint64_t tree;
 
-  if (!data)
-    return grub_errno;
-
-  err = find_path (data, name, &key_in, &data->tree, &type);
+  err = find_path (data, name, &key_in, &tree, &type);
   if (err)
-    {
-      grub_btrfs_unmount (data);
-      return err;
-    }
+    return err;
   if (type != GRUB_BTRFS_DIR_ITEM_TYPE_REGULAR)
-    {
-      grub_btrfs_unmount (data);
-      return grub_error (GRUB_ERR_BAD_FILE_TYPE, N_("not a regular file"));
-    }
+    return grub_error (GRUB_ERR_BAD_FILE_TYPE, N_("not a regular file"));
 
-  data->inode = key_in.object_id;
-  err = grub_btrfs_read_inode (data, &inode, data->inode, data->tree);
+  err = grub_btrfs_read_inode (data, &inode, key_in.object_id, tree);
   if (err)
-    {
-      grub_btrfs_unmount (data);
-      return err;
-    }
+    return err;
+
+  bfile = grub_malloc (sizeof (*bfile));
+  if (!bfile)
+    return grub_errno;
+  bfile->tree = tree;
+  bfile->inode = key_in.object_id;
 
-  file->data = data;
+  file->data = bfile;
   file->size = grub_le_to_cpu64 (inode.size);
 
-  return err;
+  return GRUB_ERR_NONE;
 }
 
 static grub_err_t
 grub_btrfs_close (grub_file_t file)
 {
-  grub_btrfs_unmount (file->data);
+  grub_free (file->data);
 
   return GRUB_ERR_NONE;
 }
@@ -2108,10 +2123,10 @@ grub_btrfs_close (grub_file_t file)
 static grub_ssize_t
 grub_btrfs_read (grub_file_t file, char *buf, grub_size_t len)
 {
-  struct grub_btrfs_data *data = file->data;
+  struct grub_btrfs_file *bfile = file->data;
 
-  return grub_btrfs_extent_read (data, data->inode,
-				 data->tree, file->offset, buf, len);
+  return grub_btrfs_extent_read (file->mount, bfile->inode,
+				 bfile->tree, file->offset, buf, len);
 }
 
 static grub_err_t
@@ -2190,14 +2205,24 @@ grub_btrfs_embed (grub_device_t device __attribute__ ((unused)),
 }
 #endif
 
+/* The primary superblock, which must be valid.  */
+static const struct grub_fs_signature grub_btrfs_signatures[] = {
+  GRUB_FS_SIGNATURE (64 * 1024 + 0x40, sizeof (GRUB_BTRFS_SIGNATURE) - 1,
+		     GRUB_BTRFS_SIGNATURE),
+  { 0, 0, 0 }
+};
+
 static struct grub_fs grub_btrfs_fs = {
   .name = "btrfs",
   .fs_dir = grub_btrfs_dir,
   .fs_open = grub_btrfs_open,
+  .fs_mount = grub_btrfs_fs_mount,
+  .fs_unmount = grub_btrfs_fs_unmount,
   .fs_read = grub_btrfs_read,
   .fs_close = grub_btrfs_close,
   .fs_uuid = grub_btrfs_uuid,
   .fs_label = grub_btrfs_label,
+  .signatures = grub_btrfs_signatures,
 #ifdef GRUB_UTIL
   .fs_embed = grub_btrfs_embed,
   .reserved_first_sector = 1,
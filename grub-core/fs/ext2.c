@@ -853,23 +853,30 @@ grub_ext2_iterate_dir (grub_fshelp_node_t dir,
   return 0;
 }
 
-/* Open a file named NAME and initialize FILE.  */
+static grub_err_t
+grub_ext2_fs_mount (grub_device_t device, void **data)
+{
+  *data = grub_ext2_mount (device->disk);
+  return grub_errno;
+}
+
+static void
+grub_ext2_fs_unmount (void *data)
+{
+  grub_free (data);
+}
+
+/* Open a file named NAME and initialize FILE.  The filesystem is mounted
+   already and shared, so FILE gets a node of its own.  */
 static grub_err_t
 grub_ext2_open (struct grub_file *file, const char *name)
 {
-  struct grub_ext2_data *data;
+  struct grub_ext2_data *data = file->mount;
   struct grub_fshelp_node *fdiro = 0;
   grub_err_t err;
 
   grub_dl_ref (my_mod);
 
-  data = grub_ext2_mount (file->device->disk);
-  if (! data)
-    {
-      err = grub_errno;
-      goto fail;
-    }
-
   err = grub_fshelp_find_file (name, &data->diropen, &fdiro,
 			       grub_ext2_iterate_dir,
 			       grub_ext2_read_symlink, GRUB_FSHELP_REG);
@@ -889,12 +896,20 @@ grub_ext2_open (struct grub_file *file, const char *name)
       goto fail;
     }
 
-  grub_memcpy (data->inode, &fdiro->inode, sizeof (struct grub_ext2_inode));
-  grub_free (fdiro);
+  if (fdiro == &data->diropen)
+    {
+      fdiro = grub_malloc (sizeof (*fdiro));
+      if (! fdiro)
+	{
+	  err = grub_errno;
+	  goto fail;
+	}
+      grub_memcpy (fdiro, &data->diropen, sizeof (*fdiro));
+    }
 
-  file->size = grub_le_to_cpu32 (data->inode->size);
-  file->size |= ((grub_off_t) grub_le_to_cpu32 (data->inode->size_high)) << 32;
-  file->data = data;
+  file->size = grub_le_to_cpu32 (fdiro->inode.size);
+  file->size |= ((grub_off_t) grub_le_to_cpu32 (fdiro->inode.size_high)) << 32;
+  file->data = fdiro;
   file->offset = 0;
 
   return 0;
@@ -902,7 +917,6 @@ grub_ext2_open (struct grub_file *file, const char *name)
  fail:
   if (fdiro != &data->diropen)
     grub_free (fdiro);
-  grub_free (data);
 
   grub_dl_unref (my_mod);
 
@@ -923,9 +937,7 @@ grub_ext2_close (grub_file_t file)
 static grub_ssize_t
 grub_ext2_read (grub_file_t file, char *buf, grub_size_t len)
 {
-  struct grub_ext2_data *data = (struct grub_ext2_data *) file->data;
-
-  return grub_ext2_read_file (&data->diropen,
+  return grub_ext2_read_file (file->data,
 			      file->read_hook, file->read_hook_data,
 			      file->offset, len, buf);
 }
@@ -1078,16 +1090,26 @@ grub_ext2_mtime (grub_device_t device, grub_int32_t *tm)
 
 
 
+/* The superblock magic, EXT2_MAGIC in little endian.  */
+static const struct grub_fs_signature grub_ext2_signatures[] =
+  {
+    GRUB_FS_SIGNATURE (1024 + 56, 2, "\x53\xef"),
+    { 0, 0, 0 }
+  };
+
 static struct grub_fs grub_ext2_fs =
   {
     .name = "ext2",
     .fs_dir = grub_ext2_dir,
     .fs_open = grub_ext2_open,
+    .fs_mount = grub_ext2_fs_mount,
+    .fs_unmount = grub_ext2_fs_unmount,
     .fs_read = grub_ext2_read,
     .fs_close = grub_ext2_close,
     .fs_label = grub_ext2_label,
     .fs_uuid = grub_ext2_uuid,
     .fs_mtime = grub_ext2_mtime,
+    .signatures = grub_ext2_signatures,
 #ifdef GRUB_UTIL
     .reserved_first_sector = 1,
     .blocklist_install = 1,
@@ -1301,6 +1301,13 @@ grub_f2fs_uuid (grub_device_t device, char **uuid)
   return grub_errno;
 }
 
+/* F2FS_SUPER_MAGIC in little endian, in either superblock.  */
+static const struct grub_fs_signature grub_f2fs_signatures[] = {
+  GRUB_FS_SIGNATURE (F2FS_SUPER_OFFSET, 4, "\x10\x20\xf5\xf2"),
+  GRUB_FS_SIGNATURE (F2FS_SUPER_OFFSET + F2FS_BLKSIZE, 4, "\x10\x20\xf5\xf2"),
+  { 0, 0, 0 }
+};
+
 static struct grub_fs grub_f2fs_fs = {
   .name                  = "f2fs",
   .fs_dir                   = grub_f2fs_dir,
@@ -1309,6 +1316,7 @@ static struct grub_fs grub_f2fs_fs = {
   .fs_close                 = grub_f2fs_close,
   .fs_label                 = grub_f2fs_label,
   .fs_uuid                  = grub_f2fs_uuid,
+  .signatures               = grub_f2fs_signatures,
 #ifdef GRUB_UTIL
   .reserved_first_sector = 1,
   .blocklist_install     = 0,
@@ -1283,6 +1283,14 @@ grub_disk_addr_t
 }
 #endif
 
+#ifdef MODE_EXFAT
+static const struct grub_fs_signature grub_exfat_signatures[] =
+  {
+    GRUB_FS_SIGNATURE (3, 8, "EXFAT   "),
+    { 0, 0, 0 }
+  };
+#endif
+
 static struct grub_fs grub_fat_fs =
   {
 #ifdef MODE_EXFAT
@@ -1296,6 +1304,9 @@ static struct grub_fs grub_fat_fs =
     .fs_close = grub_fat_close,
     .fs_label = grub_fat_label,
     .fs_uuid = grub_fat_uuid,
+#ifdef MODE_EXFAT
+    .signatures = grub_exfat_signatures,
+#endif
 #ifdef GRUB_UTIL
 #ifdef MODE_EXFAT
     /* ExFAT BPB is 30 larger than FAT32 one.  */
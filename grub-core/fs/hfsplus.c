@@ -1131,6 +1131,15 @@ grub_hfsplus_uuid (grub_device_t device, char **uuid)
 
 
 
+/* HFS+, HFSX, or an HFS wrapper which may have HFS+ embedded.  */
+static const struct grub_fs_signature grub_hfsplus_signatures[] =
+  {
+    GRUB_FS_SIGNATURE (GRUB_HFSPLUS_SBLOCK << GRUB_DISK_SECTOR_BITS, 2, "H+"),
+    GRUB_FS_SIGNATURE (GRUB_HFSPLUS_SBLOCK << GRUB_DISK_SECTOR_BITS, 2, "HX"),
+    GRUB_FS_SIGNATURE (GRUB_HFSPLUS_SBLOCK << GRUB_DISK_SECTOR_BITS, 2, "BD"),
+    { 0, 0, 0 }
+  };
+
 static struct grub_fs grub_hfsplus_fs =
   {
     .name = "hfsplus",
@@ -1141,6 +1150,7 @@ static struct grub_fs grub_hfsplus_fs =
     .fs_label = grub_hfsplus_label,
     .fs_mtime = grub_hfsplus_mtime,
     .fs_uuid = grub_hfsplus_uuid,
+    .signatures = grub_hfsplus_signatures,
 #ifdef GRUB_UTIL
     .reserved_first_sector = 1,
     .blocklist_install = 1,
@@ -1133,6 +1133,14 @@ grub_iso9660_mtime (grub_device_t device, grub_int32_t *timebuf)
 
 
 
+/* The first volume descriptor, in block 16.  */
+static const struct grub_fs_signature grub_iso9660_signatures[] =
+  {
+    GRUB_FS_SIGNATURE ((16 << (GRUB_ISO9660_LOG2_BLKSZ
+			+ GRUB_DISK_SECTOR_BITS)) + 1, 5, "CD001"),
+    { 0, 0, 0 }
+  };
+
 static struct grub_fs grub_iso9660_fs =
   {
     .name = "iso9660",
@@ -1143,6 +1151,7 @@ static struct grub_fs grub_iso9660_fs =
     .fs_label = grub_iso9660_label,
     .fs_uuid = grub_iso9660_uuid,
     .fs_mtime = grub_iso9660_mtime,
+    .signatures = grub_iso9660_signatures,
 #ifdef GRUB_UTIL
     .reserved_first_sector = 1,
     .blocklist_install = 1,
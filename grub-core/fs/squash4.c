@@ -194,7 +194,6 @@ struct grub_squash_data
 {
   grub_disk_t disk;
   struct grub_squash_super sb;
-  struct grub_squash_cache_inode ino;
   grub_uint64_t fragments;
   int log2_blksz;
   grub_size_t blksz;
@@ -654,8 +653,6 @@ squash_unmount (struct grub_squash_data *data)
   if (data->xzdec)
     xz_dec_end (data->xzdec);
   grub_free (data->xzbuf);
-  grub_free (data->ino.cumulated_block_sizes);
-  grub_free (data->ino.block_sizes);
   grub_free (data);
 }
 
@@ -711,18 +708,30 @@ grub_squash_dir (grub_device_t device, const char *path,
   return grub_errno;
 }
 
+static grub_err_t
+grub_squash_fs_mount (grub_device_t device, void **data)
+{
+  *data = squash_mount (device->disk);
+  return grub_errno;
+}
+
+static void
+grub_squash_fs_unmount (void *data)
+{
+  squash_unmount (data);
+}
+
+/* The filesystem is mounted already and shared, so FILE gets an inode of
+   its own.  */
 static grub_err_t
 grub_squash_open (struct grub_file *file, const char *name)
 {
-  struct grub_squash_data *data = 0;
+  struct grub_squash_data *data = file->mount;
+  struct grub_squash_cache_inode *ino;
   struct grub_fshelp_node *fdiro = 0;
   struct grub_fshelp_node root;
   grub_err_t err;
 
-  data = squash_mount (file->device->disk);
-  if (! data)
-    return grub_errno;
-
   err = make_root_node (data, &root);
   if (err)
     return err;
@@ -730,17 +739,18 @@ grub_squash_open (struct grub_file *file, const char *name)
   grub_fshelp_find_file (name, &root, &fdiro, grub_squash_iterate_dir,
 			 grub_squash_read_symlink, GRUB_FSHELP_REG);
   if (grub_errno)
+    return grub_errno;
+
+  ino = grub_zalloc (sizeof (*ino));
+  if (! ino)
     {
-      squash_unmount (data);
+      grub_free (fdiro);
       return grub_errno;
     }
-
-  file->data = data;
-  data->ino.ino = fdiro->ino;
-  data->ino.block_sizes = NULL;
-  data->ino.cumulated_block_sizes = NULL;
-  data->ino.ino_chunk = fdiro->stack[fdiro->stsize - 1].ino_chunk;
-  data->ino.ino_offset = fdiro->stack[fdiro->stsize - 1].ino_offset;
+  file->data = ino;
+  ino->ino = fdiro->ino;
+  ino->ino_chunk = fdiro->stack[fdiro->stsize - 1].ino_chunk;
+  ino->ino_offset = fdiro->stack[fdiro->stsize - 1].ino_offset;
 
   switch (fdiro->ino.type)
     {
@@ -754,7 +764,8 @@ grub_squash_open (struct grub_file *file, const char *name)
       {
 	grub_uint16_t type = grub_le_to_cpu16 (fdiro->ino.type);
 	grub_free (fdiro);
-	squash_unmount (data);
+	grub_free (ino);
+	file->data = 0;
 	return grub_error (GRUB_ERR_BAD_FS, "unexpected ino type 0x%x", type);
       }
     }
@@ -903,8 +914,8 @@ direct_read (struct grub_squash_data *data,
 static grub_ssize_t
 grub_squash_read (grub_file_t file, char *buf, grub_size_t len)
 {
-  struct grub_squash_data *data = file->data;
-  struct grub_squash_cache_inode *ino = &data->ino;
+  struct grub_squash_data *data = file->mount;
+  struct grub_squash_cache_inode *ino = file->data;
   grub_off_t off = file->offset;
   grub_err_t err;
   grub_uint64_t a, b;
@@ -998,7 +1009,11 @@ grub_squash_read (grub_file_t file, char *buf, grub_size_t len)
 static grub_err_t
 grub_squash_close (grub_file_t file)
 {
-  squash_unmount (file->data);
+  struct grub_squash_cache_inode *ino = file->data;
+
+  grub_free (ino->cumulated_block_sizes);
+  grub_free (ino->block_sizes);
+  grub_free (ino);
   return GRUB_ERR_NONE;
 }
 
@@ -1015,14 +1030,24 @@ grub_squash_mtime (grub_device_t dev, grub_int32_t *tm)
   return GRUB_ERR_NONE;
 } 
 
+/* SQUASH_MAGIC in little endian.  */
+static const struct grub_fs_signature grub_squash_signatures[] =
+  {
+    GRUB_FS_SIGNATURE (0, 4, "hsqs"),
+    { 0, 0, 0 }
+  };
+
 static struct grub_fs grub_squash_fs =
   {
     .name = "squash4",
     .fs_dir = grub_squash_dir,
     .fs_open = grub_squash_open,
+    .fs_mount = grub_squash_fs_mount,
+    .fs_unmount = grub_squash_fs_unmount,
     .fs_read = grub_squash_read,
     .fs_close = grub_squash_close,
     .fs_mtime = grub_squash_mtime,
+    .signatures = grub_squash_signatures,
 #ifdef GRUB_UTIL
     .reserved_first_sector = 0,
     .blocklist_install = 0,
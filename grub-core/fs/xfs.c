@@ -1011,19 +1011,36 @@ grub_xfs_dir (grub_device_t device, const char *path,
 }
 
 
-/* Open a file named NAME and initialize FILE.  */
+/* Read the superblock and root directory of the filesystem on DEVICE,
+   to be shared by the files opened on it.  */
+static grub_err_t
+grub_xfs_fs_mount (grub_device_t device, void **data)
+{
+  *data = grub_xfs_mount (device->disk);
+  if (*data && grub_errno)
+    {
+      grub_free (*data);
+      *data = 0;
+    }
+  return grub_errno;
+}
+
+static void
+grub_xfs_fs_unmount (void *data)
+{
+  grub_free (data);
+}
+
+/* The filesystem is mounted already and shared, so FILE gets a node of its
+   own.  */
 static grub_err_t
 grub_xfs_open (struct grub_file *file, const char *name)
 {
-  struct grub_xfs_data *data;
+  struct grub_xfs_data *data = file->mount;
   struct grub_fshelp_node *fdiro = 0;
 
   grub_dl_ref (my_mod);
 
-  data = grub_xfs_mount (file->device->disk);
-  if (!data)
-    goto mount_fail;
-
   grub_fshelp_find_file (name, &data->diropen, &fdiro, grub_xfs_iterate_dir,
 			 grub_xfs_read_symlink, GRUB_FSHELP_REG);
   if (grub_errno)
@@ -1036,14 +1053,16 @@ grub_xfs_open (struct grub_file *file, const char *name)
 	goto fail;
     }
 
-  if (fdiro != &data->diropen)
+  if (fdiro == &data->diropen)
     {
-      grub_memcpy (&data->diropen, fdiro, grub_xfs_fshelp_size(data));
-      grub_free (fdiro);
+      fdiro = grub_malloc (grub_xfs_fshelp_size(data) + 1);
+      if (!fdiro)
+	goto fail;
+      grub_memcpy (fdiro, &data->diropen, grub_xfs_fshelp_size(data));
     }
 
-  file->size = grub_be_to_cpu64 (data->diropen.inode.size);
-  file->data = data;
+  file->size = grub_be_to_cpu64 (fdiro->inode.size);
+  file->data = fdiro;
   file->offset = 0;
 
   return 0;
@@ -1051,9 +1070,7 @@ grub_xfs_open (struct grub_file *file, const char *name)
  fail:
   if (fdiro != &data->diropen)
     grub_free (fdiro);
-  grub_free (data);
 
- mount_fail:
   grub_dl_unref (my_mod);
 
   return grub_errno;
@@ -1063,10 +1080,7 @@ grub_xfs_open (struct grub_file *file, const char *name)
 static grub_ssize_t
 grub_xfs_read (grub_file_t file, char *buf, grub_size_t len)
 {
-  struct grub_xfs_data *data =
-    (struct grub_xfs_data *) file->data;
-
-  return grub_xfs_read_file (&data->diropen,
+  return grub_xfs_read_file (file->data,
 			     file->read_hook, file->read_hook_data,
 			     file->offset, len, buf, 0);
 }
@@ -1137,15 +1151,24 @@ grub_xfs_uuid (grub_device_t device, char **uuid)
 
 
 
+static const struct grub_fs_signature grub_xfs_signatures[] =
+  {
+    GRUB_FS_SIGNATURE (0, 4, "XFSB"),
+    { 0, 0, 0 }
+  };
+
 static struct grub_fs grub_xfs_fs =
   {
     .name = "xfs",
     .fs_dir = grub_xfs_dir,
     .fs_open = grub_xfs_open,
+    .fs_mount = grub_xfs_fs_mount,
+    .fs_unmount = grub_xfs_fs_unmount,
     .fs_read = grub_xfs_read,
     .fs_close = grub_xfs_close,
     .fs_label = grub_xfs_label,
     .fs_uuid = grub_xfs_uuid,
+    .signatures = grub_xfs_signatures,
 #ifdef GRUB_UTIL
     .reserved_first_sector = 0,
     .blocklist_install = 1,
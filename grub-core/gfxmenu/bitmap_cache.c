@@ -0,0 +1,356 @@
+/* bitmap_cache.c - Cache of theme bitmaps shared by gfxmenu components.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/bitmap.h>
+#include <grub/bitmap_scale.h>
+#include <grub/gfxmenu_view.h>
+
+/* Bitmaps are looked up by file name, size and scaling, so every icon,
+   pixmap and background is decoded and scaled once no matter how many
+   components use it.  Entries nobody holds a reference to are kept up to
+   BITMAP_CACHE_IDLE_MAX bytes, which lets them survive the destruction of
+   the view when a theme is reloaded or the video mode changes.  */
+#define BITMAP_CACHE_IDLE_MAX	(64 << 20)
+
+struct bitmap_cache_entry
+{
+  char *path;
+
+  /* Zero for the bitmap as it was loaded from PATH.  */
+  int width;
+  int height;
+  grub_video_bitmap_selection_method_t selection_method;
+  grub_video_bitmap_v_align_t v_align;
+  grub_video_bitmap_h_align_t h_align;
+
+  struct grub_video_bitmap *bitmap;
+  grub_size_t size;
+  unsigned refs;
+  unsigned long last_use;
+  struct bitmap_cache_entry *next;
+};
+
+static struct bitmap_cache_entry *bitmap_cache;
+static unsigned long bitmap_cache_clock;
+
+/* Total size of the entries with no references.  */
+static grub_size_t bitmap_cache_idle;
+
+/* What the cache is charged to.  The idle entries are dropped when memory
+   runs out.  */
+static grub_mm_tag_t bitmap_cache_tag;
+static struct grub_mm_evictor bitmap_cache_evictor =
+  {
+    .evict = grub_gfxmenu_bitmap_cache_flush
+  };
+
+static struct bitmap_cache_entry *
+find_entry (const char *path, int width, int height,
+	    grub_video_bitmap_selection_method_t selection_method,
+	    grub_video_bitmap_v_align_t v_align,
+	    grub_video_bitmap_h_align_t h_align)
+{
+  struct bitmap_cache_entry *e;
+
+  for (e = bitmap_cache; e; e = e->next)
+    if (e->width == width && e->height == height
+	&& e->selection_method == selection_method
+	&& e->v_align == v_align && e->h_align == h_align
+	&& grub_strcmp (e->path, path) == 0)
+      return e;
+  return 0;
+}
+
+static struct bitmap_cache_entry *
+find_bitmap (struct grub_video_bitmap *bitmap)
+{
+  struct bitmap_cache_entry *e;
+
+  for (e = bitmap_cache; e; e = e->next)
+    if (e->bitmap == bitmap)
+      return e;
+  return 0;
+}
+
+static struct grub_video_bitmap *
+ref_entry (struct bitmap_cache_entry *e)
+{
+  if (e->refs++ == 0)
+    bitmap_cache_idle -= e->size;
+  e->last_use = ++bitmap_cache_clock;
+  return e->bitmap;
+}
+
+static void
+remove_entry (struct bitmap_cache_entry *e)
+{
+  struct bitmap_cache_entry **p;
+
+  for (p = &bitmap_cache; *p; p = &(*p)->next)
+    if (*p == e)
+      {
+	*p = e->next;
+	break;
+      }
+  if (e->refs == 0)
+    bitmap_cache_idle -= e->size;
+  grub_video_bitmap_destroy (e->bitmap);
+  grub_free (e->path);
+  grub_free (e);
+}
+
+/* Drop the least recently used idle entries until they fit in LIMIT.  */
+static void
+trim_cache (grub_size_t limit)
+{
+  while (bitmap_cache_idle > limit)
+    {
+      struct bitmap_cache_entry *e, *oldest = 0;
+
+      for (e = bitmap_cache; e; e = e->next)
+	if (e->refs == 0 && (! oldest || e->last_use < oldest->last_use))
+	  oldest = e;
+      if (! oldest)
+	break;
+      remove_entry (oldest);
+    }
+}
+
+/* Add BITMAP to the cache with one reference.  If that fails BITMAP is
+   simply not cached, and grub_gfxmenu_bitmap_cache_release destroys it
+   in the end.  */
+static void
+insert_entry (struct grub_video_bitmap *bitmap, const char *path,
+	      int width, int height,
+	      grub_video_bitmap_selection_method_t selection_method,
+	      grub_video_bitmap_v_align_t v_align,
+	      grub_video_bitmap_h_align_t h_align)
+{
+  struct bitmap_cache_entry *e;
+
+  e = grub_malloc (sizeof (*e));
+  if (! e)
+    goto fail;
+  e->path = grub_strdup (path);
+  if (! e->path)
+    {
+      grub_free (e);
+      goto fail;
+    }
+
+  e->width = width;
+  e->height = height;
+  e->selection_method = selection_method;
+  e->v_align = v_align;
+  e->h_align = h_align;
+  e->bitmap = bitmap;
+  e->size = sizeof (*bitmap) + (grub_size_t) bitmap->mode_info.pitch
+    * bitmap->mode_info.height;
+  e->refs = 1;
+  e->last_use = ++bitmap_cache_clock;
+  e->next = bitmap_cache;
+  bitmap_cache = e;
+  return;
+
+ fail:
+  grub_errno = GRUB_ERR_NONE;
+}
+
+static grub_err_t
+load_bitmap (struct grub_video_bitmap **bitmap,
+	     const char *path, int width, int height,
+	     grub_video_bitmap_selection_method_t selection_method,
+	     grub_video_bitmap_v_align_t v_align,
+	     grub_video_bitmap_h_align_t h_align)
+{
+  struct bitmap_cache_entry *e;
+  struct grub_video_bitmap *raw = 0;
+  int own_raw = 0;
+
+  *bitmap = 0;
+
+  if (width <= 0 || height <= 0)
+    width = height = 0;
+  /* Alignment means nothing unless part of the bitmap is padded or
+     cropped.  */
+  if (width == 0
+      || selection_method == GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH)
+    {
+      selection_method = GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH;
+      v_align = GRUB_VIDEO_BITMAP_V_ALIGN_TOP;
+      h_align = GRUB_VIDEO_BITMAP_H_ALIGN_LEFT;
+    }
+
+  e = find_entry (path, width, height, selection_method, v_align, h_align);
+  if (e)
+    {
+      *bitmap = ref_entry (e);
+      return GRUB_ERR_NONE;
+    }
+
+  if (width == 0)
+    {
+      if (grub_video_bitmap_load (&raw, path) != GRUB_ERR_NONE)
+	return grub_errno;
+      insert_entry (raw, path, 0, 0, selection_method, v_align, h_align);
+      trim_cache (BITMAP_CACHE_IDLE_MAX);
+      *bitmap = raw;
+      return GRUB_ERR_NONE;
+    }
+
+  /* Scale the loaded bitmap if it is cached, otherwise decode the file
+     just for this.  Stretching needs no more than WIDTH x HEIGHT pixels so
+     the reader may return a smaller bitmap.  The cached one is referenced
+     while it is scaled so that it is not evicted in the meantime.  */
+  e = find_entry (path, 0, 0, GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH,
+		  GRUB_VIDEO_BITMAP_V_ALIGN_TOP, GRUB_VIDEO_BITMAP_H_ALIGN_LEFT);
+  if (e)
+    raw = ref_entry (e);
+  else
+    {
+      if (selection_method == GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH)
+	grub_video_bitmap_load_scaled (&raw, path, width, height);
+      else
+	grub_video_bitmap_load (&raw, path);
+      if (! raw)
+	return grub_errno;
+      own_raw = 1;
+    }
+
+  if (selection_method == GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH)
+    grub_video_bitmap_create_scaled (bitmap, width, height, raw,
+				     GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
+  else
+    grub_video_bitmap_scale_proportional (bitmap, width, height, raw,
+					  GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST,
+					  selection_method, v_align, h_align);
+  if (own_raw)
+    grub_video_bitmap_destroy (raw);
+  else
+    grub_gfxmenu_bitmap_cache_release (raw);
+  if (! *bitmap)
+    return grub_errno;
+
+  insert_entry (*bitmap, path, width, height,
+		selection_method, v_align, h_align);
+  trim_cache (BITMAP_CACHE_IDLE_MAX);
+  return GRUB_ERR_NONE;
+}
+
+/* Load the bitmap in PATH scaled to WIDTH x HEIGHT with SELECTION_METHOD
+   and the given alignment, or as it is if WIDTH or HEIGHT is 0.  The
+   bitmap is shared and must be released with
+   grub_gfxmenu_bitmap_cache_release, not destroyed.  */
+grub_err_t
+grub_gfxmenu_bitmap_cache_load (struct grub_video_bitmap **bitmap,
+				const char *path, int width, int height,
+				grub_video_bitmap_selection_method_t
+				selection_method,
+				grub_video_bitmap_v_align_t v_align,
+				grub_video_bitmap_h_align_t h_align)
+{
+  grub_mm_tag_t old_tag;
+  grub_err_t err;
+
+  old_tag = grub_mm_tag_set (bitmap_cache_tag);
+  err = load_bitmap (bitmap, path, width, height, selection_method,
+		     v_align, h_align);
+  grub_mm_tag_set (old_tag);
+  return err;
+}
+
+/* Stretch SRC to WIDTH x HEIGHT.  If SRC came from
+   grub_gfxmenu_bitmap_cache_load, the result is shared with everybody who
+   scales the same file to the same size, and may even be SRC itself.
+   Either way it must be released with grub_gfxmenu_bitmap_cache_release.  */
+grub_err_t
+grub_gfxmenu_bitmap_cache_scale (struct grub_video_bitmap **bitmap,
+				 struct grub_video_bitmap *src,
+				 int width, int height)
+{
+  struct bitmap_cache_entry *e;
+
+  e = find_bitmap (src);
+  if (! e || e->width != 0 || width <= 0 || height <= 0)
+    return grub_video_bitmap_create_scaled (bitmap, width, height, src,
+					    GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
+
+  if ((int) grub_video_bitmap_get_width (src) == width
+      && (int) grub_video_bitmap_get_height (src) == height)
+    {
+      *bitmap = ref_entry (e);
+      return GRUB_ERR_NONE;
+    }
+
+  return grub_gfxmenu_bitmap_cache_load (bitmap, e->path, width, height,
+					 GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH,
+					 GRUB_VIDEO_BITMAP_V_ALIGN_TOP,
+					 GRUB_VIDEO_BITMAP_H_ALIGN_LEFT);
+}
+
+/* Release a bitmap returned by grub_gfxmenu_bitmap_cache_load or
+   grub_gfxmenu_bitmap_cache_scale.  */
+void
+grub_gfxmenu_bitmap_cache_release (struct grub_video_bitmap *bitmap)
+{
+  struct bitmap_cache_entry *e;
+
+  if (! bitmap)
+    return;
+
+  e = find_bitmap (bitmap);
+  if (! e)
+    {
+      grub_video_bitmap_destroy (bitmap);
+      return;
+    }
+
+  if (--e->refs == 0)
+    {
+      bitmap_cache_idle += e->size;
+      trim_cache (BITMAP_CACHE_IDLE_MAX);
+    }
+}
+
+/* Free all cached bitmaps that are not in use.  */
+void
+grub_gfxmenu_bitmap_cache_flush (void)
+{
+  trim_cache (0);
+}
+
+void
+grub_gfxmenu_bitmap_cache_init (void)
+{
+  bitmap_cache_tag = grub_mm_tag_get ("bitmaps",
+				      grub_mm_tag_get ("caches", NULL));
+  bitmap_cache_evictor.tag = bitmap_cache_tag;
+  grub_mm_evictor_register (&bitmap_cache_evictor);
+}
+
+void
+grub_gfxmenu_bitmap_cache_fini (void)
+{
+  grub_mm_evictor_unregister (&bitmap_cache_evictor);
+  grub_gfxmenu_bitmap_cache_flush ();
+}
@@ -31,6 +31,87 @@
 #include <grub/fontformat.h>
 #include <grub/gfxmenu_view.h>
 
+/* Recently shaped strings.  Menu entry titles and labels are drawn over
+   and over again, so keep their visual order around.  */
+struct shaped_run
+{
+  char *str;
+  struct grub_unicode_glyph *visual;
+  grub_ssize_t visual_len;
+};
+
+#define SHAPED_RUN_CACHE_SIZE 32
+
+static struct shaped_run shaped_runs[SHAPED_RUN_CACHE_SIZE];
+static unsigned shaped_run_next;
+
+static void
+shaped_run_free (struct shaped_run *run)
+{
+  struct grub_unicode_glyph *ptr;
+
+  for (ptr = run->visual; ptr < run->visual + run->visual_len; ptr++)
+    grub_unicode_destroy_glyph (ptr);
+  grub_free (run->visual);
+  grub_free (run->str);
+  run->str = 0;
+  run->visual = 0;
+  run->visual_len = 0;
+}
+
+void
+grub_font_flush_shaped_runs (void)
+{
+  unsigned i;
+
+  for (i = 0; i < SHAPED_RUN_CACHE_SIZE; i++)
+    shaped_run_free (&shaped_runs[i]);
+  shaped_run_next = 0;
+}
+
+static struct shaped_run *
+get_shaped_run (const char *str)
+{
+  struct shaped_run *run;
+  grub_uint32_t *logical;
+  grub_ssize_t logical_len;
+  unsigned i;
+
+  for (i = 0; i < SHAPED_RUN_CACHE_SIZE; i++)
+    if (shaped_runs[i].str && grub_strcmp (shaped_runs[i].str, str) == 0)
+      return &shaped_runs[i];
+
+  run = &shaped_runs[shaped_run_next];
+  shaped_run_next = (shaped_run_next + 1) % SHAPED_RUN_CACHE_SIZE;
+  shaped_run_free (run);
+
+  run->str = grub_strdup (str);
+  if (!run->str)
+    return NULL;
+
+  logical_len = grub_utf8_to_ucs4_alloc (str, &logical, 0);
+  if (logical_len < 0)
+    goto fail;
+
+  run->visual_len = grub_bidi_logical_to_visual (logical, logical_len,
+						 &run->visual,
+						 0, 0, 0, 0, 0, 0, 0);
+  grub_free (logical);
+  if (run->visual_len < 0)
+    {
+      run->visual = 0;
+      run->visual_len = 0;
+      goto fail;
+    }
+
+  return run;
+
+ fail:
+  grub_free (run->str);
+  run->str = 0;
+  return NULL;
+}
+
 /* Draw a UTF-8 string of text on the current video render target.
    The x coordinate specifies the starting x position for the first character,
    while the y coordinate specifies the baseline position.
@@ -42,43 +123,27 @@ grub_font_draw_string (const char *str, grub_font_t font,
                        int left_x, int baseline_y)
 {
   int x;
-  grub_uint32_t *logical;
-  grub_ssize_t logical_len, visual_len;
-  struct grub_unicode_glyph *visual, *ptr;
+  struct shaped_run *run;
+  struct grub_unicode_glyph *ptr;
   grub_err_t err;
 
-  logical_len = grub_utf8_to_ucs4_alloc (str, &logical, 0);
-  if (logical_len < 0)
+  run = get_shaped_run (str);
+  if (!run)
     return grub_errno;
 
-  visual_len = grub_bidi_logical_to_visual (logical, logical_len, &visual,
-					    0, 0, 0, 0, 0, 0, 0);
-  grub_free (logical);
-  if (visual_len < 0)
-    return grub_errno;
-
-  err = GRUB_ERR_NONE;
-  for (ptr = visual, x = left_x; ptr < visual + visual_len; ptr++)
+  for (ptr = run->visual, x = left_x; ptr < run->visual + run->visual_len;
+       ptr++)
     {
-      struct grub_font_glyph *glyph;
-      glyph = grub_font_construct_glyph (font, ptr);
-      if (!glyph)
-	{
-	  err = grub_errno;
-	  goto out;
-	}
-      err = grub_font_draw_glyph (glyph, color, x, baseline_y);
+      int device_width;
+
+      err = grub_font_draw_glyph_cached (font, ptr, color, x, baseline_y,
+					 &device_width);
       if (err)
-	goto out;
-      x += glyph->device_width;
+	return err;
+      x += device_width;
     }
 
-out:
-  for (ptr = visual; ptr < visual + visual_len; ptr++)
-    grub_unicode_destroy_glyph (ptr);
-  grub_free (visual);
-
-  return err;
+  return GRUB_ERR_NONE;
 }
 
 /* Get the width in pixels of the specified UTF-8 string, when rendered in
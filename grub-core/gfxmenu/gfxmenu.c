@@ -53,6 +53,7 @@ grub_gfxmenu_try (int entry, grub_menu_t menu, int nested)
 {
   grub_gfxmenu_view_t view = NULL;
   const char *theme_path;
+  const char *fps;
   char *full_theme_path = 0;
   struct grub_menu_viewer *instance;
   grub_err_t err;
@@ -109,6 +110,21 @@ grub_gfxmenu_try (int entry, grub_menu_t menu, int nested)
   view->nested = nested;
   view->first_timeout = -1;
 
+  /* $gfxmenu_fps caps how often the menu is repainted, 0 means no cap.  */
+  fps = grub_env_get ("gfxmenu_fps");
+  if (fps)
+    {
+      unsigned long n = grub_strtoul (fps, 0, 10);
+      if (grub_errno)
+	{
+	  grub_errno = GRUB_ERR_NONE;
+	  n = GRUB_GFXMENU_DEFAULT_FPS;
+	}
+      view->frame_interval = n ? (n < 1000 ? 1000 / n : 1) : 0;
+    }
+  else
+    view->frame_interval = 1000 / GRUB_GFXMENU_DEFAULT_FPS;
+
   grub_video_set_viewport (0, 0, mode_info.width, mode_info.height);
   if (view->double_repaint)
     {
@@ -123,6 +139,7 @@ grub_gfxmenu_try (int entry, grub_menu_t menu, int nested)
   instance->fini = grub_gfxmenu_viewer_fini;
   instance->print_timeout = grub_gfxmenu_print_timeout;
   instance->clear_timeout = grub_gfxmenu_clear_timeout;
+  instance->idle = grub_gfxmenu_idle;
 
   grub_menu_register_viewer (instance);
 
@@ -133,6 +150,8 @@ GRUB_MOD_INIT (gfxmenu)
 {
   struct grub_term_output *term;
 
+  grub_gfxmenu_bitmap_cache_init ();
+
   FOR_ACTIVE_TERM_OUTPUTS(term)
     if (grub_gfxmenu_try_hook && term->fullscreen)
       {
@@ -146,5 +165,7 @@ GRUB_MOD_INIT (gfxmenu)
 GRUB_MOD_FINI (gfxmenu)
 {
   grub_gfxmenu_view_destroy (cached_view);
+  grub_font_flush_shaped_runs ();
+  grub_gfxmenu_bitmap_cache_fini ();
   grub_gfxmenu_try_hook = NULL;
 }
@@ -248,7 +248,8 @@ box_paint (void *vself, const grub_video_rect_t *region)
       grub_video_rect_t r;
       comp->ops->get_bounds(comp, &r);
 
-      if (!grub_video_have_common_points (region, &r))
+      if (!grub_video_have_common_points (region, &r)
+	  || !grub_gui_should_paint (comp))
         continue;
 
       /* Paint the child.  */
@@ -139,7 +139,8 @@ canvas_paint (void *vself, const grub_video_rect_t *region)
       r.height = h;
       comp->ops->set_bounds (comp, &r);
 
-      if (!grub_video_have_common_points (region, &r))
+      if (!grub_video_have_common_points (region, &r)
+	  || !grub_gui_should_paint (comp))
         continue;
 
       /* Paint the child.  */
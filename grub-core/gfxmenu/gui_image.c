@@ -23,6 +23,7 @@
 #include <grub/gui_string_util.h>
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
+#include <grub/gfxmenu_view.h>
 
 struct grub_gui_image
 {
@@ -43,11 +44,8 @@ image_destroy (void *vself)
 {
   grub_gui_image_t self = vself;
 
-  /* Free the scaled bitmap, unless it's a reference to the raw bitmap.  */
-  if (self->bitmap && (self->bitmap != self->raw_bitmap))
-    grub_video_bitmap_destroy (self->bitmap);
-  if (self->raw_bitmap)
-    grub_video_bitmap_destroy (self->raw_bitmap);
+  grub_gfxmenu_bitmap_cache_release (self->bitmap);
+  grub_gfxmenu_bitmap_cache_release (self->raw_bitmap);
 
   grub_free (self);
 }
@@ -106,11 +104,8 @@ rescale_image (grub_gui_image_t self)
 
   if (! self->raw_bitmap)
     {
-      if (self->bitmap)
-        {
-          grub_video_bitmap_destroy (self->bitmap);
-          self->bitmap = 0;
-        }
+      grub_gfxmenu_bitmap_cache_release (self->bitmap);
+      self->bitmap = 0;
       return grub_errno;
     }
 
@@ -125,32 +120,18 @@ rescale_image (grub_gui_image_t self)
       return grub_errno;
     }
 
-  /* Free any old scaled bitmap,
-     *unless* it's a reference to the raw bitmap.  */
-  if (self->bitmap && (self->bitmap != self->raw_bitmap))
-    grub_video_bitmap_destroy (self->bitmap);
-
+  /* Free any old scaled bitmap.  */
+  grub_gfxmenu_bitmap_cache_release (self->bitmap);
   self->bitmap = 0;
 
-  /* Create a scaled bitmap, unless the requested size is the same
-     as the raw size -- in that case a reference is made.  */
-  if ((signed) grub_video_bitmap_get_width (self->raw_bitmap) == width
-      && (signed) grub_video_bitmap_get_height (self->raw_bitmap) == height)
-    {
-      self->bitmap = self->raw_bitmap;
-      return grub_errno;
-    }
-
   /* Don't scale to an invalid size.  */
   if (width <= 0 || height <= 0)
     return grub_errno;
 
-  /* Create the scaled bitmap.  */
-  grub_video_bitmap_create_scaled (&self->bitmap,
-                                   width,
-                                   height,
-                                   self->raw_bitmap,
-                                   GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
+  /* Get the scaled bitmap.  If the requested size is the same as the raw
+     size, this is another reference to the raw bitmap.  */
+  grub_gfxmenu_bitmap_cache_scale (&self->bitmap, self->raw_bitmap,
+                                   width, height);
   return grub_errno;
 }
 
@@ -191,16 +172,16 @@ static grub_err_t
 load_image (grub_gui_image_t self, const char *path)
 {
   struct grub_video_bitmap *bitmap;
-  if (grub_video_bitmap_load (&bitmap, path) != GRUB_ERR_NONE)
+  if (grub_gfxmenu_bitmap_cache_load (&bitmap, path, 0, 0,
+                                      GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH,
+                                      GRUB_VIDEO_BITMAP_V_ALIGN_TOP,
+                                      GRUB_VIDEO_BITMAP_H_ALIGN_LEFT)
+      != GRUB_ERR_NONE)
     return grub_errno;
 
-  if (self->bitmap && (self->bitmap != self->raw_bitmap))
-    {
-      grub_video_bitmap_destroy (self->bitmap);
-      self->bitmap = 0;
-    }
-  if (self->raw_bitmap)
-    grub_video_bitmap_destroy (self->raw_bitmap);
+  grub_gfxmenu_bitmap_cache_release (self->bitmap);
+  self->bitmap = 0;
+  grub_gfxmenu_bitmap_cache_release (self->raw_bitmap);
 
   self->raw_bitmap = bitmap;
   return rescale_image (self);
@@ -26,6 +26,7 @@
 #include <grub/bitmap_scale.h>
 #include <grub/menu.h>
 #include <grub/icon_manager.h>
+#include <grub/gfxmenu_view.h>
 #include <grub/env.h>
 
 /* Currently hard coded to '.png' extension.  */
@@ -93,7 +94,7 @@ grub_gfxmenu_icon_manager_clear_cache (grub_gfxmenu_icon_manager_t mgr)
     {
       next = cur->next;
       grub_free (cur->class_name);
-      grub_video_bitmap_destroy (cur->bitmap);
+      grub_gfxmenu_bitmap_cache_release (cur->bitmap);
       grub_free (cur);
     }
   mgr->cache.next = 0;
@@ -133,14 +134,18 @@ grub_gfxmenu_icon_manager_set_icon_size (grub_gfxmenu_icon_manager_t mgr,
 }
 
 /* Try to load an icon for the specified CLASS_NAME in the directory DIR.
-   Returns 0 if the icon could not be loaded, or returns a pointer to a new
-   bitmap if it was successful.  */
+   Returns 0 if the icon could not be loaded, or returns a pointer to a
+   bitmap from the gfxmenu bitmap cache if it was successful.  */
 static struct grub_video_bitmap *
 try_loading_icon (grub_gfxmenu_icon_manager_t mgr,
                   const char *dir, const char *class_name)
 {
   char *path, *ptr;
 
+  /* Don't try to create a bitmap with a zero dimension.  */
+  if (mgr->icon_width <= 0 || mgr->icon_height <= 0)
+    return 0;
+
   path = grub_malloc (grub_strlen (dir) + grub_strlen (class_name)
 		      + grub_strlen (icon_extension) + 3);
   if (! path)
@@ -153,21 +158,15 @@ try_loading_icon (grub_gfxmenu_icon_manager_t mgr,
   ptr = grub_stpcpy (ptr, icon_extension);
   *ptr = '\0';
 
-  struct grub_video_bitmap *raw_bitmap;
-  grub_video_bitmap_load (&raw_bitmap, path);
+  /* Icons of the same class are shared by all menus and themes.  */
+  struct grub_video_bitmap *scaled_bitmap;
+  grub_gfxmenu_bitmap_cache_load (&scaled_bitmap, path,
+                                  mgr->icon_width, mgr->icon_height,
+                                  GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH,
+                                  GRUB_VIDEO_BITMAP_V_ALIGN_TOP,
+                                  GRUB_VIDEO_BITMAP_H_ALIGN_LEFT);
   grub_free (path);
   grub_errno = GRUB_ERR_NONE;  /* Critical to clear the error!!  */
-  if (! raw_bitmap)
-    return 0;
-
-  struct grub_video_bitmap *scaled_bitmap;
-  grub_video_bitmap_create_scaled (&scaled_bitmap,
-                                   mgr->icon_width, mgr->icon_height,
-                                   raw_bitmap,
-                                   GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
-  grub_video_bitmap_destroy (raw_bitmap);
-  if (! scaled_bitmap)
-    return 0;
 
   return scaled_bitmap;
 }
@@ -223,7 +222,7 @@ get_icon_by_class (grub_gfxmenu_icon_manager_t mgr, const char *class_name)
   entry = grub_malloc (sizeof (*entry));
   if (! entry)
     {
-      grub_video_bitmap_destroy (icon);
+      grub_gfxmenu_bitmap_cache_release (icon);
       return 0;
     }
   entry->class_name = grub_strdup (class_name);
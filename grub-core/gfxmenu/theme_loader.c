@@ -164,19 +164,24 @@ theme_set_string (grub_gfxmenu_view_t view,
     grub_video_parse_color (value, &view->message_bg_color);
   else if (! grub_strcmp ("desktop-image", name))
     {
-      struct grub_video_bitmap *raw_bitmap;
+      grub_file_t file;
       char *path;
       path = grub_resolve_relative_path (theme_dir, value);
       if (! path)
         return grub_errno;
-      if (grub_video_bitmap_load (&raw_bitmap, path) != GRUB_ERR_NONE)
+      /* The image is decoded and scaled only when the view is first drawn,
+         and then not at all if it is still in the bitmap cache.  */
+      file = grub_file_open (path, GRUB_FILE_TYPE_PIXMAP);
+      if (! file)
         {
           grub_free (path);
           return grub_errno;
         }
-      grub_free(path);
-      grub_video_bitmap_destroy (view->raw_desktop_image);
-      view->raw_desktop_image = raw_bitmap;
+      grub_file_close (file);
+      grub_free (view->desktop_image_path);
+      view->desktop_image_path = path;
+      grub_gfxmenu_bitmap_cache_release (view->scaled_desktop_image);
+      view->scaled_desktop_image = 0;
     }
   else if (! grub_strcmp ("desktop-image-scale-method", name))
     {
@@ -44,6 +44,8 @@ static void
 init_background (grub_gfxmenu_view_t view);
 static grub_gfxmenu_view_t term_view;
 
+grub_gui_paint_layer_t grub_gui_paint_layer = GRUB_GUI_PAINT_ALL;
+
 /* Create a new view object, loading the theme specified by THEME_PATH and
    associating MODEL with the view.  */
 grub_gfxmenu_view_t
@@ -86,6 +88,10 @@ grub_gfxmenu_view_new (const char *theme_path,
   default_bg_color = grub_video_rgba_color_rgb (255, 255, 255);
 
   view->canvas = 0;
+  view->static_layer = 0;
+  view->n_damage = 0;
+  view->frame_interval = 1000 / GRUB_GFXMENU_DEFAULT_FPS;
+  view->last_frame = 0;
 
   view->title_font = default_font;
   view->message_font = default_font;
@@ -93,7 +99,7 @@ grub_gfxmenu_view_new (const char *theme_path,
   view->title_color = default_fg_color;
   view->message_color = default_bg_color;
   view->message_bg_color = default_fg_color;
-  view->raw_desktop_image = 0;
+  view->desktop_image_path = 0;
   view->scaled_desktop_image = 0;
   view->desktop_image_scale_method = GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH;
   view->desktop_image_h_align = GRUB_VIDEO_BITMAP_H_ALIGN_CENTER;
@@ -134,8 +140,10 @@ grub_gfxmenu_view_destroy (grub_gfxmenu_view_t view)
       grub_gfxmenu_timeout_notifications = grub_gfxmenu_timeout_notifications->next;
       grub_free (p);
     }
-  grub_video_bitmap_destroy (view->raw_desktop_image);
-  grub_video_bitmap_destroy (view->scaled_desktop_image);
+  grub_free (view->desktop_image_path);
+  grub_gfxmenu_bitmap_cache_release (view->scaled_desktop_image);
+  grub_video_delete_render_target (view->static_layer);
+  grub_font_flush_rendered_glyphs ();
   if (view->terminal_box)
     view->terminal_box->destroy (view->terminal_box);
   grub_free (view->terminal_font_name);
@@ -205,7 +213,7 @@ update_timeouts (int visible, int start, int value, int end)
 }
 
 static void
-redraw_timeouts (struct grub_gfxmenu_view *view)
+invalidate_timeouts (struct grub_gfxmenu_view *view)
 {
   struct grub_gfxmenu_timeout_notify *cur;
 
@@ -213,8 +221,7 @@ redraw_timeouts (struct grub_gfxmenu_view *view)
     {
       grub_video_rect_t bounds;
       cur->self->ops->get_bounds (cur->self, &bounds);
-      grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
-      grub_gfxmenu_view_redraw (view, &bounds);
+      grub_gfxmenu_view_invalidate (view, &bounds);
     }
 }
 
@@ -227,10 +234,8 @@ grub_gfxmenu_print_timeout (int timeout, void *data)
     view->first_timeout = timeout;
 
   update_timeouts (1, -view->first_timeout, -timeout, 0);
-  redraw_timeouts (view);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    redraw_timeouts (view);
+  invalidate_timeouts (view);
+  grub_gfxmenu_view_present (view, 0);
 }
 
 void 
@@ -239,10 +244,16 @@ grub_gfxmenu_clear_timeout (void *data)
   struct grub_gfxmenu_view *view = data;
 
   update_timeouts (0, 1, 0, 0);
-  redraw_timeouts (view);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    redraw_timeouts (view);
+  invalidate_timeouts (view);
+  grub_gfxmenu_view_present (view, 0);
+}
+
+/* Called by the menu while it waits for keys, to show what was held back
+   by the frame rate limit.  */
+void
+grub_gfxmenu_idle (void *data)
+{
+  grub_gfxmenu_view_present (data, 0);
 }
 
 static void
@@ -328,10 +339,26 @@ grub_gfxmenu_view_redraw (grub_gfxmenu_view_t view,
     grub_video_set_region (region->x, region->y,
                            region->width, region->height);
 
-  redraw_background (view, region);
-  if (view->canvas)
-    view->canvas->component.ops->paint (view->canvas, region);
-  draw_title (view);
+  if (view->static_layer)
+    {
+      grub_video_blit_render_target (view->static_layer,
+				     GRUB_VIDEO_BLIT_REPLACE,
+				     region->x, region->y,
+				     region->x - view->screen.x,
+				     region->y - view->screen.y,
+				     region->width, region->height);
+      grub_gui_paint_layer = GRUB_GUI_PAINT_DYNAMIC;
+      if (view->canvas)
+	view->canvas->component.ops->paint (view->canvas, region);
+      grub_gui_paint_layer = GRUB_GUI_PAINT_ALL;
+    }
+  else
+    {
+      redraw_background (view, region);
+      if (view->canvas)
+	view->canvas->component.ops->paint (view->canvas, region);
+      draw_title (view);
+    }
   if (grub_video_have_common_points (&view->progress_message_frame, region))
     draw_message (view);
 
@@ -339,6 +366,118 @@ grub_gfxmenu_view_redraw (grub_gfxmenu_view_t view,
     grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
 }
 
+/* Frames are scheduled rather than drawn as things happen.  The timeouts,
+   the menu list and the messages only record the region of the view they
+   changed; grub_gfxmenu_view_present paints all of them and swaps once,
+   at most once every VIEW->FRAME_INTERVAL milliseconds unless forced.
+   Whatever is held back is shown from grub_gfxmenu_idle, so a burst of key
+   presses or a slow framebuffer cannot keep the menu from polling the
+   keyboard.  */
+void
+grub_gfxmenu_view_invalidate (grub_gfxmenu_view_t view,
+			      const grub_video_rect_t *region)
+{
+  grub_video_rect_t *d;
+  unsigned x2, y2;
+  int i;
+
+  if (region->width == 0 || region->height == 0)
+    return;
+
+  for (i = 0; i < view->n_damage; i++)
+    if (grub_video_have_common_points (&view->damage[i], region))
+      break;
+
+  if (i == view->n_damage)
+    {
+      if (view->n_damage < GRUB_GFXMENU_MAX_DAMAGE)
+	{
+	  view->damage[view->n_damage++] = *region;
+	  return;
+	}
+      i = view->n_damage - 1;
+    }
+
+  /* Merge into the region it touches, or the last one when full.  */
+  d = &view->damage[i];
+  x2 = d->x + d->width;
+  y2 = d->y + d->height;
+  if (region->x + region->width > x2)
+    x2 = region->x + region->width;
+  if (region->y + region->height > y2)
+    y2 = region->y + region->height;
+  if (region->x < d->x)
+    d->x = region->x;
+  if (region->y < d->y)
+    d->y = region->y;
+  d->width = x2 - d->x;
+  d->height = y2 - d->y;
+}
+
+static void
+redraw_damage (grub_gfxmenu_view_t view)
+{
+  int i;
+
+  for (i = 0; i < view->n_damage; i++)
+    {
+      grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
+      grub_gfxmenu_view_redraw (view, &view->damage[i]);
+    }
+}
+
+void
+grub_gfxmenu_view_present (grub_gfxmenu_view_t view, int force)
+{
+  grub_uint64_t now;
+
+  if (view->n_damage == 0)
+    return;
+
+  now = grub_get_time_ms ();
+  if (! force && view->frame_interval
+      && now - view->last_frame < view->frame_interval)
+    return;
+
+  redraw_damage (view);
+  grub_video_swap_buffers ();
+  if (view->double_repaint)
+    redraw_damage (view);
+
+  view->n_damage = 0;
+  view->last_frame = now;
+}
+
+/* Pre-render everything but the dynamic components so that later redraws
+   only have to copy it back and paint those.  */
+static void
+init_static_layer (grub_gfxmenu_view_t view)
+{
+  grub_video_delete_render_target (view->static_layer);
+  view->static_layer = 0;
+
+  if (grub_video_create_render_target (&view->static_layer,
+				       view->screen.width,
+				       view->screen.height,
+				       GRUB_VIDEO_MODE_TYPE_RGB))
+    {
+      /* Not fatal: everything is simply redrawn each time.  */
+      view->static_layer = 0;
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+
+  grub_video_set_active_render_target (view->static_layer);
+  grub_video_set_area_status (GRUB_VIDEO_AREA_DISABLED);
+  redraw_background (view, &view->screen);
+  grub_gui_paint_layer = GRUB_GUI_PAINT_STATIC;
+  if (view->canvas)
+    view->canvas->component.ops->paint (view->canvas, &view->screen);
+  grub_gui_paint_layer = GRUB_GUI_PAINT_ALL;
+  draw_title (view);
+  grub_video_set_active_render_target (GRUB_VIDEO_RENDER_TARGET_DISPLAY);
+}
+
 void
 grub_gfxmenu_view_draw (grub_gfxmenu_view_t view)
 {
@@ -359,6 +498,8 @@ grub_gfxmenu_view_draw (grub_gfxmenu_view_t view)
   refresh_menu_components (view);
   update_menu_components (view);
 
+  init_static_layer (view);
+
   grub_video_set_area_status (GRUB_VIDEO_AREA_DISABLED);
   grub_gfxmenu_view_redraw (view, &view->screen);
   grub_video_swap_buffers ();
@@ -368,11 +509,14 @@ grub_gfxmenu_view_draw (grub_gfxmenu_view_t view)
       grub_gfxmenu_view_redraw (view, &view->screen);
     }
 
+  /* Everything is on the screen now.  */
+  view->n_damage = 0;
+  view->last_frame = grub_get_time_ms ();
 }
 
 static void
-redraw_menu_visit (grub_gui_component_t component,
-                   void *userdata)
+invalidate_menu_visit (grub_gui_component_t component,
+		       void *userdata)
 {
   grub_gfxmenu_view_t view;
   view = userdata;
@@ -381,8 +525,7 @@ redraw_menu_visit (grub_gui_component_t component,
       grub_video_rect_t bounds;
 
       component->ops->get_bounds (component, &bounds);
-      grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
-      grub_gfxmenu_view_redraw (view, &bounds);
+      grub_gfxmenu_view_invalidate (view, &bounds);
     }
 }
 
@@ -392,13 +535,8 @@ grub_gfxmenu_redraw_menu (grub_gfxmenu_view_t view)
   update_menu_components (view);
 
   grub_gui_iterate_recursively ((grub_gui_component_t) view->canvas,
-                                redraw_menu_visit, view);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    {
-      grub_gui_iterate_recursively ((grub_gui_component_t) view->canvas,
-				    redraw_menu_visit, view);
-    }
+                                invalidate_menu_visit, view);
+  grub_gfxmenu_view_present (view, 0);
 }
 
 void 
@@ -553,28 +691,26 @@ init_terminal (grub_gfxmenu_view_t view)
 static void
 init_background (grub_gfxmenu_view_t view)
 {
-  if (view->scaled_desktop_image)
+  if (view->scaled_desktop_image || ! view->desktop_image_path)
     return;
 
+  /* The scaled image is cached, so reloading the theme at the same
+     resolution does not even decode the file again.  */
   struct grub_video_bitmap *scaled_bitmap;
-  if (view->desktop_image_scale_method ==
-      GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH)
-    grub_video_bitmap_create_scaled (&scaled_bitmap,
-                                     view->screen.width,
-                                     view->screen.height,
-                                     view->raw_desktop_image,
-                                     GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
-  else
-    grub_video_bitmap_scale_proportional (&scaled_bitmap,
-                                          view->screen.width,
-                                          view->screen.height,
-                                          view->raw_desktop_image,
-                                          GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST,
-                                          view->desktop_image_scale_method,
-                                          view->desktop_image_v_align,
-                                          view->desktop_image_h_align);
+  grub_gfxmenu_bitmap_cache_load (&scaled_bitmap,
+                                  view->desktop_image_path,
+                                  view->screen.width,
+                                  view->screen.height,
+                                  view->desktop_image_scale_method,
+                                  view->desktop_image_v_align,
+                                  view->desktop_image_h_align);
   if (! scaled_bitmap)
-    return;
+    {
+      /* Don't try again on every repaint.  */
+      grub_free (view->desktop_image_path);
+      view->desktop_image_path = 0;
+      return;
+    }
   view->scaled_desktop_image = scaled_bitmap;
 
 }
@@ -607,10 +743,8 @@ notify_booting (grub_menu_entry_t entry, void *userdata)
   grub_sprintf (s, "Booting '%s'", entry->title);
   set_progress_message (view, s);
   grub_free (s);
-  grub_gfxmenu_view_redraw (view, &view->progress_message_frame);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    grub_gfxmenu_view_redraw (view, &view->progress_message_frame);
+  grub_gfxmenu_view_invalidate (view, &view->progress_message_frame);
+  grub_gfxmenu_view_present (view, 1);
 }
 
 static void
@@ -625,10 +759,8 @@ notify_fallback (grub_menu_entry_t entry, void *userdata)
   grub_sprintf (s, "Falling back to '%s'", entry->title);
   set_progress_message (view, s);
   grub_free (s);
-  grub_gfxmenu_view_redraw (view, &view->progress_message_frame);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    grub_gfxmenu_view_redraw (view, &view->progress_message_frame);
+  grub_gfxmenu_view_invalidate (view, &view->progress_message_frame);
+  grub_gfxmenu_view_present (view, 1);
 }
 
 static void
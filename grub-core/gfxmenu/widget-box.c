@@ -25,6 +25,7 @@
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
 #include <grub/gfxwidgets.h>
+#include <grub/gfxmenu_view.h>
 
 enum box_pixmaps
 {
@@ -136,16 +137,12 @@ scale_pixmap (grub_gfxmenu_box_t self, int i, int w, int h)
       || ((int) grub_video_bitmap_get_width (*scaled) != w)
       || ((int) grub_video_bitmap_get_height (*scaled) != h))
     {
-      if (*scaled)
-        {
-          grub_video_bitmap_destroy (*scaled);
-          *scaled = 0;
-        }
+      grub_gfxmenu_bitmap_cache_release (*scaled);
+      *scaled = 0;
 
       /* Don't try to create a bitmap with a zero dimension.  */
       if (w != 0 && h != 0)
-        grub_video_bitmap_create_scaled (scaled, w, h, raw,
-                                         GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
+        grub_gfxmenu_bitmap_cache_scale (scaled, raw, w, h);
     }
 
   return grub_errno;
@@ -265,12 +262,10 @@ destroy (grub_gfxmenu_box_t self)
   unsigned i;
   for (i = 0; i < BOX_NUM_PIXMAPS; i++)
     {
-      if (self->raw_pixmaps[i])
-        grub_video_bitmap_destroy(self->raw_pixmaps[i]);
+      grub_gfxmenu_bitmap_cache_release (self->raw_pixmaps[i]);
       self->raw_pixmaps[i] = 0;
 
-      if (self->scaled_pixmaps[i])
-        grub_video_bitmap_destroy(self->scaled_pixmaps[i]);
+      grub_gfxmenu_bitmap_cache_release (self->scaled_pixmaps[i]);
       self->scaled_pixmaps[i] = 0;
     }
   grub_free (self->raw_pixmaps);
@@ -335,7 +330,10 @@ grub_gfxmenu_create_box (const char *pixmaps_prefix,
           path_end = grub_stpcpy (path_end, box_pixmap_names[i]);
           path_end = grub_stpcpy (path_end, pixmaps_suffix);
 
-          grub_video_bitmap_load (&box->raw_pixmaps[i], path);
+          grub_gfxmenu_bitmap_cache_load (&box->raw_pixmaps[i], path, 0, 0,
+                                          GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH,
+                                          GRUB_VIDEO_BITMAP_V_ALIGN_TOP,
+                                          GRUB_VIDEO_BITMAP_H_ALIGN_LEFT);
           grub_free (path);
 
           /* Ignore missing pixmaps.  */
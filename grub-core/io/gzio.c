@@ -44,6 +44,7 @@
 #include <grub/deflate.h>
 #include <grub/i18n.h>
 #include <grub/crypto.h>
+#include <grub/trace.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -1342,7 +1343,13 @@ static grub_ssize_t
 grub_gzio_read (grub_file_t file, char *buf, grub_size_t len)
 {
   grub_ssize_t ret;
+
+  grub_trace_begin (GRUB_TRACE_DECOMPRESS, grub_trace_intern ("gzip"),
+		    file->offset);
   ret = grub_gzio_read_real (file->data, file->offset, buf, len);
+  grub_trace_end (GRUB_TRACE_DECOMPRESS, grub_trace_intern ("gzip"), ret);
+  if (ret > 0)
+    grub_trace_count (GRUB_TRACE_DECOMPRESSED_BYTES, ret);
 
   if (!grub_errno && ret != (grub_ssize_t) len)
     {
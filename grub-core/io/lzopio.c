@@ -23,6 +23,7 @@
 #include <grub/fs.h>
 #include <grub/dl.h>
 #include <grub/crypto.h>
+#include <grub/trace.h>
 #include <minilzo.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
@@ -203,10 +204,19 @@ uncompress_block (struct grub_lzopio *lzopio)
       if (!lzopio->block.udata)
 	return -1;
 
+      grub_trace_begin (GRUB_TRACE_DECOMPRESS, grub_trace_intern ("lzop"),
+			lzopio->block.csize);
       if (lzo1x_decompress_safe (lzopio->block.cdata, lzopio->block.csize,
 				 lzopio->block.udata, &usize, NULL)
 	  != LZO_E_OK)
-	return -1;
+	{
+	  grub_trace_end (GRUB_TRACE_DECOMPRESS, grub_trace_intern ("lzop"),
+			  0);
+	  return -1;
+	}
+      grub_trace_end (GRUB_TRACE_DECOMPRESS, grub_trace_intern ("lzop"),
+		      usize);
+      grub_trace_count (GRUB_TRACE_DECOMPRESSED_BYTES, usize);
 
       if (lzopio->ucheck_fun)
 	{
@@ -23,6 +23,7 @@
 #include <grub/file.h>
 #include <grub/fs.h>
 #include <grub/dl.h>
+#include <grub/trace.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -266,7 +267,12 @@ grub_xzio_read (grub_file_t file, char *buf, grub_size_t len)
 	  xzio->buf.in_pos = 0;
 	}
 
+      grub_trace_begin (GRUB_TRACE_DECOMPRESS, grub_trace_intern ("xz"),
+			xzio->buf.in_size);
       xzret = xz_dec_run (xzio->dec, &xzio->buf);
+      grub_trace_end (GRUB_TRACE_DECOMPRESS, grub_trace_intern ("xz"),
+		      xzio->buf.out_pos);
+      grub_trace_count (GRUB_TRACE_DECOMPRESSED_BYTES, xzio->buf.out_pos);
       switch (xzret)
 	{
 	case XZ_MEMLIMIT_ERROR:
@@ -25,6 +25,7 @@
 #include <grub/time.h>
 #include <grub/file.h>
 #include <grub/i18n.h>
+#include <grub/trace.h>
 
 #define	GRUB_CACHE_TIMEOUT	2
 
@@ -32,6 +33,7 @@
 static grub_uint64_t grub_last_time = 0;
 
 struct grub_disk_cache grub_disk_cache_table[GRUB_DISK_CACHE_NUM];
+static grub_mm_tag_t grub_disk_cache_tag;
 
 void (*grub_disk_firmware_fini) (void);
 int grub_disk_firmware_is_tainted;
@@ -89,12 +91,14 @@ grub_disk_cache_fetch (unsigned long dev_id, unsigned long disk_id,
 #if DISK_CACHE_STATS
       grub_disk_cache_hits++;
 #endif
+      grub_trace_count (GRUB_TRACE_DISK_CACHE_HITS, 1);
       return cache->data;
     }
 
 #if DISK_CACHE_STATS
   grub_disk_cache_misses++;
 #endif
+  grub_trace_count (GRUB_TRACE_DISK_CACHE_MISSES, 1);
 
   return 0;
 }
@@ -120,6 +124,7 @@ grub_disk_cache_store (unsigned long dev_id, unsigned long disk_id,
 {
   unsigned cache_index;
   struct grub_disk_cache *cache;
+  grub_mm_tag_t old_tag;
 
   cache_index = grub_disk_cache_get_index (dev_id, disk_id, sector);
   cache = grub_disk_cache_table + cache_index;
@@ -129,7 +134,12 @@ grub_disk_cache_store (unsigned long dev_id, unsigned long disk_id,
   cache->data = 0;
   cache->lock = 0;
 
+  if (! grub_disk_cache_tag)
+    grub_disk_cache_tag = grub_mm_tag_get ("disk",
+					   grub_mm_tag_get ("caches", NULL));
+  old_tag = grub_mm_tag_set (grub_disk_cache_tag);
   cache->data = grub_malloc (GRUB_DISK_SECTOR_SIZE << GRUB_DISK_CACHE_BITS);
+  grub_mm_tag_set (old_tag);
   if (! cache->data)
     return grub_errno;
 
@@ -158,6 +168,9 @@ grub_disk_dev_unregister (grub_disk_dev_t dev)
 {
   grub_disk_dev_t *p, q;
 
+  /* Close the disks the filesystem cache holds open.  */
+  grub_fs_cache_invalidate (0);
+
   for (p = &grub_disk_dev_list, q = *p; q; p = &(q->next), q = q->next)
     if (q == dev)
       {
@@ -310,6 +323,24 @@ grub_disk_close (grub_disk_t disk)
   grub_free (disk);
 }
 
+/* Read SIZE native sectors at SECTOR from the device.  */
+static grub_err_t
+grub_disk_dev_read (grub_disk_t disk, grub_disk_addr_t sector,
+		    grub_size_t size, char *buf)
+{
+  grub_err_t err;
+
+  grub_trace_begin (GRUB_TRACE_DISK, grub_trace_intern (disk->dev->name),
+		    sector);
+  err = (disk->dev->disk_read) (disk, sector, size, buf);
+  grub_trace_end (GRUB_TRACE_DISK, grub_trace_intern (disk->dev->name),
+		  (grub_uint64_t) size << disk->log_sector_size);
+  grub_trace_count (GRUB_TRACE_DISK_READS, 1);
+  grub_trace_count (GRUB_TRACE_DISK_READ_BYTES,
+		    (grub_uint64_t) size << disk->log_sector_size);
+  return err;
+}
+
 /* Small read (less than cache size and not pass across cache unit boundaries).
    sector is already adjusted and is divisible by cache unit size.
  */
@@ -341,10 +372,10 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
       < (disk->total_sectors << (disk->log_sector_size - GRUB_DISK_SECTOR_BITS)))
     {
       grub_err_t err;
-      err = (disk->dev->disk_read) (disk, transform_sector (disk, sector),
-				    1U << (GRUB_DISK_CACHE_BITS
-					   + GRUB_DISK_SECTOR_BITS
-					   - disk->log_sector_size), tmp_buf);
+      err = grub_disk_dev_read (disk, transform_sector (disk, sector),
+				1U << (GRUB_DISK_CACHE_BITS
+				       + GRUB_DISK_SECTOR_BITS
+				       - disk->log_sector_size), tmp_buf);
       if (!err)
 	{
 	  /* Copy it and store it in the disk cache.  */
@@ -377,8 +408,8 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
     if (!tmp_buf)
       return grub_errno;
     
-    if ((disk->dev->disk_read) (disk, transform_sector (disk, aligned_sector),
-				num, tmp_buf))
+    if (grub_disk_dev_read (disk, transform_sector (disk, aligned_sector),
+			    num, tmp_buf))
       {
 	grub_error_push ();
 	grub_dprintf ("disk", "%s read failed\n", disk->name);
@@ -483,11 +514,11 @@ grub_disk_read (grub_disk_t disk, grub_disk_addr_t sector,
 	{
 	  grub_disk_addr_t i;
 
-	  err = (disk->dev->disk_read) (disk, transform_sector (disk, sector),
-					agglomerate << (GRUB_DISK_CACHE_BITS
-							+ GRUB_DISK_SECTOR_BITS
-							- disk->log_sector_size),
-					buf);
+	  err = grub_disk_dev_read (disk, transform_sector (disk, sector),
+				    agglomerate << (GRUB_DISK_CACHE_BITS
+						    + GRUB_DISK_SECTOR_BITS
+						    - disk->log_sector_size),
+				    buf);
 	  if (err)
 	    return err;
 	  
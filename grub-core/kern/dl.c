@@ -32,6 +32,8 @@
 #include <grub/env.h>
 #include <grub/cache.h>
 #include <grub/i18n.h>
+#include <grub/dl_pack.h>
+#include <grub/trace.h>
 
 /* Platforms where modules are in a readonly area of memory.  */
 #if defined(GRUB_MACHINE_QEMU)
@@ -77,17 +79,24 @@ struct grub_symbol
 {
   struct grub_symbol *next;
   const char *name;
+  /* grub_symbol_hash of the name.  */
+  unsigned hash;
   void *addr;
   int isfunc;
   grub_dl_t mod;	/* The module to which this symbol belongs.  */
 };
 typedef struct grub_symbol *grub_symbol_t;
 
-/* The size of the symbol table.  */
-#define GRUB_SYMTAB_SIZE	509
+/* The initial size of the symbol table, a power of 2.  It is doubled
+   whenever there are more symbols than buckets.  */
+#define GRUB_SYMTAB_SIZE	512
 
-/* The symbol table (using an open-hash).  */
-static struct grub_symbol *grub_symtab[GRUB_SYMTAB_SIZE];
+/* The symbol table (using an open-hash).  The initial buckets are static,
+   only growing it past the kernel symbols needs the heap.  */
+static struct grub_symbol *grub_symtab_initial[GRUB_SYMTAB_SIZE];
+static struct grub_symbol **grub_symtab = grub_symtab_initial;
+static unsigned grub_symtab_size = GRUB_SYMTAB_SIZE;
+static unsigned grub_symtab_count;
 
 /* Simple hash function.  */
 static unsigned
@@ -98,7 +107,7 @@ grub_symbol_hash (const char *s)
   while (*s)
     key = key * 65599 + *s++;
 
-  return (key + (key >> 5)) % GRUB_SYMTAB_SIZE;
+  return key + (key >> 5);
 }
 
 /* Resolve the symbol name NAME and return the address.
@@ -107,14 +116,48 @@ static grub_symbol_t
 grub_dl_resolve_symbol (const char *name)
 {
   grub_symbol_t sym;
+  unsigned hash = grub_symbol_hash (name);
 
-  for (sym = grub_symtab[grub_symbol_hash (name)]; sym; sym = sym->next)
-    if (grub_strcmp (sym->name, name) == 0)
+  for (sym = grub_symtab[hash & (grub_symtab_size - 1)]; sym; sym = sym->next)
+    if (sym->hash == hash && grub_strcmp (sym->name, name) == 0)
       return sym;
 
   return 0;
 }
 
+/* Double the number of buckets.  If that fails the chains just get
+   longer.  */
+static void
+grub_dl_grow_symtab (void)
+{
+  struct grub_symbol **symtab;
+  unsigned size = grub_symtab_size * 2, i;
+
+  symtab = grub_calloc (size, sizeof (symtab[0]));
+  if (! symtab)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+
+  for (i = 0; i < grub_symtab_size; i++)
+    {
+      grub_symbol_t sym, next;
+
+      for (sym = grub_symtab[i]; sym; sym = next)
+	{
+	  next = sym->next;
+	  sym->next = symtab[sym->hash & (size - 1)];
+	  symtab[sym->hash & (size - 1)] = sym;
+	}
+    }
+
+  if (grub_symtab != grub_symtab_initial)
+    grub_free (grub_symtab);
+  grub_symtab = symtab;
+  grub_symtab_size = size;
+}
+
 /* Register a symbol with the name NAME and the address ADDR.  */
 grub_err_t
 grub_dl_register_symbol (const char *name, void *addr, int isfunc,
@@ -142,14 +185,50 @@ grub_dl_register_symbol (const char *name, void *addr, int isfunc,
   sym->addr = addr;
   sym->mod = mod;
   sym->isfunc = isfunc;
+  sym->hash = grub_symbol_hash (name);
 
-  k = grub_symbol_hash (name);
+  if (grub_symtab_count >= grub_symtab_size)
+    grub_dl_grow_symtab ();
+
+  k = sym->hash & (grub_symtab_size - 1);
   sym->next = grub_symtab[k];
   grub_symtab[k] = sym;
+  grub_symtab_count++;
 
   return GRUB_ERR_NONE;
 }
 
+/* The modules pack read for pack_prefix, if any.  The symbols its modules
+   import are looked up once, and kept in pack_symbols by their number.  */
+static char *pack_prefix;
+static char *pack_filename;
+static grub_uint8_t *pack_index;
+static grub_uint32_t pack_index_size;
+static grub_uint32_t pack_nmodules;
+static grub_uint32_t pack_nsymbols;
+static grub_symbol_t *pack_symbols;
+
+/* Resolve the symbol NAME, which is symbol I in a module with the symbol
+   map SYMMAP of NSYMMAP entries.  */
+static grub_symbol_t
+grub_dl_resolve_pack_symbol (const grub_uint32_t *symmap,
+			     grub_uint32_t nsymmap, unsigned i,
+			     const char *name)
+{
+  grub_uint32_t n;
+
+  if (i >= nsymmap)
+    return grub_dl_resolve_symbol (name);
+  n = grub_le_to_cpu32 (symmap[i]);
+  if (n >= pack_nsymbols)
+    return grub_dl_resolve_symbol (name);
+
+  /* Check the name rather than trust a pack that doesn't match.  */
+  if (! pack_symbols[n] || grub_strcmp (pack_symbols[n]->name, name) != 0)
+    pack_symbols[n] = grub_dl_resolve_symbol (name);
+  return pack_symbols[n];
+}
+
 /* Unregister all the symbols defined in the module MOD.  */
 static void
 grub_dl_unregister_symbols (grub_dl_t mod)
@@ -159,7 +238,11 @@ grub_dl_unregister_symbols (grub_dl_t mod)
   if (! mod)
     grub_fatal ("core symbols cannot be unregistered");
 
-  for (i = 0; i < GRUB_SYMTAB_SIZE; i++)
+  for (i = 0; pack_symbols && i < pack_nsymbols; i++)
+    if (pack_symbols[i] && pack_symbols[i]->mod == mod)
+      pack_symbols[i] = 0;
+
+  for (i = 0; i < grub_symtab_size; i++)
     {
       grub_symbol_t sym, *p, q;
 
@@ -171,6 +254,7 @@ grub_dl_unregister_symbols (grub_dl_t mod)
 	      *p = q;
 	      grub_free ((void *) sym->name);
 	      grub_free (sym);
+	      grub_symtab_count--;
 	    }
 	  else
 	    p = &sym->next;
@@ -225,6 +309,9 @@ grub_dl_load_segments (grub_dl_t mod, const Elf_Ehdr *e)
   unsigned i;
   const Elf_Shdr *s;
   grub_size_t tsize = 0, talign = 1;
+#ifndef GRUB_MACHINE_EMU
+  grub_mm_tag_t old_tag;
+#endif
 #if !defined (__i386__) && !defined (__x86_64__) && !defined(__riscv)
   grub_size_t tramp;
   grub_size_t got;
@@ -256,7 +343,9 @@ grub_dl_load_segments (grub_dl_t mod, const Elf_Ehdr *e)
 #ifdef GRUB_MACHINE_EMU
   mod->base = grub_osdep_dl_memalign (talign, tsize);
 #else
+  old_tag = grub_mm_tag_set (grub_dl_mm_tag (mod));
   mod->base = grub_memalign (talign, tsize);
+  grub_mm_tag_set (old_tag);
 #endif
   if (!mod->base)
     return grub_errno;
@@ -319,7 +408,8 @@ grub_dl_load_segments (grub_dl_t mod, const Elf_Ehdr *e)
 }
 
 static grub_err_t
-grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
+grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e,
+			 const grub_uint32_t *symmap, grub_uint32_t nsymmap)
 {
   unsigned i;
   Elf_Shdr *s;
@@ -370,7 +460,12 @@ grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
 	  /* Resolve a global symbol.  */
 	  if (sym->st_name != 0 && sym->st_shndx == 0)
 	    {
-	      grub_symbol_t nsym = grub_dl_resolve_symbol (name);
+	      grub_symbol_t nsym;
+
+	      if (symmap)
+		nsym = grub_dl_resolve_pack_symbol (symmap, nsymmap, i, name);
+	      else
+		nsym = grub_dl_resolve_symbol (name);
 	      if (! nsym)
 		return grub_error (GRUB_ERR_BAD_MODULE,
 				   N_("symbol `%s' not found"), name);
@@ -600,9 +695,11 @@ grub_dl_relocate_symbols (grub_dl_t mod, void *ehdr)
   return GRUB_ERR_NONE;
 }
 
-/* Load a module from core memory.  */
-grub_dl_t
-grub_dl_load_core_noinit (void *addr, grub_size_t size)
+/* Load a module from core memory, with the symbol map SYMMAP of NSYMMAP
+   entries if it comes from the modules pack.  */
+static grub_dl_t
+grub_dl_load_core_map (void *addr, grub_size_t size,
+		       const grub_uint32_t *symmap, grub_uint32_t nsymmap)
 {
   Elf_Ehdr *e;
   grub_dl_t mod;
@@ -644,14 +741,22 @@ grub_dl_load_core_noinit (void *addr, grub_size_t size)
   if (grub_dl_check_license (e)
       || grub_dl_resolve_name (mod, e)
       || grub_dl_resolve_dependencies (mod, e)
-      || grub_dl_load_segments (mod, e)
-      || grub_dl_resolve_symbols (mod, e)
+      || grub_dl_load_segments (mod, e))
+    {
+      mod->fini = 0;
+      grub_dl_unload (mod);
+      return 0;
+    }
+
+  grub_boot_time ("Relocating module %s", mod->name);
+  if (grub_dl_resolve_symbols (mod, e, symmap, nsymmap)
       || grub_dl_relocate_symbols (mod, e))
     {
       mod->fini = 0;
       grub_dl_unload (mod);
       return 0;
     }
+  grub_boot_time ("Module %s relocated", mod->name);
 
   grub_dl_flush_cache (mod);
 
@@ -667,14 +772,22 @@ grub_dl_load_core_noinit (void *addr, grub_size_t size)
   return mod;
 }
 
+/* Load a module from core memory.  */
 grub_dl_t
-grub_dl_load_core (void *addr, grub_size_t size)
+grub_dl_load_core_noinit (void *addr, grub_size_t size)
+{
+  return grub_dl_load_core_map (addr, size, 0, 0);
+}
+
+static grub_dl_t
+grub_dl_load_core_init (void *addr, grub_size_t size,
+			const grub_uint32_t *symmap, grub_uint32_t nsymmap)
 {
   grub_dl_t mod;
 
   grub_boot_time ("Parsing module");
 
-  mod = grub_dl_load_core_noinit (addr, size);
+  mod = grub_dl_load_core_map (addr, size, symmap, nsymmap);
 
   if (!mod)
     return NULL;
@@ -686,6 +799,12 @@ grub_dl_load_core (void *addr, grub_size_t size)
   return mod;
 }
 
+grub_dl_t
+grub_dl_load_core (void *addr, grub_size_t size)
+{
+  return grub_dl_load_core_init (addr, size, 0, 0);
+}
+
 /* Load a module from the file FILENAME.  */
 grub_dl_t
 grub_dl_load_file (const char *filename)
@@ -730,6 +849,265 @@ grub_dl_load_file (const char *filename)
   return mod;
 }
 
+/* Read the index of the modules pack in the directory DIR, unless it was
+   already.  Return 0 if there is no usable pack.  */
+static int
+grub_dl_open_pack (const char *dir)
+{
+  struct grub_dl_pack_header header;
+  grub_file_t file;
+
+  if (pack_prefix && grub_strcmp (pack_prefix, dir) == 0)
+    return !! pack_index;
+
+  grub_free (pack_prefix);
+  grub_free (pack_filename);
+  grub_free (pack_index);
+  grub_free (pack_symbols);
+  pack_filename = 0;
+  pack_index = 0;
+  pack_symbols = 0;
+  pack_index_size = pack_nmodules = pack_nsymbols = 0;
+
+  pack_prefix = grub_strdup (dir);
+  if (! pack_prefix)
+    goto fail;
+  pack_filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM
+				  "/" GRUB_DL_PACK_NAME, dir);
+  if (! pack_filename)
+    goto fail;
+  file = grub_file_open (pack_filename, GRUB_FILE_TYPE_GRUB_MODULE
+			 | GRUB_FILE_TYPE_NO_DECOMPRESS);
+  if (! file)
+    goto fail;
+
+  if (grub_file_read (file, &header, sizeof (header)) != sizeof (header)
+      || grub_memcmp (header.magic, GRUB_DL_PACK_MAGIC,
+		      sizeof (header.magic)) != 0
+      || grub_le_to_cpu32 (header.version) != GRUB_DL_PACK_VERSION)
+    goto fail_close;
+
+  pack_index_size = grub_le_to_cpu32 (header.index_size);
+  pack_nmodules = grub_le_to_cpu32 (header.nmodules);
+  if (pack_index_size <= sizeof (header)
+      || pack_index_size > grub_file_size (file)
+      || pack_nmodules > (pack_index_size - sizeof (header))
+			 / sizeof (struct grub_dl_pack_module))
+    goto fail_close;
+
+  pack_index = grub_malloc (pack_index_size);
+  if (! pack_index)
+    goto fail_close;
+  grub_memcpy (pack_index, &header, sizeof (header));
+  if (grub_file_read (file, pack_index + sizeof (header),
+		      pack_index_size - sizeof (header))
+      != (grub_ssize_t) (pack_index_size - sizeof (header))
+      /* So that the names are terminated.  */
+      || pack_index[pack_index_size - 1] != 0)
+    goto fail_close;
+  grub_file_close (file);
+
+  pack_nsymbols = grub_le_to_cpu32 (header.nsymbols);
+  pack_symbols = grub_calloc (pack_nsymbols, sizeof (pack_symbols[0]));
+  if (! pack_symbols)
+    {
+      pack_nsymbols = 0;
+      grub_errno = GRUB_ERR_NONE;
+    }
+
+  grub_dprintf ("modules", "%u modules in %s\n", pack_nmodules,
+		pack_filename);
+  return 1;
+
+ fail_close:
+  grub_file_close (file);
+ fail:
+  grub_free (pack_index);
+  pack_index = 0;
+  pack_index_size = pack_nmodules = 0;
+  grub_errno = GRUB_ERR_NONE;
+  return 0;
+}
+
+static const struct grub_dl_pack_module *
+grub_dl_pack_module (grub_uint32_t i)
+{
+  return (const struct grub_dl_pack_module *)
+    (pack_index + sizeof (struct grub_dl_pack_header)) + i;
+}
+
+/* Return the name of the module M in the pack, or NULL if it's bad.  */
+static const char *
+grub_dl_pack_module_name (const struct grub_dl_pack_module *m)
+{
+  if (grub_le_to_cpu32 (m->name) >= pack_index_size)
+    return 0;
+  return (const char *) pack_index + grub_le_to_cpu32 (m->name);
+}
+
+/* Offset of the symbol map of the module M in the pack.  */
+static grub_uint64_t
+grub_dl_pack_symmap_offset (const struct grub_dl_pack_module *m)
+{
+  return ALIGN_UP ((grub_uint64_t) grub_le_to_cpu32 (m->offset)
+		   + grub_le_to_cpu32 (m->size), 4);
+}
+
+/* A module to load from the pack.  */
+struct grub_dl_pack_load
+{
+  grub_uint32_t index;
+  /* The buffer read, if this module starts it.  */
+  grub_uint8_t *run;
+  grub_uint8_t *core;
+  grub_uint32_t size;
+  const grub_uint32_t *symmap;
+  grub_uint32_t nsymbols;
+};
+
+/* Load the module NAME with all its dependencies from the modules pack in
+   the directory DIR.  The ones not loaded yet are read with a single open
+   of the pack, and modules next to each other in one read.  Return NULL
+   with GRUB_ERR_NONE if there is no pack, it doesn't have the module, or
+   it turns out to be unusable.  */
+static grub_dl_t
+grub_dl_load_pack (const char *dir, const char *name)
+{
+  const struct grub_dl_pack_module *m = 0;
+  const grub_uint32_t *deps;
+  grub_uint32_t i, j, k, ndeps, n = 0;
+  struct grub_dl_pack_load *load = 0;
+  grub_file_t file = 0;
+  grub_dl_t mod = 0;
+
+  if (! grub_dl_open_pack (dir))
+    return 0;
+
+  for (i = 0; i < pack_nmodules; i++)
+    {
+      const char *mname;
+
+      m = grub_dl_pack_module (i);
+      mname = grub_dl_pack_module_name (m);
+      if (mname && grub_strcmp (mname, name) == 0)
+	break;
+    }
+  if (i == pack_nmodules)
+    return 0;
+
+  ndeps = grub_le_to_cpu32 (m->ndeps);
+  if (ndeps == 0 || grub_le_to_cpu32 (m->deps) % 4
+      || grub_le_to_cpu32 (m->deps) > pack_index_size
+      || ndeps > (pack_index_size - grub_le_to_cpu32 (m->deps)) / 4)
+    goto bad;
+  deps = (const grub_uint32_t *) (pack_index + grub_le_to_cpu32 (m->deps));
+
+  grub_boot_time ("Loading module %s from %s", name, pack_filename);
+
+  load = grub_calloc (ndeps, sizeof (load[0]));
+  if (! load)
+    goto out;
+
+  /* Skip what is loaded already.  */
+  for (j = 0; j < ndeps; j++)
+    {
+      grub_uint32_t d = grub_le_to_cpu32 (deps[j]);
+      const char *dname;
+
+      if (d >= pack_nmodules || (j && d <= grub_le_to_cpu32 (deps[j - 1])))
+	goto bad;
+      dname = grub_dl_pack_module_name (grub_dl_pack_module (d));
+      if (! dname)
+	goto bad;
+      if (! grub_dl_get (dname))
+	load[n++].index = d;
+    }
+  if (n == 0 || load[n - 1].index != i)
+    goto bad;
+
+  file = grub_file_open (pack_filename, GRUB_FILE_TYPE_GRUB_MODULE
+			 | GRUB_FILE_TYPE_NO_DECOMPRESS);
+  if (! file)
+    goto out;
+
+  /* Read each run of consecutive modules at once.  */
+  for (i = 0; i < n; i = j)
+    {
+      grub_uint64_t start, end = 0;
+      grub_size_t len;
+
+      start = grub_le_to_cpu32 (grub_dl_pack_module (load[i].index)->offset);
+      for (j = i; j < n && (j == i || load[j].index == load[j - 1].index + 1);
+	   j++)
+	{
+	  m = grub_dl_pack_module (load[j].index);
+	  if (grub_le_to_cpu32 (m->offset) % GRUB_DL_PACK_ALIGN
+	      || grub_le_to_cpu32 (m->offset) < (j == i ? pack_index_size : end))
+	    goto bad;
+	  end = grub_dl_pack_symmap_offset (m)
+	    + 4 * (grub_uint64_t) grub_le_to_cpu32 (m->nsymbols);
+	}
+
+      len = end - start;
+      if (end > grub_file_size (file) || len != end - start)
+	goto bad;
+      load[i].run = grub_malloc (len);
+      if (! load[i].run)
+	goto out;
+      if (grub_file_seek (file, start) == (grub_off_t) -1)
+	goto out;
+      if (grub_file_read (file, load[i].run, len) != (grub_ssize_t) len)
+	{
+	  if (! grub_errno)
+	    grub_error (GRUB_ERR_FILE_READ_ERROR,
+			N_("premature end of file %s"), pack_filename);
+	  goto out;
+	}
+
+      for (k = i; k < j; k++)
+	{
+	  m = grub_dl_pack_module (load[k].index);
+	  load[k].core = load[i].run + grub_le_to_cpu32 (m->offset) - start;
+	  load[k].size = grub_le_to_cpu32 (m->size);
+	  load[k].symmap = (const grub_uint32_t *)
+	    (load[i].run + grub_dl_pack_symmap_offset (m) - start);
+	  load[k].nsymbols = grub_le_to_cpu32 (m->nsymbols);
+	}
+    }
+
+  /* We must close this before the modules are initialized, like
+     grub_dl_load_file does.  The pack index isn't used from here on, as
+     loading the dependencies may end up dropping it.  */
+  grub_file_close (file);
+  file = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      mod = grub_dl_load_core_init (load[i].core, load[i].size,
+				    load[i].symmap, load[i].nsymbols);
+      if (! mod)
+	goto out;
+      mod->ref_count--;
+    }
+  goto out;
+
+ bad:
+  /* Use the module files from now on.  */
+  grub_dprintf ("modules", "invalid modules pack %s\n", pack_filename);
+  grub_free (pack_index);
+  pack_index = 0;
+  pack_index_size = pack_nmodules = 0;
+  grub_errno = GRUB_ERR_NONE;
+  mod = 0;
+ out:
+  if (file)
+    grub_file_close (file);
+  for (i = 0; load && i < n; i++)
+    grub_free (load[i].run);
+  grub_free (load);
+  return mod;
+}
+
 /* Load a module using a symbolic name.  */
 grub_dl_t
 grub_dl_load (const char *name)
@@ -750,13 +1128,21 @@ grub_dl_load (const char *name)
     return 0;
   }
 
-  filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM "/%s.mod",
-			     grub_dl_dir, name);
-  if (! filename)
-    return 0;
+  grub_trace_begin (GRUB_TRACE_MODULE, grub_trace_intern (name), 0);
+
+  mod = grub_dl_load_pack (grub_dl_dir, name);
+  if (! mod && grub_errno == GRUB_ERR_NONE)
+    {
+      filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM
+				 "/%s.mod", grub_dl_dir, name);
+      if (filename)
+	{
+	  mod = grub_dl_load_file (filename);
+	  grub_free (filename);
+	}
+    }
 
-  mod = grub_dl_load_file (filename);
-  grub_free (filename);
+  grub_trace_end (GRUB_TRACE_MODULE, grub_trace_intern (name), 0);
 
   if (! mod)
     return 0;
@@ -25,6 +25,7 @@
 #include <setjmp.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
 #include <sys/types.h>
 
 #include <grub/dl.h>
@@ -43,6 +44,8 @@
 #include <grub/i18n.h>
 #include <grub/loader.h>
 #include <grub/util/misc.h>
+#include <grub/emu/hostfile.h>
+#include <grub/trace.h>
 
 #pragma GCC diagnostic ignored "-Wmissing-prototypes"
 
@@ -94,6 +97,7 @@ grub_machine_fini (int flags)
 
 
 #define OPT_MEMDISK 257
+#define OPT_TRACE 258
 
 static struct argp_option options[] = {
   {"root",      'r', N_("DEVICE_NAME"), 0, N_("Set root device."), 2},
@@ -107,6 +111,10 @@ static struct argp_option options[] = {
    N_("use GRUB files in the directory DIR [default=%s]"), 0},
   {"verbose",     'v', 0,      0, N_("print verbose messages."), 0},
   {"hold",     'H', N_("SECS"),      OPTION_ARG_OPTIONAL, N_("wait until a debugger will attach"), 0},
+#if BOOT_TIME_STATS
+  {"trace",  OPT_TRACE, N_("FILE"), 0,
+   N_("write the boot time trace to FILE in Chrome trace format on exit"), 0},
+#endif
   { 0, 0, 0, 0, 0, 0 }
 };
 
@@ -132,6 +140,7 @@ struct arguments
 {
   const char *dev_map;
   const char *mem_disk;
+  const char *trace;
   int hold;
 };
 
@@ -147,6 +156,9 @@ argp_parser (int key, char *arg, struct argp_state *state)
     case OPT_MEMDISK:
       arguments->mem_disk = arg;
       break;
+    case OPT_TRACE:
+      arguments->trace = arg;
+      break;
     case 'r':
       free (root_dev);
       root_dev = xstrdup (arg);
@@ -188,6 +200,86 @@ static struct argp argp = {
 
 
 
+#if BOOT_TIME_STATS
+static void
+write_json_string (FILE *fp, const char *s)
+{
+  putc ('"', fp);
+  for (; *s; s++)
+    if (*s == '"' || *s == '\\')
+      fprintf (fp, "\\%c", *s);
+    else if ((unsigned char) *s < 0x20)
+      fprintf (fp, "\\u%04x", (unsigned char) *s);
+    else
+      putc (*s, fp);
+  putc ('"', fp);
+}
+
+/* Write the trace of grub_trace_export to NAME as JSON for the Chrome
+   trace viewer, with the counters at the end.  */
+static void
+write_trace (const char *name)
+{
+  static const char *categories[] = GRUB_TRACE_CATEGORY_NAMES;
+  static const char phases[] = { 'B', 'E', 'i' };
+  struct grub_trace_header *header;
+  struct grub_trace_counter_record *counters;
+  struct grub_trace_record *records;
+  const char *strings;
+  grub_uint32_t nevents, ncounters, i;
+  grub_uint64_t last = 0;
+  grub_size_t size;
+  FILE *fp;
+
+  header = grub_trace_export (&size);
+  if (!header)
+    grub_util_error ("%s", grub_errmsg);
+
+  ncounters = grub_le_to_cpu32 (header->ncounters);
+  nevents = grub_le_to_cpu32 (header->nevents);
+  counters = (struct grub_trace_counter_record *) (header + 1);
+  records = (struct grub_trace_record *) (counters + ncounters);
+  strings = (const char *) header + grub_le_to_cpu32 (header->strings);
+
+  fp = grub_util_fopen (name, "w");
+  if (!fp)
+    grub_util_error (_("cannot open `%s': %s"), name, strerror (errno));
+
+  fprintf (fp, "{\"traceEvents\":[");
+  for (i = 0; i < nevents; i++)
+    {
+      struct grub_trace_record *r = &records[i];
+
+      if (r->type >= ARRAY_SIZE (phases)
+	  || r->category >= ARRAY_SIZE (categories))
+	continue;
+      last = grub_le_to_cpu64 (r->time);
+      fprintf (fp, "\n{\"name\":");
+      write_json_string (fp, strings + grub_le_to_cpu32 (r->name));
+      fprintf (fp, ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,"
+	       "\"pid\":1,\"tid\":1,\"args\":{\"value\":%llu}%s},",
+	       categories[r->category], phases[r->type],
+	       (unsigned long long) last,
+	       (unsigned long long) grub_le_to_cpu64 (r->value),
+	       r->type == GRUB_TRACE_INSTANT ? ",\"s\":\"g\"" : "");
+    }
+  fprintf (fp, "\n{\"name\":\"counters\",\"ph\":\"C\",\"ts\":%llu,"
+	   "\"pid\":1,\"tid\":1,\"args\":{", (unsigned long long) last);
+  for (i = 0; i < ncounters; i++)
+    {
+      write_json_string (fp, strings + grub_le_to_cpu32 (counters[i].name));
+      fprintf (fp, ":%llu%s",
+	       (unsigned long long) grub_le_to_cpu64 (counters[i].value),
+	       i + 1 < ncounters ? "," : "");
+    }
+  fprintf (fp, "}}\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  if (fclose (fp) != 0)
+    grub_util_error (_("cannot write to `%s': %s"), name, strerror (errno));
+  grub_free (header);
+}
+#endif
+
 #pragma GCC diagnostic ignored "-Wmissing-prototypes"
 
 int
@@ -198,6 +290,7 @@ main (int argc, char *argv[])
       .dev_map = DEFAULT_DEVICE_MAP,
       .hold = 0,
       .mem_disk = 0,
+      .trace = 0,
     };
   volatile int hold = 0;
   size_t total_module_size = sizeof (struct grub_module_info), memdisk_size = 0;
@@ -276,6 +369,11 @@ main (int argc, char *argv[])
   if (setjmp (main_env) == 0)
     grub_main ();
 
+#if BOOT_TIME_STATS
+  if (arguments.trace)
+    write_trace (arguments.trace);
+#endif
+
   grub_fini_all ();
   grub_hostfs_fini ();
   grub_host_fini ();
@@ -73,3 +73,27 @@ grub_realloc (void *ptr, grub_size_t size)
     grub_error (GRUB_ERR_OUT_OF_MEMORY, N_("out of memory"));
   return ret;
 }
+
+/* The host does the accounting, so tags are not even kept.  */
+grub_mm_tag_t
+grub_mm_tag_get (const char *name __attribute__ ((unused)),
+		 grub_mm_tag_t parent)
+{
+  return parent;
+}
+
+grub_mm_tag_t
+grub_mm_tag_set (grub_mm_tag_t tag __attribute__ ((unused)))
+{
+  return NULL;
+}
+
+void
+grub_mm_evictor_register (grub_mm_evictor_t evictor __attribute__ ((unused)))
+{
+}
+
+void
+grub_mm_evictor_unregister (grub_mm_evictor_t evictor __attribute__ ((unused)))
+{
+}
@@ -25,6 +25,7 @@
 #include <grub/fs.h>
 #include <grub/device.h>
 #include <grub/i18n.h>
+#include <grub/trace.h>
 
 void (*EXPORT_VAR (grub_grubnet_fini)) (void);
 
@@ -66,6 +67,8 @@ grub_file_open (const char *name, enum grub_file_type type)
   const char *file_name;
   grub_file_filter_id_t filter;
 
+  grub_trace_begin (GRUB_TRACE_FILE, "open", 0);
+
   device_name = grub_file_get_device_name (name);
   if (grub_errno)
     goto fail;
@@ -105,6 +108,14 @@ grub_file_open (const char *name, enum grub_file_type type)
       file->fs = grub_fs_probe (device);
       if (! file->fs)
 	goto fail;
+
+      if (file->fs->fs_mount)
+	{
+	  file->mount = grub_fs_mount (file->fs, &device);
+	  if (! file->mount)
+	    goto fail;
+	  file->device = device;
+	}
     }
 
   if ((file->fs->fs_open) (file, file_name) != GRUB_ERR_NONE)
@@ -128,16 +139,20 @@ grub_file_open (const char *name, enum grub_file_type type)
   if (!file)
     grub_file_close (last_file);
 
+  grub_trace_end (GRUB_TRACE_FILE, "open", file ? file->size : 0);
   return file;
 
  fail:
-  if (device)
+  if (file && file->mount)
+    grub_fs_unmount (file->mount);
+  else if (device)
     grub_device_close (device);
 
   /* if (net) grub_net_close (net);  */
 
   grub_free (file);
 
+  grub_trace_end (GRUB_TRACE_FILE, "open", 0);
   return 0;
 }
 
@@ -181,7 +196,10 @@ grub_file_read (grub_file_t file, void *buf, grub_size_t len)
   file->read_hook = read_hook;
   file->read_hook_data = read_hook_data;
   if (res > 0)
-    file->offset += res;
+    {
+      file->offset += res;
+      grub_trace_count (GRUB_TRACE_FILE_READ_BYTES, res);
+    }
 
   return res;
 }
@@ -192,7 +210,9 @@ grub_file_close (grub_file_t file)
   if (file->fs->fs_close)
     (file->fs->fs_close) (file);
 
-  if (file->device)
+  if (file->mount)
+    grub_fs_unmount (file->mount);
+  else if (file->device)
     grub_device_close (file->device);
   grub_free (file->name);
   grub_free (file);
@@ -26,12 +26,221 @@
 #include <grub/types.h>
 #include <grub/mm.h>
 #include <grub/term.h>
+#include <grub/time.h>
+#include <grub/partition.h>
 #include <grub/i18n.h>
+#include <grub/trace.h>
 
 grub_fs_t grub_fs_list = 0;
 
 grub_fs_autoload_hook_t grub_fs_autoload_hook = 0;
 
+/* Incremented whenever what was found on the disks may have changed.  */
+unsigned long grub_fs_cache_generation;
+
+/* Mounted filesystems.  An entry remembers which filesystem was found on
+   a partition, so that it isn't probed again, and for filesystems with
+   fs_mount the mount data along with the device it was read from.  Files
+   opened on the same partition share both.  Entries nobody uses are kept
+   for GRUB_FS_CACHE_TIMEOUT seconds, like the disk cache, in case the
+   medium is changed.  */
+#define GRUB_FS_CACHE_TIMEOUT	2
+
+#ifdef GRUB_UTIL
+/* The tools may run while the filesystems are being modified.  */
+#define GRUB_FS_CACHE_IDLE_MAX	0
+#else
+#define GRUB_FS_CACHE_IDLE_MAX	8
+#endif
+
+struct grub_fs_cache_entry
+{
+  struct grub_fs_cache_entry *next;
+
+  unsigned long dev_id;
+  unsigned long disk_id;
+  grub_disk_addr_t start;
+  grub_uint64_t len;
+
+  grub_fs_t fs;
+
+  /* The device DATA refers to, or NULL if not mounted yet.  */
+  grub_device_t device;
+  void *data;
+
+  unsigned refs;
+  /* Don't hand it out any more, the disk was written to.  */
+  int stale;
+  grub_uint64_t last_use;
+};
+
+static struct grub_fs_cache_entry *grub_fs_cache;
+
+static void
+fs_cache_free (struct grub_fs_cache_entry *e)
+{
+  struct grub_fs_cache_entry **p;
+
+  for (p = &grub_fs_cache; *p; p = &(*p)->next)
+    if (*p == e)
+      {
+	*p = e->next;
+	break;
+      }
+  if (e->data)
+    e->fs->fs_unmount (e->data);
+  if (e->device)
+    grub_device_close (e->device);
+  grub_free (e);
+}
+
+/* Drop unused entries that are stale, too old or too many.  */
+static void
+fs_cache_expire (void)
+{
+  struct grub_fs_cache_entry *e, *next;
+  grub_uint64_t now = grub_get_time_ms ();
+  unsigned idle = 0;
+
+  for (e = grub_fs_cache; e; e = next)
+    {
+      next = e->next;
+      if (e->refs)
+	continue;
+      if (e->stale || now > e->last_use + GRUB_FS_CACHE_TIMEOUT * 1000
+	  || ++idle > GRUB_FS_CACHE_IDLE_MAX)
+	fs_cache_free (e);
+    }
+}
+
+static void
+fs_cache_key (grub_disk_t disk, grub_disk_addr_t *start, grub_uint64_t *len)
+{
+  *start = grub_partition_get_start (disk->partition);
+  *len = disk->partition ? grub_partition_get_len (disk->partition)
+    : disk->total_sectors;
+}
+
+static struct grub_fs_cache_entry *
+fs_cache_find (grub_disk_t disk)
+{
+  struct grub_fs_cache_entry *e;
+  grub_disk_addr_t start;
+  grub_uint64_t len;
+
+  fs_cache_expire ();
+  fs_cache_key (disk, &start, &len);
+  for (e = grub_fs_cache; e; e = e->next)
+    if (! e->stale && e->dev_id == disk->dev->id && e->disk_id == disk->id
+	&& e->start == start && e->len == len)
+      return e;
+  return 0;
+}
+
+static struct grub_fs_cache_entry *
+fs_cache_add (grub_disk_t disk, grub_fs_t fs)
+{
+  struct grub_fs_cache_entry *e;
+
+  e = grub_zalloc (sizeof (*e));
+  if (! e)
+    return 0;
+  e->dev_id = disk->dev->id;
+  e->disk_id = disk->id;
+  fs_cache_key (disk, &e->start, &e->len);
+  e->fs = fs;
+  e->last_use = grub_get_time_ms ();
+  /* Newest first, so that expiring keeps the most recent ones.  */
+  e->next = grub_fs_cache;
+  grub_fs_cache = e;
+  return e;
+}
+
+/* Remember that FS was found on DISK.  */
+static grub_fs_t
+fs_cache_probed (grub_disk_t disk, grub_fs_t fs)
+{
+#if GRUB_FS_CACHE_IDLE_MAX
+  if (! fs_cache_add (disk, fs))
+    grub_errno = GRUB_ERR_NONE;
+  fs_cache_expire ();
+#else
+  (void) disk;
+#endif
+  return fs;
+}
+
+/* Return the mount data of FS on *DEVICE, mounting it if needed, or NULL
+   on error.  The device then belongs to the cache, and may be replaced by
+   the one the filesystem was mounted from.  Release it with
+   grub_fs_unmount rather than closing the device.  */
+void *
+grub_fs_mount (grub_fs_t fs, grub_device_t *device)
+{
+  struct grub_fs_cache_entry *e;
+  grub_disk_t disk = (*device)->disk;
+  grub_err_t err;
+  void *data;
+
+  e = fs_cache_find (disk);
+  if (e && e->fs == fs && e->data)
+    {
+      grub_device_close (*device);
+      *device = e->device;
+      e->refs++;
+      grub_trace_count (GRUB_TRACE_FS_CACHE_HITS, 1);
+      return e->data;
+    }
+
+  grub_trace_begin (GRUB_TRACE_FS, grub_trace_intern (fs->name), 0);
+  err = fs->fs_mount (*device, &data);
+  grub_trace_end (GRUB_TRACE_FS, grub_trace_intern (fs->name), 0);
+  if (err != GRUB_ERR_NONE)
+    return 0;
+
+  if (! e || e->fs != fs || e->data)
+    e = fs_cache_add (disk, fs);
+  if (! e)
+    {
+      fs->fs_unmount (data);
+      return 0;
+    }
+  e->device = *device;
+  e->data = data;
+  e->refs = 1;
+  return data;
+}
+
+/* Release mount data returned by grub_fs_mount.  */
+void
+grub_fs_unmount (void *data)
+{
+  struct grub_fs_cache_entry *e;
+
+  for (e = grub_fs_cache; e; e = e->next)
+    if (e->data == data && e->refs)
+      {
+	e->refs--;
+	e->last_use = grub_get_time_ms ();
+	break;
+      }
+  fs_cache_expire ();
+}
+
+/* Forget what is known about the filesystems on DISK, or on all disks if
+   DISK is NULL.  Entries in use are dropped when they are released.  */
+void
+grub_fs_cache_invalidate (grub_disk_t disk)
+{
+  struct grub_fs_cache_entry *e;
+
+  for (e = grub_fs_cache; e; e = e->next)
+    if (! disk || (e->dev_id == disk->dev->id && e->disk_id == disk->id))
+      e->stale = 1;
+  grub_fs_cache_generation++;
+  fs_cache_expire ();
+}
+
 /* Helper for grub_fs_probe.  */
 static int
 probe_dummy_iter (const char *filename __attribute__ ((unused)),
@@ -41,6 +250,124 @@ probe_dummy_iter (const char *filename __attribute__ ((unused)),
   return 1;
 }
 
+/* Filesystems are recognized by the magic numbers in their superblocks
+   before their drivers are tried.  Most of them are near the start, so
+   that much is read at once and the rest read on their own.  */
+#define GRUB_FS_PROBE_WINDOW	(64 << 10)
+
+struct probe_window
+{
+  grub_uint8_t *buf;
+  grub_size_t size;
+};
+
+static void
+probe_window_read (grub_disk_t disk, struct probe_window *w)
+{
+  grub_uint64_t sectors = grub_disk_native_sectors (disk);
+
+  w->size = GRUB_FS_PROBE_WINDOW;
+  if (sectors < (GRUB_FS_PROBE_WINDOW >> GRUB_DISK_SECTOR_BITS))
+    w->size = sectors << GRUB_DISK_SECTOR_BITS;
+
+  w->buf = w->size ? grub_malloc (w->size) : 0;
+  if (! w->buf || grub_disk_read (disk, 0, 0, w->size, w->buf))
+    {
+      grub_free (w->buf);
+      w->buf = 0;
+      w->size = 0;
+      grub_errno = GRUB_ERR_NONE;
+    }
+}
+
+/* Return 0 if none of SIGS is on DISK, or 1 if one is or if it couldn't
+   be told.  */
+static int
+signatures_match (grub_disk_t disk, const struct probe_window *w,
+		  const struct grub_fs_signature *sigs)
+{
+  grub_uint8_t tmp[GRUB_FS_SIGNATURE_MAX];
+  const grub_uint8_t *p;
+
+  for (; sigs->len; sigs++)
+    {
+      if ((grub_size_t) sigs->offset + sigs->len <= w->size)
+	p = w->buf + sigs->offset;
+      else if (sigs->len > sizeof (tmp))
+	return 1;
+      else if (grub_disk_read (disk, 0, sigs->offset, sigs->len, tmp))
+	{
+	  /* Past the end of the device there is nothing to find.  */
+	  if (grub_errno != GRUB_ERR_OUT_OF_RANGE)
+	    {
+	      grub_errno = GRUB_ERR_NONE;
+	      return 1;
+	    }
+	  grub_errno = GRUB_ERR_NONE;
+	  continue;
+	}
+      else
+	p = tmp;
+
+      if (grub_memcmp (p, sigs->magic, sigs->len) == 0)
+	return 1;
+    }
+  return 0;
+}
+
+int
+grub_fs_signatures_match (grub_disk_t disk,
+			  const struct grub_fs_signature *sigs)
+{
+  struct probe_window none = { 0, 0 };
+
+  return signatures_match (disk, &none, sigs);
+}
+
+/* Helper for grub_fs_probe.  Return 0 if FS is on DEVICE, 1 if it isn't
+   and -1 on errors other than that.  */
+static int
+probe_fs (grub_device_t device, const struct probe_window *w, grub_fs_t p)
+{
+  if (p->signatures && ! signatures_match (device->disk, w, p->signatures))
+    {
+      grub_dprintf ("fs", "%s signature not found.\n", p->name);
+      return 1;
+    }
+
+  grub_dprintf ("fs", "Detecting %s...\n", p->name);
+
+  /* This is evil: newly-created just mounted BtrFS after copying all
+     GRUB files has a very peculiar unrecoverable corruption which
+     will be fixed at sync but we'd rather not do a global sync and
+     syncing just files doesn't seem to help. Relax the check for
+     this time.  */
+#ifdef GRUB_UTIL
+  if (grub_strcmp (p->name, "btrfs") == 0)
+    {
+      char *label = 0;
+      p->fs_uuid (device, &label);
+      if (label)
+	grub_free (label);
+    }
+  else
+#endif
+    (p->fs_dir) (device, "/", probe_dummy_iter, NULL);
+  if (grub_errno == GRUB_ERR_NONE)
+    return 0;
+
+  grub_error_push ();
+  grub_dprintf ("fs", "%s detection failed.\n", p->name);
+  grub_error_pop ();
+
+  if (grub_errno != GRUB_ERR_BAD_FS
+      && grub_errno != GRUB_ERR_OUT_OF_RANGE)
+    return -1;
+
+  grub_errno = GRUB_ERR_NONE;
+  return 1;
+}
+
 grub_fs_t
 grub_fs_probe (grub_device_t device)
 {
@@ -50,69 +377,49 @@ grub_fs_probe (grub_device_t device)
     {
       /* Make it sure not to have an infinite recursive calls.  */
       static int count = 0;
+      struct probe_window w;
+      int r = 1;
+#if GRUB_FS_CACHE_IDLE_MAX
+      struct grub_fs_cache_entry *e;
 
-      for (p = grub_fs_list; p; p = p->next)
+      e = fs_cache_find (device->disk);
+      if (e)
 	{
-	  grub_dprintf ("fs", "Detecting %s...\n", p->name);
-
-	  /* This is evil: newly-created just mounted BtrFS after copying all
-	     GRUB files has a very peculiar unrecoverable corruption which
-	     will be fixed at sync but we'd rather not do a global sync and
-	     syncing just files doesn't seem to help. Relax the check for
-	     this time.  */
-#ifdef GRUB_UTIL
-	  if (grub_strcmp (p->name, "btrfs") == 0)
-	    {
-	      char *label = 0;
-	      p->fs_uuid (device, &label);
-	      if (label)
-		grub_free (label);
-	    }
-	  else
+	  e->last_use = grub_get_time_ms ();
+	  return e->fs;
+	}
 #endif
-	    (p->fs_dir) (device, "/", probe_dummy_iter, NULL);
-	  if (grub_errno == GRUB_ERR_NONE)
-	    return p;
-
-	  grub_error_push ();
-	  grub_dprintf ("fs", "%s detection failed.\n", p->name);
-	  grub_error_pop ();
 
-	  if (grub_errno != GRUB_ERR_BAD_FS
-	      && grub_errno != GRUB_ERR_OUT_OF_RANGE)
-	    return 0;
+      probe_window_read (device->disk, &w);
 
-	  grub_errno = GRUB_ERR_NONE;
+      for (p = grub_fs_list; p; p = p->next)
+	{
+	  r = probe_fs (device, &w, p);
+	  if (r <= 0)
+	    break;
 	}
 
       /* Let's load modules automatically.  */
-      if (grub_fs_autoload_hook && count == 0)
+      if (r > 0 && grub_fs_autoload_hook && count == 0)
 	{
 	  count++;
 
-	  while (grub_fs_autoload_hook ())
+	  while (grub_fs_autoload_hook (device->disk))
 	    {
 	      p = grub_fs_list;
-
-	      (p->fs_dir) (device, "/", probe_dummy_iter, NULL);
-	      if (grub_errno == GRUB_ERR_NONE)
-		{
-		  count--;
-		  return p;
-		}
-
-	      if (grub_errno != GRUB_ERR_BAD_FS
-		  && grub_errno != GRUB_ERR_OUT_OF_RANGE)
-		{
-		  count--;
-		  return 0;
-		}
-
-	      grub_errno = GRUB_ERR_NONE;
+	      r = probe_fs (device, &w, p);
+	      if (r <= 0)
+		break;
 	    }
 
 	  count--;
 	}
+
+      grub_free (w.buf);
+      if (r == 0)
+	return fs_cache_probed (device->disk, p);
+      if (r < 0)
+	return 0;
     }
   else if (device->net && device->net->fs)
     return device->net->fs;
@@ -121,7 +428,7 @@ grub_fs_probe (grub_device_t device)
   return 0;
 }
 
-
+
 
 /* Block list support routines.  */
 
@@ -1229,6 +1229,7 @@ grub_fatal (const char *fmt, ...)
 #if BOOT_TIME_STATS
 
 #include <grub/time.h>
+#include <grub/trace.h>
 
 struct grub_boot_time *grub_boot_time_head;
 static struct grub_boot_time **boot_time_last = &grub_boot_time_head;
@@ -1261,6 +1262,9 @@ grub_real_boot_time (const char *file,
   *boot_time_last = n;
   boot_time_last = &n->next;
 
+  if (n->msg)
+    grub_real_trace (GRUB_TRACE_INSTANT, GRUB_TRACE_MARK, n->msg, 0);
+
   grub_errno = 0;
   grub_error_pop ();
 }
@@ -28,6 +28,9 @@
   - multiple regions may be used as free space. They may not be
   contiguous.
 
+  - platforms may add regions when the heap runs out, and give huge blocks
+  pages of their own outside of the heap.
+
   Regions are managed by a singly linked list, and the meta information is
   stored in the beginning of each region. Space after the meta information
   is used to allocate memory.
@@ -42,10 +45,10 @@
 
   There are two types of blocks: allocated blocks and free blocks.
 
-  In allocated blocks, the header of each block has only its size. Note that
-  this size is based on cells but not on bytes. The header is located right
-  before the returned pointer, that is, the header resides at the previous
-  cell.
+  In allocated blocks, the header of each block has only its size and the
+  tag it is charged to. Note that this size is based on cells but not on
+  bytes. The header is located right before the returned pointer, that is,
+  the header resides at the previous cell.
 
   Free blocks constitutes a ring, using a singly linked list. The first free
   block is pointed to by the meta information of a region. The allocator
@@ -53,6 +56,14 @@
   a typical optimization against defragmentation, and makes the
   implementation a bit easier.
 
+  Free blocks of two cells or more are also nodes of a treap, keyed by
+  their address and kept in their second cell, and each node knows the
+  size of the biggest block below it.  It finds the free block at the lowest address
+  which is big enough, and where to look in the ring around a block, in
+  logarithmic time, so that neither allocating nor freeing walks the whole
+  ring.  The rings stay what the heap is made of: the index is rebuilt
+  from them when something else changed them.
+
   For safety, both allocated blocks and free ones are marked by magic
   numbers. Whenever anything unexpected is detected, GRUB aborts the
   operation.
@@ -68,6 +79,8 @@
 #include <grub/i18n.h>
 #include <grub/mm_private.h>
 #include <grub/safemath.h>
+#include <grub/trace.h>
+#include <grub/list.h>
 
 #ifdef MM_DEBUG
 # undef grub_calloc
@@ -81,25 +94,411 @@
 
 
 grub_mm_region_t grub_mm_base;
+grub_mm_add_region_func_t grub_mm_add_region_fn;
+grub_mm_alloc_pages_func_t grub_mm_alloc_pages_fn;
+grub_mm_free_pages_func_t grub_mm_free_pages_fn;
+
+/* The heap grows by this much more than the allocation needs, so that the
+   next ones fit too and the regions stay few.  */
+#define GRUB_MM_HEAP_GROW	0x400000
+
+/* The index of the free blocks, NULL if it is empty or not valid.  */
+static grub_mm_header_t free_index;
+static int free_index_valid;
+
+/* The region of the last block looked up, which is likely to be the
+   region of the next one too.  */
+static grub_mm_region_t last_region;
+
+struct free_node
+{
+  grub_mm_header_t left;
+  grub_mm_header_t right;
+  /* The size of the biggest block in the subtree.  */
+  grub_size_t max;
+};
+
+#define FREE_NODE(h)	((struct free_node *) ((h) + 1))
+
+/* The whole heap.  Allocations made while no other tag is set are charged
+   to it alone.  */
+static struct grub_mm_tag root_tag =
+  {
+    .name = (char *) "heap"
+  };
+
+grub_mm_tag_t grub_mm_tags = &root_tag;
+static grub_mm_tag_t current_tag = &root_tag;
+static grub_mm_evictor_t evictors;
+static int evicting;
+
+/* Return the tag NAME under PARENT, or under the root tag if PARENT is
+   NULL, creating it if needed.  If it can't be created, return the parent
+   instead.  */
+grub_mm_tag_t
+grub_mm_tag_get (const char *name, grub_mm_tag_t parent)
+{
+  grub_mm_tag_t tag, *last;
+
+  if (! parent)
+    parent = &root_tag;
+
+  for (last = &grub_mm_tags; *last; last = &(*last)->next)
+    if ((*last)->parent == parent && grub_strcmp ((*last)->name, name) == 0)
+      return *last;
+
+  grub_error_push ();
+  tag = grub_zalloc (sizeof (*tag));
+  if (tag)
+    {
+      tag->name = grub_strdup (name);
+      if (! tag->name)
+	{
+	  grub_free (tag);
+	  tag = 0;
+	}
+    }
+  grub_errno = GRUB_ERR_NONE;
+  grub_error_pop ();
+  if (! tag)
+    return parent;
+
+  tag->parent = parent;
+  *last = tag;
+  return tag;
+}
+
+/* Charge the allocations from now on to TAG, or to the root tag if TAG is
+   NULL.  Return the tag they were charged to until now.  */
+grub_mm_tag_t
+grub_mm_tag_set (grub_mm_tag_t tag)
+{
+  grub_mm_tag_t old = current_tag;
+
+  current_tag = tag ? : &root_tag;
+  return old;
+}
+
+void
+grub_mm_evictor_register (grub_mm_evictor_t evictor)
+{
+  if (! evictor->tag)
+    evictor->tag = &root_tag;
+  grub_list_push (GRUB_AS_LIST_P (&evictors), GRUB_AS_LIST (evictor));
+}
+
+void
+grub_mm_evictor_unregister (grub_mm_evictor_t evictor)
+{
+  grub_list_remove (GRUB_AS_LIST (evictor));
+}
+
+/* Run the evictors of the memory charged to TAG, or all of them if TAG is
+   NULL.  */
+static void
+evict (grub_mm_tag_t tag)
+{
+  grub_mm_evictor_t e;
+  grub_mm_tag_t t;
+
+  /* An evictor which allocates anyway could get here again.  */
+  if (evicting)
+    return;
+  evicting = 1;
+
+  FOR_LIST_ELEMENTS (e, evictors)
+    {
+      for (t = e->tag; t && tag && t != tag; t = t->parent);
+      if (t)
+	e->evict ();
+    }
+
+  evicting = 0;
+}
+
+static void
+tag_charge (grub_mm_header_t p, grub_mm_tag_t tag)
+{
+  grub_size_t bytes = p->size << GRUB_MM_ALIGN_LOG2;
+
+  p->tag = tag;
+  for (; tag; tag = tag->parent)
+    {
+      tag->live += bytes;
+      tag->count++;
+      if (tag->live > tag->peak)
+	tag->peak = tag->live;
+    }
+}
+
+static void
+tag_uncharge (grub_mm_header_t p)
+{
+  grub_size_t bytes = p->size << GRUB_MM_ALIGN_LOG2;
+  grub_mm_tag_t tag;
+
+  for (tag = p->tag; tag; tag = tag->parent)
+    {
+      tag->live -= bytes;
+      tag->count--;
+    }
+}
+
+/* The priorities of the nodes are a hash of their address, so that the
+   tree stays balanced whatever the order of the blocks.  */
+static grub_uint32_t
+index_priority (grub_mm_header_t h)
+{
+  grub_addr_t a = (grub_addr_t) h >> GRUB_MM_ALIGN_LOG2;
+  grub_uint32_t x = a ^ (a >> 16 >> 16);
+
+  x ^= x >> 16;
+  x *= 0x85ebca6b;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35;
+  x ^= x >> 16;
+  return x;
+}
+
+static grub_size_t
+index_max (grub_mm_header_t t)
+{
+  return t ? FREE_NODE (t)->max : 0;
+}
+
+static void
+index_update (grub_mm_header_t t)
+{
+  struct free_node *n = FREE_NODE (t);
+
+  n->max = t->size;
+  if (index_max (n->left) > n->max)
+    n->max = index_max (n->left);
+  if (index_max (n->right) > n->max)
+    n->max = index_max (n->right);
+}
+
+/* Split the subtree T into the blocks below H, in *LO, and the others, in
+   *HI.  */
+static void
+index_split (grub_mm_header_t t, grub_mm_header_t h,
+	     grub_mm_header_t *lo, grub_mm_header_t *hi)
+{
+  if (! t)
+    {
+      *lo = *hi = 0;
+      return;
+    }
+
+  if (t < h)
+    {
+      index_split (FREE_NODE (t)->right, h, &FREE_NODE (t)->right, hi);
+      *lo = t;
+    }
+  else
+    {
+      index_split (FREE_NODE (t)->left, h, lo, &FREE_NODE (t)->left);
+      *hi = t;
+    }
+  index_update (t);
+}
+
+/* Join the subtrees LO and HI, all the blocks of LO being below those of
+   HI.  */
+static grub_mm_header_t
+index_join (grub_mm_header_t lo, grub_mm_header_t hi)
+{
+  if (! lo)
+    return hi;
+  if (! hi)
+    return lo;
+
+  if (index_priority (lo) > index_priority (hi))
+    {
+      FREE_NODE (lo)->right = index_join (FREE_NODE (lo)->right, hi);
+      index_update (lo);
+      return lo;
+    }
+
+  FREE_NODE (hi)->left = index_join (lo, FREE_NODE (hi)->left);
+  index_update (hi);
+  return hi;
+}
+
+/* Add the free block H to the index, if it is big enough to be in it.  */
+static void
+index_insert (grub_mm_header_t h)
+{
+  grub_mm_header_t lo, hi;
+
+  if (! free_index_valid || h->size < 2)
+    return;
+
+  FREE_NODE (h)->left = FREE_NODE (h)->right = 0;
+  index_update (h);
+  index_split (free_index, h, &lo, &hi);
+  free_index = index_join (index_join (lo, h), hi);
+}
+
+static grub_mm_header_t
+index_delete (grub_mm_header_t t, grub_mm_header_t h)
+{
+  if (! t)
+    grub_fatal ("free block %p is not in the index", h);
+
+  if (t == h)
+    return index_join (FREE_NODE (t)->left, FREE_NODE (t)->right);
+
+  if (h < t)
+    FREE_NODE (t)->left = index_delete (FREE_NODE (t)->left, h);
+  else
+    FREE_NODE (t)->right = index_delete (FREE_NODE (t)->right, h);
+  index_update (t);
+  return t;
+}
+
+/* Remove the free block H from the index, before it changes.  */
+static void
+index_remove (grub_mm_header_t h)
+{
+  if (! free_index_valid || h->size < 2)
+    return;
+
+  free_index = index_delete (free_index, h);
+}
+
+/* Return the lowest free block of N cells or more in the index, NULL if
+   there is none.  */
+static grub_mm_header_t
+index_find (grub_size_t n)
+{
+  grub_mm_header_t t = free_index;
+
+  if (index_max (t) < n)
+    return 0;
+
+  for (;;)
+    if (index_max (FREE_NODE (t)->left) >= n)
+      t = FREE_NODE (t)->left;
+    else if (t->size >= n)
+      return t;
+    else
+      t = FREE_NODE (t)->right;
+}
+
+/* Return the lowest block in the index above H, NULL if there is none.  */
+static grub_mm_header_t
+index_above (grub_mm_header_t h)
+{
+  grub_mm_header_t t, found = 0;
+
+  for (t = free_index; t; )
+    if (t > h)
+      {
+	found = t;
+	t = FREE_NODE (t)->left;
+      }
+    else
+      t = FREE_NODE (t)->right;
+
+  return found;
+}
+
+static int
+in_region (grub_mm_region_t r, grub_mm_header_t h)
+{
+  return ((grub_addr_t) h >= (grub_addr_t) (r + 1)
+	  && (grub_addr_t) h < (grub_addr_t) (r + 1) + r->size);
+}
+
+/* Return the free block of the region R which comes right before H in
+   its ring, as far as the index knows: the blocks in between are too
+   small to be in it.  The ring runs down the addresses and wraps around.
+   Return NULL if none of the blocks of R are in the index.  */
+static grub_mm_header_t
+index_before (grub_mm_region_t r, grub_mm_header_t h)
+{
+  grub_mm_header_t t;
+
+  t = index_above (h);
+  if (t && in_region (r, t))
+    return t;
+
+  t = index_above ((grub_mm_header_t) r);
+  if (t && in_region (r, t))
+    return t;
+
+  return 0;
+}
+
+static void
+index_rebuild (void)
+{
+  grub_mm_region_t r;
+  grub_mm_header_t p;
+
+  free_index = 0;
+  free_index_valid = 1;
+
+  for (r = grub_mm_base; r; r = r->next)
+    {
+      if (r->first->magic == GRUB_MM_ALLOC_MAGIC)
+	continue;
+
+      p = r->first;
+      do
+	{
+	  if (p->magic != GRUB_MM_FREE_MAGIC)
+	    grub_fatal ("free magic is broken at %p: 0x%x", p, p->magic);
+	  index_insert (p);
+	  p = p->next;
+	}
+      while (p != r->first);
+    }
+}
+
+void
+grub_mm_invalidate_index (void)
+{
+  free_index = 0;
+  free_index_valid = 0;
+  last_region = 0;
+}
+
+/* Return the region of the block H, NULL if it is in none.  */
+static grub_mm_region_t
+find_region (grub_mm_header_t h)
+{
+  grub_mm_region_t r;
+
+  if (last_region && in_region (last_region, h))
+    return last_region;
+
+  for (r = grub_mm_base; r; r = r->next)
+    if (in_region (r, h))
+      return last_region = r;
+
+  return 0;
+}
 
 /* Get a header from the pointer PTR, and set *P and *R to a pointer
    to the header and a pointer to its region, respectively. PTR must
-   be allocated.  */
+   be allocated.  *R is NULL for huge blocks.  */
 static void
 get_header_from_pointer (void *ptr, grub_mm_header_t *p, grub_mm_region_t *r)
 {
   if ((grub_addr_t) ptr & (GRUB_MM_ALIGN - 1))
     grub_fatal ("unaligned pointer %p", ptr);
 
-  for (*r = grub_mm_base; *r; *r = (*r)->next)
-    if ((grub_addr_t) ptr > (grub_addr_t) ((*r) + 1)
-	&& (grub_addr_t) ptr <= (grub_addr_t) ((*r) + 1) + (*r)->size)
-      break;
-
+  *p = (grub_mm_header_t) ptr - 1;
+  *r = find_region (*p);
   if (! *r)
-    grub_fatal ("out of range pointer %p", ptr);
+    {
+      if (grub_mm_free_pages_fn && (*p)->magic == GRUB_MM_HUGE_MAGIC)
+	return;
+      grub_fatal ("out of range pointer %p", ptr);
+    }
 
-  *p = (grub_mm_header_t) ptr - 1;
   if ((*p)->magic == GRUB_MM_FREE_MAGIC)
     grub_fatal ("double free at %p", *p);
   if ((*p)->magic != GRUB_MM_ALLOC_MAGIC)
@@ -134,12 +533,14 @@ grub_mm_init_region (void *addr, grub_size_t size)
 	r = (grub_mm_region_t) ALIGN_UP ((grub_addr_t) addr, GRUB_MM_ALIGN);
 	*r = *q;
 	r->pre_size += size;
+	last_region = 0;
 	
 	if (r->pre_size >> GRUB_MM_ALIGN_LOG2)
 	  {
 	    h = (grub_mm_header_t) (r + 1);
 	    h->size = (r->pre_size >> GRUB_MM_ALIGN_LOG2);
 	    h->magic = GRUB_MM_ALLOC_MAGIC;
+	    h->tag = 0;
 	    r->size += h->size << GRUB_MM_ALIGN_LOG2;
 	    r->pre_size &= (GRUB_MM_ALIGN - 1);
 	    *p = r;
@@ -166,6 +567,7 @@ grub_mm_init_region (void *addr, grub_size_t size)
   r->first = h;
   r->pre_size = (grub_addr_t) r - (grub_addr_t) addr;
   r->size = (h->size << GRUB_MM_ALIGN_LOG2);
+  index_insert (h);
 
   /* Find where to insert this region. Put a smaller one before bigger ones,
      to prevent fragmentation.  */
@@ -177,6 +579,131 @@ grub_mm_init_region (void *addr, grub_size_t size)
   r->next = q;
 }
 
+/* Allocate the number of units N with the alignment ALIGN from the free
+   block P, which comes after Q in the ring starting from *FIRST, if it is
+   big enough.  ALIGN must be a power of two. Both N and ALIGN are in units
+   of GRUB_MM_ALIGN.  Return a non-NULL if successful, otherwise return
+   NULL.  */
+static void *
+take_block (grub_mm_header_t *first, grub_mm_header_t q, grub_mm_header_t p,
+	    grub_size_t n, grub_size_t align)
+{
+  grub_mm_header_t r = 0, left = 0;
+  grub_off_t extra;
+
+  extra = ((grub_addr_t) (p + 1) >> GRUB_MM_ALIGN_LOG2) & (align - 1);
+  if (extra)
+    extra = align - extra;
+
+  if (p->size < n + extra)
+    return 0;
+
+  index_remove (p);
+
+  extra += (p->size - extra - n) & (~(align - 1));
+  if (extra == 0 && p->size == n)
+    {
+      /* There is no special alignment requirement and memory block
+	 is complete match.
+
+	 1. Just mark memory block as allocated and remove it from
+	    free list.
+
+	 Result:
+	 +---------------+ previous block's next
+	 | alloc, size=n |          |
+	 +---------------+          v
+       */
+      q->next = p->next;
+    }
+  else if (align == 1 || p->size == n + extra)
+    {
+      /* There might be alignment requirement, when taking it into
+	 account memory block fits in.
+
+	 1. Allocate new area at end of memory block.
+	 2. Reduce size of available blocks from original node.
+	 3. Mark new area as allocated and "remove" it from free
+	    list.
+
+	 Result:
+	 +---------------+
+	 | free, size-=n | next --+
+	 +---------------+        |
+	 | alloc, size=n |        |
+	 +---------------+        v
+       */
+
+      p->size -= n;
+      left = p;
+      p += p->size;
+    }
+  else if (extra == 0)
+    {
+      r = p + extra + n;
+      r->magic = GRUB_MM_FREE_MAGIC;
+      r->size = p->size - extra - n;
+      r->next = p->next;
+      q->next = r;
+
+      if (q == p)
+	{
+	  q = r;
+	  r->next = r;
+	}
+    }
+  else
+    {
+      /* There is alignment requirement and there is room in memory
+	 block.  Split memory block to three pieces.
+
+	 1. Create new memory block right after section being
+	    allocated.  Mark it as free.
+	 2. Add new memory block to free chain.
+	 3. Mark current memory block having only extra blocks.
+	 4. Advance to aligned block and mark that as allocated and
+	    "remove" it from free list.
+
+	 Result:
+	 +------------------------------+
+	 | free, size=extra             | next --+
+	 +------------------------------+        |
+	 | alloc, size=n                |        |
+	 +------------------------------+        |
+	 | free, size=orig.size-extra-n | <------+, next --+
+	 +------------------------------+                  v
+       */
+      r = p + extra + n;
+      r->magic = GRUB_MM_FREE_MAGIC;
+      r->size = p->size - extra - n;
+      r->next = p;
+
+      p->size = extra;
+      q->next = r;
+      left = p;
+      p += extra;
+    }
+
+  p->magic = GRUB_MM_ALLOC_MAGIC;
+  p->size = n;
+
+  /* Mark find as a start marker for next allocation to fasten it.
+     This will have side effect of fragmenting memory as small
+     pieces before this will be un-used.  */
+  /* So do it only for chunks under 64K.  */
+  if (n < (0x8000 >> GRUB_MM_ALIGN_LOG2)
+      || *first == p)
+    *first = q;
+
+  /* What is left of the block is free still.  */
+  if (left)
+    index_insert (left);
+  if (r)
+    index_insert (r);
+
+  return p + 1;
+}
+
 /* Allocate the number of units N with the alignment ALIGN from the ring
    buffer starting from *FIRST.  ALIGN must be a power of two. Both N and
    ALIGN are in units of GRUB_MM_ALIGN.  Return a non-NULL if successful,
@@ -185,6 +712,7 @@ static void *
 grub_real_malloc (grub_mm_header_t *first, grub_size_t n, grub_size_t align)
 {
   grub_mm_header_t p, q;
+  void *ret;
 
   /* When everything is allocated side effect is that *first will have alloc
      magic marked, meaning that there is no room in this region.  */
@@ -194,119 +722,15 @@ grub_real_malloc (grub_mm_header_t *first, grub_size_t n, grub_size_t align)
   /* Try to search free slot for allocation in this memory region.  */
   for (q = *first, p = q->next; ; q = p, p = p->next)
     {
-      grub_off_t extra;
-
-      extra = ((grub_addr_t) (p + 1) >> GRUB_MM_ALIGN_LOG2) & (align - 1);
-      if (extra)
-	extra = align - extra;
-
       if (! p)
 	grub_fatal ("null in the ring");
 
       if (p->magic != GRUB_MM_FREE_MAGIC)
 	grub_fatal ("free magic is broken at %p: 0x%x", p, p->magic);
 
-      if (p->size >= n + extra)
-	{
-	  extra += (p->size - extra - n) & (~(align - 1));
-	  if (extra == 0 && p->size == n)
-	    {
-	      /* There is no special alignment requirement and memory block
-	         is complete match.
-
-	         1. Just mark memory block as allocated and remove it from
-	            free list.
-
-	         Result:
-	         +---------------+ previous block's next
-	         | alloc, size=n |          |
-	         +---------------+          v
-	       */
-	      q->next = p->next;
-	    }
-	  else if (align == 1 || p->size == n + extra)
-	    {
-	      /* There might be alignment requirement, when taking it into
-	         account memory block fits in.
-
-	         1. Allocate new area at end of memory block.
-	         2. Reduce size of available blocks from original node.
-	         3. Mark new area as allocated and "remove" it from free
-	            list.
-
-	         Result:
-	         +---------------+
-	         | free, size-=n | next --+
-	         +---------------+        |
-	         | alloc, size=n |        |
-	         +---------------+        v
-	       */
-
-	      p->size -= n;
-	      p += p->size;
-	    }
-	  else if (extra == 0)
-	    {
-	      grub_mm_header_t r;
-	      
-	      r = p + extra + n;
-	      r->magic = GRUB_MM_FREE_MAGIC;
-	      r->size = p->size - extra - n;
-	      r->next = p->next;
-	      q->next = r;
-
-	      if (q == p)
-		{
-		  q = r;
-		  r->next = r;
-		}
-	    }
-	  else
-	    {
-	      /* There is alignment requirement and there is room in memory
-	         block.  Split memory block to three pieces.
-
-	         1. Create new memory block right after section being
-	            allocated.  Mark it as free.
-	         2. Add new memory block to free chain.
-	         3. Mark current memory block having only extra blocks.
-	         4. Advance to aligned block and mark that as allocated and
-	            "remove" it from free list.
-
-	         Result:
-	         +------------------------------+
-	         | free, size=extra             | next --+
-	         +------------------------------+        |
-	         | alloc, size=n                |        |
-	         +------------------------------+        |
-	         | free, size=orig.size-extra-n | <------+, next --+
-	         +------------------------------+                  v
-	       */
-	      grub_mm_header_t r;
-
-	      r = p + extra + n;
-	      r->magic = GRUB_MM_FREE_MAGIC;
-	      r->size = p->size - extra - n;
-	      r->next = p;
-
-	      p->size = extra;
-	      q->next = r;
-	      p += extra;
-	    }
-
-	  p->magic = GRUB_MM_ALLOC_MAGIC;
-	  p->size = n;
-
-	  /* Mark find as a start marker for next allocation to fasten it.
-	     This will have side effect of fragmenting memory as small
-	     pieces before this will be un-used.  */
-	  /* So do it only for chunks under 64K.  */
-	  if (n < (0x8000 >> GRUB_MM_ALIGN_LOG2)
-	      || *first == p)
-	    *first = q;
-
-	  return p + 1;
-	}
+      ret = take_block (first, q, p, n, align);
+      if (ret)
+	return ret;
 
       /* Search was completed without result.  */
       if (p == *first)
@@ -316,12 +740,99 @@ grub_real_malloc (grub_mm_header_t *first, grub_size_t n, grub_size_t align)
   return 0;
 }
 
+/* Allocate the number of units N with the alignment ALIGN from the lowest
+   free block which is sure to be big enough, if the index has one.  */
+static void *
+index_malloc (grub_size_t n, grub_size_t align)
+{
+  grub_mm_header_t p, q;
+  grub_mm_region_t r;
+
+  if (! free_index_valid)
+    index_rebuild ();
+
+  p = index_find (n + align - 1);
+  if (! p)
+    return 0;
+
+  r = find_region (p);
+  if (! r)
+    grub_fatal ("free block %p is out of range", p);
+
+  for (q = index_before (r, p); q->next != p; q = q->next)
+    if (q->magic != GRUB_MM_FREE_MAGIC)
+      grub_fatal ("free magic is broken at %p: 0x%x", q, q->magic);
+
+  return take_block (&r->first, q, p, n, align);
+}
+
+/* Allocate SIZE bytes with the alignment ALIGN, in bytes, in pages of
+   their own.  */
+static void *
+huge_malloc (grub_size_t align, grub_size_t size)
+{
+  grub_mm_header_t p;
+  grub_addr_t base;
+  grub_size_t bytes;
+
+  /* The block, its header and the padding before them fit in SIZE + ALIGN
+     bytes since the pages are aligned to GRUB_MM_ALIGN at least.  */
+  if (align < GRUB_MM_ALIGN)
+    align = GRUB_MM_ALIGN;
+  if (grub_add (size, align, &bytes)
+      || grub_add (bytes, GRUB_MM_HUGE_PAGE_SIZE - 1, &bytes))
+    return 0;
+  bytes &= ~((grub_size_t) GRUB_MM_HUGE_PAGE_SIZE - 1);
+
+  grub_error_push ();
+  base = (grub_addr_t) grub_mm_alloc_pages_fn (bytes);
+  grub_errno = GRUB_ERR_NONE;
+  grub_error_pop ();
+  if (! base)
+    return 0;
+
+  p = (grub_mm_header_t) ALIGN_UP (base + GRUB_MM_ALIGN, align) - 1;
+  p->next = (grub_mm_header_t) base;
+  p->size = (base + bytes - (grub_addr_t) p) >> GRUB_MM_ALIGN_LOG2;
+  p->magic = GRUB_MM_HUGE_MAGIC;
+  return p + 1;
+}
+
+static void
+huge_free (grub_mm_header_t p)
+{
+  grub_addr_t base = (grub_addr_t) p->next;
+
+  p->magic = GRUB_MM_FREE_MAGIC;
+  grub_mm_free_pages_fn ((void *) base, (grub_addr_t) (p + p->size) - base);
+}
+
+/* Ask the platform for BYTES more of heap.  Return 0 if it added some,
+   not necessarily all of it.  */
+static int
+add_region (grub_size_t bytes, unsigned int flags)
+{
+  grub_err_t err;
+
+  if (! grub_mm_add_region_fn)
+    return -1;
+
+  grub_error_push ();
+  err = grub_mm_add_region_fn (bytes, flags);
+  grub_errno = GRUB_ERR_NONE;
+  grub_error_pop ();
+  return err ? -1 : 0;
+}
+
 /* Allocate SIZE bytes with the alignment ALIGN and return the pointer.  */
 void *
 grub_memalign (grub_size_t align, grub_size_t size)
 {
   grub_mm_region_t r;
   grub_size_t n = ((size + GRUB_MM_ALIGN - 1) >> GRUB_MM_ALIGN_LOG2) + 1;
+  grub_size_t grow;
+  grub_mm_tag_t tag;
+  void *p;
   int count = 0;
 
   if (!grub_mm_base)
@@ -340,17 +851,47 @@ grub_memalign (grub_size_t align, grub_size_t size)
   if (align == 0)
     align = 1;
 
- again:
+  for (tag = current_tag; tag; tag = tag->parent)
+    if (tag->limit && tag->live + (n << GRUB_MM_ALIGN_LOG2) > tag->limit)
+      {
+	evict (tag);
+	if (tag->live + (n << GRUB_MM_ALIGN_LOG2) > tag->limit)
+	  {
+	    grub_error (GRUB_ERR_OUT_OF_MEMORY,
+			N_("memory limit of `%s' reached"), tag->name);
+	    return 0;
+	  }
+      }
 
-  for (r = grub_mm_base; r; r = r->next)
+  if (size >= GRUB_MM_HUGE_SIZE && grub_mm_alloc_pages_fn)
     {
-      void *p;
-
-      p = grub_real_malloc (&(r->first), n, align);
+      p = huge_malloc (align << GRUB_MM_ALIGN_LOG2, size);
       if (p)
-	return p;
+	goto done;
     }
 
+ again:
+
+  p = index_malloc (n, align);
+  if (p)
+    goto done;
+
+  /* Only the blocks which happen to be aligned well enough may be smaller
+     than what the index was asked for.  */
+  if (align > 1 || n < 2)
+    for (r = grub_mm_base; r; r = r->next)
+      {
+	p = grub_real_malloc (&(r->first), n, align);
+	if (p)
+	  goto done;
+      }
+
+  /* Room for the block, its alignment and the header of the region.  */
+  if (grub_add ((n + align) << GRUB_MM_ALIGN_LOG2,
+		sizeof (struct grub_mm_region) + GRUB_MM_HEAP_GROW, &grow))
+    grow = 0;
+  grow = ALIGN_DOWN (grow, GRUB_MM_HEAP_GROW);
+
   /* If failed, increase free memory somehow.  */
   switch (count)
     {
@@ -360,8 +901,28 @@ grub_memalign (grub_size_t align, grub_size_t size)
       count++;
       goto again;
 
-#if 0
     case 1:
+      /* Get more memory for the heap, in one piece.  */
+      count++;
+      if (grow && add_region (grow, GRUB_MM_ADD_REGION_CONSECUTIVE) == 0)
+	goto again;
+      /* Fallthrough.  */
+
+    case 2:
+      /* Get what's left, in case it is enough after all.  */
+      count++;
+      if (grow && add_region (grow, GRUB_MM_ADD_REGION_NONE) == 0)
+	goto again;
+      /* Fallthrough.  */
+
+    case 3:
+      /* Shrink the other caches.  */
+      evict (NULL);
+      count++;
+      goto again;
+
+#if 0
+    case 4:
       /* Unload unneeded modules.  */
       grub_dl_unload_unneeded ();
       count++;
@@ -375,6 +936,12 @@ grub_memalign (grub_size_t align, grub_size_t size)
  fail:
   grub_error (GRUB_ERR_OUT_OF_MEMORY, N_("out of memory"));
   return 0;
+
+ done:
+  tag_charge ((grub_mm_header_t) p - 1, current_tag);
+  grub_trace_count (GRUB_TRACE_ALLOCATIONS, 1);
+  grub_trace_count (GRUB_TRACE_ALLOCATED_BYTES, size);
+  return p;
 }
 
 /*
@@ -432,11 +999,22 @@ grub_free (void *ptr)
     return;
 
   get_header_from_pointer (ptr, &p, &r);
+  tag_uncharge (p);
+
+  if (! r)
+    {
+      huge_free (p);
+      return;
+    }
+
+  if (! free_index_valid)
+    index_rebuild ();
 
   if (r->first->magic == GRUB_MM_ALLOC_MAGIC)
     {
       p->magic = GRUB_MM_FREE_MAGIC;
       r->first = p->next = p;
+      index_insert (p);
     }
   else
     {
@@ -453,7 +1031,12 @@ grub_free (void *ptr)
       while (q != r->first);
 #endif
 
-      for (s = r->first, q = s->next; q <= p || q->next >= p; s = q, q = s->next)
+      /* Start from the block before the one before P: P goes right after
+	 the one before it, which must be looked at too.  */
+      s = index_before (r, p);
+      s = s ? index_before (r, s) : r->first;
+
+      for (q = s->next; q <= p || q->next >= p; s = q, q = s->next)
 	{
 	  if (q->magic != GRUB_MM_FREE_MAGIC)
 	    grub_fatal ("free magic is broken at %p: 0x%x", q, q->magic);
@@ -468,6 +1051,7 @@ grub_free (void *ptr)
 
       if (p->next + p->next->size == p)
 	{
+	  index_remove (p->next);
 	  p->magic = 0;
 
 	  p->next->size += p->size;
@@ -479,6 +1063,7 @@ grub_free (void *ptr)
 
       if (q == p + p->size)
 	{
+	  index_remove (q);
 	  q->magic = 0;
 	  p->size += q->size;
 	  if (q == s)
@@ -488,6 +1073,7 @@ grub_free (void *ptr)
 	}
 
       r->first = q;
+      index_insert (p);
     }
 }
 
@@ -521,8 +1107,8 @@ grub_realloc (void *ptr, grub_size_t size)
   if (! q)
     return q;
 
-  /* We've already checked that p->size < n.  */
-  grub_memcpy (q, ptr, p->size << GRUB_MM_ALIGN_LOG2);
+  /* We've already checked that p->size < n.  The header takes a cell.  */
+  grub_memcpy (q, ptr, (p->size - 1) << GRUB_MM_ALIGN_LOG2);
   grub_free (ptr);
   return q;
 }
@@ -0,0 +1,212 @@
+/* trace.c - boot time tracing */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/time.h>
+#include <grub/trace.h>
+
+#if BOOT_TIME_STATS
+
+/* The number of events kept.  Older ones are overwritten.  */
+#define TRACE_RING_SIZE	8192
+
+struct trace_event
+{
+  grub_uint64_t tp;
+  const char *name;
+  grub_uint64_t value;
+  grub_uint8_t type;
+  grub_uint8_t category;
+};
+
+struct trace_string
+{
+  struct trace_string *next;
+  char name[0];
+};
+
+grub_uint64_t grub_trace_counters[GRUB_TRACE_NCOUNTERS];
+
+static struct trace_event *ring;
+static int ring_failed;
+static grub_size_t ring_next;
+static grub_uint32_t ring_dropped;
+static struct trace_string *strings;
+
+void
+grub_real_trace (enum grub_trace_type type,
+		 enum grub_trace_category category,
+		 const char *name, grub_uint64_t value)
+{
+  struct trace_event *e;
+
+  if (! ring)
+    {
+      /* Failing allocations flush the caches, so don't retry on every
+	 disk read.  */
+      if (ring_failed)
+	return;
+      grub_error_push ();
+      ring = grub_calloc (TRACE_RING_SIZE, sizeof (ring[0]));
+      grub_errno = GRUB_ERR_NONE;
+      grub_error_pop ();
+      if (! ring)
+	{
+	  ring_failed = 1;
+	  return;
+	}
+    }
+
+  if (ring_next >= TRACE_RING_SIZE)
+    ring_dropped++;
+  e = &ring[ring_next++ % TRACE_RING_SIZE];
+  e->tp = grub_get_time_ms ();
+  e->name = name;
+  e->value = value;
+  e->type = type;
+  e->category = category;
+}
+
+/* Return a copy of NAME which is never freed, for spans named after
+   things that may go away, like modules.  */
+const char *
+grub_trace_intern (const char *name)
+{
+  struct trace_string *s;
+  grub_size_t len;
+
+  for (s = strings; s; s = s->next)
+    if (grub_strcmp (s->name, name) == 0)
+      return s->name;
+
+  len = grub_strlen (name) + 1;
+  s = grub_malloc (sizeof (*s) + len);
+  if (! s)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return "?";
+    }
+  grub_memcpy (s->name, name, len);
+  s->next = strings;
+  strings = s;
+  return s->name;
+}
+
+/* Find NAME in the NSTRINGS names of TABLE, adding it if needed.  Return
+   its offset in the string table.  */
+static grub_uint32_t
+export_string (const char **table, grub_uint32_t *offsets,
+	       grub_size_t *nstrings, grub_uint32_t *size, const char *name)
+{
+  grub_size_t i;
+
+  for (i = 0; i < *nstrings; i++)
+    if (table[i] == name)
+      return offsets[i];
+
+  table[i] = name;
+  offsets[i] = *size;
+  *size += grub_strlen (name) + 1;
+  (*nstrings)++;
+  return offsets[i];
+}
+
+/* Return the trace and the counters as a struct grub_trace_header and
+   what follows it, in SIZE bytes allocated with grub_malloc.  */
+void *
+grub_trace_export (grub_size_t *size)
+{
+  static const char *counter_names[] = GRUB_TRACE_COUNTER_NAMES;
+  struct grub_trace_header *header;
+  struct grub_trace_counter_record *counters;
+  struct grub_trace_record *records;
+  const char **table;
+  grub_uint32_t *offsets;
+  grub_size_t nevents, first, nstrings = 0, i;
+  grub_uint32_t strings_size = 0;
+  char *out = NULL, *p;
+
+  nevents = ring_next < TRACE_RING_SIZE ? ring_next : TRACE_RING_SIZE;
+  first = ring_next - nevents;
+
+  /* At most one string per counter and per event.  */
+  table = grub_calloc (GRUB_TRACE_NCOUNTERS + nevents, sizeof (table[0]));
+  offsets = grub_calloc (GRUB_TRACE_NCOUNTERS + nevents, sizeof (offsets[0]));
+  if (! table || ! offsets)
+    goto fail;
+
+  for (i = 0; i < GRUB_TRACE_NCOUNTERS; i++)
+    export_string (table, offsets, &nstrings, &strings_size,
+		   counter_names[i]);
+  for (i = 0; i < nevents; i++)
+    export_string (table, offsets, &nstrings, &strings_size,
+		   ring[(first + i) % TRACE_RING_SIZE].name);
+
+  *size = sizeof (*header) + GRUB_TRACE_NCOUNTERS * sizeof (*counters)
+    + nevents * sizeof (*records) + strings_size;
+  out = grub_malloc (*size);
+  if (! out)
+    goto fail;
+
+  header = (struct grub_trace_header *) out;
+  grub_memcpy (header->magic, GRUB_TRACE_MAGIC, sizeof (header->magic));
+  header->version = grub_cpu_to_le32_compile_time (GRUB_TRACE_VERSION);
+  header->size = grub_cpu_to_le32 (*size);
+  header->ncounters = grub_cpu_to_le32_compile_time (GRUB_TRACE_NCOUNTERS);
+  header->nevents = grub_cpu_to_le32 (nevents);
+  header->dropped = grub_cpu_to_le32 (ring_dropped);
+  header->strings = grub_cpu_to_le32 (*size - strings_size);
+
+  counters = (struct grub_trace_counter_record *) (header + 1);
+  for (i = 0; i < GRUB_TRACE_NCOUNTERS; i++)
+    {
+      counters[i].name = grub_cpu_to_le32 (offsets[i]);
+      counters[i].reserved = 0;
+      counters[i].value = grub_cpu_to_le64 (grub_trace_counters[i]);
+    }
+
+  records = (struct grub_trace_record *) (counters + GRUB_TRACE_NCOUNTERS);
+  for (i = 0; i < nevents; i++)
+    {
+      struct trace_event *e = &ring[(first + i) % TRACE_RING_SIZE];
+
+      records[i].time = grub_cpu_to_le64 (e->tp * 1000);
+      records[i].value = grub_cpu_to_le64 (e->value);
+      records[i].name = grub_cpu_to_le32 (export_string (table, offsets,
+							  &nstrings,
+							  &strings_size,
+							  e->name));
+      records[i].type = e->type;
+      records[i].category = e->category;
+      records[i].reserved = 0;
+    }
+
+  for (i = 0, p = (char *) (records + nevents); i < nstrings; i++)
+    p = grub_stpcpy (p, table[i]) + 1;
+
+ fail:
+  grub_free (table);
+  grub_free (offsets);
+  return out;
+}
+
+#endif
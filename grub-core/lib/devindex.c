@@ -0,0 +1,278 @@
+/* devindex.c - What is on each disk and partition.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/device.h>
+#include <grub/disk.h>
+#include <grub/partition.h>
+#include <grub/fs.h>
+#include <grub/time.h>
+#include <grub/devindex.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+/* search, probe and ls all want the filesystem, UUID and label of every
+   partition, which takes probing and mounting each of them.  The answers
+   are kept here for the rest of the session, so the devices are only
+   looked at once however many times the config asks.  Whatever may change
+   what is on the disks, like writing to them or adding disk drivers,
+   bumps grub_fs_cache_generation and the index is read again.  Like the
+   disk and filesystem caches, entries not asked for in
+   GRUB_DEVINDEX_TIMEOUT seconds are read again too, in case the medium
+   was changed.  */
+#define GRUB_DEVINDEX_TIMEOUT	2
+
+static struct grub_devindex_entry *devindex;
+
+static void
+free_entry (struct grub_devindex_entry *e)
+{
+  grub_free (e->name);
+  grub_free (e->fs);
+  grub_free (e->uuid);
+  grub_free (e->label);
+  grub_free (e->partmap);
+  grub_free (e);
+}
+
+static int
+entry_expired (const struct grub_devindex_entry *e, grub_uint64_t now)
+{
+  return (e->generation != grub_fs_cache_generation
+	  || now > e->last_use + GRUB_DEVINDEX_TIMEOUT * 1000);
+}
+
+static void
+drop_stale (void)
+{
+  struct grub_devindex_entry **p, *e;
+  grub_uint64_t now = grub_get_time_ms ();
+
+  for (p = &devindex; *p; )
+    {
+      e = *p;
+      if (entry_expired (e, now))
+	{
+	  *p = e->next;
+	  free_entry (e);
+	}
+      else
+	p = &e->next;
+    }
+}
+
+static int
+entry_valid (const struct grub_devindex_entry *e)
+{
+#ifdef GRUB_UTIL
+  /* The tools may run while the filesystems are being modified.  */
+  (void) e;
+  return 0;
+#else
+  if (entry_expired (e, grub_get_time_ms ()))
+    return 0;
+  /* Look again if filesystem modules were loaded since or can be now.  */
+  if (! e->fs && (e->fs_list != grub_fs_list
+		  || (! e->autoload && grub_fs_autoload_hook)))
+    return 0;
+  return 1;
+#endif
+}
+
+static struct grub_devindex_entry *
+find_entry (const char *name)
+{
+  struct grub_devindex_entry *e;
+
+  for (e = devindex; e; e = e->next)
+    if (grub_strcmp (e->name, name) == 0)
+      return e;
+  return 0;
+}
+
+/* Fill in E from DEV.  Errors reading the values just leave them
+   NULL.  */
+static void
+read_entry (struct grub_devindex_entry *e, grub_device_t dev)
+{
+  grub_disk_t disk = dev->disk;
+  grub_fs_t fs;
+
+  e->fs_list = grub_fs_list;
+  e->autoload = !! grub_fs_autoload_hook;
+  e->generation = grub_fs_cache_generation;
+  e->last_use = grub_get_time_ms ();
+
+  e->sectors = grub_disk_native_sectors (disk);
+  e->log_sector_size = disk->log_sector_size;
+  if (disk->partition)
+    {
+      e->partmap = grub_strdup (disk->partition->partmap->name);
+      e->start = grub_partition_get_start (disk->partition);
+    }
+
+  fs = grub_fs_probe (dev);
+  grub_errno = GRUB_ERR_NONE;
+  if (! fs)
+    return;
+
+  e->fs = grub_strdup (fs->name);
+  if (fs->fs_uuid && fs->fs_uuid (dev, &e->uuid) != GRUB_ERR_NONE)
+    e->uuid = 0;
+  grub_errno = GRUB_ERR_NONE;
+  if (fs->fs_label && fs->fs_label (dev, &e->label) != GRUB_ERR_NONE)
+    e->label = 0;
+  grub_errno = GRUB_ERR_NONE;
+  if (fs->fs_mtime && fs->fs_mtime (dev, &e->mtime) == GRUB_ERR_NONE)
+    e->have_mtime = 1;
+  grub_errno = GRUB_ERR_NONE;
+}
+
+/* Return what is on the device NAME, reading it from DEV if it isn't
+   known yet.  If DEV is NULL, the device is opened only if needed.  Return
+   NULL with grub_errno set on errors, and with GRUB_ERR_NONE for devices
+   other than disks.  The entry stays valid until the next call.  */
+const struct grub_devindex_entry *
+grub_devindex_get (const char *name, grub_device_t dev)
+{
+  struct grub_devindex_entry *e;
+  grub_device_t opened = 0;
+
+  e = find_entry (name);
+  if (e && entry_valid (e))
+    {
+      e->last_use = grub_get_time_ms ();
+      return e;
+    }
+
+  if (! dev)
+    {
+      dev = opened = grub_device_open (name);
+      if (! dev)
+	return 0;
+    }
+  if (! dev->disk)
+    {
+      if (opened)
+	grub_device_close (opened);
+      return 0;
+    }
+
+  drop_stale ();
+  /* The entry may just have been freed.  */
+  e = find_entry (name);
+  if (e)
+    {
+      struct grub_devindex_entry *next = e->next;
+      char *ename = e->name;
+
+      grub_free (e->fs);
+      grub_free (e->uuid);
+      grub_free (e->label);
+      grub_free (e->partmap);
+      grub_memset (e, 0, sizeof (*e));
+      e->next = next;
+      e->name = ename;
+    }
+  else
+    {
+      e = grub_zalloc (sizeof (*e));
+      if (! e)
+	goto fail;
+      e->name = grub_strdup (name);
+      if (! e->name)
+	{
+	  grub_free (e);
+	  goto fail;
+	}
+      e->next = devindex;
+      devindex = e;
+    }
+
+  read_entry (e, dev);
+  if (opened)
+    grub_device_close (opened);
+  return e;
+
+ fail:
+  if (opened)
+    grub_device_close (opened);
+  return 0;
+}
+
+/* Same for the open device DEV, under the name grub_device_iterate
+   gives it.  */
+const struct grub_devindex_entry *
+grub_devindex_get_device (grub_device_t dev)
+{
+  const struct grub_devindex_entry *e;
+  char *partname, *name;
+
+  if (! dev->disk)
+    return 0;
+  if (! dev->disk->partition)
+    return grub_devindex_get (dev->disk->name, dev);
+
+  partname = grub_partition_get_name (dev->disk->partition);
+  if (! partname)
+    return 0;
+  name = grub_xasprintf ("%s,%s", dev->disk->name, partname);
+  grub_free (partname);
+  if (! name)
+    return 0;
+  e = grub_devindex_get (name, dev);
+  grub_free (name);
+  return e;
+}
+
+/* Have the device NAME looked at again next time.  */
+void
+grub_devindex_forget (const char *name)
+{
+  struct grub_devindex_entry **p, *e;
+
+  for (p = &devindex; *p; p = &(*p)->next)
+    if (grub_strcmp ((*p)->name, name) == 0)
+      {
+	e = *p;
+	*p = e->next;
+	free_entry (e);
+	return;
+      }
+}
+
+GRUB_MOD_INIT (devindex)
+{
+}
+
+GRUB_MOD_FINI (devindex)
+{
+  struct grub_devindex_entry *e, *next;
+
+  for (e = devindex; e; e = next)
+    {
+      next = e->next;
+      free_entry (e);
+    }
+  devindex = 0;
+}
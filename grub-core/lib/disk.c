@@ -63,6 +63,9 @@ grub_disk_write (grub_disk_t disk, grub_disk_addr_t sector,
   if (grub_disk_adjust_range (disk, &sector, &offset, size) != GRUB_ERR_NONE)
     return -1;
 
+  /* Filesystems mounted from this disk may have changed.  */
+  grub_fs_cache_invalidate (disk);
+
   aligned_sector = (sector & ~((1ULL << (disk->log_sector_size
 					 - GRUB_DISK_SECTOR_BITS)) - 1));
   real_offset = offset + ((sector - aligned_sector) << GRUB_DISK_SECTOR_BITS);
@@ -90,3 +90,140 @@ grub_file_getline (grub_file_t file)
 
   return cmdline;
 }
+
+/* Read this much of the file at a time.  */
+#define LINEREADER_BUFSIZE	8192
+
+struct grub_linereader
+{
+  grub_file_t file;
+  char *buf;
+  /* Where the next line starts in BUF, and where what was read ends.  */
+  grub_size_t start;
+  grub_size_t end;
+  int eof;
+};
+
+/* Return a reader of the lines of FILE, which closes it when it is closed
+   itself.  */
+grub_linereader_t
+grub_linereader_open (grub_file_t file)
+{
+  grub_linereader_t reader;
+
+  reader = grub_zalloc (sizeof (*reader));
+  if (! reader)
+    return 0;
+
+  reader->buf = grub_malloc (LINEREADER_BUFSIZE);
+  if (! reader->buf)
+    {
+      grub_free (reader);
+      return 0;
+    }
+
+  reader->file = file;
+  return reader;
+}
+
+void
+grub_linereader_close (grub_linereader_t reader)
+{
+  grub_file_close (reader->file);
+  grub_free (reader->buf);
+  grub_free (reader);
+}
+
+typedef grub_addr_t __attribute__ ((may_alias)) linereader_word_t;
+
+/* Return the first newline in the LEN bytes at S, NULL if there is none.
+   Whole words are looked at while they have no newline: a word which has
+   none has no zero byte once XORed with newlines.  */
+static char *
+find_newline (char *s, grub_size_t len)
+{
+  const grub_addr_t ones = ~(grub_addr_t) 0 / 0xff;
+  const grub_addr_t newlines = ones * '\n';
+  char *e = s + len;
+  grub_addr_t x;
+
+  for (; s < e && ((grub_addr_t) s & (sizeof (x) - 1)); s++)
+    if (*s == '\n')
+      return s;
+
+  for (; e - s >= (grub_ssize_t) sizeof (x); s += sizeof (x))
+    {
+      x = *(linereader_word_t *) s ^ newlines;
+      if ((x - ones) & ~x & (ones << 7))
+	break;
+    }
+
+  return grub_memchr (s, '\n', e - s);
+}
+
+/* Read a line from READER, like grub_file_getline.  */
+char *
+grub_linereader_getline (grub_linereader_t reader)
+{
+  char *line = 0, *nl = 0, *p, *q;
+  grub_size_t len = 0, n;
+  grub_ssize_t got;
+
+  while (! nl)
+    {
+      if (reader->start == reader->end)
+	{
+	  if (reader->eof)
+	    break;
+
+	  got = grub_file_read (reader->file, reader->buf, LINEREADER_BUFSIZE);
+	  if (got <= 0)
+	    {
+	      reader->eof = 1;
+	      break;
+	    }
+	  reader->start = 0;
+	  reader->end = got;
+	}
+
+      p = reader->buf + reader->start;
+      n = reader->end - reader->start;
+      nl = find_newline (p, n);
+      if (nl)
+	n = nl - p;
+
+      q = grub_realloc (line, len + n + 1);
+      if (! q)
+	{
+	  grub_free (line);
+	  return 0;
+	}
+      line = q;
+      grub_memcpy (line + len, p, n);
+      len += n;
+      reader->start += n + (nl ? 1 : 0);
+    }
+
+  if (! line)
+    return 0;
+
+  /* Skip all carriage returns.  */
+  if (grub_memchr (line, '\r', len))
+    {
+      for (p = q = line; p < line + len; p++)
+	if (*p != '\r')
+	  *q++ = *p;
+      len = q - line;
+    }
+
+  /* If the buffer is empty, don't return anything at all.  */
+  if (len == 0 && ! nl)
+    {
+      grub_free (line);
+      return 0;
+    }
+
+  line[len] = '\0';
+
+  return line;
+}
@@ -142,6 +142,8 @@ allocate_regstart (grub_phys_addr_t addr, grub_size_t size, grub_mm_region_t rb,
 #ifdef DEBUG_RELOCATOR_NOMEM_DPRINTF  
   grub_dprintf ("relocator", "ra = %p, rb = %p\n", regancestor, rb);
 #endif
+  grub_mm_invalidate_index ();
+
   newreg_start = ALIGN_UP (newreg_raw_start, GRUB_MM_ALIGN);
   newreg_presize = newreg_start - newreg_raw_start;
   newreg_size = rb->size - (newreg_start - (grub_addr_t) rb);
@@ -212,6 +214,7 @@ allocate_inreg (grub_phys_addr_t paddr, grub_size_t size,
 		(unsigned long) paddr, (unsigned long) size, hb, hbp,
 		rb, (unsigned long) vaddr);
 #endif
+  grub_mm_invalidate_index ();
     
   if (ALIGN_UP (vaddr + size, GRUB_MM_ALIGN) + GRUB_MM_ALIGN
       <= (grub_addr_t) (hb + hb->size))
@@ -278,6 +281,8 @@ check_leftover (struct grub_relocator_fw_leftover *lo)
 static void
 free_subchunk (const struct grub_relocator_subchunk *subchu)
 {
+  grub_mm_invalidate_index ();
+
   switch (subchu->type)
     {
     case CHUNK_TYPE_REGION_START:
@@ -351,6 +356,7 @@ free_subchunk (const struct grub_relocator_subchunk *subchu)
 	    grub_mm_header_t hl2, hl, g;
 	    g = (grub_mm_header_t) ((grub_addr_t) r2 + r2->size);
 	    g->size = (grub_mm_header_t) r1 - g;
+	    g->tag = 0;
 	    r2->size += r1->size;
 	    for (hl = r2->first; hl->next != r2->first; hl = hl->next);
 	    for (hl2 = r1->first; hl2->next != r1->first; hl2 = hl2->next);
@@ -371,6 +377,7 @@ free_subchunk (const struct grub_relocator_subchunk *subchu)
 	  - (subchu->start / GRUB_MM_ALIGN) - 1;
 	h->next = h;
 	h->magic = GRUB_MM_ALLOC_MAGIC;
+	h->tag = 0;
 	grub_free (h + 1);
 	break;
       }
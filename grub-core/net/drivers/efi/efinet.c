@@ -121,7 +121,7 @@ get_card_packet (struct grub_net_card *dev)
   if (st != GRUB_EFI_SUCCESS)
     return NULL;
 
-  nb = grub_netbuff_alloc (bufsize + 2);
+  nb = grub_net_card_rx_alloc (dev, bufsize + 2);
   if (!nb)
     return NULL;
 
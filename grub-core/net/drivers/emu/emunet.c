@@ -70,7 +70,7 @@ get_card_packet (struct grub_net_card *dev __attribute__ ((unused)))
   grub_ssize_t actual;
   struct grub_net_buff *nb;
 
-  nb = grub_netbuff_alloc (emucard.mtu + 36 + 2);
+  nb = grub_net_card_rx_alloc (&emucard, emucard.mtu + 36 + 2);
   if (!nb)
     return NULL;
 
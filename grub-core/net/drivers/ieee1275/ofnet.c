@@ -93,7 +93,7 @@ get_card_packet (struct grub_net_card *dev)
   if (actual <= 0)
     return NULL;
 
-  nb = grub_netbuff_alloc (actual + 2);
+  nb = grub_net_card_rx_alloc (dev, actual + 2);
   if (!nb)
     return NULL;
   /* Reserve 2 bytes so that 2 + 14/18 bytes of ethernet header is divisible
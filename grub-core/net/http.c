@@ -26,12 +26,17 @@
 #include <grub/dl.h>
 #include <grub/file.h>
 #include <grub/i18n.h>
+#include <grub/env.h>
+#include <grub/time.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
 enum
   {
-    HTTP_PORT = 80
+    HTTP_PORT = 80,
+    HTTP_PARALLEL_MAX = 16,
+    /* Smaller reads aren't worth the extra connection setups.  */
+    HTTP_PARALLEL_MIN_READ = 1024 * 1024
   };
 
 
@@ -49,8 +54,26 @@ typedef struct http_data
   int chunked;
   grub_size_t chunk_rem;
   int in_chunk_len;
+  /* Server answered with 206 Partial Content.  */
+  int partial;
+  /* A parallel read failed or fell back, don't try again for this file.  */
+  int no_parallel;
+  /* The stream was stopped for a parallel read and must be reopened at
+     the current offset before it is read from.  */
+  int resume;
+  /* For range segments of a parallel read: where the body goes, how much
+     of it is still expected and the flag to raise on progress.  */
+  char *seg_buf;
+  grub_size_t seg_rem;
+  int *seg_event;
 } *http_data_t;
 
+struct http_segment
+{
+  grub_file_t file;
+  struct http_data data;
+};
+
 static grub_off_t
 have_ahead (struct grub_file *file)
 {
@@ -92,7 +115,7 @@ parse_line (grub_file_t file, http_data_t data, char *ptr, grub_size_t len)
   if (ptr == end)
     {
       data->headers_recv = 1;
-      if (data->chunked)
+      if (data->chunked && !data->seg_buf)
 	data->in_chunk_len = 2;
       return GRUB_ERR_NONE;
     }
@@ -112,8 +135,10 @@ parse_line (grub_file_t file, http_data_t data, char *ptr, grub_size_t len)
 	return grub_errno;
       switch (code)
 	{
-	case 200:
 	case 206:
+	  data->partial = 1;
+	  break;
+	case 200:
 	  break;
 	case 404:
 	  data->err = GRUB_ERR_FILE_NOT_FOUND;
@@ -168,12 +193,35 @@ http_err (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 }
 
 static grub_err_t
-http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
-	      struct grub_net_buff *nb,
-	      void *f)
+http_segment_body (http_data_t data, struct grub_net_buff *nb)
+{
+  grub_size_t amount = nb->tail - nb->data;
+
+  /* A range request must be answered with exactly the requested range.  */
+  if (!data->partial || data->chunked)
+    {
+      grub_netbuff_free (nb);
+      grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+      data->sock = 0;
+      data->err = GRUB_ERR_NET_UNKNOWN_ERROR;
+      *data->seg_event = 1;
+      return GRUB_ERR_NONE;
+    }
+
+  if (amount > data->seg_rem)
+    amount = data->seg_rem;
+  grub_memcpy (data->seg_buf, nb->data, amount);
+  data->seg_buf += amount;
+  data->seg_rem -= amount;
+  grub_netbuff_free (nb);
+  if (amount)
+    *data->seg_event = 1;
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+http_process (grub_file_t file, http_data_t data, struct grub_net_buff *nb)
 {
-  grub_file_t file = f;
-  http_data_t data = file->data;
   grub_err_t err;
 
   if (!data->sock)
@@ -269,18 +317,21 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 	  grub_netbuff_free (nb);
 	  return err;
 	}
+      if (data->seg_buf)
+	return http_segment_body (data, nb);
       if (!(data->chunked && (grub_ssize_t) data->chunk_rem
 	    < nb->tail - nb->data))
 	{
-	  grub_net_put_packet (&file->device->net->packs, nb);
+	  if (data->chunked)
+	    data->chunk_rem -= nb->tail - nb->data;
+
+	  grub_net_deliver_packet (file, nb);
 	  if (file->device->net->packs.count >= 20)
 	    file->device->net->stall = 1;
 
 	  if (file->device->net->packs.count >= 100)
 	    grub_net_tcp_stall (data->sock);
 
-	  if (data->chunked)
-	    data->chunk_rem -= nb->tail - nb->data;
 	  return GRUB_ERR_NONE;
 	}
       if (data->chunk_rem)
@@ -297,7 +348,7 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 	      grub_net_tcp_stall (data->sock);
 	    }
 
-	  grub_net_put_packet (&file->device->net->packs, nb2);
+	  grub_net_deliver_packet (file, nb2);
 	  grub_netbuff_pull (nb, data->chunk_rem);
 	}
       data->in_chunk_len = 1;
@@ -305,11 +356,45 @@ http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
 }
 
 static grub_err_t
-http_establish (struct grub_file *file, grub_off_t offset, int initial)
+http_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
+	      struct grub_net_buff *nb,
+	      void *f)
+{
+  grub_file_t file = f;
+
+  return http_process (file, file->data, nb);
+}
+
+static grub_err_t
+http_segment_receive (grub_net_tcp_socket_t sock __attribute__ ((unused)),
+		      struct grub_net_buff *nb,
+		      void *s)
+{
+  struct http_segment *seg = s;
+
+  return http_process (seg->file, &seg->data, nb);
+}
+
+static void
+http_segment_err (grub_net_tcp_socket_t sock __attribute__ ((unused)),
+		  void *s)
+{
+  struct http_segment *seg = s;
+
+  if (seg->data.sock)
+    grub_net_tcp_close (seg->data.sock, GRUB_NET_TCP_ABORT);
+  seg->data.sock = 0;
+  *seg->data.seg_event = 1;
+}
+
+/* Build a GET request for DATA->filename.  Unless INITIAL, ask for the
+   range starting at OFFSET, LENGTH bytes long or up to the end if LENGTH
+   is 0.  */
+static struct grub_net_buff *
+http_make_request (struct grub_file *file, http_data_t data,
+		   grub_off_t offset, grub_off_t length, int initial)
 {
-  http_data_t data = file->data;
   grub_uint8_t *ptr;
-  int i;
   struct grub_net_buff *nb;
   grub_err_t err;
 
@@ -321,9 +406,9 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
 			   + sizeof ("\r\nUser-Agent: " PACKAGE_STRING
 				     "\r\n") - 1
 			   + sizeof ("Range: bytes=XXXXXXXXXXXXXXXXXXXX"
-				     "-\r\n\r\n"));
+				     "-XXXXXXXXXXXXXXXXXXXX\r\n\r\n"));
   if (!nb)
-    return grub_errno;
+    return NULL;
 
   grub_netbuff_reserve (nb, GRUB_NET_TCP_RESERVE_SIZE);
   ptr = nb->tail;
@@ -331,7 +416,7 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, "GET ", sizeof ("GET ") - 1);
 
@@ -341,7 +426,7 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, data->filename, grub_strlen (data->filename));
 
@@ -350,7 +435,7 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, " HTTP/1.1\r\nHost: ",
 	       sizeof (" HTTP/1.1\r\nHost: ") - 1);
@@ -360,7 +445,7 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, file->device->net->server,
 	       grub_strlen (file->device->net->server));
@@ -372,11 +457,21 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   if (err)
     {
       grub_netbuff_free (nb);
-      return err;
+      return NULL;
     }
   grub_memcpy (ptr, "\r\nUser-Agent: " PACKAGE_STRING "\r\n",
 	       sizeof ("\r\nUser-Agent: " PACKAGE_STRING "\r\n") - 1);
-  if (!initial)
+  if (!initial && length)
+    {
+      ptr = nb->tail;
+      grub_snprintf ((char *) ptr,
+		     sizeof ("Range: bytes=XXXXXXXXXXXXXXXXXXXX-"
+			     "XXXXXXXXXXXXXXXXXXXX\r\n"),
+		     "Range: bytes=%" PRIuGRUB_UINT64_T "-%" PRIuGRUB_UINT64_T
+		     "\r\n", offset, offset + length - 1);
+      grub_netbuff_put (nb, grub_strlen ((char *) ptr));
+    }
+  else if (!initial)
     {
       ptr = nb->tail;
       grub_snprintf ((char *) ptr,
@@ -390,6 +485,22 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   grub_netbuff_put (nb, 2);
   grub_memcpy (ptr, "\r\n", 2);
 
+  return nb;
+}
+
+static grub_err_t
+http_establish (struct grub_file *file, grub_off_t offset, int initial)
+{
+  http_data_t data = file->data;
+  int i;
+  struct grub_net_buff *nb;
+  grub_err_t err;
+
+  nb = http_make_request (file, data, offset, 0, initial);
+  if (!nb)
+    return grub_errno;
+
+
   data->sock = grub_net_tcp_open (file->device->net->server,
 				  HTTP_PORT, http_receive,
 				  http_err, NULL,
@@ -431,8 +542,10 @@ http_establish (struct grub_file *file, grub_off_t offset, int initial)
   return GRUB_ERR_NONE;
 }
 
+/* Drop the current connection and queued data and restart the transfer at
+   OFF.  Doesn't touch the file position.  */
 static grub_err_t
-http_seek (struct grub_file *file, grub_off_t off)
+http_reestablish (struct grub_file *file, grub_off_t off)
 {
   struct http_data *old_data, *data;
   grub_err_t err;
@@ -450,7 +563,6 @@ http_seek (struct grub_file *file, grub_off_t off)
 
   file->device->net->stall = 0;
   file->device->net->eof = 0;
-  file->device->net->offset = off;
 
   data = grub_zalloc (sizeof (*data));
   if (!data)
@@ -464,6 +576,7 @@ http_seek (struct grub_file *file, grub_off_t off)
       file->data = 0;
       return grub_errno;
     }
+  data->no_parallel = old_data->no_parallel;
   grub_free (old_data);
 
   file->data = data;
@@ -478,6 +591,228 @@ http_seek (struct grub_file *file, grub_off_t off)
   return GRUB_ERR_NONE;
 }
 
+static grub_err_t
+http_seek (struct grub_file *file, grub_off_t off)
+{
+  file->device->net->offset = off;
+  return http_reestablish (file, off);
+}
+
+static grub_err_t
+http_segment_open (struct http_segment *seg, grub_off_t offset,
+		   grub_off_t length)
+{
+  struct grub_net_buff *nb;
+  grub_err_t err;
+
+  nb = http_make_request (seg->file, &seg->data, offset, length, 0);
+  if (!nb)
+    return grub_errno;
+
+  seg->data.sock = grub_net_tcp_open (seg->file->device->net->server,
+				      HTTP_PORT, http_segment_receive,
+				      http_segment_err, NULL, seg);
+  if (!seg->data.sock)
+    {
+      grub_netbuff_free (nb);
+      return grub_errno;
+    }
+
+  err = grub_net_send_tcp_packet (seg->data.sock, nb, 1);
+  if (err)
+    {
+      grub_net_tcp_close (seg->data.sock, GRUB_NET_TCP_ABORT);
+      seg->data.sock = 0;
+    }
+  return err;
+}
+
+static void
+http_segments_free (struct http_segment *segs, unsigned n)
+{
+  unsigned i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (segs[i].data.sock)
+	grub_net_tcp_close (segs[i].data.sock, GRUB_NET_TCP_ABORT);
+      grub_free (segs[i].data.current_line);
+      grub_free (segs[i].data.errmsg);
+    }
+  grub_free (segs);
+}
+
+/* Reopen the stream if a parallel read left it stopped.  */
+static grub_err_t
+http_resume (struct grub_file *file)
+{
+  http_data_t data = file->data;
+
+  if (!data->resume)
+    return GRUB_ERR_NONE;
+  return http_reestablish (file, file->device->net->offset);
+}
+
+/* Return how many range requests a read of LEN bytes of FILE should be
+   split into, or 0 to read it from the stream.  */
+static unsigned long
+http_parallel_count (struct grub_file *file, grub_size_t len)
+{
+  http_data_t data = file->data;
+  grub_net_t net = file->device->net;
+  const char *val;
+  unsigned long n;
+
+  if (data->no_parallel || data->chunked || net->packs.first
+      || file->size == GRUB_FILE_SIZE_UNKNOWN || net->offset >= file->size)
+    return 0;
+
+  val = grub_env_get ("http_parallel");
+  if (!val)
+    return 0;
+  n = grub_strtoul (val, 0, 0);
+  if (grub_errno)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return 0;
+    }
+  if (n < 2)
+    return 0;
+  if (n > HTTP_PARALLEL_MAX)
+    n = HTTP_PARALLEL_MAX;
+
+  if (len > file->size - net->offset)
+    len = file->size - net->offset;
+  if (len < HTTP_PARALLEL_MIN_READ)
+    return 0;
+  return n;
+}
+
+/* Fetch a large read as $http_parallel concurrent range requests, each
+   written straight to its part of BUF.  Returns 0 when the read isn't
+   eligible so that the caller falls back to the single stream.  The
+   stream is left stopped after a parallel read and only reopened once
+   something has to be read from it, so that consecutive large reads
+   don't open it just to abort it again.  After the first failure, which
+   includes servers ignoring the range, the file sticks to the stream.  */
+static grub_ssize_t
+http_read (struct grub_file *file, char *buf, grub_size_t len)
+{
+  http_data_t data = file->data;
+  grub_net_t net = file->device->net;
+  struct http_segment *segs;
+  grub_off_t start = net->offset;
+  grub_size_t seg_len, done, rem, last_rem = 0;
+  unsigned long n;
+  unsigned i;
+  int event = 0, failed = 0, try = 0;
+  grub_err_t err;
+
+  if (!data)
+    return 0;
+
+  n = buf ? http_parallel_count (file, len) : 0;
+  if (!n)
+    return http_resume (file) ? -1 : 0;
+
+  if (len > file->size - start)
+    len = file->size - start;
+
+  segs = grub_calloc (n, sizeof (*segs));
+  if (!segs)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return http_resume (file) ? -1 : 0;
+    }
+
+  /* The single stream would run past the window, so stop it and pick it
+     up again when it is needed.  */
+  if (data->sock)
+    grub_net_tcp_close (data->sock, GRUB_NET_TCP_ABORT);
+  data->sock = 0;
+  data->resume = 1;
+
+  seg_len = len / n;
+  for (i = 0; i < n; i++)
+    {
+      segs[i].file = file;
+      segs[i].data.filename = data->filename;
+      segs[i].data.size_recv = 1;
+      segs[i].data.seg_buf = buf + i * seg_len;
+      segs[i].data.seg_rem = (i == n - 1) ? len - i * seg_len : seg_len;
+      segs[i].data.seg_event = &event;
+      err = http_segment_open (&segs[i], start + i * seg_len,
+			       segs[i].data.seg_rem);
+      if (err)
+	{
+	  grub_dprintf ("http", "opening segment %u failed: %s\n", i,
+			grub_errmsg);
+	  grub_errno = GRUB_ERR_NONE;
+	  http_segments_free (segs, n);
+	  data->no_parallel = 1;
+	  return http_resume (file) ? -1 : 0;
+	}
+    }
+
+  while (1)
+    {
+      rem = 0;
+      for (i = 0; i < n; i++)
+	{
+	  rem += segs[i].data.seg_rem;
+	  if (segs[i].data.err
+	      || (!segs[i].data.sock && segs[i].data.seg_rem))
+	    failed = 1;
+	}
+      if (!rem || failed)
+	break;
+      if (rem != last_rem)
+	{
+	  last_rem = rem;
+	  try = 0;
+	}
+      else if (++try > GRUB_NET_TRIES)
+	{
+	  failed = 1;
+	  break;
+	}
+      event = 0;
+      grub_net_poll_cards (GRUB_NET_INTERVAL
+			   + (try * GRUB_NET_INTERVAL_ADDITION), &event);
+    }
+
+  /* Only the contiguous prefix counts.  */
+  done = 0;
+  for (i = 0; i < n; i++)
+    {
+      grub_size_t want = (i == n - 1) ? len - i * seg_len : seg_len;
+
+      done += want - segs[i].data.seg_rem;
+      if (segs[i].data.seg_rem)
+	break;
+    }
+  http_segments_free (segs, n);
+
+  grub_dprintf ("http", "parallel read of %" PRIuGRUB_SIZE " bytes at %"
+		PRIuGRUB_UINT64_T ": got %" PRIuGRUB_SIZE "%s\n", len, start,
+		done, failed ? ", falling back" : "");
+
+  if (failed)
+    data->no_parallel = 1;
+
+  if (start + done >= file->size)
+    {
+      data->resume = 0;
+      net->eof = 1;
+      net->stall = 1;
+    }
+  /* The caller goes to the stream with nothing read.  */
+  else if (!done && http_resume (file))
+    return -1;
+
+  return done;
+}
+
 static grub_err_t
 http_open (struct grub_file *file, const char *filename)
 {
@@ -548,6 +883,7 @@ static struct grub_net_app_protocol grub_http_protocol =
     .open = http_open,
     .close = http_close,
     .seek = http_seek,
+    .read = http_read,
     .packets_pulled = http_packets_pulled
   };
 
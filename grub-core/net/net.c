@@ -197,6 +197,8 @@ grub_net_card_unregister (struct grub_net_card *card)
 	card->driver->close (card);
       card->opened = 0;
     }
+  grub_netbuff_pool_destroy (card->rx_pool);
+  card->rx_pool = NULL;
   grub_list_remove (GRUB_AS_LIST (card));
 }
 
@@ -1421,6 +1423,7 @@ grub_net_fs_open (struct grub_file *file_out, const char *name)
   grub_memcpy (file, file_out, sizeof (struct grub_file));
   file->device->net->packs.first = NULL;
   file->device->net->packs.last = NULL;
+  file->device->net->read_pending = 0;
   file->device->net->name = grub_strdup (name);
   if (!file->device->net->name)
     {
@@ -1490,10 +1493,16 @@ receive_packets (struct grub_net_card *card, int *stop_condition)
 	}
       card->opened = 1;
     }
+  if (!card->rx_pool)
+    {
+      /* Without a pool drivers simply fall back to the heap.  */
+      card->rx_pool = grub_netbuff_pool_create (card->mtu
+						+ GRUB_NET_MAX_LINK_HEADER_SIZE
+						+ 2, GRUB_NET_RX_POOL_SIZE);
+      grub_errno = GRUB_ERR_NONE;
+    }
   while (received < 100)
     {
-      /* Maybe should be better have a fixed number of packets for each card
-	 and just mark them as used and not used.  */ 
       struct grub_net_buff *nb;
 
       if (received > 10 && stop_condition && *stop_condition)
@@ -1583,6 +1592,52 @@ grub_net_poll_cards_idle_real (void)
   grub_net_tcp_retransmit ();
 }
 
+static void
+consume_payload (grub_file_t file, grub_size_t amount)
+{
+  file->device->net->offset += amount;
+  if (grub_file_progress_hook)
+    grub_file_progress_hook (0, 0, amount, file);
+}
+
+/* Hand a payload packet over to the file.  If a read is waiting and no
+   earlier data is queued, the payload is copied straight into the
+   reader's buffer and only the remainder, if any, is queued.  Takes
+   ownership of NB.  */
+grub_err_t
+grub_net_deliver_packet (struct grub_file *file, struct grub_net_buff *nb)
+{
+  grub_net_t net = file->device->net;
+  grub_size_t amount;
+  grub_err_t err;
+
+  if (net->read_pending && net->read_len && !net->packs.first)
+    {
+      amount = nb->tail - nb->data;
+      if (amount > net->read_len)
+	amount = net->read_len;
+      if (net->read_buf)
+	{
+	  grub_memcpy (net->read_buf, nb->data, amount);
+	  net->read_buf += amount;
+	}
+      net->read_len -= amount;
+      consume_payload (file, amount);
+      nb->data += amount;
+    }
+
+  if (nb->tail == nb->data)
+    {
+      grub_netbuff_free (nb);
+      return GRUB_ERR_NONE;
+    }
+
+  err = grub_net_put_packet (&net->packs, nb);
+  if (err)
+    grub_netbuff_free (nb);
+  return err;
+}
+
 /*  Read from the packets list*/
 static grub_ssize_t
 grub_net_fs_read_real (grub_file_t file, char *buf, grub_size_t len)
@@ -1604,9 +1659,7 @@ grub_net_fs_read_real (grub_file_t file, char *buf, grub_size_t len)
 	    amount = len;
 	  len -= amount;
 	  total += amount;
-	  file->device->net->offset += amount;
-	  if (grub_file_progress_hook)
-	    grub_file_progress_hook (0, 0, amount, file);
+	  consume_payload (file, amount);
 	  if (buf)
 	    {
 	      grub_memcpy (ptr, nb->data, amount);
@@ -1630,11 +1683,50 @@ grub_net_fs_read_real (grub_file_t file, char *buf, grub_size_t len)
       if (net->protocol->packets_pulled)
 	net->protocol->packets_pulled (file);
 
+      if (!net->eof && net->protocol->read)
+	{
+	  grub_ssize_t direct;
+
+	  direct = net->protocol->read (file, buf ? ptr : NULL, len);
+	  if (direct < 0)
+	    return -1;
+	  if (direct > 0)
+	    {
+	      try = 0;
+	      consume_payload (file, direct);
+	      len -= direct;
+	      total += direct;
+	      ptr += direct;
+	      if (!len)
+		return total;
+	      continue;
+	    }
+	}
+
       if (!net->eof)
 	{
 	  try++;
+	  net->read_pending = 1;
+	  net->read_buf = buf ? ptr : NULL;
+	  net->read_len = len;
 	  grub_net_poll_cards (GRUB_NET_INTERVAL +
                                (try * GRUB_NET_INTERVAL_ADDITION), &net->stall);
+	  net->read_pending = 0;
+	  amount = len - net->read_len;
+	  if (amount)
+	    {
+	      try = 0;
+	      len -= amount;
+	      total += amount;
+	      if (buf)
+		ptr += amount;
+	      if (!len)
+		{
+		  if (net->protocol->packets_pulled)
+		    net->protocol->packets_pulled (file);
+		  return total;
+		}
+	    }
         }
       else
 	return total;
@@ -19,6 +19,8 @@
 #include <grub/err.h>
 #include <grub/misc.h>
 #include <grub/mm.h>
+#include <grub/safemath.h>
+#include <grub/i18n.h>
 #include <grub/net/netbuff.h>
 
 grub_err_t
@@ -78,6 +80,7 @@ grub_netbuff_alloc (grub_size_t len)
   void *data;
 
   COMPILE_TIME_ASSERT (NETBUFF_ALIGN % sizeof (grub_properly_aligned_t) == 0);
+  COMPILE_TIME_ASSERT (NETBUFF_POOL_ALIGN % sizeof (grub_properly_aligned_t) == 0);
 
   if (len < NETBUFFMINLEN)
     len = NETBUFFMINLEN;
@@ -94,6 +97,98 @@ grub_netbuff_alloc (grub_size_t len)
 				 + len / sizeof (grub_properly_aligned_t));
   nb->head = nb->data = nb->tail = data;
   nb->end = (grub_uint8_t *) nb;
+  nb->pool = NULL;
+  nb->next_free = NULL;
+  return nb;
+}
+
+struct grub_net_buff_pool *
+grub_netbuff_pool_create (grub_size_t bufsize, unsigned count)
+{
+  struct grub_net_buff_pool *pool;
+  grub_size_t stride, total;
+  unsigned i;
+
+  if (bufsize < NETBUFFMINLEN)
+    bufsize = NETBUFFMINLEN;
+  bufsize = ALIGN_UP (bufsize, NETBUFF_POOL_ALIGN);
+  /* Every buffer starts on NETBUFF_ALIGN, like those of grub_netbuff_alloc,
+     which the drivers' DMA may rely on.  */
+  stride = ALIGN_UP (bufsize + sizeof (struct grub_net_buff), NETBUFF_ALIGN);
+
+  if (grub_mul (stride, count, &total))
+    {
+      grub_error (GRUB_ERR_OUT_OF_RANGE, N_("overflow is detected"));
+      return NULL;
+    }
+
+  pool = grub_zalloc (sizeof (*pool));
+  if (!pool)
+    return NULL;
+
+#ifdef GRUB_MACHINE_EMU
+  pool->mem = grub_malloc (total);
+#else
+  pool->mem = grub_memalign (NETBUFF_ALIGN, total);
+#endif
+  if (!pool->mem)
+    {
+      grub_free (pool);
+      return NULL;
+    }
+
+  pool->bufsize = bufsize;
+  pool->count = count;
+
+  for (i = 0; i < count; i++)
+    {
+      grub_uint8_t *data = (grub_uint8_t *) pool->mem + i * stride;
+      struct grub_net_buff *nb;
+
+      nb = (struct grub_net_buff *) ((grub_properly_aligned_t *) data
+				     + bufsize / sizeof (grub_properly_aligned_t));
+      nb->head = nb->data = nb->tail = data;
+      nb->end = (grub_uint8_t *) nb;
+      nb->pool = pool;
+      nb->next_free = pool->free_list;
+      pool->free_list = nb;
+    }
+
+  return pool;
+}
+
+static void
+pool_release (struct grub_net_buff_pool *pool)
+{
+  grub_free (pool->mem);
+  grub_free (pool);
+}
+
+/* Buffers still owned by the upper layers (e.g. queued on a socket) keep
+   the pool alive until they're freed.  */
+void
+grub_netbuff_pool_destroy (struct grub_net_buff_pool *pool)
+{
+  if (!pool)
+    return;
+  pool->dead = 1;
+  if (!pool->in_use)
+    pool_release (pool);
+}
+
+struct grub_net_buff *
+grub_netbuff_pool_alloc (struct grub_net_buff_pool *pool, grub_size_t len)
+{
+  struct grub_net_buff *nb;
+
+  if (!pool || pool->dead || len > pool->bufsize || !pool->free_list)
+    return grub_netbuff_alloc (len);
+
+  nb = pool->free_list;
+  pool->free_list = nb->next_free;
+  nb->next_free = NULL;
+  pool->in_use++;
+  nb->data = nb->tail = nb->head;
   return nb;
 }
 
@@ -122,6 +217,17 @@ grub_netbuff_free (struct grub_net_buff *nb)
 {
   if (!nb)
     return;
+  if (nb->pool)
+    {
+      struct grub_net_buff_pool *pool = nb->pool;
+
+      nb->next_free = pool->free_list;
+      pool->free_list = nb;
+      pool->in_use--;
+      if (pool->dead && !pool->in_use)
+	pool_release (pool);
+      return;
+    }
   grub_free (nb->head);
 }
 
@@ -239,10 +239,10 @@ tftp_receive (grub_net_udp_socket_t sock __attribute__ ((unused)),
 	      if (err)
 		return err;
 	    }
-	  /* If there is data, puts packet in socket list. */
+	  /* If there is data, hand it to the reader or queue it. */
 	  if ((nb->tail - nb->data) > 0)
 	    {
-	      grub_net_put_packet (&file->device->net->packs, nb);
+	      grub_net_deliver_packet (file, nb);
 	      /* Do not free nb. */
 	      return GRUB_ERR_NONE;
 	    }
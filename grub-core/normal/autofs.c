@@ -27,30 +27,67 @@
 /* This is used to store the names of filesystem modules for auto-loading.  */
 static grub_named_list_t fs_module_list;
 
-/* The auto-loading hook for filesystems.  */
+/* Signatures of the filesystems in modules that aren't loaded yet, taken
+   from their drivers at build time.  Modules not listed may be on any
+   disk.  */
+static const struct
+{
+  const char *name;
+  struct grub_fs_signature sig;
+} fs_module_signatures[] =
+  {
+#ifndef GRUB_LST_GENERATOR
+#include "fs_signatures.h"
+#endif
+    { 0, { 0, 0, 0 } }
+  };
+
+/* Return whether the filesystem of module NAME may be on DISK.  */
+static int
+fs_module_may_match (const char *name, grub_disk_t disk)
+{
+  struct grub_fs_signature sigs[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+  int listed = 0;
+  unsigned i;
+
+  for (i = 0; fs_module_signatures[i].name; i++)
+    if (grub_strcmp (fs_module_signatures[i].name, name) == 0)
+      {
+	sigs[0] = fs_module_signatures[i].sig;
+	if (grub_fs_signatures_match (disk, sigs))
+	  return 1;
+	listed = 1;
+      }
+  return ! listed;
+}
+
+/* The auto-loading hook for filesystems.  Modules whose filesystem can't
+   be on DISK are skipped but kept for other disks.  */
 static int
-autoload_fs_module (void)
+autoload_fs_module (grub_disk_t disk)
 {
-  grub_named_list_t p;
-  int ret = 0;
+  grub_named_list_t p, *prev;
 
-  while ((p = fs_module_list) != NULL)
+  for (prev = &fs_module_list; (p = *prev) != NULL; )
     {
-      if (! grub_dl_get (p->name) && grub_dl_load (p->name))
+      if (grub_dl_get (p->name) || ! fs_module_may_match (p->name, disk))
 	{
-	  ret = 1;
-	  break;
+	  prev = &p->next;
+	  continue;
 	}
 
+      if (grub_dl_load (p->name))
+	return 1;
+
       if (grub_errno)
 	grub_print_error ();
 
-      fs_module_list = p->next;
+      *prev = p->next;
       grub_free (p->name);
       grub_free (p);
     }
 
-  return ret;
+  return 0;
 }
 
 /* Read the file fs.lst for auto-loading.  */
@@ -66,6 +103,7 @@ read_fs_list (const char *prefix)
       if (filename)
 	{
 	  grub_file_t file;
+	  grub_linereader_t reader = NULL;
 	  grub_fs_autoload_hook_t tmp_autoload_hook;
 
 	  /* This rules out the possibility that read_fs_list() is invoked
@@ -75,6 +113,15 @@ read_fs_list (const char *prefix)
 
 	  file = grub_file_open (filename, GRUB_FILE_TYPE_GRUB_MODULE_LIST);
 	  if (file)
+	    {
+	      reader = grub_linereader_open (file);
+	      if (! reader)
+		{
+		  grub_file_close (file);
+		  grub_fs_autoload_hook = tmp_autoload_hook;
+		}
+	    }
+	  if (reader)
 	    {
 	      /* Override previous fs.lst.  */
 	      while (fs_module_list)
@@ -92,7 +139,7 @@ read_fs_list (const char *prefix)
 		  char *q;
 		  grub_named_list_t fs_mod;
 
-		  buf = grub_file_getline (file);
+		  buf = grub_linereader_getline (reader);
 		  if (! buf)
 		    break;
 
@@ -132,7 +179,7 @@ read_fs_list (const char *prefix)
 		  fs_module_list = fs_mod;
 		}
 
-	      grub_file_close (file);
+	      grub_linereader_close (reader);
 	      grub_fs_autoload_hook = tmp_autoload_hook;
 	    }
 
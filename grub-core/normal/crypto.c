@@ -78,6 +78,7 @@ read_crypto_list (const char *prefix)
 {
   char *filename;
   grub_file_t file;
+  grub_linereader_t reader;
   char *buf = NULL;
 
   if (!prefix)
@@ -102,6 +103,14 @@ read_crypto_list (const char *prefix)
       return;
     }
 
+  reader = grub_linereader_open (file);
+  if (!reader)
+    {
+      grub_file_close (file);
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+
   /* Override previous crypto.lst.  */
   grub_crypto_spec_free ();
 
@@ -110,7 +119,7 @@ read_crypto_list (const char *prefix)
       char *p, *name;
       struct load_spec *cur;
       
-      buf = grub_file_getline (file);
+      buf = grub_linereader_getline (reader);
 	
       if (! buf)
 	break;
@@ -155,7 +164,7 @@ read_crypto_list (const char *prefix)
       crypto_specs = cur;
     }
   
-  grub_file_close (file);
+  grub_linereader_close (reader);
 
   grub_errno = GRUB_ERR_NONE;
 
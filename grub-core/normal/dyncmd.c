@@ -26,6 +26,8 @@
 #include <grub/extcmd.h>
 #include <grub/script_sh.h>
 #include <grub/i18n.h>
+#include <grub/file.h>
+#include <grub/command_index.h>
 
 grub_command_t
 grub_dyncmd_get_cmd (grub_command_t cmd)
@@ -92,11 +94,173 @@ grub_dyncmd_dispatcher (struct grub_extcmd_context *ctxt,
   return ret;
 }
 
+/* Remove the commands registered from a previous command list.  */
+static void
+free_dyncmds (void)
+{
+  grub_command_t ptr, last = 0, next;
+
+  for (ptr = grub_command_list; ptr; ptr = next)
+    {
+      next = ptr->next;
+      if (ptr->flags & GRUB_COMMAND_FLAG_DYNCMD)
+	{
+	  if (last)
+	    last->next = ptr->next;
+	  else
+	    grub_command_list = ptr->next;
+	  grub_free (ptr->data); /* extcmd struct */
+	  grub_free (ptr);
+	}
+      else
+	last = ptr;
+    }
+}
+
+/* Register the command NAME loading MODNAME when it is first run.  */
+static void
+add_dyncmd (const char *name, const char *modname, int prio)
+{
+  grub_extcmd_t cmd;
+  char *name_copy, *modname_copy;
+
+  name_copy = grub_strdup (name);
+  if (! name_copy)
+    return;
+
+  modname_copy = grub_strdup (modname);
+  if (! modname_copy)
+    {
+      grub_free (name_copy);
+      return;
+    }
+
+  cmd = grub_register_extcmd_prio (name_copy,
+				   grub_dyncmd_dispatcher,
+				   GRUB_COMMAND_FLAG_BLOCKS
+				   | GRUB_COMMAND_FLAG_EXTCMD
+				   | GRUB_COMMAND_FLAG_DYNCMD,
+				   0, N_("module isn't loaded"),
+				   0, prio);
+  if (! cmd)
+    {
+      grub_free (name_copy);
+      grub_free (modname_copy);
+      return;
+    }
+  cmd->data = modname_copy;
+
+  /* Update the active flag.  */
+  grub_command_find (name_copy);
+}
+
+/* Return the string at OFFSET in the index BUF of SIZE bytes, or NULL if
+   it doesn't end inside it.  */
+static const char *
+index_string (const char *buf, grub_size_t size, grub_uint32_t offset)
+{
+  if (offset >= size || ! grub_memchr (buf + offset, '\0', size - offset))
+    return NULL;
+  return buf + offset;
+}
+
+/* Read the binary GRUB_COMMAND_INDEX_NAME grub-install makes out of
+   command.lst, with one read and without parsing it line by line.  Return
+   0 if there is none or it's unusable, so that command.lst is read
+   instead.  */
+static int
+read_command_index (const char *prefix)
+{
+  char *filename, *buf = NULL;
+  grub_file_t file;
+  grub_off_t size;
+  struct grub_command_index_header *header;
+  struct grub_command_index_entry *entries;
+  grub_uint32_t *modules;
+  grub_uint32_t nmodules, ncommands, i;
+  grub_uint8_t *loaded = NULL;
+  int ret = 0;
+
+  filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM
+			     "/" GRUB_COMMAND_INDEX_NAME, prefix);
+  if (! filename)
+    return 0;
+  file = grub_file_open (filename, GRUB_FILE_TYPE_GRUB_MODULE_LIST
+			 | GRUB_FILE_TYPE_NO_DECOMPRESS);
+  grub_free (filename);
+  if (! file)
+    return 0;
+
+  size = grub_file_size (file);
+  if (size < sizeof (*header) || size > 0x100000)
+    {
+      grub_file_close (file);
+      return 0;
+    }
+  buf = grub_malloc (size);
+  if (! buf || grub_file_read (file, buf, size) != (grub_ssize_t) size)
+    {
+      grub_file_close (file);
+      goto out;
+    }
+  grub_file_close (file);
+
+  header = (struct grub_command_index_header *) buf;
+  if (grub_memcmp (header->magic, GRUB_COMMAND_INDEX_MAGIC,
+		   sizeof (header->magic)) != 0
+      || grub_le_to_cpu32 (header->version) != GRUB_COMMAND_INDEX_VERSION)
+    goto out;
+  nmodules = grub_le_to_cpu32 (header->nmodules);
+  ncommands = grub_le_to_cpu32 (header->ncommands);
+  if ((grub_uint64_t) nmodules * sizeof (modules[0])
+      + (grub_uint64_t) ncommands * sizeof (entries[0])
+      > size - sizeof (*header))
+    goto out;
+  modules = (grub_uint32_t *) (header + 1);
+  entries = (struct grub_command_index_entry *) (modules + nmodules);
+
+  /* Check everything before touching the command list.  */
+  for (i = 0; i < nmodules; i++)
+    if (! index_string (buf, size, grub_le_to_cpu32 (modules[i])))
+      goto out;
+  for (i = 0; i < ncommands; i++)
+    if (grub_le_to_cpu16 (entries[i].module) >= nmodules
+	|| ! index_string (buf, size, grub_le_to_cpu32 (entries[i].name)))
+      goto out;
+
+  loaded = grub_malloc (nmodules ? : 1);
+  if (! loaded)
+    goto out;
+  for (i = 0; i < nmodules; i++)
+    loaded[i] = !! grub_dl_get (buf + grub_le_to_cpu32 (modules[i]));
+
+  /* Override previous command lists.  */
+  free_dyncmds ();
+
+  for (i = 0; i < ncommands; i++)
+    {
+      grub_uint16_t module = grub_le_to_cpu16 (entries[i].module);
+
+      if (loaded[module])
+	continue;
+      add_dyncmd (buf + grub_le_to_cpu32 (entries[i].name),
+		  buf + grub_le_to_cpu32 (modules[module]),
+		  !! grub_le_to_cpu16 (entries[i].prio));
+    }
+  ret = 1;
+
+ out:
+  grub_free (loaded);
+  grub_free (buf);
+  grub_errno = GRUB_ERR_NONE;
+  return ret;
+}
+
 /* Read the file command.lst for auto-loading.  */
 void
 read_command_list (const char *prefix)
 {
-  if (prefix)
+  if (prefix && ! read_command_index (prefix))
     {
       char *filename;
 
@@ -105,37 +269,28 @@ read_command_list (const char *prefix)
       if (filename)
 	{
 	  grub_file_t file;
+	  grub_linereader_t reader = NULL;
 
 	  file = grub_file_open (filename, GRUB_FILE_TYPE_GRUB_MODULE_LIST);
 	  if (file)
+	    {
+	      reader = grub_linereader_open (file);
+	      if (! reader)
+		grub_file_close (file);
+	    }
+	  if (reader)
 	    {
 	      char *buf = NULL;
-	      grub_command_t ptr, last = 0, next;
 
 	      /* Override previous commands.lst.  */
-	      for (ptr = grub_command_list; ptr; ptr = next)
-		{
-		  next = ptr->next;
-		  if (ptr->flags & GRUB_COMMAND_FLAG_DYNCMD)
-		    {
-		      if (last)
-			last->next = ptr->next;
-		      else
-			grub_command_list = ptr->next;
-		      grub_free (ptr->data); /* extcmd struct */
-		      grub_free (ptr);
-		    }
-		  else
-		    last = ptr;
-		}
+	      free_dyncmds ();
 
 	      for (;; grub_free (buf))
 		{
-		  char *p, *name, *modname;
-		  grub_extcmd_t cmd;
+		  char *p, *name;
 		  int prio = 0;
 
-		  buf = grub_file_getline (file);
+		  buf = grub_linereader_getline (reader);
 
 		  if (! buf)
 		    break;
@@ -168,37 +323,10 @@ read_command_list (const char *prefix)
 		  if (grub_dl_get (p))
 		    continue;
 
-		  name = grub_strdup (name);
-		  if (! name)
-		    continue;
-
-		  modname = grub_strdup (p);
-		  if (! modname)
-		    {
-		      grub_free (name);
-		      continue;
-		    }
-
-		  cmd = grub_register_extcmd_prio (name,
-						   grub_dyncmd_dispatcher,
-						   GRUB_COMMAND_FLAG_BLOCKS
-						   | GRUB_COMMAND_FLAG_EXTCMD
-						   | GRUB_COMMAND_FLAG_DYNCMD,
-						   0, N_("module isn't loaded"),
-						   0, prio);
-		  if (! cmd)
-		    {
-		      grub_free (name);
-		      grub_free (modname);
-		      continue;
-		    }
-		  cmd->data = modname;
-
-		  /* Update the active flag.  */
-		  grub_command_find (name);
+		  add_dyncmd (name, p, prio);
 		}
 
-	      grub_file_close (file);
+	      grub_linereader_close (reader);
 	    }
 
 	  grub_free (filename);
@@ -208,3 +336,54 @@ read_command_list (const char *prefix)
   /* Ignore errors.  */
   grub_errno = GRUB_ERR_NONE;
 }
+
+/* Load the modules needed by the commands, or the modules, named in the
+   space-separated list NAMES.  The config sets this in the variable
+   `preload' for the commands its menu entries run, so that the modules
+   are all read before the menu is shown instead of after an entry is
+   chosen.  Names of neither are ignored.  */
+void
+grub_dyncmd_preload (const char *names)
+{
+  char *list, *p, *name;
+
+  list = grub_strdup (names);
+  if (! list)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+
+  for (p = list; ; )
+    {
+      grub_command_t cmd;
+
+      while (grub_isspace (*p))
+	p++;
+      if (! *p)
+	break;
+      name = p;
+      while (*p && ! grub_isspace (*p))
+	p++;
+      if (*p)
+	*p++ = '\0';
+
+      cmd = grub_command_find (name);
+      if (cmd)
+	{
+	  if (cmd->flags & GRUB_COMMAND_FLAG_DYNCMD)
+	    grub_dyncmd_get_cmd (cmd);
+	}
+      else if (! grub_dl_get (name))
+	{
+	  grub_dl_t mod;
+
+	  mod = grub_dl_load (name);
+	  if (mod)
+	    grub_dl_ref (mod);
+	}
+      grub_errno = GRUB_ERR_NONE;
+    }
+
+  grub_free (list);
+}
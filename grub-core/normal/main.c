@@ -33,7 +33,7 @@
 #include <grub/i18n.h>
 #include <grub/charset.h>
 #include <grub/script_sh.h>
-#include <grub/bufio.h>
+#include <grub/script_cache.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -71,6 +71,7 @@ grub_normal_free_menu (grub_menu_t menu)
       grub_free ((void *) entry->users);
       grub_free ((void *) entry->title);
       grub_free ((void *) entry->sourcecode);
+      grub_script_unref (entry->script);
       grub_free (entry);
       entry = next_entry;
     }
@@ -84,13 +85,13 @@ static grub_err_t
 read_config_file_getline (char **line, int cont __attribute__ ((unused)),
 			  void *data)
 {
-  grub_file_t file = data;
+  grub_linereader_t reader = data;
 
   while (1)
     {
       char *buf;
 
-      *line = buf = grub_file_getline (file);
+      *line = buf = grub_linereader_getline (reader);
       if (! buf)
 	return grub_errno;
 
@@ -103,10 +104,98 @@ read_config_file_getline (char **line, int cont __attribute__ ((unused)),
   return GRUB_ERR_NONE;
 }
 
+/* Read this much of the configuration file at a time to hash it.  */
+#define CONFIG_HASH_BUFSIZE	8192
+
+/* Run the configuration file CONFIG, opened as FILE, from its cache if it
+   has one which is up to date.  Return 0 if it doesn't: FILE is then back
+   at its start to be parsed.  */
+static int
+read_config_cache (const char *config, grub_file_t file)
+{
+  struct grub_script_cache_entry *entries = 0, *e;
+  grub_file_t cache;
+  char *name, *buf = 0, *data = 0;
+  grub_size_t size;
+  grub_uint64_t hash = GRUB_SCRIPT_CACHE_HASH_INIT, hashed = 0;
+  grub_ssize_t got;
+
+  /* Print an error, if any, as parsing would first.  */
+  grub_print_error ();
+  grub_errno = GRUB_ERR_NONE;
+
+  name = grub_xasprintf ("%s" GRUB_SCRIPT_CACHE_SUFFIX, config);
+  if (! name)
+    goto fail;
+
+  /* The cache is a configuration file too, for the verifiers.  */
+  cache = grub_file_open (name, GRUB_FILE_TYPE_CONFIG);
+  grub_free (name);
+  if (! cache)
+    goto fail;
+
+  size = grub_file_size (cache);
+  if (grub_file_size (cache) == GRUB_FILE_SIZE_UNKNOWN
+      || size != grub_file_size (cache))
+    {
+      grub_file_close (cache);
+      goto fail;
+    }
+
+  buf = grub_malloc (size);
+  if (! buf || grub_file_read (cache, buf, size) != (grub_ssize_t) size)
+    {
+      grub_file_close (cache);
+      goto fail;
+    }
+  grub_file_close (cache);
+
+  data = grub_malloc (CONFIG_HASH_BUFSIZE);
+  if (! data)
+    goto fail;
+
+  while ((got = grub_file_read (file, data, CONFIG_HASH_BUFSIZE)) > 0)
+    {
+      hash = grub_script_cache_hash (hash, data, got);
+      hashed += got;
+    }
+  if (got < 0)
+    goto fail;
+
+  entries = grub_script_cache_load (buf, size, hashed, hash);
+  if (! entries)
+    goto fail;
+  grub_free (buf);
+  grub_free (data);
+
+  /* Like the loop parsing the file, statement by statement.  */
+  for (e = entries; e; e = e->next)
+    {
+      grub_print_error ();
+      grub_errno = GRUB_ERR_NONE;
+
+      grub_script_cache_execute (e);
+    }
+  grub_print_error ();
+  grub_errno = GRUB_ERR_NONE;
+
+  grub_script_cache_free (entries);
+  return 1;
+
+ fail:
+  grub_dprintf ("normal", "parsing %s\n", config);
+  grub_free (buf);
+  grub_free (data);
+  grub_errno = GRUB_ERR_NONE;
+  grub_file_seek (file, 0);
+  return 0;
+}
+
 static grub_menu_t
 read_config_file (const char *config)
 {
-  grub_file_t rawfile, file;
+  grub_file_t file;
+  grub_linereader_t reader;
   char *old_file = 0, *old_dir = 0;
   char *config_dir, *ptr = 0;
   const char *ctmp;
@@ -124,14 +213,14 @@ read_config_file (const char *config)
     }
 
   /* Try to open the config file.  */
-  rawfile = grub_file_open (config, GRUB_FILE_TYPE_CONFIG);
-  if (! rawfile)
+  file = grub_file_open (config, GRUB_FILE_TYPE_CONFIG);
+  if (! file)
     return 0;
 
-  file = grub_bufio_open (rawfile, 0);
-  if (! file)
+  reader = grub_linereader_open (file);
+  if (! reader)
     {
-      grub_file_close (rawfile);
+      grub_file_close (file);
       return 0;
     }
 
@@ -165,20 +254,22 @@ read_config_file (const char *config)
   grub_env_export ("config_file");
   grub_env_export ("config_directory");
 
-  while (1)
-    {
-      char *line;
+  /* The reader hasn't read anything from FILE yet.  */
+  if (! read_config_cache (config, file))
+    while (1)
+      {
+	char *line;
 
-      /* Print an error, if any.  */
-      grub_print_error ();
-      grub_errno = GRUB_ERR_NONE;
+	/* Print an error, if any.  */
+	grub_print_error ();
+	grub_errno = GRUB_ERR_NONE;
 
-      if ((read_config_file_getline (&line, 0, file)) || (! line))
-	break;
+	if ((read_config_file_getline (&line, 0, reader)) || (! line))
+	  break;
 
-      grub_normal_parse_line (line, read_config_file_getline, file);
-      grub_free (line);
-    }
+	grub_normal_parse_line (line, read_config_file_getline, reader);
+	grub_free (line);
+      }
 
   if (old_file)
     grub_env_set ("config_file", old_file);
@@ -191,7 +282,7 @@ read_config_file (const char *config)
   grub_free (old_file);
   grub_free (old_dir);
 
-  grub_file_close (file);
+  grub_linereader_close (reader);
 
   return newmenu;
 }
@@ -286,6 +377,14 @@ grub_normal_execute (const char *config, int nested, int batch)
     {
       if (menu && menu->size)
 	{
+	  const char *preload = grub_env_get ("preload");
+
+	  if (preload && ! grub_no_modules)
+	    {
+	      grub_boot_time ("Preloading modules");
+	      grub_dyncmd_preload (preload);
+	      grub_boot_time ("Modules preloaded");
+	    }
 
 	  grub_boot_time ("Entering menu");
 	  grub_show_menu (menu, nested, 0);
@@ -294,7 +294,11 @@ grub_menu_execute_entry(grub_menu_entry_t entry, int auto_boot)
   else
     grub_env_unset ("default");
 
-  grub_script_execute_new_scope (entry->sourcecode, entry->argc, entry->args);
+  if (entry->script)
+    grub_script_execute_script_new_scope (entry->script,
+					  entry->argc, entry->args);
+  else
+    grub_script_execute_new_scope (entry->sourcecode, entry->argc, entry->args);
 
   if (errs_before != grub_err_printed_errors)
     grub_wait_after_message ();
@@ -383,6 +387,15 @@ menu_print_timeout (int timeout)
     cur->print_timeout (timeout, cur->data);
 }
 
+static void
+menu_idle (void)
+{
+  struct grub_menu_viewer *cur;
+  for (cur = viewers; cur; cur = cur->next)
+    if (cur->idle)
+      cur->idle (cur->data);
+}
+
 static void
 menu_fini (void)
 {
@@ -695,6 +708,8 @@ run_menu (grub_menu_t menu, int nested, int *auto_boot)
 	  return default_entry;
 	}
 
+      menu_idle ();
+
       c = grub_getkey_noblock ();
 
       /* Negative values are returned on error. */
@@ -27,6 +27,7 @@
 #include <grub/term.h>
 #include <grub/i18n.h>
 #include <grub/partition.h>
+#include <grub/devindex.h>
 
 static const char *grub_human_sizes[3][6] =
   {
@@ -107,65 +108,38 @@ grub_normal_print_device_info (const char *name)
     grub_printf ("%s", _("Filesystem cannot be accessed"));
   else if (dev->disk)
     {
-      grub_fs_t fs;
+      const struct grub_devindex_entry *e;
 
-      fs = grub_fs_probe (dev);
+      e = grub_devindex_get_device (dev);
       /* Ignore all errors.  */
       grub_errno = 0;
 
-      if (fs)
+      if (e && e->fs)
 	{
-	  const char *fsname = fs->name;
+	  const char *fsname = e->fs;
 	  if (grub_strcmp (fsname, "ext2") == 0)
 	    fsname = "ext*";
 	  grub_printf_ (N_("Filesystem type %s"), fsname);
-	  if (fs->fs_label)
+	  if (e->label && grub_strlen (e->label))
 	    {
-	      char *label;
-	      (fs->fs_label) (dev, &label);
-	      if (grub_errno == GRUB_ERR_NONE)
-		{
-		  if (label && grub_strlen (label))
-		    {
-		      grub_xputs (" ");
-		      grub_printf_ (N_("- Label `%s'"), label);
-		    }
-		  grub_free (label);
-		}
-	      grub_errno = GRUB_ERR_NONE;
+	      grub_xputs (" ");
+	      grub_printf_ (N_("- Label `%s'"), e->label);
 	    }
-	  if (fs->fs_mtime)
+	  if (e->have_mtime)
 	    {
-	      grub_int32_t tm;
 	      struct grub_datetime datetime;
-	      (fs->fs_mtime) (dev, &tm);
-	      if (grub_errno == GRUB_ERR_NONE)
-		{
-		  grub_unixtime2datetime (tm, &datetime);
-		  grub_xputs (" ");
-		  /* TRANSLATORS: Arguments are year, month, day, hour, minute,
-		     second, day of the week (translated).  */
-		  grub_printf_ (N_("- Last modification time %d-%02d-%02d "
-			       "%02d:%02d:%02d %s"),
-			       datetime.year, datetime.month, datetime.day,
-			       datetime.hour, datetime.minute, datetime.second,
-			       grub_get_weekday_name (&datetime));
-
-		}
-	      grub_errno = GRUB_ERR_NONE;
-	    }
-	  if (fs->fs_uuid)
-	    {
-	      char *uuid;
-	      (fs->fs_uuid) (dev, &uuid);
-	      if (grub_errno == GRUB_ERR_NONE)
-		{
-		  if (uuid && grub_strlen (uuid))
-		    grub_printf (", UUID %s", uuid);
-		  grub_free (uuid);
-		}
-	      grub_errno = GRUB_ERR_NONE;
+	      grub_unixtime2datetime (e->mtime, &datetime);
+	      grub_xputs (" ");
+	      /* TRANSLATORS: Arguments are year, month, day, hour, minute,
+		 second, day of the week (translated).  */
+	      grub_printf_ (N_("- Last modification time %d-%02d-%02d "
+			   "%02d:%02d:%02d %s"),
+			   datetime.year, datetime.month, datetime.day,
+			   datetime.hour, datetime.minute, datetime.second,
+			   grub_get_weekday_name (&datetime));
 	    }
+	  if (e->uuid && grub_strlen (e->uuid))
+	    grub_printf (", UUID %s", e->uuid);
 	}
       else
 	grub_printf ("%s", _("No known filesystem detected"));
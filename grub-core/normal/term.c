@@ -315,6 +315,7 @@ read_terminal_list (const char *prefix)
 {
   char *filename;
   grub_file_t file;
+  grub_linereader_t reader;
   char *buf = NULL;
 
   if (!prefix)
@@ -339,6 +340,14 @@ read_terminal_list (const char *prefix)
       return;
     }
 
+  reader = grub_linereader_open (file);
+  if (!reader)
+    {
+      grub_file_close (file);
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+
   /* Override previous terminal.lst.  */
   grub_terminal_autoload_free ();
 
@@ -348,7 +357,7 @@ read_terminal_list (const char *prefix)
       struct grub_term_autoload *cur;
       struct grub_term_autoload **target = NULL;
       
-      buf = grub_file_getline (file);
+      buf = grub_linereader_getline (reader);
 	
       if (! buf)
 	break;
@@ -408,7 +417,7 @@ read_terminal_list (const char *prefix)
       *target = cur;
     }
   
-  grub_file_close (file);
+  grub_linereader_close (reader);
 
   grub_errno = GRUB_ERR_NONE;
 }
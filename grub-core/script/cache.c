@@ -0,0 +1,585 @@
+/* cache.c - parsed configuration files */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/i18n.h>
+#include <grub/script_sh.h>
+#include <grub/script_cache.h>
+
+/* Nothing GRUB parses is nested this deep, but the loader recurses and the
+   stack is small.  */
+#define MAX_DEPTH	128
+
+grub_uint64_t
+grub_script_cache_hash (grub_uint64_t hash, const void *buf, grub_size_t size)
+{
+  const grub_uint8_t *p = buf;
+
+  while (size--)
+    {
+      hash ^= *p++;
+      hash *= 0x100000001b3ULL;
+    }
+
+  return hash;
+}
+
+/* The scripts are rebuilt with the constructors of the parser, so that
+   they are just like the ones it makes: the memory of a script is
+   recorded in STATE, and its blocks are collected in STATE->scripts to
+   become its children.  */
+struct cache_reader
+{
+  const grub_uint8_t *p;
+  const grub_uint8_t *end;
+  struct grub_parser_param state;
+};
+
+static grub_err_t
+bad_cache (void)
+{
+  return grub_error (GRUB_ERR_BAD_FILE_TYPE, N_("invalid script cache"));
+}
+
+static grub_err_t
+read_word (struct cache_reader *r, grub_uint32_t *val)
+{
+  if (r->end - r->p < 4)
+    return bad_cache ();
+
+  *val = grub_le_to_cpu32 (grub_get_unaligned32 (r->p));
+  r->p += 4;
+  return GRUB_ERR_NONE;
+}
+
+/* Return in STR the string at R, which stays in the buffer.  */
+static grub_err_t
+read_string (struct cache_reader *r, char **str)
+{
+  grub_uint32_t len;
+
+  if (read_word (r, &len))
+    return grub_errno;
+
+  if (len == 0 || (grub_size_t) (r->end - r->p) < len || r->p[len - 1]
+      || grub_strlen ((const char *) r->p) != len - 1)
+    return bad_cache ();
+
+  *str = (char *) r->p;
+  r->p += len;
+  return GRUB_ERR_NONE;
+}
+
+static void
+free_scripts (struct grub_script *s)
+{
+  struct grub_script *t;
+
+  for (; s; s = t)
+    {
+      t = s->next_siblings;
+      grub_script_unref (s);
+    }
+}
+
+static grub_err_t read_cmd (struct cache_reader *r,
+			    struct grub_script_cmd **cmd, int depth);
+
+static struct grub_script *
+read_script (struct cache_reader *r, int depth)
+{
+  struct grub_script_mem *restore, *mem;
+  struct grub_script *scripts = r->state.scripts, *script = 0;
+  struct grub_script_cmd *cmd;
+
+  restore = grub_script_mem_record (&r->state);
+  r->state.scripts = 0;
+
+  if (read_cmd (r, &cmd, depth) == GRUB_ERR_NONE)
+    script = grub_script_create (cmd, 0);
+
+  mem = grub_script_mem_record_stop (&r->state, restore);
+  if (! script)
+    {
+      grub_script_mem_free (mem);
+      free_scripts (r->state.scripts);
+      r->state.scripts = scripts;
+      return 0;
+    }
+
+  script->mem = mem;
+  script->children = r->state.scripts;
+  r->state.scripts = scripts;
+  return script;
+}
+
+static grub_err_t
+read_arg (struct cache_reader *r, struct grub_script_arg **arg, int depth)
+{
+  struct grub_script_arg *last;
+  struct grub_script *script;
+  grub_uint32_t nparts, type;
+  char *str;
+
+  *arg = 0;
+  if (read_word (r, &nparts))
+    return grub_errno;
+  if (nparts == 0)
+    return bad_cache ();
+
+  while (nparts--)
+    {
+      if (read_word (r, &type) || read_string (r, &str))
+	return grub_errno;
+      if (type > GRUB_SCRIPT_ARG_TYPE_BLOCK)
+	return bad_cache ();
+
+      *arg = grub_script_arg_add (&r->state, *arg, type, str);
+      if (grub_errno)
+	return grub_errno;
+
+      if (type != GRUB_SCRIPT_ARG_TYPE_BLOCK)
+	continue;
+
+      script = read_script (r, depth + 1);
+      if (! script)
+	return grub_errno;
+
+      for (last = *arg; last->next; last = last->next);
+      last->script = script;
+      script->next_siblings = r->state.scripts;
+      r->state.scripts = script;
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+read_arglist (struct cache_reader *r, struct grub_script_arglist **list,
+	      int depth)
+{
+  struct grub_script_arg *arg;
+  grub_uint32_t n;
+
+  *list = 0;
+  if (read_word (r, &n))
+    return grub_errno;
+
+  while (n--)
+    {
+      if (read_arg (r, &arg, depth))
+	return grub_errno;
+      *list = grub_script_add_arglist (&r->state, *list, arg);
+      if (grub_errno)
+	return grub_errno;
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+read_cmd (struct cache_reader *r, struct grub_script_cmd **cmd, int depth)
+{
+  struct grub_script_cmd *a, *b, *c;
+  struct grub_script_arglist *list;
+  struct grub_script_arg *arg;
+  grub_uint32_t kind, n;
+
+  *cmd = 0;
+  if (depth > MAX_DEPTH)
+    return bad_cache ();
+  if (read_word (r, &kind))
+    return grub_errno;
+
+  switch (kind)
+    {
+    case GRUB_SCRIPT_CACHE_CMD_NONE:
+      return GRUB_ERR_NONE;
+
+    case GRUB_SCRIPT_CACHE_CMD_LINE:
+      if (read_arglist (r, &list, depth))
+	return grub_errno;
+      if (! list)
+	return bad_cache ();
+      *cmd = grub_script_create_cmdline (&r->state, list);
+      break;
+
+    case GRUB_SCRIPT_CACHE_CMD_LIST:
+      if (read_word (r, &n))
+	return grub_errno;
+      if (n == 0)
+	return bad_cache ();
+      while (n--)
+	{
+	  if (read_cmd (r, &a, depth + 1))
+	    return grub_errno;
+	  /* The commands of a list are chained through their NEXT, so they
+	     can't be lists themselves.  */
+	  if (! a || a->exec == grub_script_execute_cmdlist)
+	    return bad_cache ();
+	  *cmd = grub_script_append_cmd (&r->state, *cmd, a);
+	  if (grub_errno)
+	    return grub_errno;
+	}
+      return GRUB_ERR_NONE;
+
+    case GRUB_SCRIPT_CACHE_CMD_IF:
+      if (read_cmd (r, &a, depth + 1) || read_cmd (r, &b, depth + 1)
+	  || read_cmd (r, &c, depth + 1))
+	return grub_errno;
+      *cmd = grub_script_create_cmdif (&r->state, a, b, c);
+      break;
+
+    case GRUB_SCRIPT_CACHE_CMD_FOR:
+      if (read_arg (r, &arg, depth) || read_arglist (r, &list, depth)
+	  || read_cmd (r, &a, depth + 1))
+	return grub_errno;
+      *cmd = grub_script_create_cmdfor (&r->state, arg, list, a);
+      break;
+
+    case GRUB_SCRIPT_CACHE_CMD_WHILE:
+    case GRUB_SCRIPT_CACHE_CMD_UNTIL:
+      if (read_cmd (r, &a, depth + 1) || read_cmd (r, &b, depth + 1))
+	return grub_errno;
+      *cmd = grub_script_create_cmdwhile (&r->state, a, b,
+					  kind == GRUB_SCRIPT_CACHE_CMD_UNTIL);
+      break;
+
+    default:
+      return bad_cache ();
+    }
+
+  return *cmd ? GRUB_ERR_NONE : grub_errno;
+}
+
+/* Load the SIZE bytes of the cache at BUF, made from a configuration file
+   of SOURCE_SIZE bytes which hash to SOURCE_HASH.  Return its records,
+   NULL if it is not valid or was made from another file.  grub_errno
+   must be clear.  */
+struct grub_script_cache_entry *
+grub_script_cache_load (const void *buf, grub_size_t size,
+			grub_uint64_t source_size, grub_uint64_t source_hash)
+{
+  const struct grub_script_cache_header *header = buf;
+  struct grub_script_cache_entry *entries = 0, **last = &entries, *e;
+  struct cache_reader r;
+  grub_uint32_t kind;
+  char *name;
+
+  if (size < sizeof (*header)
+      || grub_memcmp (header->magic, GRUB_SCRIPT_CACHE_MAGIC,
+		      sizeof (header->magic)) != 0
+      || header->version
+	 != grub_cpu_to_le32_compile_time (GRUB_SCRIPT_CACHE_VERSION))
+    {
+      bad_cache ();
+      return 0;
+    }
+
+  if (grub_le_to_cpu64 (header->source_size) != source_size
+      || grub_le_to_cpu64 (header->source_hash) != source_hash)
+    {
+      grub_error (GRUB_ERR_BAD_FILE_TYPE, N_("script cache is out of date"));
+      return 0;
+    }
+
+  grub_memset (&r, 0, sizeof (r));
+  r.p = (const grub_uint8_t *) (header + 1);
+  r.end = (const grub_uint8_t *) buf + size;
+
+  while (1)
+    {
+      if (read_word (&r, &kind))
+	goto fail;
+      if (kind == GRUB_SCRIPT_CACHE_END)
+	break;
+
+      if (kind != GRUB_SCRIPT_CACHE_STATEMENT
+	  && kind != GRUB_SCRIPT_CACHE_FUNCTION)
+	{
+	  bad_cache ();
+	  goto fail;
+	}
+
+      e = grub_zalloc (sizeof (*e));
+      if (! e)
+	goto fail;
+      *last = e;
+      last = &e->next;
+
+      if (kind == GRUB_SCRIPT_CACHE_FUNCTION)
+	{
+	  if (read_string (&r, &name))
+	    goto fail;
+	  e->name = grub_strdup (name);
+	  if (! e->name)
+	    goto fail;
+	}
+
+      e->script = read_script (&r, 0);
+      if (! e->script)
+	goto fail;
+    }
+
+  return entries;
+
+ fail:
+  grub_script_cache_free (entries);
+  return 0;
+}
+
+/* Do what parsing the configuration file did at ENTRY: define its
+   function, or execute its statement.  Its script is released.  */
+grub_err_t
+grub_script_cache_execute (struct grub_script_cache_entry *entry)
+{
+  struct grub_script_arg name;
+
+  if (! entry->name)
+    {
+      grub_script_execute (entry->script);
+      grub_script_unref (entry->script);
+    }
+  else
+    {
+      name.type = GRUB_SCRIPT_ARG_TYPE_TEXT;
+      name.str = entry->name;
+      name.script = 0;
+      name.next = 0;
+      if (! grub_script_function_create (&name, entry->script))
+	grub_script_free (entry->script);
+    }
+
+  entry->script = 0;
+  return grub_errno;
+}
+
+void
+grub_script_cache_free (struct grub_script_cache_entry *entries)
+{
+  struct grub_script_cache_entry *next;
+
+  for (; entries; entries = next)
+    {
+      next = entries->next;
+      grub_free (entries->name);
+      grub_script_unref (entries->script);
+      grub_free (entries);
+    }
+}
+
+#ifdef GRUB_UTIL
+
+static grub_err_t
+write_bytes (struct grub_script_cache_writer *w, const void *data,
+	     grub_size_t size)
+{
+  char *buf;
+  grub_size_t allocated;
+
+  if (w->size + size > w->allocated)
+    {
+      allocated = w->allocated ? : 4096;
+      while (w->size + size > allocated)
+	allocated *= 2;
+      buf = grub_realloc (w->buf, allocated);
+      if (! buf)
+	return grub_errno;
+      w->buf = buf;
+      w->allocated = allocated;
+    }
+
+  grub_memcpy (w->buf + w->size, data, size);
+  w->size += size;
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+write_word (struct grub_script_cache_writer *w, grub_uint32_t val)
+{
+  grub_uint32_t le = grub_cpu_to_le32 (val);
+
+  return write_bytes (w, &le, sizeof (le));
+}
+
+static grub_err_t
+write_string (struct grub_script_cache_writer *w, const char *str)
+{
+  grub_size_t len = grub_strlen (str) + 1;
+
+  if (write_word (w, len))
+    return grub_errno;
+  return write_bytes (w, str, len);
+}
+
+static grub_err_t write_cmd (struct grub_script_cache_writer *w,
+			     struct grub_script_cmd *cmd);
+
+static grub_err_t
+write_arg (struct grub_script_cache_writer *w, struct grub_script_arg *arg)
+{
+  struct grub_script_arg *part;
+  grub_uint32_t n = 0;
+
+  for (part = arg; part; part = part->next)
+    n++;
+  if (write_word (w, n))
+    return grub_errno;
+
+  for (part = arg; part; part = part->next)
+    {
+      if (write_word (w, part->type) || write_string (w, part->str))
+	return grub_errno;
+      if (part->type == GRUB_SCRIPT_ARG_TYPE_BLOCK
+	  && write_cmd (w, part->script ? part->script->cmd : 0))
+	return grub_errno;
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+write_arglist (struct grub_script_cache_writer *w,
+	       struct grub_script_arglist *list)
+{
+  struct grub_script_arglist *link;
+  grub_uint32_t n = 0;
+
+  for (link = list; link; link = link->next)
+    n++;
+  if (write_word (w, n))
+    return grub_errno;
+
+  for (link = list; link; link = link->next)
+    if (write_arg (w, link->arg))
+      return grub_errno;
+
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+write_cmd (struct grub_script_cache_writer *w, struct grub_script_cmd *cmd)
+{
+  struct grub_script_cmd *c;
+  grub_uint32_t n = 0;
+
+  if (! cmd)
+    return write_word (w, GRUB_SCRIPT_CACHE_CMD_NONE);
+
+  if (cmd->exec == grub_script_execute_cmdline)
+    {
+      struct grub_script_cmdline *line = (struct grub_script_cmdline *) cmd;
+
+      if (write_word (w, GRUB_SCRIPT_CACHE_CMD_LINE))
+	return grub_errno;
+      return write_arglist (w, line->arglist);
+    }
+
+  if (cmd->exec == grub_script_execute_cmdlist)
+    {
+      for (c = cmd->next; c; c = c->next)
+	n++;
+      if (write_word (w, GRUB_SCRIPT_CACHE_CMD_LIST) || write_word (w, n))
+	return grub_errno;
+      for (c = cmd->next; c; c = c->next)
+	if (write_cmd (w, c))
+	  return grub_errno;
+      return GRUB_ERR_NONE;
+    }
+
+  if (cmd->exec == grub_script_execute_cmdif)
+    {
+      struct grub_script_cmdif *cmdif = (struct grub_script_cmdif *) cmd;
+
+      if (write_word (w, GRUB_SCRIPT_CACHE_CMD_IF)
+	  || write_cmd (w, cmdif->exec_to_evaluate)
+	  || write_cmd (w, cmdif->exec_on_true))
+	return grub_errno;
+      return write_cmd (w, cmdif->exec_on_false);
+    }
+
+  if (cmd->exec == grub_script_execute_cmdfor)
+    {
+      struct grub_script_cmdfor *cmdfor = (struct grub_script_cmdfor *) cmd;
+
+      if (write_word (w, GRUB_SCRIPT_CACHE_CMD_FOR)
+	  || write_arg (w, cmdfor->name)
+	  || write_arglist (w, cmdfor->words))
+	return grub_errno;
+      return write_cmd (w, cmdfor->list);
+    }
+
+  if (cmd->exec == grub_script_execute_cmdwhile)
+    {
+      struct grub_script_cmdwhile *cmdwhile
+	= (struct grub_script_cmdwhile *) cmd;
+
+      if (write_word (w, cmdwhile->until ? GRUB_SCRIPT_CACHE_CMD_UNTIL
+		      : GRUB_SCRIPT_CACHE_CMD_WHILE)
+	  || write_cmd (w, cmdwhile->cond))
+	return grub_errno;
+      return write_cmd (w, cmdwhile->list);
+    }
+
+  return grub_error (GRUB_ERR_BUG, "unknown script command");
+}
+
+grub_err_t
+grub_script_cache_write_header (struct grub_script_cache_writer *writer,
+				grub_uint64_t source_size,
+				grub_uint64_t source_hash)
+{
+  struct grub_script_cache_header header;
+
+  grub_memcpy (header.magic, GRUB_SCRIPT_CACHE_MAGIC, sizeof (header.magic));
+  header.version = grub_cpu_to_le32_compile_time (GRUB_SCRIPT_CACHE_VERSION);
+  header.reserved = 0;
+  header.source_size = grub_cpu_to_le64 (source_size);
+  header.source_hash = grub_cpu_to_le64 (source_hash);
+  return write_bytes (writer, &header, sizeof (header));
+}
+
+grub_err_t
+grub_script_cache_write_statement (struct grub_script_cache_writer *writer,
+				   struct grub_script *script)
+{
+  if (write_word (writer, GRUB_SCRIPT_CACHE_STATEMENT))
+    return grub_errno;
+  return write_cmd (writer, script->cmd);
+}
+
+grub_err_t
+grub_script_cache_write_function (struct grub_script_cache_writer *writer,
+				  const char *name, struct grub_script *script)
+{
+  if (write_word (writer, GRUB_SCRIPT_CACHE_FUNCTION)
+      || write_string (writer, name))
+    return grub_errno;
+  return write_cmd (writer, script->cmd);
+}
+
+grub_err_t
+grub_script_cache_write_end (struct grub_script_cache_writer *writer)
+{
+  return write_word (writer, GRUB_SCRIPT_CACHE_END);
+}
+
+#endif
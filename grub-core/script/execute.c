@@ -926,6 +926,37 @@ grub_script_execute_new_scope (const char *source, int argc, char **args)
   return ret;
 }
 
+/* Execute an already parsed script in new scope, like a function.  */
+grub_err_t
+grub_script_execute_script_new_scope (struct grub_script *script,
+				      int argc, char **args)
+{
+  grub_err_t ret = 0;
+  unsigned long loops = active_loops;
+  struct grub_script_scope new_scope;
+  struct grub_script_scope *old_scope;
+
+  active_loops = 0;
+  new_scope.argv.argc = argc;
+  new_scope.argv.args = args;
+  new_scope.flags = 0;
+  new_scope.shifts = 0;
+
+  old_scope = scope;
+  scope = &new_scope;
+
+  /* The script may free the menu which holds it, by loading another
+     configuration file.  */
+  grub_script_ref (script);
+  ret = grub_script_execute (script);
+  grub_script_unref (script);
+
+  function_return = 0;
+  active_loops = loops;
+  replace_scope (old_scope); /* free any scopes by setparams */
+  return ret;
+}
+
 /* Execute a single command line.  */
 grub_err_t
 grub_script_execute_cmdline (struct grub_script_cmd *cmd)
@@ -53,6 +53,9 @@ struct grub_colored_char
   /* Color values.  */
   grub_video_color_t fg_color;
   grub_video_color_t bg_color;
+
+  /* Width in columns.  */
+  unsigned char width;
 };
 
 struct grub_virtual_screen
@@ -93,8 +96,10 @@ struct grub_virtual_screen
   grub_video_color_t bg_color_display;
 
   /* Text buffer for virtual screen.  Contains (columns * rows) number
-     of entries.  */
+     of entries.  It is a ring of rows beginning with FIRST_ROW, so that
+     scrolling does not have to move the text.  */
   struct grub_colored_char *text_buffer;
+  unsigned int first_row;
 
   int total_scroll;
 
@@ -134,8 +139,6 @@ static void dirty_region_add (int x, int y,
 
 static unsigned int calculate_normal_character_width (grub_font_t font);
 
-static unsigned char calculate_character_width (struct grub_font_glyph *glyph);
-
 static void grub_gfxterm_refresh (struct grub_term_output *term __attribute__ ((unused)));
 
 static grub_size_t
@@ -175,6 +178,17 @@ clear_char (struct grub_colored_char *c)
   grub_unicode_set_glyph_from_code (&c->code, ' ');
   c->fg_color = virtual_screen.fg_color;
   c->bg_color = virtual_screen.bg_color;
+  c->width = 1;
+}
+
+/* Return the first character of row CY of the virtual screen.  */
+static inline struct grub_colored_char *
+text_row (unsigned int cy)
+{
+  cy += virtual_screen.first_row;
+  if (cy >= virtual_screen.rows)
+    cy -= virtual_screen.rows;
+  return virtual_screen.text_buffer + cy * virtual_screen.columns;
 }
 
 static void
@@ -196,6 +210,9 @@ grub_virtual_screen_free (void)
   /* Reset virtual screen data.  */
   grub_memset (&virtual_screen, 0, sizeof (virtual_screen));
 
+  /* Glyphs are rendered in text layer colors.  */
+  grub_font_flush_rendered_glyphs ();
+
   /* Free render targets.  */
   grub_video_delete_render_target (text_layer);
   text_layer = 0;
@@ -616,12 +633,8 @@ static inline void
 paint_char (unsigned cx, unsigned cy)
 {
   struct grub_colored_char *p;
-  struct grub_font_glyph *glyph;
-  grub_video_color_t color;
-  grub_video_color_t bgcolor;
   unsigned int x;
   unsigned int y;
-  int ascent;
   unsigned int height;
   unsigned int width;
 
@@ -629,34 +642,23 @@ paint_char (unsigned cx, unsigned cy)
     return;
 
   /* Find out active character.  */
-  p = (virtual_screen.text_buffer
-       + cx + (cy * virtual_screen.columns));
+  p = text_row (cy) + cx;
 
   if (!p->code.base)
     return;
 
-  /* Get glyph for character.  */
-  glyph = grub_font_construct_glyph (virtual_screen.font, &p->code);
-  if (!glyph)
-    {
-      grub_errno = GRUB_ERR_NONE;
-      return;
-    }
-  ascent = grub_font_get_ascent (virtual_screen.font);
-
-  width = virtual_screen.normal_char_width * calculate_character_width(glyph);
+  width = virtual_screen.normal_char_width * p->width;
   height = virtual_screen.normal_char_height;
 
-  color = p->fg_color;
-  bgcolor = p->bg_color;
-
   x = cx * virtual_screen.normal_char_width;
   y = (cy + virtual_screen.total_scroll) * virtual_screen.normal_char_height;
 
   /* Render glyph to text layer.  */
   grub_video_set_active_render_target (text_layer);
-  grub_video_fill_rect (bgcolor, x, y, width, height);
-  grub_font_draw_glyph (glyph, color, x, y + ascent);
+  if (grub_font_draw_glyph_cell (virtual_screen.font, &p->code,
+				 p->fg_color, p->bg_color, x, y, width, height,
+				 grub_font_get_ascent (virtual_screen.font)))
+    grub_errno = GRUB_ERR_NONE;
   grub_video_set_active_render_target (render_target);
 
   /* Mark character to be drawn.  */
@@ -750,27 +752,22 @@ real_scroll (void)
 
       while (i--)
 	{
-	  /* Save viewport and set it to our window.  */
+	  /* Save viewport.  */
 	  grub_video_get_viewport ((unsigned *) &saved_view.x, 
 				   (unsigned *) &saved_view.y, 
 				   (unsigned *) &saved_view.width, 
 				   (unsigned *) &saved_view.height);
 
-	  grub_video_set_viewport (window.x, window.y, window.width,
-				   window.height);
-
-	  /* Clear new border area.  */
-	  grub_video_fill_rect (color,
-				virtual_screen.offset_x,
-				virtual_screen.offset_y,
-				virtual_screen.width,
-				virtual_screen.normal_char_height
-				* virtual_screen.total_scroll);
-
-	  grub_video_set_active_render_target (render_target);
+	  /* Draw pending changes first, they have to scroll too.  */
 	  dirty_region_redraw ();
 
-	  /* Scroll physical screen.  */
+	  /* Scroll physical screen.  Only the text area moves, the border
+	     around it stays as it is.  The newly exposed lines are cleared
+	     here and their text is drawn below.  */
+	  grub_video_set_viewport (window.x + virtual_screen.offset_x,
+				   window.y + virtual_screen.offset_y,
+				   virtual_screen.width,
+				   virtual_screen.height);
 	  grub_video_scroll (color, 0, -virtual_screen.normal_char_height
 			     * virtual_screen.total_scroll);
 
@@ -813,24 +810,15 @@ real_scroll (void)
 static void
 scroll_up (void)
 {
+  struct grub_colored_char *row = text_row (0);
   unsigned int i;
 
-  /* Clear first line in text buffer.  */
+  /* The first line in text buffer becomes the cleared last line.  */
   for (i = 0; i < virtual_screen.columns; i++)
-    grub_unicode_destroy_glyph (&virtual_screen.text_buffer[i].code);
-  
-  /* Scroll text buffer with one line to up.  */
-  grub_memmove (virtual_screen.text_buffer,
-                virtual_screen.text_buffer + virtual_screen.columns,
-                sizeof (*virtual_screen.text_buffer)
-                * virtual_screen.columns
-                * (virtual_screen.rows - 1));
-
-  /* Clear last line in text buffer.  */
-  for (i = virtual_screen.columns * (virtual_screen.rows - 1);
-       i < virtual_screen.columns * virtual_screen.rows;
-       i++)
-    clear_char (&(virtual_screen.text_buffer[i]));
+    clear_char (&row[i]);
+
+  if (++virtual_screen.first_row == virtual_screen.rows)
+    virtual_screen.first_row = 0;
 
   virtual_screen.total_scroll++;
 }
@@ -890,23 +878,21 @@ grub_gfxterm_putchar (struct grub_term_output *term,
 	}
 
       /* Find position on virtual screen, and fill information.  */
-      p = (virtual_screen.text_buffer +
-           virtual_screen.cursor_x +
-           virtual_screen.cursor_y * virtual_screen.columns);
+      p = text_row (virtual_screen.cursor_y) + virtual_screen.cursor_x;
       grub_unicode_destroy_glyph (&p->code);
       grub_unicode_set_glyph (&p->code, c);
       grub_errno = GRUB_ERR_NONE;
       p->fg_color = virtual_screen.fg_color;
       p->bg_color = virtual_screen.bg_color;
+      p->width = char_width;
 
       /* If we have large glyph, add fixup info.  */
       if (char_width > 1)
         {
           unsigned i;
 
-          for (i = 1; i < char_width && p + i < 
-		 virtual_screen.text_buffer + virtual_screen.columns
-		 * virtual_screen.rows; i++)
+          for (i = 1; i < char_width
+		 && virtual_screen.cursor_x + i < virtual_screen.columns; i++)
 	      {
 		grub_unicode_destroy_glyph (&p[i].code);
 		p[i].code.base = 0;
@@ -962,17 +948,6 @@ calculate_normal_character_width (grub_font_t font)
   return width;
 }
 
-static unsigned char
-calculate_character_width (struct grub_font_glyph *glyph)
-{
-  if (! glyph || glyph->device_width == 0)
-    return 1;
-
-  return (glyph->device_width
-          + (virtual_screen.normal_char_width - 1))
-         / virtual_screen.normal_char_width;
-}
-
 static grub_size_t
 grub_gfxterm_getcharwidth (struct grub_term_output *term __attribute__ ((unused)),
 			   const struct grub_unicode_glyph *c)
@@ -1029,6 +1004,7 @@ grub_virtual_screen_cls (struct grub_term_output *term __attribute__ ((unused)))
   for (i = 0; i < virtual_screen.columns * virtual_screen.rows; i++)
     clear_char (&(virtual_screen.text_buffer[i]));
 
+  virtual_screen.first_row = 0;
   virtual_screen.cursor_x = virtual_screen.cursor_y = 0;
 }
 
@@ -1097,8 +1073,16 @@ grub_gfxterm_setcursor (struct grub_term_output *term __attribute__ ((unused)),
 static void
 grub_gfxterm_refresh (struct grub_term_output *term __attribute__ ((unused)))
 {
+  int scrolled = virtual_screen.total_scroll != 0;
+
   real_scroll ();
 
+  /* Nothing to show: don't swap.  Refreshes come after every bit of output
+     and would otherwise flip pages or wait for the framebuffer for no
+     reason, also under a graphical menu that is animating.  */
+  if (! scrolled && ! repaint_scheduled && dirty_region_is_empty ())
+    return;
+
   /* Redraw only changed regions.  */
   dirty_region_redraw ();
 
@@ -81,18 +81,26 @@ grub_gfxterm_background_image_cmd (grub_extcmd_context_t ctxt,
   /* If filename was provided, try to load that.  */
   if (argc >= 1)
     {
+      unsigned int width, height;
+      int stretch;
+
+      /* Determine if the bitmap should be scaled to fit the screen.  */
+      stretch = (!state[BACKGROUND_CMD_ARGINDEX_MODE].set
+		 || grub_strcmp (state[BACKGROUND_CMD_ARGINDEX_MODE].arg,
+				 "stretch") == 0);
+      grub_gfxterm_get_dimensions (&width, &height);
+
       /* Try to load new one.  */
-      grub_video_bitmap_load (&grub_gfxterm_background.bitmap, args[0]);
+      if (stretch)
+	grub_video_bitmap_load_scaled (&grub_gfxterm_background.bitmap,
+				       args[0], width, height);
+      else
+	grub_video_bitmap_load (&grub_gfxterm_background.bitmap, args[0]);
       if (grub_errno != GRUB_ERR_NONE)
         return grub_errno;
 
-      /* Determine if the bitmap should be scaled to fit the screen.  */
-      if (!state[BACKGROUND_CMD_ARGINDEX_MODE].set
-          || grub_strcmp (state[BACKGROUND_CMD_ARGINDEX_MODE].arg,
-                          "stretch") == 0)
+      if (stretch)
           {
-	    unsigned int width, height;
-	    grub_gfxterm_get_dimensions (&width, &height);
             if (width
 		!= grub_video_bitmap_get_width (grub_gfxterm_background.bitmap)
                 || height
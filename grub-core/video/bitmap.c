@@ -217,6 +217,42 @@ grub_video_bitmap_load (struct grub_video_bitmap **bitmap,
 			" unsupported format"), filename);
 }
 
+/* Loads bitmap that is going to be scaled down to MIN_WIDTH x MIN_HEIGHT
+   or larger.  Readers that can may return a smaller bitmap than the image,
+   which is cheaper to decode and to scale.  */
+grub_err_t
+grub_video_bitmap_load_scaled (struct grub_video_bitmap **bitmap,
+			       const char *filename,
+			       unsigned int min_width,
+			       unsigned int min_height)
+{
+  grub_video_bitmap_reader_t reader = bitmap_readers_list;
+
+  if (!bitmap)
+    return grub_error (GRUB_ERR_BUG, "invalid argument");
+
+  *bitmap = 0;
+
+  while (reader)
+    {
+      if (match_extension (filename, reader->extension))
+	{
+	  if (reader->reader_scaled && min_width && min_height)
+	    return reader->reader_scaled (bitmap, filename,
+					  min_width, min_height);
+	  return reader->reader (bitmap, filename);
+	}
+
+      reader = reader->next;
+    }
+
+  return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+		     /* TRANSLATORS: We're speaking about bitmap images like
+			JPEG or PNG.  */
+		     N_("bitmap file `%s' is of"
+			" unsupported format"), filename);
+}
+
 /* Return mode info for bitmap.  */
 void grub_video_bitmap_get_mode_info (struct grub_video_bitmap *bitmap,
                                       struct grub_video_mode_info *mode_info)
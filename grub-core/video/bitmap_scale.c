@@ -24,14 +24,34 @@
 #include <grub/bitmap_scale.h>
 #include <grub/types.h>
 #include <grub/dl.h>
+#include <grub/safemath.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
+/* Filter weights are fixed point numbers with this many fraction bits.  */
+#define SCALE_WEIGHT_BITS	14
+#define SCALE_WEIGHT_ONE	(1 << SCALE_WEIGHT_BITS)
+
+/* Horizontally scaled rows keep this many fraction bits.  */
+#define SCALE_ROW_BITS		8
+
+/* Filter along one axis of the bitmap.  Output sample D is the weighted
+   sum of COUNT[D] consecutive input samples, beginning with START[D].  The
+   weights of all output samples follow each other in WEIGHTS.  */
+struct scale_filter
+{
+  unsigned *start;
+  unsigned *count;
+  grub_uint16_t *weights;
+  unsigned max_count;
+};
+
 /* Prototypes for module-local functions.  */
 static grub_err_t scale_nn (struct grub_video_bitmap *dst,
                             struct grub_video_bitmap *src);
-static grub_err_t scale_bilinear (struct grub_video_bitmap *dst,
-                                  struct grub_video_bitmap *src);
+static grub_err_t scale_filtered (struct grub_video_bitmap *dst,
+                                  struct grub_video_bitmap *src,
+                                  int allow_area);
 
 static grub_err_t
 verify_source_bitmap (struct grub_video_bitmap *src)
@@ -66,8 +86,9 @@ grub_video_bitmap_scale (struct grub_video_bitmap *dst,
     case GRUB_VIDEO_BITMAP_SCALE_METHOD_NEAREST:
       return scale_nn (dst, src);
     case GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST:
+      return scale_filtered (dst, src, 1);
     case GRUB_VIDEO_BITMAP_SCALE_METHOD_BILINEAR:
-      return scale_bilinear (dst, src);
+      return scale_filtered (dst, src, 0);
     default:
       return grub_error (GRUB_ERR_BUG, "Invalid scale_method value");
     }
@@ -406,18 +427,183 @@ scale_nn (struct grub_video_bitmap *dst, struct grub_video_bitmap *src)
   return GRUB_ERR_NONE;
 }
 
-/* Bilinear interpolation image scaling algorithm.
+static void
+scale_filter_free (struct scale_filter *f)
+{
+  grub_free (f->start);
+  grub_free (f->count);
+  grub_free (f->weights);
+}
+
+/* Set up F for bilinear interpolation from SRC_LEN to DST_LEN samples.
+   Output sample D is taken from position D * SRC_LEN / DST_LEN, with 8
+   bits of fraction.  */
+static grub_err_t
+scale_filter_bilinear (struct scale_filter *f, unsigned src_len,
+		       unsigned dst_len)
+{
+  unsigned d, pos, frac, step, over;
+  grub_uint16_t *w;
+
+  f->max_count = 2;
+  f->start = grub_calloc (dst_len, sizeof (f->start[0]));
+  f->count = grub_calloc (dst_len, sizeof (f->count[0]));
+  f->weights = grub_calloc (dst_len, 2 * sizeof (f->weights[0]));
+  if (!f->start || !f->count || !f->weights)
+    return grub_errno;
+
+  step = (src_len << 8) / dst_len;
+  over = (src_len << 8) % dst_len;
+
+  w = f->weights;
+  for (d = 0, pos = 0, frac = 0; d < dst_len; d++, pos += step, frac += over)
+    {
+      unsigned u;
+
+      if (frac >= dst_len)
+	{
+	  frac -= dst_len;
+	  pos++;
+	}
+
+      f->start[d] = pos >> 8;
+      u = pos & 0xff;
+
+      /* Past the last sample there is nothing to interpolate with.  */
+      if (u == 0 || f->start[d] >= src_len - 1)
+	{
+	  f->count[d] = 1;
+	  *w++ = SCALE_WEIGHT_ONE;
+	}
+      else
+	{
+	  f->count[d] = 2;
+	  *w++ = (256 - u) << (SCALE_WEIGHT_BITS - 8);
+	  *w++ = u << (SCALE_WEIGHT_BITS - 8);
+	}
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+/* Set up F for an area average from SRC_LEN to DST_LEN samples, where
+   DST_LEN is smaller.  Output sample D covers the input interval
+   [D * SRC_LEN / DST_LEN, (D + 1) * SRC_LEN / DST_LEN) and every input
+   sample is weighted by how much of it lies in that interval.  */
+static grub_err_t
+scale_filter_area (struct scale_filter *f, unsigned src_len,
+		   unsigned dst_len)
+{
+  unsigned d, i;
+  grub_size_t total;
+  grub_uint16_t *w;
+
+  f->max_count = (src_len + dst_len - 1) / dst_len + 1;
+  if (grub_mul (dst_len, f->max_count, &total))
+    return grub_error (GRUB_ERR_OUT_OF_RANGE, N_("overflow is detected"));
+
+  f->start = grub_calloc (dst_len, sizeof (f->start[0]));
+  f->count = grub_calloc (dst_len, sizeof (f->count[0]));
+  f->weights = grub_calloc (total, sizeof (f->weights[0]));
+  if (!f->start || !f->count || !f->weights)
+    return grub_errno;
+
+  /* Interval ends are measured in units of 1 / DST_LEN input samples.  */
+  w = f->weights;
+  for (d = 0; d < dst_len; d++)
+    {
+      grub_uint64_t lo = (grub_uint64_t) d * src_len;
+      grub_uint64_t hi = lo + src_len;
+      unsigned sum = 0, largest = 0;
+      grub_uint16_t *first = w;
+
+      f->start[d] = lo / dst_len;
+      for (i = f->start[d]; (grub_uint64_t) i * dst_len < hi; i++)
+	{
+	  grub_uint64_t a = (grub_uint64_t) i * dst_len;
+	  grub_uint64_t b = a + dst_len;
+	  unsigned weight;
+
+	  if (a < lo)
+	    a = lo;
+	  if (b > hi)
+	    b = hi;
+	  weight = ((unsigned) (b - a) * SCALE_WEIGHT_ONE + src_len / 2)
+	    / src_len;
+	  if (weight > first[largest])
+	    largest = w - first;
+	  *w++ = weight;
+	  sum += weight;
+	}
+      f->count[d] = w - first;
+
+      /* Make the weights add up to exactly one.  */
+      first[largest] += SCALE_WEIGHT_ONE - sum;
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+/* Filter a row of the source bitmap horizontally into OUT.  */
+static void
+scale_row (grub_uint16_t *out, const grub_uint8_t *in,
+	   const struct scale_filter *f, unsigned dst_len,
+	   unsigned bytes_per_pixel)
+{
+  const grub_uint16_t *w = f->weights;
+  unsigned d, k, comp;
+
+  for (d = 0; d < dst_len; d++)
+    {
+      const grub_uint8_t *p = in + f->start[d] * bytes_per_pixel;
+      unsigned acc[4] = { 0, 0, 0, 0 };
+
+      if (f->count[d] == 1)
+	{
+	  for (comp = 0; comp < bytes_per_pixel; comp++)
+	    *out++ = p[comp] << SCALE_ROW_BITS;
+	  w++;
+	  continue;
+	}
+
+      if (f->count[d] == 2)
+	{
+	  unsigned w0 = w[0], w1 = w[1];
+
+	  for (comp = 0; comp < bytes_per_pixel; comp++)
+	    *out++ = (w0 * p[comp] + w1 * p[comp + bytes_per_pixel]
+		      + (1 << (SCALE_WEIGHT_BITS - SCALE_ROW_BITS - 1)))
+	      >> (SCALE_WEIGHT_BITS - SCALE_ROW_BITS);
+	  w += 2;
+	  continue;
+	}
+
+      for (k = 0; k < f->count[d]; k++, w++, p += bytes_per_pixel)
+	for (comp = 0; comp < bytes_per_pixel; comp++)
+	  acc[comp] += *w * p[comp];
+
+      for (comp = 0; comp < bytes_per_pixel; comp++)
+	*out++ = (acc[comp] + (1 << (SCALE_WEIGHT_BITS - SCALE_ROW_BITS - 1)))
+	  >> (SCALE_WEIGHT_BITS - SCALE_ROW_BITS);
+    }
+}
+
+/* Separable image scaling algorithm.
 
    Copy the bitmap SRC to the bitmap DST, scaling the bitmap to fit the
-   dimensions of DST.  This function uses the bilinear interpolation algorithm
-   to interpolate the pixels.
+   dimensions of DST.  Rows are first filtered horizontally and then
+   combined vertically, with fixed point weights.  Every source row is
+   filtered horizontally only once.  Along each axis bilinear
+   interpolation is used, or, if ALLOW_AREA is set and the axis shrinks to
+   half or less, an area average.
 
    Supports only direct color modes which have components separated
    into bytes (e.g., RGBA 8:8:8:8 or BGR 8:8:8 true color).
    But because of this simplifying assumption, the implementation is
    greatly simplified.  */
 static grub_err_t
-scale_bilinear (struct grub_video_bitmap *dst, struct grub_video_bitmap *src)
+scale_filtered (struct grub_video_bitmap *dst, struct grub_video_bitmap *src,
+		int allow_area)
 {
   grub_err_t err = verify_bitmaps(dst, src);
   if (err != GRUB_ERR_NONE)
@@ -432,84 +618,95 @@ scale_bilinear (struct grub_video_bitmap *dst, struct grub_video_bitmap *src)
   int dstride = dst->mode_info.pitch;
   int sstride = src->mode_info.pitch;
   /* bytes_per_pixel is the same for both src and dst. */
-  int bytes_per_pixel = dst->mode_info.bytes_per_pixel;
-  unsigned dy, syf, sy, ystep, yfrac, yover;
-  unsigned sxf, sx, xstep, xfrac, xover;
-  grub_uint8_t *dptr, *dline_end, *sline;
+  unsigned bytes_per_pixel = dst->mode_info.bytes_per_pixel;
+  unsigned row_len = dw * bytes_per_pixel;
+  struct scale_filter fx, fy;
+  grub_uint16_t *rows = 0;
+  const grub_uint16_t **r = 0;
+  unsigned *row_tag = 0;
+  const grub_uint16_t *wy;
+  unsigned dy, x, k, i;
+
+  if (bytes_per_pixel > 4)
+    return grub_error (GRUB_ERR_NOT_IMPLEMENTED_YET,
+		       "unsupported pixel size for scale");
 
-  xstep = (sw << 8) / dw;
-  xover = (sw << 8) % dw;
-  ystep = (sh << 8) / dh;
-  yover = (sh << 8) % dh;
+  grub_memset (&fx, 0, sizeof (fx));
+  grub_memset (&fy, 0, sizeof (fy));
 
-  for (dy = 0, syf = 0, yfrac = 0; dy < dh; dy++, syf += ystep, yfrac += yover)
+  if (allow_area && sw >= 2 * dw)
+    err = scale_filter_area (&fx, sw, dw);
+  else
+    err = scale_filter_bilinear (&fx, sw, dw);
+  if (err == GRUB_ERR_NONE)
     {
-      if (yfrac >= dh)
+      if (allow_area && sh >= 2 * dh)
+	err = scale_filter_area (&fy, sh, dh);
+      else
+	err = scale_filter_bilinear (&fy, sh, dh);
+    }
+  if (err != GRUB_ERR_NONE)
+    goto out;
+
+  /* Ring of horizontally filtered source rows.  Row SY is kept in slot
+     SY % fy.max_count, which is enough for the rows of one output row.  */
+  rows = grub_calloc (fy.max_count, row_len * sizeof (rows[0]));
+  row_tag = grub_calloc (fy.max_count, sizeof (row_tag[0]));
+  r = grub_calloc (fy.max_count, sizeof (r[0]));
+  if (!rows || !row_tag || !r)
+    {
+      err = grub_errno;
+      goto out;
+    }
+  for (i = 0; i < fy.max_count; i++)
+    row_tag[i] = ~0U;
+
+  wy = fy.weights;
+  for (dy = 0; dy < dh; dy++)
+    {
+      grub_uint8_t *dptr = ddata + dy * dstride;
+      unsigned n = fy.count[dy];
+
+      for (k = 0; k < n; k++)
 	{
-	  yfrac -= dh;
-	  syf++;
-	}
-      sy = syf >> 8;
-      dptr = ddata + dy * dstride;
-      dline_end = dptr + dw * bytes_per_pixel;
-      sline = sdata + sy * sstride;
-      for (sxf = 0, xfrac = 0; dptr < dline_end; sxf += xstep, xfrac += xover, dptr += bytes_per_pixel)
-        {
-          grub_uint8_t *sptr;
-          int comp;
+	  unsigned sy = fy.start[dy] + k;
+	  unsigned slot = sy % fy.max_count;
 
-	  if (xfrac >= dw)
+	  r[k] = rows + slot * row_len;
+	  if (row_tag[slot] != sy)
 	    {
-	      xfrac -= dw;
-	      sxf++;
+	      scale_row (rows + slot * row_len, sdata + sy * sstride, &fx,
+			 dw, bytes_per_pixel);
+	      row_tag[slot] = sy;
 	    }
+	}
 
-          /* Get the address of the pixels in src and dst. */
-	  sx = sxf >> 8;
-	  sptr = sline + sx * bytes_per_pixel;
+      if (n == 1)
+	for (x = 0; x < row_len; x++)
+	  dptr[x] = (r[0][x] + (1 << (SCALE_ROW_BITS - 1))) >> SCALE_ROW_BITS;
+      else if (n == 2)
+	for (x = 0; x < row_len; x++)
+	  dptr[x] = (wy[0] * r[0][x] + wy[1] * r[1][x]
+		     + (1 << (SCALE_WEIGHT_BITS + SCALE_ROW_BITS - 1)))
+	    >> (SCALE_WEIGHT_BITS + SCALE_ROW_BITS);
+      else
+	for (x = 0; x < row_len; x++)
+	  {
+	    unsigned acc = 1 << (SCALE_WEIGHT_BITS + SCALE_ROW_BITS - 1);
 
-          /* If we have enough space to do so, use bilinear interpolation.
-             Otherwise, fall back to nearest neighbor for this pixel. */
-          if (sx < sw - 1 && sy < sh - 1)
-            {
-              /* Do bilinear interpolation. */
-
-              /* Fixed-point .8 numbers representing the fraction of the
-                 distance in the x (u) and y (v) direction within the
-                 box of 4 pixels in the source. */
-              unsigned u = sxf & 0xff;
-              unsigned v = syf & 0xff;
-
-              for (comp = 0; comp < bytes_per_pixel; comp++)
-                {
-                  /* Get the component's values for the
-                     four source corner pixels. */
-                  unsigned f00 = sptr[comp];
-                  unsigned f10 = sptr[comp + bytes_per_pixel];
-                  unsigned f01 = sptr[comp + sstride];
-                  unsigned f11 = sptr[comp + sstride + bytes_per_pixel];
-
-                  /* Count coeffecients. */
-                  unsigned c00 = (256 - u) * (256 - v);
-                  unsigned c10 = u * (256 - v);
-                  unsigned c01 = (256 - u) * v;
-                  unsigned c11 = u * v;
-
-                  /* Interpolate. */
-                  unsigned fxy = c00 * f00 + c01 * f01 + c10 * f10 + c11 * f11;
-                  fxy = fxy >> 16;
-
-                  dptr[comp] = fxy;
-                }
-            }
-          else
-            {
-              /* Fall back to nearest neighbor interpolation. */
-              /* Copy the pixel color value. */
-              for (comp = 0; comp < bytes_per_pixel; comp++)
-                dptr[comp] = sptr[comp];
-            }
-        }
+	    for (k = 0; k < n; k++)
+	      acc += wy[k] * r[k][x];
+	    dptr[x] = acc >> (SCALE_WEIGHT_BITS + SCALE_ROW_BITS);
+	  }
+
+      wy += n;
     }
-  return GRUB_ERR_NONE;
+
+ out:
+  grub_free (rows);
+  grub_free (row_tag);
+  grub_free (r);
+  scale_filter_free (&fx);
+  scale_filter_free (&fy);
+  return err;
 }
@@ -34,6 +34,39 @@
 #include <grub/types.h>
 #include <grub/video.h>
 
+/* Swap the channels in bits 0-7 and 16-23 of a 32-bit pixel, converting
+   between RGBX and BGRX layouts.  The same swap works on both
+   endiannesses.  */
+static inline grub_uint32_t
+swap_red_blue (grub_uint32_t color)
+{
+  return (color & 0xff00ff00) | ((color & 0xff) << 16)
+    | ((color >> 16) & 0xff);
+}
+
+/* Same as alpha_dilute but on the two channels in bits 0-7 and 16-23 of
+   BG and FG at once.  Each 16-bit lane holds at most 255 * 255, so the
+   division by 255 is done exactly without crossing lanes.  */
+static inline grub_uint32_t
+alpha_dilute2 (grub_uint32_t bg, grub_uint32_t fg, unsigned int alpha)
+{
+  grub_uint32_t s;
+
+  s = (fg & 0x00ff00ff) * alpha + (bg & 0x00ff00ff) * (255 ^ alpha);
+  s += ((s >> 8) & 0x00ff00ff) + 0x00010001;
+  return (s >> 8) & 0x00ff00ff;
+}
+
+/* Blend FG over BG, both in the same 32-bit layout with the alpha in the
+   top byte.  The result carries ALPHA.  */
+static inline grub_uint32_t
+alpha_blend32 (grub_uint32_t bg, grub_uint32_t fg, unsigned int alpha)
+{
+  return alpha_dilute2 (bg, fg, alpha)
+    | ((alpha_dilute2 (bg >> 8, fg >> 8, alpha) & 0xff) << 8)
+    | (alpha << 24);
+}
+
 /* Generic replacing blitter (slow).  Works for every supported format.  */
 static void
 grub_video_fbblit_replace (struct grub_video_fbblit_info *dst,
@@ -769,8 +802,8 @@ grub_video_fbblit_replace_BGRX8888_RGBX8888 (struct grub_video_fbblit_info *dst,
 {
   int i;
   int j;
-  grub_uint8_t *srcptr;
-  grub_uint8_t *dstptr;
+  grub_uint32_t *srcptr;
+  grub_uint32_t *dstptr;
   unsigned int srcrowskip;
   unsigned int dstrowskip;
 
@@ -784,31 +817,12 @@ grub_video_fbblit_replace_BGRX8888_RGBX8888 (struct grub_video_fbblit_info *dst,
 
   for (j = 0; j < height; j++)
     {
+      /* Whole pixels at a time: only red and blue trade places.  */
       for (i = 0; i < width; i++)
-        {
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-          grub_uint8_t a = *srcptr++;
-#endif
-          grub_uint8_t r = *srcptr++;
-          grub_uint8_t g = *srcptr++;
-          grub_uint8_t b = *srcptr++;
-#ifndef GRUB_CPU_WORDS_BIGENDIAN
-          grub_uint8_t a = *srcptr++;
-#endif
+        *dstptr++ = swap_red_blue (*srcptr++);
 
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-          *dstptr++ = a;
-#endif
-          *dstptr++ = b;
-          *dstptr++ = g;
-          *dstptr++ = r;
-#ifndef GRUB_CPU_WORDS_BIGENDIAN
-          *dstptr++ = a;
-#endif
-        }
-
-      srcptr += srcrowskip;
-      dstptr += dstrowskip;
+      GRUB_VIDEO_FB_ADVANCE_POINTER (srcptr, srcrowskip);
+      GRUB_VIDEO_FB_ADVANCE_POINTER (dstptr, dstrowskip);
     }
 }
 
@@ -1245,13 +1259,7 @@ grub_video_fbblit_blend_BGRA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
       for (i = 0; i < width; i++)
         {
           grub_uint32_t color;
-          unsigned int sr;
-          unsigned int sg;
-          unsigned int sb;
           unsigned int a;
-          unsigned int dr;
-          unsigned int dg;
-          unsigned int db;
 
           color = *srcptr++;
 
@@ -1264,31 +1272,11 @@ grub_video_fbblit_blend_BGRA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
               continue;
             }
 
-          sr = (color >> 0) & 0xFF;
-          sg = (color >> 8) & 0xFF;
-          sb = (color >> 16) & 0xFF;
+          color = swap_red_blue (color);
 
-          if (a == 255)
-            {
-              /* Opaque pixel shortcut.  */
-              dr = sr;
-              dg = sg;
-              db = sb;
-            }
-          else
-            {
-              /* General pixel color blending.  */
-              color = *dstptr;
-
-              dr = (color >> 16) & 0xFF;
-              dr = alpha_dilute (dr, sr, a);
-              dg = (color >> 8) & 0xFF;
-              dg = alpha_dilute (dg, sg, a);
-              db = (color >> 0) & 0xFF;
-              db = alpha_dilute (db, sb, a);
-            }
-
-          color = (a << 24) | (dr << 16) | (dg << 8) | db;
+          /* General pixel color blending, opaque pixels are copied.  */
+          if (a != 255)
+            color = alpha_blend32 (*dstptr, color, a);
 
           *dstptr++ = color;
         }
@@ -1405,13 +1393,7 @@ grub_video_fbblit_blend_RGBA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
   int j;
   grub_uint32_t *srcptr;
   grub_uint32_t *dstptr;
-  unsigned int sr;
-  unsigned int sg;
-  unsigned int sb;
   unsigned int a;
-  unsigned int dr;
-  unsigned int dg;
-  unsigned int db;
   grub_size_t srcrowskip;
   grub_size_t dstrowskip;
 
@@ -1441,23 +1423,8 @@ grub_video_fbblit_blend_RGBA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
               continue;
             }
 
-          sr = (color >> 0) & 0xFF;
-          sg = (color >> 8) & 0xFF;
-          sb = (color >> 16) & 0xFF;
-
-          color = *dstptr;
-
-          dr = (color >> 0) & 0xFF;
-          dg = (color >> 8) & 0xFF;
-          db = (color >> 16) & 0xFF;
-
-          dr = alpha_dilute (dr, sr, a);
-          dg = alpha_dilute (dg, sg, a);
-          db = alpha_dilute (db, sb, a);
-
-          color = (a << 24) | (db << 16) | (dg << 8) | dr;
-
-          *dstptr++ = color;
+          *dstptr = alpha_blend32 (*dstptr, color, a);
+          dstptr++;
         }
       GRUB_VIDEO_FB_ADVANCE_POINTER (srcptr, srcrowskip);
       GRUB_VIDEO_FB_ADVANCE_POINTER (dstptr, dstrowskip);
@@ -2031,6 +1998,14 @@ grub_video_fb_dispatch_blit (struct grub_video_fbblit_info *target,
 	    }
 	  break;
 	case GRUB_VIDEO_BLIT_FORMAT_INDEXCOLOR_ALPHA:
+	  if (target->mode_info->blit_format
+	      == GRUB_VIDEO_BLIT_FORMAT_INDEXCOLOR_ALPHA)
+	    {
+	      grub_video_fbblit_replace_directN (target, source,
+						 x, y, width, height,
+						 offset_x, offset_y);
+	      return;
+	    }
 	  switch (target->mode_info->bytes_per_pixel)
 	    {
 	    case 4:
@@ -48,6 +48,10 @@ grub_video_fbfill (struct grub_video_fbblit_info *dst,
       set_pixel (dst, x + i, y + j, color);
 }
 
+#if GRUB_CPU_SIZEOF_VOID_P == 8
+typedef grub_uint64_t fill64_t __attribute__ ((may_alias));
+#endif
+
 /* Optimized filler for direct color 32 bit modes.  It is assumed that color
    is already mapped to destination format.  */
 static void
@@ -59,6 +63,9 @@ grub_video_fbfill_direct32 (struct grub_video_fbblit_info *dst,
   int j;
   grub_uint32_t *dstptr;
   grub_size_t rowskip;
+#if GRUB_CPU_SIZEOF_VOID_P == 8
+  grub_uint64_t color64;
+#endif
 
   /* Calculate the number of bytes to advance from the end of one line
      to the beginning of the next line.  */
@@ -69,9 +76,27 @@ grub_video_fbfill_direct32 (struct grub_video_fbblit_info *dst,
   /* Get the start address.  */
   dstptr = grub_video_fb_get_video_ptr (dst, x, y);
 
+#if GRUB_CPU_SIZEOF_VOID_P == 8
+  color64 = ((grub_uint64_t) color << 32) | color;
+#endif
+
   for (j = 0; j < height; j++)
     {
-      for (i = 0; i < width; i++)
+      i = width;
+#if GRUB_CPU_SIZEOF_VOID_P == 8
+      /* Store two pixels at a time once the pointer is 8-byte aligned.  */
+      if (i && ((grub_addr_t) dstptr & 7))
+	{
+	  *dstptr++ = color;
+	  i--;
+	}
+      for (; i >= 2; i -= 2)
+	{
+	  *(fill64_t *) dstptr = color64;
+	  dstptr += 2;
+	}
+#endif
+      for (; i > 0; i--)
         *dstptr++ = color;
 
       /* Advance the dest pointer to the right location on the next line.  */
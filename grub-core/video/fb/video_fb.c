@@ -32,10 +32,23 @@ GRUB_MOD_LICENSE ("GPLv3+");
 typedef grub_err_t (*grub_video_fb_doublebuf_update_screen_t) (void);
 typedef volatile void *framebuf_t;
 
+/* Maximum number of separate damaged rectangles tracked between swaps.
+   Further damage is merged into the closest existing rectangle.  */
+#define GRUB_VIDEO_FB_MAX_DIRTY 16
+
+/* Half-open rectangle [x1, x2) x [y1, y2).  */
+struct dirty_rect
+{
+  int x1;
+  int y1;
+  int x2;
+  int y2;
+};
+
 struct dirty
 {
-  int first_line;
-  int last_line;
+  unsigned int count;
+  struct dirty_rect rects[GRUB_VIDEO_FB_MAX_DIRTY];
 };
 
 static struct
@@ -830,15 +843,170 @@ grub_video_fb_unmap_color_int (struct grub_video_fbblit_info * source,
     }
 }
 
+typedef grub_addr_t fb_word_t __attribute__ ((may_alias));
+
+/* Move N bytes from SRC to DEST, which may overlap.  Unlike grub_memmove
+   this goes a machine word at a time when both are aligned alike, which
+   matters for whole frames and even more so for writes to video memory.  */
+static void
+fb_move (void *dest, const void *src, grub_size_t n)
+{
+  grub_uint8_t *d = dest;
+  const grub_uint8_t *s = src;
+
+  if (((grub_addr_t) d - (grub_addr_t) s) % sizeof (fb_word_t) != 0)
+    {
+      grub_memmove (dest, src, n);
+      return;
+    }
+
+  if (d <= s)
+    {
+      for (; n && (grub_addr_t) d % sizeof (fb_word_t); n--)
+	*d++ = *s++;
+      for (; n >= sizeof (fb_word_t); n -= sizeof (fb_word_t))
+	{
+	  *(fb_word_t *) d = *(const fb_word_t *) s;
+	  d += sizeof (fb_word_t);
+	  s += sizeof (fb_word_t);
+	}
+      for (; n; n--)
+	*d++ = *s++;
+    }
+  else
+    {
+      d += n;
+      s += n;
+      for (; n && (grub_addr_t) d % sizeof (fb_word_t); n--)
+	*--d = *--s;
+      for (; n >= sizeof (fb_word_t); n -= sizeof (fb_word_t))
+	{
+	  d -= sizeof (fb_word_t);
+	  s -= sizeof (fb_word_t);
+	  *(fb_word_t *) d = *(const fb_word_t *) s;
+	}
+      for (; n; n--)
+	*--d = *--s;
+    }
+}
+
+static inline int
+dirty_rect_touches (const struct dirty_rect *a, const struct dirty_rect *b)
+{
+  return a->x1 <= b->x2 && b->x1 <= a->x2 && a->y1 <= b->y2 && b->y1 <= a->y2;
+}
+
+static inline void
+dirty_rect_union (struct dirty_rect *a, const struct dirty_rect *b)
+{
+  if (a->x1 > b->x1)
+    a->x1 = b->x1;
+  if (a->y1 > b->y1)
+    a->y1 = b->y1;
+  if (a->x2 < b->x2)
+    a->x2 = b->x2;
+  if (a->y2 < b->y2)
+    a->y2 = b->y2;
+}
+
+static inline grub_uint64_t
+dirty_rect_area (const struct dirty_rect *r)
+{
+  return (grub_uint64_t) (r->x2 - r->x1) * (r->y2 - r->y1);
+}
+
+static void
+dirty_add (struct dirty *d, struct dirty_rect r)
+{
+  unsigned int i;
+  unsigned int best = 0;
+  grub_uint64_t best_growth = ~(grub_uint64_t) 0;
+
+  /* Swallow every rectangle the new one overlaps or touches.  As the
+     union may now reach others, rescan from the start.  */
+  for (i = 0; i < d->count; )
+    if (dirty_rect_touches (&r, &d->rects[i]))
+      {
+	dirty_rect_union (&r, &d->rects[i]);
+	d->rects[i] = d->rects[--d->count];
+	i = 0;
+      }
+    else
+      i++;
+
+  if (d->count < GRUB_VIDEO_FB_MAX_DIRTY)
+    {
+      d->rects[d->count++] = r;
+      return;
+    }
+
+  /* Out of slots: merge with the rectangle whose bounds grow least.  */
+  for (i = 0; i < d->count; i++)
+    {
+      struct dirty_rect u = d->rects[i];
+      grub_uint64_t growth;
+
+      dirty_rect_union (&u, &r);
+      growth = dirty_rect_area (&u) - dirty_rect_area (&d->rects[i]);
+      if (growth < best_growth)
+	{
+	  best_growth = growth;
+	  best = i;
+	}
+    }
+  dirty_rect_union (&d->rects[best], &r);
+}
+
 static void
-dirty (int y, int height)
+dirty (int x, int y, int width, int height)
 {
+  struct dirty_rect r;
+
   if (framebuffer.render_target != framebuffer.back_target)
     return;
-  if (framebuffer.current_dirty.first_line > y)
-    framebuffer.current_dirty.first_line = y;
-  if (framebuffer.current_dirty.last_line < y + height)
-    framebuffer.current_dirty.last_line = y + height;
+  if (width <= 0 || height <= 0)
+    return;
+
+  r.x1 = x;
+  r.y1 = y;
+  r.x2 = x + width;
+  r.y2 = y + height;
+  dirty_add (&framebuffer.current_dirty, r);
+}
+
+/* Copy the damaged parts of the back buffer to PAGE.  */
+static void
+dirty_flush (framebuf_t page, const struct dirty *d)
+{
+  struct grub_video_mode_info *mode_info = &framebuffer.back_target->mode_info;
+  grub_size_t pitch = mode_info->pitch;
+  unsigned int i;
+
+  for (i = 0; i < d->count; i++)
+    {
+      const struct dirty_rect *r = &d->rects[i];
+      grub_size_t offset, len;
+      int y;
+
+      /* Sub-byte pixels and full-width spans are copied as whole lines,
+	 in one go.  */
+      if (mode_info->bpp % 8 != 0
+	  || (r->x1 == 0 && r->x2 == (int) mode_info->width))
+	{
+	  offset = (grub_size_t) r->y1 * pitch;
+	  fb_move ((char *) page + offset,
+		   (char *) framebuffer.back_target->data + offset,
+		   (grub_size_t) (r->y2 - r->y1) * pitch);
+	  continue;
+	}
+
+      offset = (grub_size_t) r->y1 * pitch
+	+ (grub_size_t) r->x1 * mode_info->bytes_per_pixel;
+      len = (grub_size_t) (r->x2 - r->x1) * mode_info->bytes_per_pixel;
+      for (y = r->y1; y < r->y2; y++, offset += pitch)
+	fb_move ((char *) page + offset,
+		 (char *) framebuffer.back_target->data + offset, len);
+    }
 }
 
 grub_err_t
@@ -896,7 +1064,7 @@ grub_video_fb_fill_rect (grub_video_color_t color, int x, int y,
   x += area_x;
   y += area_y;
 
-  dirty (y, height);
+  dirty (x, y, width, height);
 
   /* Use fbblit_info to encapsulate rendering.  */
   target.mode_info = &framebuffer.render_target->mode_info;
@@ -1009,7 +1177,7 @@ grub_video_fb_blit_source (struct grub_video_fbblit_info *source,
   target.data = framebuffer.render_target->data;
 
   /* Do actual blitting.  */
-  dirty (y, height);
+  dirty (x, y, width, height);
   grub_video_fb_dispatch_blit (&target, source, oper, x, y, width, height,
                                offset_x, offset_y);
 
@@ -1061,7 +1229,9 @@ grub_video_fb_scroll (grub_video_color_t color, int dx, int dy)
   width = framebuffer.render_target->viewport.width - grub_abs (dx);
   height = framebuffer.render_target->viewport.height - grub_abs (dy);
 
-  dirty (framebuffer.render_target->viewport.y,
+  dirty (framebuffer.render_target->viewport.x,
+	 framebuffer.render_target->viewport.y,
+	 framebuffer.render_target->viewport.width,
 	 framebuffer.render_target->viewport.height);
 
   if (dx < 0)
@@ -1092,85 +1262,32 @@ grub_video_fb_scroll (grub_video_color_t color, int dx, int dy)
     {
       /* 3. Move data in render target.  */
       struct grub_video_fbblit_info target;
-      int i, j;
-      int linedelta, linelen;
+      grub_uint8_t *src, *dst;
+      grub_size_t pitch, linelen;
+      int j;
 
       target.mode_info = &framebuffer.render_target->mode_info;
       target.data = framebuffer.render_target->data;
 
-      linedelta = target.mode_info->pitch
-	- width * target.mode_info->bytes_per_pixel;
-      linelen = width * target.mode_info->bytes_per_pixel;
-#define DO_SCROLL                                                    \
-      /* Check vertical direction of the move.  */                   \
-      if (dy < 0 || (dy == 0 && dx < 0))                             \
-	{                                                            \
-	  dst = (void *) grub_video_fb_get_video_ptr (&target,       \
-						      dst_x, dst_y); \
-	  src = (void *) grub_video_fb_get_video_ptr (&target,	     \
-						      src_x, src_y); \
-	  /* 3a. Move data upwards.  */                              \
-	  for (j = 0; j < height; j++)                               \
-	    {                                                        \
-	      for (i = 0; i < linelen; i++)                          \
-		*(dst++) = *(src++);	                             \
-	      dst += linedelta;                                      \
-	      src += linedelta;                                      \
-	    }							     \
-	}                                                            \
-      else                                                           \
-	{                                                            \
-	  /* 3b. Move data downwards.  */                            \
-	  dst = (void *) grub_video_fb_get_video_ptr (&target,	     \
-					              dst_x + width, \
-					     dst_y + height - 1);    \
-	  src = (void *) grub_video_fb_get_video_ptr (&target,	     \
-					              src_x + width, \
-					     src_y + height - 1);    \
-	  dst--;                                                     \
-          src--;                                                     \
-	  for (j = 0; j < height; j++)                               \
-	    {                                                        \
-	      for (i = 0; i < linelen; i++)                          \
-		*(dst--) = *(src--);                                 \
-	      dst -= linedelta;                                      \
-	      src -= linedelta;                                      \
-	    }                                                        \
-	}
-
-      /* If everything is aligned on 32-bit use 32-bit copy.  */
-      if ((grub_addr_t) grub_video_fb_get_video_ptr (&target, src_x, src_y)
-	  % sizeof (grub_uint32_t) == 0
-	  && (grub_addr_t) grub_video_fb_get_video_ptr (&target, dst_x, dst_y) 
-	  % sizeof (grub_uint32_t) == 0
-	  && linelen % sizeof (grub_uint32_t) == 0
-	  && linedelta % sizeof (grub_uint32_t) == 0)
-	{
-	  grub_uint32_t *src, *dst;
-	  linelen /= sizeof (grub_uint32_t);
-	  linedelta /= sizeof (grub_uint32_t);
-	  DO_SCROLL
-	}
-      /* If everything is aligned on 16-bit use 16-bit copy.  */
-      else if ((grub_addr_t) grub_video_fb_get_video_ptr (&target, src_x, src_y)
-	       % sizeof (grub_uint16_t) == 0
-	       && (grub_addr_t) grub_video_fb_get_video_ptr (&target,
-							     dst_x, dst_y) 
-	       % sizeof (grub_uint16_t) == 0
-	       && linelen % sizeof (grub_uint16_t) == 0
-	       && linedelta % sizeof (grub_uint16_t) == 0)
-	{
-	  grub_uint16_t *src, *dst;
-	  linelen /= sizeof (grub_uint16_t);
-	  linedelta /= sizeof (grub_uint16_t);
-	  DO_SCROLL
-	}
-      /* If not aligned at all use 8-bit copy.  */
+      pitch = target.mode_info->pitch;
+      linelen = (grub_size_t) width * target.mode_info->bytes_per_pixel;
+      src = grub_video_fb_get_video_ptr (&target, src_x, src_y);
+      dst = grub_video_fb_get_video_ptr (&target, dst_x, dst_y);
+
+      /* Full lines are contiguous and move in one go.  Otherwise go line
+	 by line, starting at the end the data moves away from.  */
+      if (linelen == pitch)
+	fb_move (dst, src, linelen * height);
+      else if (dy < 0 || (dy == 0 && dx < 0))
+	for (j = 0; j < height; j++, dst += pitch, src += pitch)
+	  fb_move (dst, src, linelen);
       else
 	{
-	  grub_uint8_t *src, *dst;
-	  DO_SCROLL
-	}	
+	  dst += (grub_size_t) (height - 1) * pitch;
+	  src += (grub_size_t) (height - 1) * pitch;
+	  for (j = 0; j < height; j++, dst -= pitch, src -= pitch)
+	    fb_move (dst, src, linelen);
+	}
     }
 
   /* 4. Fill empty space with specified color.  In this implementation
@@ -1416,28 +1533,8 @@ grub_video_fb_get_active_render_target (struct grub_video_fbrender_target **targ
 static grub_err_t
 doublebuf_blit_update_screen (void)
 {
-  if (framebuffer.current_dirty.first_line
-      <= framebuffer.current_dirty.last_line)
-    {
-      grub_size_t copy_size;
-
-      if (grub_sub (framebuffer.current_dirty.last_line,
-		    framebuffer.current_dirty.first_line, &copy_size) ||
-	  grub_mul (framebuffer.back_target->mode_info.pitch, copy_size, &copy_size))
-	{
-	  /* Shouldn't happen, but if it does we've a bug. */
-	  return GRUB_ERR_BUG;
-	}
-
-      grub_memcpy ((char *) framebuffer.pages[0] + framebuffer.current_dirty.first_line *
-		   framebuffer.back_target->mode_info.pitch,
-		   (char *) framebuffer.back_target->data + framebuffer.current_dirty.first_line *
-		   framebuffer.back_target->mode_info.pitch,
-		   copy_size);
-    }
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  dirty_flush (framebuffer.pages[0], &framebuffer.current_dirty);
+  framebuffer.current_dirty.count = 0;
 
   return GRUB_ERR_NONE;
 }
@@ -1470,8 +1567,7 @@ grub_video_fb_doublebuf_blit_init (struct grub_video_fbrender_target **back,
   framebuffer.pages[0] = framebuf;
   framebuffer.displayed_page = 0;
   framebuffer.render_page = 0;
-  framebuffer.current_dirty.first_line = mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  framebuffer.current_dirty.count = 0;
 
   return GRUB_ERR_NONE;
 }
@@ -1481,37 +1577,19 @@ doublebuf_pageflipping_update_screen (void)
 {
   int new_displayed_page;
   grub_err_t err;
-  int first_line, last_line;
-
-  first_line = framebuffer.current_dirty.first_line;
-  last_line = framebuffer.current_dirty.last_line;
-  if (first_line > framebuffer.previous_dirty.first_line)
-    first_line = framebuffer.previous_dirty.first_line;
-  if (last_line < framebuffer.previous_dirty.last_line)
-    last_line = framebuffer.previous_dirty.last_line;
-
-  if (first_line <= last_line)
-    {
-      grub_size_t copy_size;
+  struct dirty combined;
+  unsigned int i;
 
-      if (grub_sub (last_line, first_line, &copy_size) ||
-	  grub_mul (framebuffer.back_target->mode_info.pitch, copy_size, &copy_size))
-	{
-	  /* Shouldn't happen, but if it does we've a bug. */
-	  return GRUB_ERR_BUG;
-	}
+  /* The render page also misses whatever was drawn for the page that is
+     being displayed now.  */
+  combined = framebuffer.current_dirty;
+  for (i = 0; i < framebuffer.previous_dirty.count; i++)
+    dirty_add (&combined, framebuffer.previous_dirty.rects[i]);
 
-      grub_memcpy ((char *) framebuffer.pages[framebuffer.render_page] + first_line *
-		   framebuffer.back_target->mode_info.pitch,
-		   (char *) framebuffer.back_target->data + first_line *
-		   framebuffer.back_target->mode_info.pitch,
-		   copy_size);
-    }
+  dirty_flush (framebuffer.pages[framebuffer.render_page], &combined);
 
   framebuffer.previous_dirty = framebuffer.current_dirty;
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  framebuffer.current_dirty.count = 0;
 
   /* Swap the page numbers in the framebuffer struct.  */
   new_displayed_page = framebuffer.render_page;
@@ -1570,12 +1648,8 @@ doublebuf_pageflipping_init (struct grub_video_mode_info *mode_info,
   framebuffer.pages[0] = page0_ptr;
   framebuffer.pages[1] = page1_ptr;
 
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
-  framebuffer.previous_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.previous_dirty.last_line = 0;
+  framebuffer.current_dirty.count = 0;
+  framebuffer.previous_dirty.count = 0;
 
   /* Set the framebuffer memory data pointer and display the right page.  */
   err = set_page_in (framebuffer.displayed_page);
@@ -1661,9 +1735,7 @@ grub_video_fb_setup (unsigned int mode_type, unsigned int mode_mask,
   framebuffer.displayed_page = 0;
   framebuffer.render_page = 0;
   framebuffer.set_page = 0;
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  framebuffer.current_dirty.count = 0;
 
   mode_info->mode_type &= ~GRUB_VIDEO_MODE_TYPE_DOUBLE_BUFFERED;
 
@@ -23,12 +23,10 @@
 #include <grub/mm.h>
 #include <grub/misc.h>
 #include <grub/bufio.h>
+#include <grub/time.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
-/* Uncomment following define to enable JPEG debug.  */
-//#define JPEG_DEBUG
-
 #define JPEG_ESC_CHAR		0xFF
 
 #define JPEG_SAMPLING_1x1	0x11
@@ -55,8 +53,31 @@ enum
 #define SHIFT_BITS		8
 #define CONST(x)		((int) ((x) * (1L << SHIFT_BITS) + 0.5))
 
+/* Colour conversion uses more precision than the IDCT.  */
+#define YCC_SHIFT_BITS		16
+#define YCC_CONST(x)		((int) ((x) * (1L << YCC_SHIFT_BITS) + 0.5))
+
+/* Fraction bits the prescaled quantization tables add to the coefficients.  */
+#define PASS1_BITS		6
+
 #define JPEG_UNIT_SIZE		8
 
+/* Entropy coded data is read in chunks of this size.  */
+#define JPEG_INBUF_SIZE		512
+
+/* Huffman codes up to this many bits long are decoded with one lookup.  */
+#define JPEG_HUFF_LOOKAHEAD	8
+
+#ifdef GRUB_CPU_WORDS_BIGENDIAN
+#define R3 2
+#define G3 1
+#define B3 0
+#else
+#define R3 0
+#define G3 1
+#define B3 2
+#endif
+
 static const grub_uint8_t jpeg_zigzag_order[64] = {
   0, 1, 8, 16, 9, 2, 3, 10,
   17, 24, 32, 25, 18, 11, 4, 5,
@@ -68,9 +89,25 @@ static const grub_uint8_t jpeg_zigzag_order[64] = {
   53, 60, 61, 54, 47, 55, 62, 63
 };
 
-#ifdef JPEG_DEBUG
+/* AAN IDCT scale factors, in natural order and scaled by 2^14.  */
+static const grub_uint16_t jpeg_aan_scales[64] = {
+  16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+  22725, 31521, 29692, 26722, 22725, 17855, 12299, 6270,
+  21407, 29692, 27969, 25172, 21407, 16819, 11585, 5906,
+  19266, 26722, 25172, 22654, 19266, 15137, 10426, 5315,
+  16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+  12873, 17855, 16819, 15137, 12873, 10114, 6967, 3552,
+  8867, 12299, 11585, 10426, 8867, 6967, 4799, 2446,
+  4520, 6270, 5906, 5315, 4520, 3552, 2446, 1247
+};
+
+/* Chroma contributions to the RGB components, indexed by Cb or Cr.  */
+static int jpeg_cr_r[256];
+static int jpeg_cb_b[256];
+static int jpeg_cr_g[256];
+static int jpeg_cb_g[256];
+
 static grub_command_t cmd;
-#endif
 
 typedef int jpeg_data_unit_t[64];
 
@@ -86,23 +123,43 @@ struct grub_jpeg_data
   grub_uint8_t *huff_value[4];
   int huff_offset[4][16];
   int huff_maxval[4][16];
+  /* (length << 8) | value of the code each JPEG_HUFF_LOOKAHEAD bit prefix
+     starts with, or 0 if that code is longer.  */
+  grub_uint16_t huff_lookup[4][1 << JPEG_HUFF_LOOKAHEAD];
 
   grub_uint8_t quan_table[2][64];
+  /* Quantization tables in zigzag order, prescaled for the AAN IDCT.  */
+  int idct_quan[2][64];
   int comp_index[3][3];
 
-  jpeg_data_unit_t ydu[4];
-  jpeg_data_unit_t crdu;
-  jpeg_data_unit_t cbdu;
+  jpeg_data_unit_t coef;
+  /* Samples of the current MCU.  Luma rows are 16 bytes apart, chroma
+     rows 8 bytes.  */
+  grub_uint8_t ydu[16 * 16];
+  grub_uint8_t crdu[64];
+  grub_uint8_t cbdu[64];
 
   unsigned log_vs, log_hs;
   int dri;
-  unsigned r1;
+  /* Position of the next MCU.  */
+  unsigned r1, c1;
+
+  /* Bitmap must not be smaller than this; 0 if the full size is wanted.  */
+  unsigned min_width, min_height;
+  /* Decode only the DC coefficients, at 1/8 of the size.  */
+  int dc_only;
 
   int dc_value[3];
 
   int color_components;
 
-  int bit_mask, bit_save;
+  /* Entropy coded data, most significant bit first.  */
+  grub_uint32_t bit_buf;
+  int bit_count;
+  int marker_hit;
+
+  grub_uint8_t inbuf[JPEG_INBUF_SIZE];
+  grub_uint8_t *in_ptr, *in_end;
 };
 
 static grub_uint8_t
@@ -127,43 +184,91 @@ grub_jpeg_get_word (struct grub_jpeg_data *data)
   return grub_be_to_cpu16 (r);
 }
 
-static int
-grub_jpeg_get_bit (struct grub_jpeg_data *data)
+/* Return the next byte of entropy coded data, or 0 at the end of file.  */
+static grub_uint8_t
+grub_jpeg_get_data_byte (struct grub_jpeg_data *data)
 {
-  int ret;
+  if (data->in_ptr == data->in_end)
+    {
+      grub_ssize_t len;
+
+      len = grub_file_read (data->file, data->inbuf, sizeof (data->inbuf));
+      if (len <= 0)
+	return 0;
+      data->in_ptr = data->inbuf;
+      data->in_end = data->inbuf + len;
+    }
+
+  return *data->in_ptr++;
+}
+
+/* Give back input that was read ahead, so the file is positioned at the
+   first byte the bit reader has not consumed.  */
+static void
+grub_jpeg_unread_data (struct grub_jpeg_data *data, grub_off_t extra)
+{
+  grub_file_seek (data->file, data->file->offset
+		  - (data->in_end - data->in_ptr) - extra);
+  data->in_ptr = data->in_end = data->inbuf;
+}
 
-  if (data->bit_mask == 0)
+/* Top up the bit buffer to at least 25 bits.  A marker ends the entropy
+   coded segment: it is left in the file for grub_jpeg_decode_jpeg and zero
+   bits are returned from then on.  */
+static void
+grub_jpeg_fill_bits (struct grub_jpeg_data *data)
+{
+  while (data->bit_count <= 24)
     {
-      data->bit_save = grub_jpeg_get_byte (data);
-      if (data->bit_save == JPEG_ESC_CHAR)
+      grub_uint32_t c = 0;
+
+      if (!data->marker_hit)
 	{
-	  if (grub_jpeg_get_byte (data) != 0)
+	  c = grub_jpeg_get_data_byte (data);
+	  if (c == JPEG_ESC_CHAR && grub_jpeg_get_data_byte (data) != 0)
 	    {
-	      grub_error (GRUB_ERR_BAD_FILE_TYPE,
-			  "jpeg: invalid 0xFF in data stream");
-	      return 0;
+	      grub_jpeg_unread_data (data, 2);
+	      data->marker_hit = 1;
+	      c = 0;
 	    }
 	}
-      data->bit_mask = 0x80;
+
+      data->bit_buf |= c << (24 - data->bit_count);
+      data->bit_count += 8;
     }
+}
+
+/* Read NUM bits, 1 <= NUM <= 16.  */
+static int
+grub_jpeg_get_bits (struct grub_jpeg_data *data, int num)
+{
+  int ret;
 
-  ret = ((data->bit_save & data->bit_mask) != 0);
-  data->bit_mask >>= 1;
+  if (data->bit_count < num)
+    grub_jpeg_fill_bits (data);
+
+  ret = data->bit_buf >> (32 - num);
+  data->bit_buf <<= num;
+  data->bit_count -= num;
   return ret;
 }
 
 static int
 grub_jpeg_get_number (struct grub_jpeg_data *data, int num)
 {
-  int value, i, msb;
+  int value;
 
   if (num == 0)
     return 0;
 
-  msb = value = grub_jpeg_get_bit (data);
-  for (i = 1; i < num; i++)
-    value = (value << 1) + (grub_jpeg_get_bit (data) != 0);
-  if (!msb)
+  if (num > 16)
+    {
+      grub_error (GRUB_ERR_BAD_FILE_TYPE, "jpeg: invalid coefficient size");
+      return 0;
+    }
+
+  value = grub_jpeg_get_bits (data, num);
+  if (value < (1 << (num - 1)))
     value += 1 - (1 << num);
 
   return value;
@@ -172,17 +277,29 @@ grub_jpeg_get_number (struct grub_jpeg_data *data, int num)
 static int
 grub_jpeg_get_huff_code (struct grub_jpeg_data *data, int id)
 {
-  int code;
+  unsigned code, entry;
   unsigned i;
 
-  code = 0;
-  for (i = 0; i < ARRAY_SIZE (data->huff_maxval[id]); i++)
+  if (data->bit_count < 16)
+    grub_jpeg_fill_bits (data);
+
+  entry = data->huff_lookup[id][data->bit_buf >> (32 - JPEG_HUFF_LOOKAHEAD)];
+  if (entry)
+    {
+      data->bit_buf <<= entry >> 8;
+      data->bit_count -= entry >> 8;
+      return entry & 0xff;
+    }
+
+  for (i = JPEG_HUFF_LOOKAHEAD; i < ARRAY_SIZE (data->huff_maxval[id]); i++)
     {
-      code <<= 1;
-      if (grub_jpeg_get_bit (data))
-	code++;
-      if (code < data->huff_maxval[id][i])
-	return data->huff_value[id][code + data->huff_offset[id][i]];
+      code = data->bit_buf >> (31 - i);
+      if ((int) code < data->huff_maxval[id][i])
+	{
+	  data->bit_buf <<= i + 1;
+	  data->bit_count -= i + 1;
+	  return data->huff_value[id][code + data->huff_offset[id][i]];
+	}
     }
   grub_error (GRUB_ERR_BAD_FILE_TYPE, "jpeg: huffman decode fails");
   return 0;
@@ -194,7 +311,7 @@ grub_jpeg_decode_huff_table (struct grub_jpeg_data *data)
   int id, ac, n, base, ofs;
   grub_uint32_t next_marker;
   grub_uint8_t count[16];
-  unsigned i;
+  unsigned i, j, k, code;
 
   next_marker = data->file->offset;
   next_marker += grub_jpeg_get_word (data);
@@ -217,6 +334,7 @@ grub_jpeg_decode_huff_table (struct grub_jpeg_data *data)
 	n += count[i];
 
       id += ac * 2;
+      grub_free (data->huff_value[id]);
       data->huff_value[id] = grub_malloc (n);
       if (grub_errno)
 	return grub_errno;
@@ -236,6 +354,24 @@ grub_jpeg_decode_huff_table (struct grub_jpeg_data *data)
 
 	  base <<= 1;
 	}
+
+      grub_memset (data->huff_lookup[id], 0, sizeof (data->huff_lookup[id]));
+      code = 0;
+      k = 0;
+      for (i = 0; i < JPEG_HUFF_LOOKAHEAD; i++, code <<= 1)
+	for (j = 0; j < count[i]; j++, k++, code++)
+	  {
+	    unsigned shift = JPEG_HUFF_LOOKAHEAD - 1 - i;
+	    unsigned p;
+
+	    if (code >= (1U << (i + 1)))
+	      return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+				 "jpeg: invalid huffman table");
+
+	    for (p = code << shift; p < (code + 1) << shift; p++)
+	      data->huff_lookup[id][p] = ((i + 1) << 8)
+		| data->huff_value[id][k];
+	  }
     }
 
   if (data->file->offset != next_marker)
@@ -248,6 +384,7 @@ static grub_err_t
 grub_jpeg_decode_quan_table (struct grub_jpeg_data *data)
 {
   int id;
+  unsigned i;
   grub_uint32_t next_marker;
 
   next_marker = data->file->offset;
@@ -276,6 +413,11 @@ grub_jpeg_decode_quan_table (struct grub_jpeg_data *data)
 	  != sizeof (data->quan_table[id]))
 	return grub_errno;
 
+      for (i = 0; i < ARRAY_SIZE (data->idct_quan[id]); i++)
+	data->idct_quan[id][i] = (data->quan_table[id][i]
+				  * jpeg_aan_scales[jpeg_zigzag_order[i]]
+				  + (1 << (13 - PASS1_BITS)))
+	  >> (14 - PASS1_BITS);
     }
 
   if (data->file->offset != next_marker)
@@ -358,8 +500,20 @@ grub_jpeg_decode_dri (struct grub_jpeg_data *data)
   return grub_errno;
 }
 
+static inline grub_uint8_t
+grub_jpeg_clamp (int v)
+{
+  if ((unsigned) v > 255)
+    return v < 0 ? 0 : 255;
+  return v;
+}
+
+/* Integer version of the AAN IDCT.  The quantization tables carry the
+   AAN scale factors, so each 1-D pass needs only 5 multiplications.  The
+   result is level shifted and stored as samples, STRIDE bytes apart.  */
 static void
-grub_jpeg_idct_transform (jpeg_data_unit_t du)
+grub_jpeg_idct_transform (jpeg_data_unit_t du, grub_uint8_t *out,
+			  unsigned stride)
 {
   int *pd;
   int i;
@@ -374,8 +528,6 @@ grub_jpeg_idct_transform (jpeg_data_unit_t du)
 	   pd[JPEG_UNIT_SIZE * 5] | pd[JPEG_UNIT_SIZE * 6] |
 	   pd[JPEG_UNIT_SIZE * 7]) == 0)
 	{
-	  pd[JPEG_UNIT_SIZE * 0] <<= SHIFT_BITS;
-
 	  pd[JPEG_UNIT_SIZE * 1] = pd[JPEG_UNIT_SIZE * 2]
 	    = pd[JPEG_UNIT_SIZE * 3] = pd[JPEG_UNIT_SIZE * 4]
 	    = pd[JPEG_UNIT_SIZE * 5] = pd[JPEG_UNIT_SIZE * 6]
@@ -384,44 +536,29 @@ grub_jpeg_idct_transform (jpeg_data_unit_t du)
 	  continue;
 	}
 
-      t0 = pd[JPEG_UNIT_SIZE * 0];
-      t1 = pd[JPEG_UNIT_SIZE * 2];
-      t2 = pd[JPEG_UNIT_SIZE * 4];
-      t3 = pd[JPEG_UNIT_SIZE * 6];
-
-      v4 = (t1 + t3) * CONST (0.541196100);
-
-      v0 = ((t0 + t2) << SHIFT_BITS);
-      v1 = ((t0 - t2) << SHIFT_BITS);
-      v2 = v4 - t3 * CONST (1.847759065);
-      v3 = v4 + t1 * CONST (0.765366865);
+      /* Even part.  */
+      v0 = pd[JPEG_UNIT_SIZE * 0] + pd[JPEG_UNIT_SIZE * 4];
+      v1 = pd[JPEG_UNIT_SIZE * 0] - pd[JPEG_UNIT_SIZE * 4];
+      v3 = pd[JPEG_UNIT_SIZE * 2] + pd[JPEG_UNIT_SIZE * 6];
+      v2 = (((pd[JPEG_UNIT_SIZE * 2] - pd[JPEG_UNIT_SIZE * 6])
+	     * CONST (1.414213562)) >> SHIFT_BITS) - v3;
 
       t0 = v0 + v3;
       t3 = v0 - v3;
       t1 = v1 + v2;
       t2 = v1 - v2;
 
-      t4 = pd[JPEG_UNIT_SIZE * 7];
-      t5 = pd[JPEG_UNIT_SIZE * 5];
-      t6 = pd[JPEG_UNIT_SIZE * 3];
-      t7 = pd[JPEG_UNIT_SIZE * 1];
-
-      v0 = t4 + t7;
-      v1 = t5 + t6;
-      v2 = t4 + t6;
-      v3 = t5 + t7;
-
-      v4 = (v2 + v3) * CONST (1.175875602);
-
-      v0 *= CONST (0.899976223);
-      v1 *= CONST (2.562915447);
-      v2 = v2 * CONST (1.961570560) - v4;
-      v3 = v3 * CONST (0.390180644) - v4;
+      /* Odd part.  */
+      v0 = pd[JPEG_UNIT_SIZE * 5] + pd[JPEG_UNIT_SIZE * 3];
+      v1 = pd[JPEG_UNIT_SIZE * 5] - pd[JPEG_UNIT_SIZE * 3];
+      v2 = pd[JPEG_UNIT_SIZE * 1] + pd[JPEG_UNIT_SIZE * 7];
+      v3 = pd[JPEG_UNIT_SIZE * 1] - pd[JPEG_UNIT_SIZE * 7];
 
-      t4 = t4 * CONST (0.298631336) - v0 - v2;
-      t5 = t5 * CONST (2.053119869) - v1 - v3;
-      t6 = t6 * CONST (3.072711026) - v1 - v2;
-      t7 = t7 * CONST (1.501321110) - v0 - v3;
+      t7 = v2 + v0;
+      v4 = ((v1 + v3) * CONST (1.847759065)) >> SHIFT_BITS;
+      t6 = ((v1 * -CONST (2.613125930)) >> SHIFT_BITS) + v4 - t7;
+      t5 = (((v2 - v0) * CONST (1.414213562)) >> SHIFT_BITS) - t6;
+      t4 = ((v3 * CONST (1.082392200)) >> SHIFT_BITS) - v4 + t5;
 
       pd[JPEG_UNIT_SIZE * 0] = t0 + t7;
       pd[JPEG_UNIT_SIZE * 7] = t0 - t7;
@@ -429,93 +566,101 @@ grub_jpeg_idct_transform (jpeg_data_unit_t du)
       pd[JPEG_UNIT_SIZE * 6] = t1 - t6;
       pd[JPEG_UNIT_SIZE * 2] = t2 + t5;
       pd[JPEG_UNIT_SIZE * 5] = t2 - t5;
-      pd[JPEG_UNIT_SIZE * 3] = t3 + t4;
-      pd[JPEG_UNIT_SIZE * 4] = t3 - t4;
+      pd[JPEG_UNIT_SIZE * 4] = t3 + t4;
+      pd[JPEG_UNIT_SIZE * 3] = t3 - t4;
     }
 
   pd = du;
-  for (i = 0; i < JPEG_UNIT_SIZE; i++, pd += JPEG_UNIT_SIZE)
+  for (i = 0; i < JPEG_UNIT_SIZE; i++, pd += JPEG_UNIT_SIZE, out += stride)
     {
+      /* Level shift and rounding of all eight outputs.  */
+      pd[0] += (128 << (PASS1_BITS + 3)) + (1 << (PASS1_BITS + 2));
+
       if ((pd[1] | pd[2] | pd[3] | pd[4] | pd[5] | pd[6] | pd[7]) == 0)
 	{
-	  pd[0] >>= (SHIFT_BITS + 3);
-	  pd[1] = pd[2] = pd[3] = pd[4] = pd[5] = pd[6] = pd[7] = pd[0];
+	  grub_memset (out, grub_jpeg_clamp (pd[0] >> (PASS1_BITS + 3)),
+		       JPEG_UNIT_SIZE);
 	  continue;
 	}
 
-      v4 = (pd[2] + pd[6]) * CONST (0.541196100);
-
-      v0 = (pd[0] + pd[4]) << SHIFT_BITS;
-      v1 = (pd[0] - pd[4]) << SHIFT_BITS;
-      v2 = v4 - pd[6] * CONST (1.847759065);
-      v3 = v4 + pd[2] * CONST (0.765366865);
+      v0 = pd[0] + pd[4];
+      v1 = pd[0] - pd[4];
+      v3 = pd[2] + pd[6];
+      v2 = (((pd[2] - pd[6]) * CONST (1.414213562)) >> SHIFT_BITS) - v3;
 
       t0 = v0 + v3;
       t3 = v0 - v3;
       t1 = v1 + v2;
       t2 = v1 - v2;
 
-      t4 = pd[7];
-      t5 = pd[5];
-      t6 = pd[3];
-      t7 = pd[1];
-
-      v0 = t4 + t7;
-      v1 = t5 + t6;
-      v2 = t4 + t6;
-      v3 = t5 + t7;
-
-      v4 = (v2 + v3) * CONST (1.175875602);
-
-      v0 *= CONST (0.899976223);
-      v1 *= CONST (2.562915447);
-      v2 = v2 * CONST (1.961570560) - v4;
-      v3 = v3 * CONST (0.390180644) - v4;
-
-      t4 = t4 * CONST (0.298631336) - v0 - v2;
-      t5 = t5 * CONST (2.053119869) - v1 - v3;
-      t6 = t6 * CONST (3.072711026) - v1 - v2;
-      t7 = t7 * CONST (1.501321110) - v0 - v3;
-
-      pd[0] = (t0 + t7) >> (SHIFT_BITS * 2 + 3);
-      pd[7] = (t0 - t7) >> (SHIFT_BITS * 2 + 3);
-      pd[1] = (t1 + t6) >> (SHIFT_BITS * 2 + 3);
-      pd[6] = (t1 - t6) >> (SHIFT_BITS * 2 + 3);
-      pd[2] = (t2 + t5) >> (SHIFT_BITS * 2 + 3);
-      pd[5] = (t2 - t5) >> (SHIFT_BITS * 2 + 3);
-      pd[3] = (t3 + t4) >> (SHIFT_BITS * 2 + 3);
-      pd[4] = (t3 - t4) >> (SHIFT_BITS * 2 + 3);
-    }
-
-  for (i = 0; i < JPEG_UNIT_SIZE * JPEG_UNIT_SIZE; i++)
-    {
-      du[i] += 128;
-
-      if (du[i] < 0)
-	du[i] = 0;
-      if (du[i] > 255)
-	du[i] = 255;
+      v0 = pd[5] + pd[3];
+      v1 = pd[5] - pd[3];
+      v2 = pd[1] + pd[7];
+      v3 = pd[1] - pd[7];
+
+      t7 = v2 + v0;
+      v4 = ((v1 + v3) * CONST (1.847759065)) >> SHIFT_BITS;
+      t6 = ((v1 * -CONST (2.613125930)) >> SHIFT_BITS) + v4 - t7;
+      t5 = (((v2 - v0) * CONST (1.414213562)) >> SHIFT_BITS) - t6;
+      t4 = ((v3 * CONST (1.082392200)) >> SHIFT_BITS) - v4 + t5;
+
+      out[0] = grub_jpeg_clamp ((t0 + t7) >> (PASS1_BITS + 3));
+      out[7] = grub_jpeg_clamp ((t0 - t7) >> (PASS1_BITS + 3));
+      out[1] = grub_jpeg_clamp ((t1 + t6) >> (PASS1_BITS + 3));
+      out[6] = grub_jpeg_clamp ((t1 - t6) >> (PASS1_BITS + 3));
+      out[2] = grub_jpeg_clamp ((t2 + t5) >> (PASS1_BITS + 3));
+      out[5] = grub_jpeg_clamp ((t2 - t5) >> (PASS1_BITS + 3));
+      out[4] = grub_jpeg_clamp ((t3 + t4) >> (PASS1_BITS + 3));
+      out[3] = grub_jpeg_clamp ((t3 - t4) >> (PASS1_BITS + 3));
     }
 }
 
+/* Decode one data unit of component ID into samples STRIDE bytes apart.
+   In DC only mode a single sample, the average of the unit, is stored.  */
 static void
-grub_jpeg_decode_du (struct grub_jpeg_data *data, int id, jpeg_data_unit_t du)
+grub_jpeg_decode_du (struct grub_jpeg_data *data, int id, grub_uint8_t *out,
+		     unsigned stride)
 {
   int h1, h2, qt;
   unsigned pos;
-
-  grub_memset (du, 0, sizeof (jpeg_data_unit_t));
+  int *du = data->coef;
+  const int *quan;
 
   qt = data->comp_index[id][0];
   h1 = data->comp_index[id][1];
   h2 = data->comp_index[id][2];
+  quan = data->idct_quan[qt];
 
   data->dc_value[id] +=
     grub_jpeg_get_number (data, grub_jpeg_get_huff_code (data, h1));
 
-  du[0] = data->dc_value[id] * (int) data->quan_table[qt][0];
+  if (data->dc_only)
+    {
+      /* Skip the AC coefficients.  */
+      for (pos = 1; pos < ARRAY_SIZE (jpeg_zigzag_order); pos++)
+	{
+	  int num;
+
+	  num = grub_jpeg_get_huff_code (data, h2);
+	  if (!num)
+	    break;
+
+	  if (num & 0xF)
+	    grub_jpeg_get_bits (data, num & 0xF);
+	  pos += num >> 4;
+	}
+
+      *out = grub_jpeg_clamp ((data->dc_value[id] * quan[0]
+			       + (128 << (PASS1_BITS + 3))
+			       + (1 << (PASS1_BITS + 2))) >> (PASS1_BITS + 3));
+      return;
+    }
+
+  grub_memset (du, 0, sizeof (jpeg_data_unit_t));
+
+  du[0] = data->dc_value[id] * quan[0];
   pos = 1;
-  while (pos < ARRAY_SIZE (data->quan_table[qt]))
+  while (pos < ARRAY_SIZE (jpeg_zigzag_order))
     {
       int num, val;
 
@@ -534,57 +679,58 @@ grub_jpeg_decode_du (struct grub_jpeg_data *data, int id, jpeg_data_unit_t du)
 	  return;
 	}
 
-      du[jpeg_zigzag_order[pos]] = val * (int) data->quan_table[qt][pos];
+      du[jpeg_zigzag_order[pos]] = val * quan[pos];
       pos++;
     }
 
-  grub_jpeg_idct_transform (du);
+  grub_jpeg_idct_transform (du, out, stride);
 }
 
 static void
-grub_jpeg_ycrcb_to_rgb (int yy, int cr, int cb, grub_uint8_t * rgb)
+grub_jpeg_init_ycrcb_tables (void)
 {
-  int dd;
+  int i, x;
 
-  cr -= 128;
-  cb -= 128;
+  for (i = 0, x = -128; i < 256; i++, x++)
+    {
+      jpeg_cr_r[i] = (YCC_CONST (1.402) * x
+		      + (1 << (YCC_SHIFT_BITS - 1))) >> YCC_SHIFT_BITS;
+      jpeg_cb_b[i] = (YCC_CONST (1.772) * x
+		      + (1 << (YCC_SHIFT_BITS - 1))) >> YCC_SHIFT_BITS;
+      jpeg_cr_g[i] = -YCC_CONST (0.71414) * x;
+      jpeg_cb_g[i] = -YCC_CONST (0.34414) * x + (1 << (YCC_SHIFT_BITS - 1));
+    }
+}
 
-  /* Red  */
-  dd = yy + ((cr * CONST (1.402)) >> SHIFT_BITS);
-  if (dd < 0)
-    dd = 0;
-  if (dd > 255)
-    dd = 255;
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-  rgb[2] = dd;
-#else
-  *(rgb++) = dd;
-#endif
+/* Convert N pixels of a row to RGB.  Each chroma sample covers
+   1 << LOG_HS luma samples.  */
+static void
+grub_jpeg_ycrcb_to_rgb (const grub_uint8_t *yy, const grub_uint8_t *cr,
+			const grub_uint8_t *cb, unsigned n, unsigned log_hs,
+			grub_uint8_t *rgb)
+{
+  unsigned i, j, next;
 
-  /* Green  */
-  dd = yy - ((cb * CONST (0.34414) + cr * CONST (0.71414)) >> SHIFT_BITS);
-  if (dd < 0)
-    dd = 0;
-  if (dd > 255)
-    dd = 255;
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-  rgb[1] = dd;
-#else
-  *(rgb++) = dd;
-#endif
+  for (i = 0; i < n; cr++, cb++)
+    {
+      int r, g, b;
 
-  /* Blue  */
-  dd = yy + ((cb * CONST (1.772)) >> SHIFT_BITS);
-  if (dd < 0)
-    dd = 0;
-  if (dd > 255)
-    dd = 255;
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-  rgb[0] = dd;
-  rgb += 3;
-#else
-  *(rgb++) = dd;
-#endif
+      r = jpeg_cr_r[*cr];
+      g = (jpeg_cb_g[*cb] + jpeg_cr_g[*cr]) >> YCC_SHIFT_BITS;
+      b = jpeg_cb_b[*cb];
+
+      next = i + (1 << log_hs);
+      if (next > n)
+	next = n;
+
+      for (j = i; j < next; j++, rgb += 3)
+	{
+	  rgb[R3] = grub_jpeg_clamp (yy[j] + r);
+	  rgb[G3] = grub_jpeg_clamp (yy[j] + g);
+	  rgb[B3] = grub_jpeg_clamp (yy[j] + b);
+	}
+      i = next;
+    }
 }
 
 static grub_err_t
@@ -626,6 +772,17 @@ grub_jpeg_decode_sos (struct grub_jpeg_data *data)
   if (data->file->offset != data_offset)
     return grub_error (GRUB_ERR_BAD_FILE_TYPE, "jpeg: extra byte in sos");
 
+  /* If even an eighth of the image is big enough, the DC coefficients
+     alone are all that is needed.  */
+  if (data->min_width && data->min_height
+      && ((data->image_width + 7) >> 3) >= data->min_width
+      && ((data->image_height + 7) >> 3) >= data->min_height)
+    {
+      data->dc_only = 1;
+      data->image_width = (data->image_width + 7) >> 3;
+      data->image_height = (data->image_height + 7) >> 3;
+    }
+
   if (grub_video_bitmap_create (data->bitmap, data->image_width,
 				data->image_height,
 				GRUB_VIDEO_BLIT_FORMAT_RGB_888))
@@ -638,67 +795,69 @@ grub_jpeg_decode_sos (struct grub_jpeg_data *data)
 static grub_err_t
 grub_jpeg_decode_data (struct grub_jpeg_data *data)
 {
-  unsigned c1, vb, hb, nr1, nc1;
+  unsigned vb, hb, nr1, nc1, unit;
   int rst = data->dri;
 
-  vb = 8 << data->log_vs;
-  hb = 8 << data->log_hs;
-  nr1 = (data->image_height + vb - 1) >> (3 + data->log_vs);
-  nc1 = (data->image_width + hb - 1)  >> (3 + data->log_hs);
+  /* Size of a data unit in the bitmap.  */
+  unit = data->dc_only ? 1 : JPEG_UNIT_SIZE;
+  vb = unit << data->log_vs;
+  hb = unit << data->log_hs;
+  nr1 = (data->image_height + vb - 1) / vb;
+  nc1 = (data->image_width + hb - 1) / hb;
 
   if (data->bitmap_ptr == NULL)
     return grub_error(GRUB_ERR_BAD_FILE_TYPE,
 		      "jpeg: attempted to decode data before start of stream");
 
-  for (; data->r1 < nr1 && (!data->dri || rst);
-       data->r1++, data->bitmap_ptr += (vb * data->image_width - hb * nc1) * 3)
-    for (c1 = 0;  c1 < nc1 && (!data->dri || rst);
-	c1++, rst--, data->bitmap_ptr += hb * 3)
-      {
-	unsigned r2, c2, nr2, nc2;
-	grub_uint8_t *ptr2;
+  /* Restart intervals need not end at the end of an MCU row.  */
+  while (data->r1 < nr1 && (!data->dri || rst))
+    {
+      unsigned r2, c2, nr2, nc2;
+      grub_uint8_t *ptr2;
 
-	for (r2 = 0; r2 < (1U << data->log_vs); r2++)
-	  for (c2 = 0; c2 < (1U << data->log_hs); c2++)
-	    grub_jpeg_decode_du (data, 0, data->ydu[r2 * 2 + c2]);
+      for (r2 = 0; r2 < (1U << data->log_vs); r2++)
+	for (c2 = 0; c2 < (1U << data->log_hs); c2++)
+	  grub_jpeg_decode_du (data, 0,
+			       data->ydu + (r2 * 16 + c2) * unit, 16);
 
-	if (data->color_components >= 3)
-	  {
-	    grub_jpeg_decode_du (data, 1, data->cbdu);
-	    grub_jpeg_decode_du (data, 2, data->crdu);
-	  }
+      if (data->color_components >= 3)
+	{
+	  grub_jpeg_decode_du (data, 1, data->cbdu, 8);
+	  grub_jpeg_decode_du (data, 2, data->crdu, 8);
+	}
 
-	if (grub_errno)
-	  return grub_errno;
+      if (grub_errno)
+	return grub_errno;
 
-	nr2 = (data->r1 == nr1 - 1) ? (data->image_height - data->r1 * vb) : vb;
-	nc2 = (c1 == nc1 - 1) ? (data->image_width - c1 * hb) : hb;
+      nr2 = (data->r1 == nr1 - 1) ? (data->image_height - data->r1 * vb) : vb;
+      nc2 = (data->c1 == nc1 - 1) ? (data->image_width - data->c1 * hb) : hb;
 
-	ptr2 = data->bitmap_ptr;
-	for (r2 = 0; r2 < nr2; r2++, ptr2 += (data->image_width - nc2) * 3)
-	  for (c2 = 0; c2 < nc2; c2++, ptr2 += 3)
+      ptr2 = data->bitmap_ptr
+	+ ((grub_size_t) data->r1 * vb * data->image_width
+	   + data->c1 * hb) * 3;
+      for (r2 = 0; r2 < nr2; r2++, ptr2 += data->image_width * 3)
+	{
+	  const grub_uint8_t *yy = data->ydu + r2 * 16;
+
+	  if (data->color_components >= 3)
 	    {
-	      unsigned i0;
-	      int yy;
-
-	      i0 = (r2 >> data->log_vs) * 8 + (c2 >> data->log_hs);
-	      yy = data->ydu[(r2 / 8) * 2 + (c2 / 8)][(r2 % 8) * 8 + (c2 % 8)];
-
-	      if (data->color_components >= 3)
-		{
-		  int cr, cb;
-		  cr = data->crdu[i0];
-		  cb = data->cbdu[i0];
-		  grub_jpeg_ycrcb_to_rgb (yy, cr, cb, ptr2);
-		}
-	      else
-		{
-		  ptr2[0] = yy;
-		  ptr2[1] = yy;
-		  ptr2[2] = yy;
-		}
+	      unsigned i0 = (r2 >> data->log_vs) * 8;
+
+	      grub_jpeg_ycrcb_to_rgb (yy, data->crdu + i0, data->cbdu + i0,
+				      nc2, data->log_hs, ptr2);
 	    }
-      }
+	  else
+	    for (c2 = 0; c2 < nc2; c2++)
+	      ptr2[c2 * 3] = ptr2[c2 * 3 + 1] = ptr2[c2 * 3 + 2] = yy[c2];
+	}
+
+      rst--;
+      if (++data->c1 == nc1)
+	{
+	  data->c1 = 0;
+	  data->r1++;
+	}
+    }
 
   return grub_errno;
 }
@@ -706,7 +865,12 @@ grub_jpeg_decode_data (struct grub_jpeg_data *data)
 static void
 grub_jpeg_reset (struct grub_jpeg_data *data)
 {
-  data->bit_mask = 0x0;
+  if (data->in_ptr != data->in_end)
+    grub_jpeg_unread_data (data, 0);
+
+  data->bit_buf = 0;
+  data->bit_count = 0;
+  data->marker_hit = 0;
 
   data->dc_value[0] = 0;
   data->dc_value[1] = 0;
@@ -783,6 +947,9 @@ grub_jpeg_decode_jpeg (struct grub_jpeg_data *data)
 	    sz = grub_jpeg_get_word (data);
 	    if (grub_errno)
 	      return (grub_errno);
+	    if (sz < 2)
+	      return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+				 "jpeg: invalid marker length");
 	    grub_file_seek (data->file, data->file->offset + sz - 2);
 	  }
 	}
@@ -792,8 +959,9 @@ grub_jpeg_decode_jpeg (struct grub_jpeg_data *data)
 }
 
 static grub_err_t
-grub_video_reader_jpeg (struct grub_video_bitmap **bitmap,
-			const char *filename)
+grub_video_reader_jpeg_scaled (struct grub_video_bitmap **bitmap,
+			       const char *filename,
+			       unsigned int min_width, unsigned int min_height)
 {
   grub_file_t file;
   struct grub_jpeg_data *data;
@@ -809,6 +977,8 @@ grub_video_reader_jpeg (struct grub_video_bitmap **bitmap,
 
       data->file = file;
       data->bitmap = bitmap;
+      data->min_width = min_width;
+      data->min_height = min_height;
       grub_jpeg_decode_jpeg (data);
 
       for (i = 0; i < 4; i++)
@@ -827,53 +997,82 @@ grub_video_reader_jpeg (struct grub_video_bitmap **bitmap,
   return grub_errno;
 }
 
-#if defined(JPEG_DEBUG)
+static grub_err_t
+grub_video_reader_jpeg (struct grub_video_bitmap **bitmap,
+			const char *filename)
+{
+  return grub_video_reader_jpeg_scaled (bitmap, filename, 0, 0);
+}
+
 static grub_err_t
 grub_cmd_jpegtest (grub_command_t cmdd __attribute__ ((unused)),
 		   int argc, char **args)
 {
   struct grub_video_bitmap *bitmap = 0;
+  unsigned long count = 1, i;
+  grub_uint64_t start, elapsed;
+  unsigned width = 0, height = 0;
 
-  if (argc != 1)
+  if (argc < 1)
     return grub_error (GRUB_ERR_BAD_ARGUMENT, N_("filename expected"));
 
-  grub_video_reader_jpeg (&bitmap, args[0]);
-  if (grub_errno != GRUB_ERR_NONE)
-    return grub_errno;
+  if (argc > 1)
+    {
+      const char *end;
 
-  grub_video_bitmap_destroy (bitmap);
+      count = grub_strtoul (args[1], &end, 0);
+      if (grub_errno || *end || count == 0)
+	return grub_error (GRUB_ERR_BAD_ARGUMENT,
+			   N_("unrecognized number"));
+    }
+
+  start = grub_get_time_ms ();
+  for (i = 0; i < count; i++)
+    {
+      grub_video_reader_jpeg (&bitmap, args[0]);
+      if (grub_errno != GRUB_ERR_NONE)
+	return grub_errno;
+
+      width = bitmap->mode_info.width;
+      height = bitmap->mode_info.height;
+      grub_video_bitmap_destroy (bitmap);
+    }
+  elapsed = grub_get_time_ms () - start;
+
+  grub_printf ("%ux%u: %llu ms per image\n", width, height,
+	       (unsigned long long) (elapsed / count));
 
   return GRUB_ERR_NONE;
 }
-#endif
 
 static struct grub_video_bitmap_reader jpg_reader = {
   .extension = ".jpg",
   .reader = grub_video_reader_jpeg,
+  .reader_scaled = grub_video_reader_jpeg_scaled,
   .next = 0
 };
 
 static struct grub_video_bitmap_reader jpeg_reader = {
   .extension = ".jpeg",
   .reader = grub_video_reader_jpeg,
+  .reader_scaled = grub_video_reader_jpeg_scaled,
   .next = 0
 };
 
 GRUB_MOD_INIT (jpeg)
 {
+  grub_jpeg_init_ycrcb_tables ();
   grub_video_bitmap_reader_register (&jpg_reader);
   grub_video_bitmap_reader_register (&jpeg_reader);
-#if defined(JPEG_DEBUG)
   cmd = grub_register_command ("jpegtest", grub_cmd_jpegtest,
-			       "FILE", "Tests loading of JPEG bitmap.");
-#endif
+			       N_("FILE [COUNT]"),
+			       N_("Decode a JPEG file COUNT times and show the"
+				  " time each decode took on average."));
 }
 
 GRUB_MOD_FINI (jpeg)
 {
-#if defined(JPEG_DEBUG)
   grub_unregister_command (cmd);
-#endif
   grub_video_bitmap_reader_unregister (&jpeg_reader);
   grub_video_bitmap_reader_unregister (&jpg_reader);
 }
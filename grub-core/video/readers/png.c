@@ -24,12 +24,10 @@
 #include <grub/misc.h>
 #include <grub/bufio.h>
 #include <grub/safemath.h>
+#include <grub/time.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
-/* Uncomment following define to enable PNG debug.  */
-//#define PNG_DEBUG
-
 enum
   {
     PNG_COLOR_TYPE_GRAY = 0,
@@ -79,14 +77,28 @@ enum
 
 #define DEFLATE_HUFF_LEN	16
 
-#ifdef PNG_DEBUG
+/* Codes up to this long are decoded with a single table lookup.  */
+#define HUFF_FAST_BITS		9
+#define HUFF_FAST_MASK		((1 << HUFF_FAST_BITS) - 1)
+
+/* Size of the buffer IDAT contents are read into.  */
+#define PNG_INBUF_SIZE		4096
+
 static grub_command_t cmd;
-#endif
 
 struct huff_table
 {
-  int *values, *maxval, *offset;
-  int num_values, max_length;
+  /* Length and symbol, as (length << 9) | symbol, of the code starting with
+     the next HUFF_FAST_BITS bits of input, or 0 if that code is longer.  */
+  grub_uint16_t fast[1 << HUFF_FAST_BITS];
+
+  /* Canonical decoding of the longer codes.  MAXCODE is the first code of
+     each length which is too large, left aligned to 16 bits.  */
+  grub_uint32_t maxcode[DEFLATE_HUFF_LEN + 1];
+  grub_uint16_t firstcode[DEFLATE_HUFF_LEN];
+  grub_uint16_t firstsymbol[DEFLATE_HUFF_LEN];
+  grub_uint8_t size[DEFLATE_HLIT_MAX];
+  grub_uint16_t value[DEFLATE_HLIT_MAX];
 };
 
 struct grub_png_data
@@ -94,25 +106,21 @@ struct grub_png_data
   grub_file_t file;
   struct grub_video_bitmap **bitmap;
 
-  int bit_count, bit_save;
+  grub_uint32_t bit_save;
+  int bit_count;
 
   grub_uint32_t next_offset;
 
   unsigned image_width, image_height;
   int bpp, is_16bit;
-  int raw_bytes, is_gray, is_alpha, is_palette;
+  int is_gray, is_alpha, is_palette;
   int row_bytes, color_bits;
-  grub_uint8_t *image_data;
-
-  int inside_idat, idat_remain;
 
-  int code_values[DEFLATE_HLIT_MAX];
-  int code_maxval[DEFLATE_HUFF_LEN];
-  int code_offset[DEFLATE_HUFF_LEN];
+  /* Unfiltered rows are written straight into the bitmap.  */
+  int is_direct;
 
-  int dist_values[DEFLATE_HDIST_MAX];
-  int dist_maxval[DEFLATE_HUFF_LEN];
-  int dist_offset[DEFLATE_HUFF_LEN];
+  int idat_remain, idat_done;
+  grub_uint8_t *in_ptr, *in_end;
 
   grub_uint8_t palette[256][3];
 
@@ -120,11 +128,17 @@ struct grub_png_data
   struct huff_table dist_table;
 
   grub_uint8_t slide[WSIZE];
-  int wp;
+  int wp, flush_pos;
+
+  /* Row being assembled and the previous one, which starts out as zeroes.
+     Both point into the bitmap when is_direct is set.  */
+  grub_uint8_t *cur_row, *prev_row;
+  grub_uint8_t *row_buf[2];
 
-  grub_uint8_t *cur_rgb;
+  unsigned cur_y;
+  int cur_column, cur_filter;
 
-  int cur_column, cur_filter, first_line;
+  grub_uint8_t inbuf[PNG_INBUF_SIZE];
 };
 
 static grub_uint32_t
@@ -143,82 +157,88 @@ grub_png_get_byte (struct grub_png_data *data)
 {
   grub_uint8_t r;
 
-  if ((data->inside_idat) && (data->idat_remain == 0))
-    {
-      grub_uint32_t len, type;
-
-      do
-	{
-          /* Skip crc checksum.  */
-	  grub_png_get_dword (data);
-
-          if (data->file->offset != data->next_offset)
-            {
-              grub_error (GRUB_ERR_BAD_FILE_TYPE,
-                          "png: chunk size error");
-              return 0;
-            }
-
-	  len = grub_png_get_dword (data);
-	  type = grub_png_get_dword (data);
-	  if (type != PNG_CHUNK_IDAT)
-	    {
-	      grub_error (GRUB_ERR_BAD_FILE_TYPE,
-			  "png: unexpected end of data");
-	      return 0;
-	    }
-
-          data->next_offset = data->file->offset + len + 4;
-	}
-      while (len == 0);
-      data->idat_remain = len;
-    }
-
   r = 0;
   grub_file_read (data->file, &r, 1);
 
-  if (data->inside_idat)
-    data->idat_remain--;
-
   return r;
 }
 
-static int
-grub_png_get_bits (struct grub_png_data *data, int num)
+/* Refill the input buffer with the contents of the current IDAT chunk, or
+   of the next one if the current one is exhausted.  */
+static grub_err_t
+grub_png_fill_input (struct grub_png_data *data)
 {
-  int code, shift;
+  grub_size_t len;
 
-  if (data->bit_count == 0)
+  while (data->idat_remain == 0)
     {
-      data->bit_save = grub_png_get_byte (data);
-      data->bit_count = 8;
+      grub_uint32_t type;
+
+      /* Skip crc checksum.  */
+      grub_png_get_dword (data);
+
+      if (data->file->offset != data->next_offset)
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			   "png: chunk size error");
+
+      data->idat_remain = grub_png_get_dword (data);
+      type = grub_png_get_dword (data);
+      if (type != PNG_CHUNK_IDAT)
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			   "png: unexpected end of data");
+
+      data->next_offset = data->file->offset + data->idat_remain + 4;
     }
 
-  code = 0;
-  shift = 0;
-  while (grub_errno == 0)
+  len = data->idat_remain;
+  if (len > PNG_INBUF_SIZE)
+    len = PNG_INBUF_SIZE;
+
+  if (grub_file_read (data->file, data->inbuf, len) != (grub_ssize_t) len)
     {
-      int n;
+      if (!grub_errno)
+	grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: unexpected end of data");
+      return grub_errno;
+    }
 
-      n = data->bit_count;
-      if (n > num)
-	n = num;
+  data->idat_remain -= len;
+  data->in_ptr = data->inbuf;
+  data->in_end = data->inbuf + len;
 
-      code += (int) (data->bit_save & ((1 << n) - 1)) << shift;
-      num -= n;
-      if (!num)
-	{
-	  data->bit_count -= n;
-	  data->bit_save >>= n;
-	  break;
-	}
+  return GRUB_ERR_NONE;
+}
+
+/* Make sure at least 25 bits are buffered.  Never reads more than 4 bytes
+   past the bits consumed so far, which the adler checksum that ends the
+   zlib stream covers.  */
+static inline void
+grub_png_fill_bits (struct grub_png_data *data)
+{
+  while (data->bit_count <= 24)
+    {
+      if (data->in_ptr == data->in_end && grub_png_fill_input (data))
+	return;
+      data->bit_save |= (grub_uint32_t) *data->in_ptr++ << data->bit_count;
+      data->bit_count += 8;
+    }
+}
 
-      shift += n;
+static inline int
+grub_png_get_bits (struct grub_png_data *data, int num)
+{
+  int code;
 
-      data->bit_save = grub_png_get_byte (data);
-      data->bit_count = 8;
+  if (data->bit_count < num)
+    {
+      grub_png_fill_bits (data);
+      if (data->bit_count < num)
+	return 0;
     }
 
+  code = data->bit_save & ((1U << num) - 1);
+  data->bit_save >>= num;
+  data->bit_count -= num;
+
   return code;
 }
 
@@ -271,7 +291,10 @@ grub_png_decode_image_header (struct grub_png_data *data)
     return grub_error (GRUB_ERR_BAD_FILE_TYPE,
 		       "png: color type not supported");
   if (color_type & PNG_COLOR_MASK_ALPHA)
-    blt = GRUB_VIDEO_BLIT_FORMAT_RGBA_8888;
+    {
+      data->is_alpha = 1;
+      blt = GRUB_VIDEO_BLIT_FORMAT_RGBA_8888;
+    }
   else
     blt = GRUB_VIDEO_BLIT_FORMAT_RGB_888;
   if (data->is_palette)
@@ -308,34 +331,35 @@ grub_png_decode_image_header (struct grub_png_data *data)
 
   if (data->color_bits <= 4)
     {
-      if (grub_mul (data->image_width, data->color_bits + 7, &data->row_bytes))
+      if (grub_mul (data->image_width, data->color_bits, &data->row_bytes)
+	  || grub_add (data->row_bytes, 7, &data->row_bytes))
 	return grub_error (GRUB_ERR_OUT_OF_RANGE, N_("overflow is detected"));
 
       data->row_bytes >>= 3;
     }
 
+  /* 8-bit RGB and RGBA rows are laid out like the bitmap on little endian
+     machines, so they are unfiltered in place.  */
 #ifndef GRUB_CPU_WORDS_BIGENDIAN
-  if (data->is_16bit || data->is_gray || data->is_palette)
+  data->is_direct = !(data->is_16bit || data->is_gray || data->is_palette);
 #endif
-    {
-      data->image_data = grub_calloc (data->image_height, data->row_bytes);
-      if (grub_errno)
-        return grub_errno;
 
-      data->cur_rgb = data->image_data;
-    }
-#ifndef GRUB_CPU_WORDS_BIGENDIAN
+  data->row_buf[0] = grub_zalloc (data->row_bytes);
+  if (!data->row_buf[0])
+    return grub_errno;
+  data->prev_row = data->row_buf[0];
+  if (data->is_direct)
+    data->cur_row = (*data->bitmap)->data;
   else
     {
-      data->image_data = 0;
-      data->cur_rgb = (*data->bitmap)->data;
+      data->row_buf[1] = grub_zalloc (data->row_bytes);
+      if (!data->row_buf[1])
+	return grub_errno;
+      data->cur_row = data->row_buf[1];
     }
-#endif
-
-  data->raw_bytes = data->image_height * (data->row_bytes + 1);
 
+  data->cur_y = 0;
   data->cur_column = 0;
-  data->first_line = 1;
 
   if (grub_png_get_byte (data) != PNG_COMPRESSION_BASE)
     return grub_error (GRUB_ERR_BAD_FILE_TYPE,
@@ -386,122 +410,156 @@ static const grub_uint8_t cpdext[] = {
   12, 12, 13, 13
 };
 
-static void
-grub_png_init_huff_table (struct huff_table *ht, int cur_maxlen,
-			  int *cur_values, int *cur_maxval, int *cur_offset)
+static inline unsigned
+grub_png_bit_reverse (unsigned code, int len)
 {
-  ht->values = cur_values;
-  ht->maxval = cur_maxval;
-  ht->offset = cur_offset;
-  ht->num_values = 0;
-  ht->max_length = cur_maxlen;
-  grub_memset (cur_maxval, 0, sizeof (int) * cur_maxlen);
+  unsigned r = 0;
+
+  while (len--)
+    {
+      r = (r << 1) | (code & 1);
+      code >>= 1;
+    }
+  return r;
 }
 
-static void
-grub_png_insert_huff_item (struct huff_table *ht, int code, int len)
+/* Build the decoding tables for the NUM code lengths in LENS.  */
+static grub_err_t
+grub_png_build_huff_table (struct huff_table *ht, const grub_uint8_t *lens,
+			   int num)
 {
-  int i, n;
+  int sizes[DEFLATE_HUFF_LEN];
+  int next_code[DEFLATE_HUFF_LEN];
+  int i, code, k;
 
-  if (len == 0)
-    return;
+  grub_memset (sizes, 0, sizeof (sizes));
+  grub_memset (ht->fast, 0, sizeof (ht->fast));
 
-  if (len > ht->max_length)
+  for (i = 0; i < num; i++)
     {
-      grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: invalid code length");
-      return;
+      if (lens[i] >= DEFLATE_HUFF_LEN)
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: invalid code length");
+      sizes[lens[i]]++;
     }
+  sizes[0] = 0;
 
-  n = 0;
-  for (i = len; i < ht->max_length; i++)
-    n += ht->maxval[i];
-
-  for (i = 0; i < n; i++)
-    ht->values[ht->num_values - i] = ht->values[ht->num_values - i - 1];
-
-  ht->values[ht->num_values - n] = code;
-  ht->num_values++;
-  ht->maxval[len - 1]++;
-}
-
-static void
-grub_png_build_huff_table (struct huff_table *ht)
-{
-  int base, ofs, i;
+  code = 0;
+  k = 0;
+  for (i = 1; i < DEFLATE_HUFF_LEN; i++)
+    {
+      next_code[i] = code;
+      ht->firstcode[i] = code;
+      ht->firstsymbol[i] = k;
+      code += sizes[i];
+      if (code > (1 << i))
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: invalid code length");
+      ht->maxcode[i] = code << (DEFLATE_HUFF_LEN - i);
+      code <<= 1;
+      k += sizes[i];
+    }
+  /* Sentinel for the search in grub_png_get_huff_code.  */
+  ht->maxcode[DEFLATE_HUFF_LEN] = 0x10000;
 
-  base = 0;
-  ofs = 0;
-  for (i = 0; i < ht->max_length; i++)
+  for (i = 0; i < num; i++)
     {
-      base += ht->maxval[i];
-      ofs += ht->maxval[i];
+      int s = lens[i];
+      int c;
+
+      if (!s)
+	continue;
 
-      ht->maxval[i] = base;
-      ht->offset[i] = ofs - base;
+      c = next_code[s] - ht->firstcode[s] + ht->firstsymbol[s];
+      ht->size[c] = s;
+      ht->value[c] = i;
+      if (s <= HUFF_FAST_BITS)
+	{
+	  unsigned j;
 
-      base <<= 1;
+	  for (j = grub_png_bit_reverse (next_code[s], s);
+	       j < (1 << HUFF_FAST_BITS); j += 1 << s)
+	    ht->fast[j] = (s << 9) | i;
+	}
+      next_code[s]++;
     }
+
+  return GRUB_ERR_NONE;
 }
 
-static int
+static inline int
 grub_png_get_huff_code (struct grub_png_data *data, struct huff_table *ht)
 {
-  int code, i;
+  unsigned k;
+  int b, s;
 
-  code = 0;
-  for (i = 0; i < ht->max_length; i++)
+  if (data->bit_count < DEFLATE_HUFF_LEN)
+    grub_png_fill_bits (data);
+
+  b = ht->fast[data->bit_save & HUFF_FAST_MASK];
+  if (b)
+    {
+      s = b >> 9;
+      data->bit_save >>= s;
+      data->bit_count -= s;
+      return b & 0x1ff;
+    }
+
+  /* Deflate codes are stored starting with their most significant bit.  */
+  k = grub_png_bit_reverse (data->bit_save & 0xffff, DEFLATE_HUFF_LEN);
+  for (s = HUFF_FAST_BITS + 1; k >= ht->maxcode[s]; s++)
+    ;
+  if (s >= DEFLATE_HUFF_LEN)
     {
-      code = (code << 1) + grub_png_get_bits (data, 1);
-      if (code < ht->maxval[i])
-	return ht->values[code + ht->offset[i]];
+      grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: invalid huffman code");
+      return 0;
     }
-  return 0;
+
+  b = (k >> (DEFLATE_HUFF_LEN - s)) - ht->firstcode[s] + ht->firstsymbol[s];
+  if (b >= DEFLATE_HLIT_MAX || ht->size[b] != s)
+    {
+      grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: invalid huffman code");
+      return 0;
+    }
+
+  data->bit_save >>= s;
+  data->bit_count -= s;
+  return ht->value[b];
 }
 
 static grub_err_t
 grub_png_init_fixed_block (struct grub_png_data *data)
 {
+  grub_uint8_t lens[DEFLATE_HLIT_MAX];
   int i;
 
-  grub_png_init_huff_table (&data->code_table, DEFLATE_HUFF_LEN,
-			    data->code_values, data->code_maxval,
-			    data->code_offset);
-
   for (i = 0; i < 144; i++)
-    grub_png_insert_huff_item (&data->code_table, i, 8);
+    lens[i] = 8;
 
   for (; i < 256; i++)
-    grub_png_insert_huff_item (&data->code_table, i, 9);
+    lens[i] = 9;
 
   for (; i < 280; i++)
-    grub_png_insert_huff_item (&data->code_table, i, 7);
+    lens[i] = 7;
 
   for (; i < DEFLATE_HLIT_MAX; i++)
-    grub_png_insert_huff_item (&data->code_table, i, 8);
-
-  grub_png_build_huff_table (&data->code_table);
+    lens[i] = 8;
 
-  grub_png_init_huff_table (&data->dist_table, DEFLATE_HUFF_LEN,
-			    data->dist_values, data->dist_maxval,
-			    data->dist_offset);
+  if (grub_png_build_huff_table (&data->code_table, lens, DEFLATE_HLIT_MAX))
+    return grub_errno;
 
   for (i = 0; i < DEFLATE_HDIST_MAX; i++)
-    grub_png_insert_huff_item (&data->dist_table, i, 5);
+    lens[i] = 5;
 
-  grub_png_build_huff_table (&data->dist_table);
-
-  return grub_errno;
+  return grub_png_build_huff_table (&data->dist_table, lens,
+				    DEFLATE_HDIST_MAX);
 }
 
 static grub_err_t
 grub_png_init_dynamic_block (struct grub_png_data *data)
 {
-  int nl, nd, nb, i, prev;
+  int nl, nd, nb, i;
   struct huff_table cl;
-  int cl_values[sizeof (bitorder)];
-  int cl_maxval[8];
-  int cl_offset[8];
-  grub_uint8_t lens[DEFLATE_HCLEN_MAX];
+  grub_uint8_t cl_lens[DEFLATE_HCLEN_MAX];
+  grub_uint8_t lens[DEFLATE_HLIT_MAX + DEFLATE_HDIST_MAX];
 
   nl = DEFLATE_HLIT_BASE + grub_png_get_bits (data, 5);
   nd = DEFLATE_HDIST_BASE + grub_png_get_bits (data, 5);
@@ -511,186 +569,352 @@ grub_png_init_dynamic_block (struct grub_png_data *data)
       (nb > DEFLATE_HCLEN_MAX))
     return grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: too much data");
 
-  grub_png_init_huff_table (&cl, 8, cl_values, cl_maxval, cl_offset);
-
   for (i = 0; i < nb; i++)
-    lens[bitorder[i]] = grub_png_get_bits (data, 3);
+    cl_lens[bitorder[i]] = grub_png_get_bits (data, 3);
 
   for (; i < DEFLATE_HCLEN_MAX; i++)
-    lens[bitorder[i]] = 0;
+    cl_lens[bitorder[i]] = 0;
 
-  for (i = 0; i < DEFLATE_HCLEN_MAX; i++)
-    grub_png_insert_huff_item (&cl, i, lens[i]);
-
-  grub_png_build_huff_table (&cl);
-
-  grub_png_init_huff_table (&data->code_table, DEFLATE_HUFF_LEN,
-			    data->code_values, data->code_maxval,
-			    data->code_offset);
-
-  grub_png_init_huff_table (&data->dist_table, DEFLATE_HUFF_LEN,
-			    data->dist_values, data->dist_maxval,
-			    data->dist_offset);
+  if (grub_png_build_huff_table (&cl, cl_lens, DEFLATE_HCLEN_MAX))
+    return grub_errno;
 
-  prev = 0;
-  for (i = 0; i < nl + nd; i++)
+  i = 0;
+  while (i < nl + nd)
     {
-      int n, code;
-      struct huff_table *ht;
+      int n, c;
+      grub_uint8_t fill;
 
       if (grub_errno)
 	return grub_errno;
 
-      if (i < nl)
+      n = grub_png_get_huff_code (data, &cl);
+      if (n < 16)
 	{
-	  ht = &data->code_table;
-	  code = i;
+	  lens[i++] = n;
+	  continue;
 	}
-      else
+
+      if (n == 16)
 	{
-	  ht = &data->dist_table;
-	  code = i - nl;
+	  if (i == 0)
+	    return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			       "png: invalid code length");
+	  c = 3 + grub_png_get_bits (data, 2);
+	  fill = lens[i - 1];
 	}
-
-      n = grub_png_get_huff_code (data, &cl);
-      if (n < 16)
+      else if (n == 17)
 	{
-	  grub_png_insert_huff_item (ht, code, n);
-	  prev = n;
+	  c = 3 + grub_png_get_bits (data, 3);
+	  fill = 0;
 	}
-      else if (n == 16)
+      else
 	{
-	  int c;
+	  c = 11 + grub_png_get_bits (data, 7);
+	  fill = 0;
+	}
 
-	  c = 3 + grub_png_get_bits (data, 2);
-	  while (c > 0)
+      if (c > nl + nd - i)
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE, "png: too much data");
+      grub_memset (lens + i, fill, c);
+      i += c;
+    }
+
+  if (grub_png_build_huff_table (&data->code_table, lens, nl))
+    return grub_errno;
+
+  return grub_png_build_huff_table (&data->dist_table, lens + nl, nd);
+}
+
+#ifndef GRUB_CPU_WORDS_BIGENDIAN
+#define R4 0
+#define G4 1
+#define B4 2
+#define A4 3
+#define R3 0
+#define G3 1
+#define B3 2
+#else
+#define R4 3
+#define G4 2
+#define B4 1
+#define A4 0
+#define R3 2
+#define G3 1
+#define B3 0
+#endif
+
+/* Convert an unfiltered row S into row D of the bitmap.  */
+static void
+grub_png_convert_row (struct grub_png_data *data, const grub_uint8_t *s,
+		      grub_uint8_t *d)
+{
+  /* Only the upper 8 bits of 16-bit samples are kept.  */
+  int step = data->is_16bit ? 2 : 1;
+  unsigned i;
+
+  if (data->color_bits <= 4)
+    {
+      grub_uint8_t palette[16][3];
+      int mask = (1 << data->color_bits) - 1;
+      int shift = 8 - data->color_bits;
+
+      if (data->is_gray)
+	for (i = 0; i < (1U << data->color_bits); i++)
+	  palette[i][0] = palette[i][1] = palette[i][2]
+	    = (0xff / mask) * i;
+      else
+	grub_memcpy (palette, data->palette, 3 << data->color_bits);
+
+      for (i = 0; i < data->image_width; i++, d += 3)
+	{
+	  grub_uint8_t col = (*s >> shift) & mask;
+
+	  d[R3] = palette[col][0];
+	  d[G3] = palette[col][1];
+	  d[B3] = palette[col][2];
+	  shift -= data->color_bits;
+	  if (shift < 0)
 	    {
-	      grub_png_insert_huff_item (ht, code++, prev);
-	      i++;
-	      c--;
+	      s++;
+	      shift += 8;
 	    }
-	  i--;
 	}
-      else if (n == 17)
-	i += 3 + grub_png_get_bits (data, 3) - 1;
-      else
-	i += 11 + grub_png_get_bits (data, 7) - 1;
+      return;
     }
 
-  grub_png_build_huff_table (&data->code_table);
-  grub_png_build_huff_table (&data->dist_table);
+  if (data->is_palette)
+    {
+      for (i = 0; i < data->image_width; i++, d += 3, s++)
+	{
+	  d[R3] = data->palette[*s][0];
+	  d[G3] = data->palette[*s][1];
+	  d[B3] = data->palette[*s][2];
+	}
+      return;
+    }
 
-  return grub_errno;
+  if (data->is_gray && data->is_alpha)
+    for (i = 0; i < data->image_width; i++, d += 4, s += 2 * step)
+      {
+	d[R4] = d[G4] = d[B4] = s[0];
+	d[A4] = s[step];
+      }
+  else if (data->is_gray)
+    for (i = 0; i < data->image_width; i++, d += 3, s += step)
+      d[R3] = d[G3] = d[B3] = s[0];
+  else if (data->is_alpha)
+    for (i = 0; i < data->image_width; i++, d += 4, s += 4 * step)
+      {
+	d[R4] = s[0];
+	d[G4] = s[step];
+	d[B4] = s[2 * step];
+	d[A4] = s[3 * step];
+      }
+  else
+    for (i = 0; i < data->image_width; i++, d += 3, s += 3 * step)
+      {
+	d[R3] = s[0];
+	d[G3] = s[step];
+	d[B3] = s[2 * step];
+      }
 }
 
-static grub_err_t
-grub_png_output_byte (struct grub_png_data *data, grub_uint8_t n)
+typedef grub_addr_t png_word_t __attribute__ ((may_alias));
+
+#define PNG_WORD_LOW7	((png_word_t) -1 / 0xff * 0x7f)
+#define PNG_WORD_HIGH	((png_word_t) -1 / 0xff * 0x80)
+
+static inline grub_uint8_t
+grub_png_paeth (int a, int b, int c)
 {
-  if (--data->raw_bytes < 0)
-    return grub_error (GRUB_ERR_BAD_FILE_TYPE, "image size overflown");
+  int pa, pb, pc;
+
+  pa = b - c;
+  pb = a - c;
+  pc = pa + pb;
 
-  if (data->cur_column == 0)
+  if (pa < 0)
+    pa = -pa;
+  if (pb < 0)
+    pb = -pb;
+  if (pc < 0)
+    pc = -pc;
+
+  return ((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : c;
+}
+
+/* Undo FILTER on row CUR of LEN bytes, UP being the previous row.  */
+static void
+grub_png_unfilter (int filter, grub_uint8_t *cur, const grub_uint8_t *up,
+		   int len, int bpp)
+{
+  int i = 0;
+
+  switch (filter)
     {
-      if (n >= PNG_FILTER_VALUE_LAST)
-	return grub_error (GRUB_ERR_BAD_FILE_TYPE, "invalid filter value");
+    case PNG_FILTER_VALUE_SUB:
+      for (i = bpp; i < len; i++)
+	cur[i] += cur[i - bpp];
+      break;
+
+    case PNG_FILTER_VALUE_UP:
+      /* Add whole words at once, keeping carries within their byte.  */
+      if ((((grub_addr_t) cur | (grub_addr_t) up)
+	   & (sizeof (png_word_t) - 1)) == 0)
+	for (; i + (int) sizeof (png_word_t) <= len; i += sizeof (png_word_t))
+	  {
+	    png_word_t a = *(png_word_t *) (cur + i);
+	    png_word_t b = *(const png_word_t *) (up + i);
 
-      data->cur_filter = n;
+	    *(png_word_t *) (cur + i) = (((a & PNG_WORD_LOW7)
+					  + (b & PNG_WORD_LOW7))
+					 ^ ((a ^ b) & PNG_WORD_HIGH));
+	  }
+      for (; i < len; i++)
+	cur[i] += up[i];
+      break;
+
+    case PNG_FILTER_VALUE_AVG:
+      for (; i < bpp; i++)
+	cur[i] += up[i] >> 1;
+      for (; i < len; i++)
+	cur[i] += ((int) up[i] + (int) cur[i - bpp]) >> 1;
+      break;
+
+    case PNG_FILTER_VALUE_PAETH:
+      for (; i < bpp; i++)
+	cur[i] += up[i];
+      for (; i < len; i++)
+	cur[i] += grub_png_paeth (cur[i - bpp], up[i], up[i - bpp]);
+      break;
     }
-  else
-    *data->cur_rgb++ = n;
+}
 
-  data->cur_column++;
-  if (data->cur_column == data->row_bytes + 1)
+/* Take LEN bytes of decompressed data, made of a filter type byte followed
+   by the filtered bytes for each row.  Rows are unfiltered and converted
+   as soon as they are complete.  */
+static grub_err_t
+grub_png_output (struct grub_png_data *data, const grub_uint8_t *p,
+		 grub_size_t len)
+{
+  while (len)
     {
-      grub_uint8_t *blank_line = NULL;
-      grub_uint8_t *cur = data->cur_rgb - data->row_bytes;
-      grub_uint8_t *left = cur;
-      grub_uint8_t *up;
+      grub_size_t n;
+
+      if (data->cur_y >= data->image_height)
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE, "image size overflown");
 
-      if (data->first_line)
+      if (data->cur_column == 0)
 	{
-	  blank_line = grub_zalloc (data->row_bytes);
-	  if (blank_line == NULL)
-	    return grub_errno;
+	  if (*p >= PNG_FILTER_VALUE_LAST)
+	    return grub_error (GRUB_ERR_BAD_FILE_TYPE, "invalid filter value");
 
-	  up = blank_line;
+	  data->cur_filter = *p++;
+	  len--;
+	  data->cur_column = 1;
+	  continue;
 	}
-      else
-	up = cur - data->row_bytes;
 
-      switch (data->cur_filter)
-	{
-	case PNG_FILTER_VALUE_SUB:
-	  {
-	    int i;
+      n = data->row_bytes + 1 - data->cur_column;
+      if (n > len)
+	n = len;
+      grub_memcpy (data->cur_row + data->cur_column - 1, p, n);
+      p += n;
+      len -= n;
+      data->cur_column += n;
 
-	    cur += data->bpp;
-	    for (i = data->bpp; i < data->row_bytes; i++, cur++, left++)
-	      *cur += *left;
+      if (data->cur_column == data->row_bytes + 1)
+	{
+	  struct grub_video_bitmap *bitmap = *data->bitmap;
+	  grub_uint8_t *row;
 
-	    break;
-	  }
-	case PNG_FILTER_VALUE_UP:
-	  {
-	    int i;
+	  grub_png_unfilter (data->cur_filter, data->cur_row, data->prev_row,
+			     data->row_bytes, data->bpp);
 
-	    for (i = 0; i < data->row_bytes; i++, cur++, up++)
-	      *cur += *up;
+	  row = (grub_uint8_t *) bitmap->data
+	    + data->cur_y * bitmap->mode_info.pitch;
+	  if (data->is_direct)
+	    {
+	      data->prev_row = data->cur_row;
+	      data->cur_row = row + bitmap->mode_info.pitch;
+	    }
+	  else
+	    {
+	      grub_uint8_t *t = data->prev_row;
 
-	    break;
-	  }
-	case PNG_FILTER_VALUE_AVG:
-	  {
-	    int i;
+	      grub_png_convert_row (data, data->cur_row, row);
+	      data->prev_row = data->cur_row;
+	      data->cur_row = t;
+	    }
 
-	    for (i = 0; i < data->bpp; i++, cur++, up++)
-	      *cur += *up >> 1;
+	  data->cur_y++;
+	  data->cur_column = 0;
+	}
+    }
 
-	    for (; i < data->row_bytes; i++, cur++, up++, left++)
-	      *cur += ((int) *up + (int) *left) >> 1;
+  return GRUB_ERR_NONE;
+}
 
-	    break;
-	  }
-	case PNG_FILTER_VALUE_PAETH:
-	  {
-	    int i;
-	    grub_uint8_t *upper_left = up;
+/* Pass what was added to the sliding window since the last call on.  */
+static grub_err_t
+grub_png_flush_window (struct grub_png_data *data)
+{
+  grub_err_t err;
 
-	    for (i = 0; i < data->bpp; i++, cur++, up++)
-	      *cur += *up;
+  err = grub_png_output (data, data->slide + data->flush_pos,
+			 data->wp - data->flush_pos);
+  if (data->wp == WSIZE)
+    data->wp = 0;
+  data->flush_pos = data->wp;
 
-	    for (; i < data->row_bytes; i++, cur++, up++, left++, upper_left++)
-	      {
-		int a, b, c, pa, pb, pc;
+  return err;
+}
 
-                a = *left;
-                b = *up;
-                c = *upper_left;
+static grub_err_t
+grub_png_read_stored_block (struct grub_png_data *data)
+{
+  int len;
 
-                pa = b - c;
-                pb = a - c;
-                pc = pa + pb;
+  /* Drop the bits up to the next byte boundary.  */
+  grub_png_get_bits (data, data->bit_count & 7);
 
-                if (pa < 0)
-                  pa = -pa;
+  len = grub_png_get_bits (data, 16);
 
-                if (pb < 0)
-                  pb = -pb;
+  /* Skip NLEN field.  */
+  grub_png_get_bits (data, 16);
 
-                if (pc < 0)
-                  pc = -pc;
+  while (len > 0 && grub_errno == GRUB_ERR_NONE)
+    {
+      int n;
 
-                *cur += ((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : c;
-	      }
-	  }
+      /* Bytes still in the bit buffer come first.  */
+      if (data->bit_count)
+	{
+	  data->slide[data->wp++] = grub_png_get_bits (data, 8);
+	  len--;
+	}
+      else
+	{
+	  if (data->in_ptr == data->in_end && grub_png_fill_input (data))
+	    break;
+	  n = data->in_end - data->in_ptr;
+	  if (n > len)
+	    n = len;
+	  if (n > WSIZE - data->wp)
+	    n = WSIZE - data->wp;
+	  grub_memcpy (data->slide + data->wp, data->in_ptr, n);
+	  data->in_ptr += n;
+	  data->wp += n;
+	  len -= n;
 	}
 
-      grub_free (blank_line);
-
-      data->cur_column = 0;
-      data->first_line = 0;
+      if (data->wp == WSIZE)
+	grub_png_flush_window (data);
     }
 
+  if (grub_errno == GRUB_ERR_NONE)
+    grub_png_flush_window (data);
+
   return grub_errno;
 }
 
@@ -704,12 +928,9 @@ grub_png_read_dynamic_block (struct grub_png_data *data)
       n = grub_png_get_huff_code (data, &data->code_table);
       if (n < 256)
 	{
-	  data->slide[data->wp] = n;
-	  grub_png_output_byte (data, n);
-
-	  data->wp++;
-	  if (data->wp >= WSIZE)
-	    data->wp = 0;
+	  data->slide[data->wp++] = n;
+	  if (data->wp == WSIZE)
+	    grub_png_flush_window (data);
 	}
       else if (n == 256)
 	break;
@@ -718,11 +939,17 @@ grub_png_read_dynamic_block (struct grub_png_data *data)
 	  int len, dist, pos;
 
 	  n -= 257;
+	  if (n >= 29)
+	    return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			       "png: invalid length code");
 	  len = cplens[n];
 	  if (cplext[n])
 	    len += grub_png_get_bits (data, cplext[n]);
 
 	  n = grub_png_get_huff_code (data, &data->dist_table);
+	  if (n >= DEFLATE_HDIST_MAX)
+	    return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			       "png: invalid distance code");
 	  dist = cpdist[n];
 	  if (cpdext[n])
 	    dist += grub_png_get_bits (data, cpdext[n]);
@@ -733,22 +960,39 @@ grub_png_read_dynamic_block (struct grub_png_data *data)
 
 	  while (len > 0)
 	    {
-	      data->slide[data->wp] = data->slide[pos];
-	      grub_png_output_byte (data, data->slide[data->wp]);
+	      int cnt = len;
 
-	      data->wp++;
-	      if (data->wp >= WSIZE)
-		data->wp = 0;
+	      if (cnt > WSIZE - data->wp)
+		cnt = WSIZE - data->wp;
+	      if (cnt > WSIZE - pos)
+		cnt = WSIZE - pos;
 
-	      pos++;
-	      if (pos >= WSIZE)
-		pos = 0;
+	      if (pos + cnt <= data->wp || data->wp + cnt <= pos)
+		grub_memcpy (data->slide + data->wp, data->slide + pos, cnt);
+	      else
+		{
+		  /* Overlapping copies repeat the last DIST bytes.  */
+		  int i;
 
-	      len--;
+		  for (i = 0; i < cnt; i++)
+		    data->slide[data->wp + i] = data->slide[pos + i];
+		}
+
+	      data->wp += cnt;
+	      pos += cnt;
+	      len -= cnt;
+
+	      if (pos == WSIZE)
+		pos = 0;
+	      if (data->wp == WSIZE)
+		grub_png_flush_window (data);
 	    }
 	}
     }
 
+  if (grub_errno == GRUB_ERR_NONE)
+    grub_png_flush_window (data);
+
   return grub_errno;
 }
 
@@ -758,8 +1002,8 @@ grub_png_decode_image_data (struct grub_png_data *data)
   grub_uint8_t cmf, flg;
   int final;
 
-  cmf = grub_png_get_byte (data);
-  flg = grub_png_get_byte (data);
+  cmf = grub_png_get_bits (data, 8);
+  flg = grub_png_get_bits (data, 8);
 
   if ((cmf & 0xF) != Z_DEFLATED)
     return grub_error (GRUB_ERR_BAD_FILE_TYPE,
@@ -779,31 +1023,17 @@ grub_png_decode_image_data (struct grub_png_data *data)
       switch (block_type)
 	{
 	case INFLATE_STORED:
-	  {
-	    grub_uint16_t i, len;
-
-	    data->bit_count = 0;
-	    len = grub_png_get_byte (data);
-	    len += ((grub_uint16_t) grub_png_get_byte (data)) << 8;
-
-            /* Skip NLEN field.  */
-	    grub_png_get_byte (data);
-	    grub_png_get_byte (data);
-
-	    for (i = 0; i < len; i++)
-	      grub_png_output_byte (data, grub_png_get_byte (data));
-
-	    break;
-	  }
+	  grub_png_read_stored_block (data);
+	  break;
 
 	case INFLATE_FIXED:
-          grub_png_init_fixed_block (data);
-	  grub_png_read_dynamic_block (data);
+	  if (grub_png_init_fixed_block (data) == GRUB_ERR_NONE)
+	    grub_png_read_dynamic_block (data);
 	  break;
 
 	case INFLATE_DYNAMIC:
-	  grub_png_init_dynamic_block (data);
-	  grub_png_read_dynamic_block (data);
+	  if (grub_png_init_dynamic_block (data) == GRUB_ERR_NONE)
+	    grub_png_read_dynamic_block (data);
 	  break;
 
 	default:
@@ -813,11 +1043,13 @@ grub_png_decode_image_data (struct grub_png_data *data)
     }
   while ((!final) && (grub_errno == 0));
 
-  /* Skip adler checksum.  */
-  grub_png_get_dword (data);
+  if (grub_errno)
+    return grub_errno;
 
-  /* Skip crc checksum.  */
-  grub_png_get_dword (data);
+  /* Skip the adler checksum and the rest of the chunk, including its crc.
+     Any further IDAT chunks are ignored.  */
+  data->idat_done = 1;
+  grub_file_seek (data->file, data->next_offset);
 
   return grub_errno;
 }
@@ -825,209 +1057,6 @@ grub_png_decode_image_data (struct grub_png_data *data)
 static const grub_uint8_t png_magic[8] =
   { 0x89, 0x50, 0x4e, 0x47, 0xd, 0xa, 0x1a, 0x0a };
 
-static void
-grub_png_convert_image (struct grub_png_data *data)
-{
-  unsigned i;
-  grub_uint8_t *d1, *d2;
-
-  d1 = (*data->bitmap)->data;
-  d2 = data->image_data + data->is_16bit;
-
-#ifndef GRUB_CPU_WORDS_BIGENDIAN
-#define R4 3
-#define G4 2
-#define B4 1
-#define A4 0
-#define R3 2
-#define G3 1
-#define B3 0
-#else
-#define R4 0
-#define G4 1
-#define B4 2
-#define A4 3
-#define R3 0
-#define G3 1
-#define B3 2
-#endif
-
-  if (data->color_bits <= 4)
-    {
-      grub_uint8_t palette[16][3];
-      grub_uint8_t *d1c, *d2c;
-      int shift;
-      int mask = (1 << data->color_bits) - 1;
-      unsigned j;
-      if (data->is_gray)
-	{
-	  /* Generic formula is
-	     (0xff * i) / ((1U << data->color_bits) - 1)
-	     but for allowed bit depth of 1, 2 and for it's
-	     equivalent to
-	     (0xff / ((1U << data->color_bits) - 1)) * i
-	     Precompute the multipliers to avoid division.
-	  */
-
-	  const grub_uint8_t multipliers[5] = { 0xff, 0xff, 0x55, 0x24, 0x11 };
-	  for (i = 0; i < (1U << data->color_bits); i++)
-	    {
-	      grub_uint8_t col = multipliers[data->color_bits] * i;
-	      palette[i][0] = col;
-	      palette[i][1] = col;
-	      palette[i][2] = col;
-	    }
-	}
-      else
-	grub_memcpy (palette, data->palette, 3 << data->color_bits);
-      d1c = d1;
-      d2c = d2;
-      for (j = 0; j < data->image_height; j++, d1c += data->image_width * 3,
-	   d2c += data->row_bytes)
-	{
-	  d1 = d1c;
-	  d2 = d2c;
-	  shift = 8 - data->color_bits;
-	  for (i = 0; i < data->image_width; i++, d1 += 3)
-	    {
-	      grub_uint8_t col = (d2[0] >> shift) & mask;
-	      d1[R3] = data->palette[col][2];
-	      d1[G3] = data->palette[col][1];
-	      d1[B3] = data->palette[col][0];
-	      shift -= data->color_bits;
-	      if (shift < 0)
-		{
-		  d2++;
-		  shift += 8;
-		}
-	    }
-	}
-      return;
-    }
-
-  if (data->is_palette)
-    {
-      for (i = 0; i < (data->image_width * data->image_height);
-	   i++, d1 += 3, d2++)
-	{
-	  d1[R3] = data->palette[d2[0]][2];
-	  d1[G3] = data->palette[d2[0]][1];
-	  d1[B3] = data->palette[d2[0]][0];
-	}
-      return;
-    }
-  
-  if (data->is_gray)
-    {
-      switch (data->bpp)
-	{
-	case 4:
-	  /* 16-bit gray with alpha.  */
-	  for (i = 0; i < (data->image_width * data->image_height);
-	       i++, d1 += 4, d2 += 4)
-	    {
-	      d1[R4] = d2[3];
-	      d1[G4] = d2[3];
-	      d1[B4] = d2[3];
-	      d1[A4] = d2[1];
-	    }
-	  break;
-	case 2:
-	  if (data->is_16bit)
-	    /* 16-bit gray without alpha.  */
-	    {
-	      for (i = 0; i < (data->image_width * data->image_height);
-		   i++, d1 += 4, d2 += 2)
-		{
-		  d1[R3] = d2[1];
-		  d1[G3] = d2[1];
-		  d1[B3] = d2[1];
-		}
-	    }
-	  else
-	    /* 8-bit gray with alpha.  */
-	    {
-	      for (i = 0; i < (data->image_width * data->image_height);
-		   i++, d1 += 4, d2 += 2)
-		{
-		  d1[R4] = d2[1];
-		  d1[G4] = d2[1];
-		  d1[B4] = d2[1];
-		  d1[A4] = d2[0];
-		}
-	    }
-	  break;
-	  /* 8-bit gray without alpha.  */
-	case 1:
-	  for (i = 0; i < (data->image_width * data->image_height);
-	       i++, d1 += 3, d2++)
-	    {
-	      d1[R3] = d2[0];
-	      d1[G3] = d2[0];
-	      d1[B3] = d2[0];
-	    }
-	  break;
-	}
-      return;
-    }
-
-    {
-  /* Only copy the upper 8 bit.  */
-#ifndef GRUB_CPU_WORDS_BIGENDIAN
-      for (i = 0; i < (data->image_width * data->image_height * data->bpp >> 1);
-	   i++, d1++, d2 += 2)
-	*d1 = *d2;
-#else
-      switch (data->bpp)
-	{
-	  /* 16-bit with alpha.  */
-	case 8:
-	  for (i = 0; i < (data->image_width * data->image_height);
-	       i++, d1 += 4, d2+=8)
-	    {
-	      d1[0] = d2[7];
-	      d1[1] = d2[5];
-	      d1[2] = d2[3];
-	      d1[3] = d2[1];
-	    }
-	  break;
-	  /* 16-bit without alpha.  */
-	case 6:
-	  for (i = 0; i < (data->image_width * data->image_height);
-	       i++, d1 += 3, d2+=6)
-	    {
-	      d1[0] = d2[5];
-	      d1[1] = d2[3];
-	      d1[2] = d2[1];
-	    }
-	  break;
-	case 4:
-	  /* 8-bit with alpha.  */
-	  for (i = 0; i < (data->image_width * data->image_height);
-	       i++, d1 += 4, d2 += 4)
-	    {
-	      d1[0] = d2[3];
-	      d1[1] = d2[2];
-	      d1[2] = d2[1];
-	      d1[3] = d2[0];
-	    }
-	  break;
-	  /* 8-bit without alpha.  */
-	case 3:
-	  for (i = 0; i < (data->image_width * data->image_height);
-	       i++, d1 += 3, d2 += 3)
-	    {
-	      d1[0] = d2[2];
-	      d1[1] = d2[1];
-	      d1[2] = d2[0];
-	    }
-	  break;
-	}
-#endif
-    }
-
-}
-
 static grub_err_t
 grub_png_decode_png (struct grub_png_data *data)
 {
@@ -1058,19 +1087,24 @@ grub_png_decode_png (struct grub_png_data *data)
 	  break;
 
 	case PNG_CHUNK_IDAT:
-	  data->inside_idat = 1;
+	  if (!data->row_buf[0])
+	    return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			       "png: missing image header");
+	  if (data->idat_done)
+	    {
+	      grub_file_seek (data->file, data->file->offset + len + 4);
+	      break;
+	    }
+
 	  data->idat_remain = len;
+	  data->in_ptr = data->in_end = data->inbuf;
 	  data->bit_count = 0;
+	  data->bit_save = 0;
 
 	  grub_png_decode_image_data (data);
-
-	  data->inside_idat = 0;
 	  break;
 
 	case PNG_CHUNK_IEND:
-          if (data->image_data)
-            grub_png_convert_image (data);
-
 	  return grub_errno;
 
 	default:
@@ -1107,7 +1141,8 @@ grub_video_reader_png (struct grub_video_bitmap **bitmap,
 
       grub_png_decode_png (data);
 
-      grub_free (data->image_data);
+      grub_free (data->row_buf[0]);
+      grub_free (data->row_buf[1]);
       grub_free (data);
     }
 
@@ -1121,25 +1156,46 @@ grub_video_reader_png (struct grub_video_bitmap **bitmap,
   return grub_errno;
 }
 
-#if defined(PNG_DEBUG)
 static grub_err_t
 grub_cmd_pngtest (grub_command_t cmd_d __attribute__ ((unused)),
 		  int argc, char **args)
 {
   struct grub_video_bitmap *bitmap = 0;
+  unsigned long count = 1, i;
+  grub_uint64_t start, elapsed;
+  unsigned width = 0, height = 0;
 
-  if (argc != 1)
+  if (argc < 1)
     return grub_error (GRUB_ERR_BAD_ARGUMENT, N_("filename expected"));
 
-  grub_video_reader_png (&bitmap, args[0]);
-  if (grub_errno != GRUB_ERR_NONE)
-    return grub_errno;
+  if (argc > 1)
+    {
+      const char *end;
 
-  grub_video_bitmap_destroy (bitmap);
+      count = grub_strtoul (args[1], &end, 0);
+      if (grub_errno || *end || count == 0)
+	return grub_error (GRUB_ERR_BAD_ARGUMENT,
+			   N_("unrecognized number"));
+    }
+
+  start = grub_get_time_ms ();
+  for (i = 0; i < count; i++)
+    {
+      grub_video_reader_png (&bitmap, args[0]);
+      if (grub_errno != GRUB_ERR_NONE)
+	return grub_errno;
+
+      width = bitmap->mode_info.width;
+      height = bitmap->mode_info.height;
+      grub_video_bitmap_destroy (bitmap);
+    }
+  elapsed = grub_get_time_ms () - start;
+
+  grub_printf ("%ux%u: %llu ms per image\n", width, height,
+	       (unsigned long long) (elapsed / count));
 
   return GRUB_ERR_NONE;
 }
-#endif
 
 static struct grub_video_bitmap_reader png_reader = {
   .extension = ".png",
@@ -1150,17 +1206,14 @@ static struct grub_video_bitmap_reader png_reader = {
 GRUB_MOD_INIT (png)
 {
   grub_video_bitmap_reader_register (&png_reader);
-#if defined(PNG_DEBUG)
   cmd = grub_register_command ("pngtest", grub_cmd_pngtest,
-			       "FILE",
-			       "Tests loading of PNG bitmap.");
-#endif
+			       N_("FILE [COUNT]"),
+			       N_("Decode a PNG file COUNT times and show the"
+				  " time each decode took on average."));
 }
 
 GRUB_MOD_FINI (png)
 {
-#if defined(PNG_DEBUG)
   grub_unregister_command (cmd);
-#endif
   grub_video_bitmap_reader_unregister (&png_reader);
 }
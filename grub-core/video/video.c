@@ -22,9 +22,13 @@
 #include <grub/misc.h>
 #include <grub/mm.h>
 #include <grub/i18n.h>
+#include <grub/trace.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
+/* Blits smaller than this are not traced.  */
+#define GRUB_VIDEO_TRACE_MIN_PIXELS 0x10000
+
 /* The list of video adapters registered to system.  */
 grub_video_adapter_t grub_video_adapter_list = NULL;
 
@@ -332,12 +336,26 @@ grub_video_blit_bitmap (struct grub_video_bitmap *bitmap,
                         int x, int y, int offset_x, int offset_y,
                         unsigned int width, unsigned int height)
 {
+  static const char *span;
+  grub_err_t err;
+
   if (! grub_video_adapter_active)
     return grub_error (GRUB_ERR_BAD_DEVICE, "no video mode activated");
 
-  return grub_video_adapter_active->blit_bitmap (bitmap, oper, x, y,
-                                                 offset_x, offset_y,
-                                                 width, height);
+  /* Glyphs and small icons would only fill the trace.  */
+  if ((grub_uint64_t) width * height < GRUB_VIDEO_TRACE_MIN_PIXELS)
+    return grub_video_adapter_active->blit_bitmap (bitmap, oper, x, y,
+                                                   offset_x, offset_y,
+                                                   width, height);
+
+  if (! span)
+    span = grub_trace_intern ("blit_bitmap");
+  grub_trace_begin (GRUB_TRACE_VIDEO, span, (grub_uint64_t) width * height);
+  err = grub_video_adapter_active->blit_bitmap (bitmap, oper, x, y,
+                                                offset_x, offset_y,
+                                                width, height);
+  grub_trace_end (GRUB_TRACE_VIDEO, span, 0);
+  return err;
 }
 
 /* Blit render target to active render target.  */
@@ -347,12 +365,26 @@ grub_video_blit_render_target (struct grub_video_render_target *target,
                                int x, int y, int offset_x, int offset_y,
                                unsigned int width, unsigned int height)
 {
+  static const char *span;
+  grub_err_t err;
+
   if (! grub_video_adapter_active)
     return grub_error (GRUB_ERR_BAD_DEVICE, "no video mode activated");
 
-  return grub_video_adapter_active->blit_render_target (target, oper, x, y,
-                                                        offset_x, offset_y,
-                                                        width, height);
+  /* Cached glyphs and theme layers come through here on every repaint.  */
+  if ((grub_uint64_t) width * height < GRUB_VIDEO_TRACE_MIN_PIXELS)
+    return grub_video_adapter_active->blit_render_target (target, oper, x, y,
+                                                          offset_x, offset_y,
+                                                          width, height);
+
+  if (! span)
+    span = grub_trace_intern ("blit_target");
+  grub_trace_begin (GRUB_TRACE_VIDEO, span, (grub_uint64_t) width * height);
+  err = grub_video_adapter_active->blit_render_target (target, oper, x, y,
+                                                       offset_x, offset_y,
+                                                       width, height);
+  grub_trace_end (GRUB_TRACE_VIDEO, span, 0);
+  return err;
 }
 
 /* Scroll viewport and fill new areas with specified color.  */
@@ -369,10 +401,15 @@ grub_video_scroll (grub_video_color_t color, int dx, int dy)
 grub_err_t
 grub_video_swap_buffers (void)
 {
+  grub_err_t err;
+
   if (! grub_video_adapter_active)
     return grub_error (GRUB_ERR_BAD_DEVICE, "no video mode activated");
 
-  return grub_video_adapter_active->swap_buffers ();
+  grub_trace_begin (GRUB_TRACE_VIDEO, grub_trace_intern ("swap_buffers"), 0);
+  err = grub_video_adapter_active->swap_buffers ();
+  grub_trace_end (GRUB_TRACE_VIDEO, grub_trace_intern ("swap_buffers"), 0);
+  return err;
 }
 
 /* Create new render target.  */
@@ -42,6 +42,13 @@ struct grub_video_bitmap_reader
   grub_err_t (*reader) (struct grub_video_bitmap **bitmap,
                         const char *filename);
 
+  /* Optional reader that may return a bitmap smaller than the image, but
+     at least MIN_WIDTH x MIN_HEIGHT, when it is going to be scaled down.  */
+  grub_err_t (*reader_scaled) (struct grub_video_bitmap **bitmap,
+                               const char *filename,
+                               unsigned int min_width,
+                               unsigned int min_height);
+
   /* Next reader.  */
   struct grub_video_bitmap_reader *next;
 };
@@ -59,6 +66,11 @@ grub_err_t EXPORT_FUNC (grub_video_bitmap_destroy) (struct grub_video_bitmap *bi
 grub_err_t EXPORT_FUNC (grub_video_bitmap_load) (struct grub_video_bitmap **bitmap,
 						 const char *filename);
 
+grub_err_t EXPORT_FUNC (grub_video_bitmap_load_scaled) (struct grub_video_bitmap **bitmap,
+							const char *filename,
+							unsigned int min_width,
+							unsigned int min_height);
+
 /* Return bitmap width.  */
 static inline unsigned int
 grub_video_bitmap_get_width (struct grub_video_bitmap *bitmap)
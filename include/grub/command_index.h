@@ -0,0 +1,53 @@
+/* command_index.h - command.lst for the machine */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_COMMAND_INDEX_H
+#define GRUB_COMMAND_INDEX_H	1
+
+#include <grub/types.h>
+
+/* grub-install writes GRUB_COMMAND_INDEX_NAME next to command.lst, with
+   the same contents: the header, the offsets of the module names, the
+   command table and then the names themselves, NUL-terminated.  Each
+   module is named only once so that normal mode checks only once whether
+   it is loaded.  All the numbers are little-endian.  */
+
+#define GRUB_COMMAND_INDEX_NAME		"command.idx"
+#define GRUB_COMMAND_INDEX_MAGIC	"GRUBCMDS"
+#define GRUB_COMMAND_INDEX_VERSION	1
+
+struct grub_command_index_header
+{
+  char magic[8];
+  grub_uint32_t version;
+  grub_uint32_t nmodules;
+  grub_uint32_t ncommands;
+} GRUB_PACKED;
+
+struct grub_command_index_entry
+{
+  /* Offset of the name from the start of the file.  */
+  grub_uint32_t name;
+  /* Index of the module in the module table.  */
+  grub_uint16_t module;
+  /* 1 for the commands marked with `*' in command.lst.  */
+  grub_uint16_t prio;
+} GRUB_PACKED;
+
+#endif /* ! GRUB_COMMAND_INDEX_H */
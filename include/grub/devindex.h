@@ -0,0 +1,64 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_DEVINDEX_HEADER
+#define GRUB_DEVINDEX_HEADER	1
+
+#include <grub/types.h>
+#include <grub/device.h>
+#include <grub/fs.h>
+
+/* What was found on a disk or partition the first time it was looked at.
+   Values the filesystem doesn't have, or that couldn't be read, are
+   NULL.  */
+struct grub_devindex_entry
+{
+  struct grub_devindex_entry *next;
+  char *name;
+
+  /* Name of the filesystem driver.  */
+  char *fs;
+  char *uuid;
+  char *label;
+  int have_mtime;
+  grub_int32_t mtime;
+
+  /* Name of the partition map and start of the partition in 512-byte
+     sectors, or NULL and 0 for a whole disk.  */
+  char *partmap;
+  grub_disk_addr_t start;
+  /* Size in 512-byte sectors, GRUB_DISK_SIZE_UNKNOWN if unknown.  */
+  grub_uint64_t sectors;
+  unsigned int log_sector_size;
+
+  /* Only valid as long as this is grub_fs_cache_generation.  */
+  unsigned long generation;
+  /* When it was last read or asked for, in milliseconds.  */
+  grub_uint64_t last_use;
+  /* If no filesystem was found, which ones were tried.  */
+  grub_fs_t fs_list;
+  int autoload;
+};
+
+const struct grub_devindex_entry *
+EXPORT_FUNC(grub_devindex_get) (const char *name, grub_device_t dev);
+const struct grub_devindex_entry *
+EXPORT_FUNC(grub_devindex_get_device) (grub_device_t dev);
+void EXPORT_FUNC(grub_devindex_forget) (const char *name);
+
+#endif /* ! GRUB_DEVINDEX_HEADER */
@@ -27,6 +27,7 @@
 #include <grub/elf.h>
 #include <grub/list.h>
 #include <grub/misc.h>
+#include <grub/mm.h>
 #endif
 
 /*
@@ -221,11 +222,23 @@ void
 grub_dl_osdep_dl_free (void *ptr);
 #endif
 
+/* The tag the memory of MOD and what it allocates while it is initialized
+   are charged to.  */
+static inline grub_mm_tag_t
+grub_dl_mm_tag (grub_dl_t mod)
+{
+  return grub_mm_tag_get (mod->name, grub_mm_tag_get ("modules", NULL));
+}
+
 static inline void
 grub_dl_init (grub_dl_t mod)
 {
+  grub_mm_tag_t old_tag;
+
+  old_tag = grub_mm_tag_set (grub_dl_mm_tag (mod));
   if (mod->init)
     (mod->init) (mod);
+  grub_mm_tag_set (old_tag);
 
   mod->next = grub_dl_head;
   grub_dl_head = mod;
@@ -0,0 +1,69 @@
+/* dl_pack.h - all the modules of a platform in one file */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_DL_PACK_H
+#define GRUB_DL_PACK_H	1
+
+#include <grub/types.h>
+
+/* grub-install writes GRUB_DL_PACK_NAME next to the modules.  It starts
+   with the header, the module table, the dependency lists and the module
+   names, index_size bytes in all.  Then come the modules, each in the
+   order of the table and aligned to GRUB_DL_PACK_ALIGN: the ELF file,
+   and at the next 4-byte boundary the symbol map.
+
+   Modules come after all the modules they depend on, and the dependency
+   list of a module holds the indexes of all the modules it needs,
+   directly or not, in ascending order and ending with the module itself.
+   Loading them in that order never has to wait for a dependency.
+
+   The symbol map has an entry for each symbol in the ELF symbol table.
+   Symbols the module imports are numbered the same in all the modules,
+   so that the loader can look each of them up only once; the others are
+   GRUB_DL_PACK_NO_SYMBOL.  All the numbers are little-endian.  */
+
+#define GRUB_DL_PACK_NAME	"modules.pack"
+#define GRUB_DL_PACK_MAGIC	"GRUBPACK"
+#define GRUB_DL_PACK_VERSION	1
+#define GRUB_DL_PACK_ALIGN	16
+#define GRUB_DL_PACK_NO_SYMBOL	0xffffffff
+
+struct grub_dl_pack_header
+{
+  char magic[8];
+  grub_uint32_t version;
+  grub_uint32_t nmodules;
+  /* Number of distinct imported symbols.  */
+  grub_uint32_t nsymbols;
+  grub_uint32_t index_size;
+} GRUB_PACKED;
+
+struct grub_dl_pack_module
+{
+  /* Offset of the name from the start of the file.  */
+  grub_uint32_t name;
+  grub_uint32_t offset;
+  grub_uint32_t size;
+  grub_uint32_t nsymbols;
+  /* Offset of the dependency list and its number of entries.  */
+  grub_uint32_t deps;
+  grub_uint32_t ndeps;
+} GRUB_PACKED;
+
+#endif /* ! GRUB_DL_PACK_H */
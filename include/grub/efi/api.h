@@ -339,6 +339,12 @@
     { 0x83, 0x0b, 0xd9, 0x15, 0x2c, 0x69, 0xaa, 0xe0 } \
   }
 
+/* The boot time trace of grub_trace_export, see include/grub/trace.h.  */
+#define GRUB_EFI_GRUB_TRACE_GUID \
+  { 0xc44cdec3, 0xc6ad, 0x4969, \
+    { 0x97, 0x44, 0x87, 0x5b, 0xec, 0x16, 0x66, 0x53 } \
+  }
+
 #define GRUB_EFI_VENDOR_APPLE_GUID \
   { 0x2B0585EB, 0xD8B8, 0x49A9,	\
     { 0x8B, 0x8C, 0xE2, 0x1B, 0x01, 0xAE, 0xF2, 0xB7 } \
@@ -165,6 +165,10 @@ struct grub_file
   /* Filesystem-specific data.  */
   void *data;
 
+  /* Data from the filesystem's fs_mount, shared with other files.  The
+     device belongs to it then.  */
+  void *mount;
+
   /* This is called when a sector is read. Used only for a disk device.  */
   grub_disk_read_hook_t read_hook;
 
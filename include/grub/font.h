@@ -45,6 +45,20 @@ struct grub_font
   grub_uint32_t num_chars;
   struct char_index_entry *char_index;
   grub_uint16_t *bmp_idx;
+
+  /* For every 256 code points above the BMP, the first entry of
+     char_index at or after them.  */
+  grub_uint32_t *astral_idx;
+  grub_uint32_t astral_blocks;
+
+  /* The DATA section, if it was read in whole when loading the font.  */
+  grub_uint8_t *data;
+  grub_off_t data_start;
+  grub_size_t data_size;
+
+  /* Space glyphs decoded from DATA are carved from.  */
+  grub_uint8_t *glyph_arena;
+  grub_size_t glyph_arena_left;
 };
 
 /* Font type used to access font functions.  */
@@ -97,6 +111,9 @@ struct grub_font_glyph
    Must be called before any fonts are loaded or used.  */
 void grub_font_loader_init (void);
 
+/* Release what the font loader registered, before it is unloaded.  */
+void grub_font_loader_fini (void);
+
 /* Load a font and add it to the beginning of the global font list.
    Returns: 0 upon success; nonzero upon failure.  */
 grub_font_t EXPORT_FUNC(grub_font_load) (const char *filename);
@@ -150,4 +167,26 @@ struct grub_font_glyph *
 EXPORT_FUNC (grub_font_construct_glyph) (grub_font_t hinted_font,
 			   const struct grub_unicode_glyph *glyph_id);
 
+/* Draw the glyph for GLYPH_ID on a WIDTH x HEIGHT cell filled with BG.  The
+   rendered cell is cached, so drawing it again is a plain copy.  */
+grub_err_t
+EXPORT_FUNC (grub_font_draw_glyph_cell) (grub_font_t font,
+					 const struct grub_unicode_glyph *glyph_id,
+					 grub_video_color_t fg,
+					 grub_video_color_t bg,
+					 int x, int y,
+					 unsigned width, unsigned height,
+					 int ascent);
+
+grub_err_t
+EXPORT_FUNC (grub_font_draw_glyph_cached) (grub_font_t font,
+					   const struct grub_unicode_glyph *glyph_id,
+					   grub_video_color_t color,
+					   int left_x, int baseline_y,
+					   int *device_width);
+
+/* Drop all cached rendered glyphs.  Must be called before the video mode
+   or the palette changes.  */
+void EXPORT_FUNC (grub_font_flush_rendered_glyphs) (void);
+
 #endif /* ! GRUB_FONT_HEADER */
@@ -47,6 +47,24 @@ typedef int (*grub_fs_dir_hook_t) (const char *filename,
 				   const struct grub_dirhook_info *info,
 				   void *data);
 
+/* Longest magic number in a signature.  */
+#define GRUB_FS_SIGNATURE_MAX	16
+
+/* A magic number found at OFFSET bytes from the start of every device
+   with a given filesystem.  */
+struct grub_fs_signature
+{
+  grub_uint32_t offset;
+  grub_uint32_t len;
+  const char *magic;
+};
+
+/* Drivers list their signatures with this, so that fs_signatures.h is
+   generated from them for modules that aren't loaded.  */
+#ifndef GRUB_FS_SIGNATURE
+#define GRUB_FS_SIGNATURE(offset, len, magic) { (offset), (len), (magic) }
+#endif
+
 /* Filesystem descriptor.  */
 struct grub_fs
 {
@@ -64,6 +82,14 @@ struct grub_fs
   /* Open a file named NAME and initialize FILE.  */
   grub_err_t (*fs_open) (struct grub_file *file, const char *name);
 
+  /* Optional.  Read the filesystem on DEVICE and return in DATA what
+     fs_open needs.  If present, the data is shared by all the files opened
+     on the same partition and fs_open finds it in FILE->mount.  */
+  grub_err_t (*fs_mount) (grub_device_t device, void **data);
+
+  /* Free the data returned by fs_mount.  */
+  void (*fs_unmount) (void *data);
+
   /* Read LEN bytes data from FILE into BUF.  */
   grub_ssize_t (*fs_read) (struct grub_file *file, char *buf, grub_size_t len);
 
@@ -83,6 +109,10 @@ struct grub_fs
   /* Get writing time of filesystem. */
   grub_err_t (*fs_mtime) (grub_device_t device, grub_int32_t *timebuf);
 
+  /* Signatures, ended by one of length 0.  The filesystem is only probed
+     on devices where one of them is found.  NULL to probe it everywhere.  */
+  const struct grub_fs_signature *signatures;
+
 #ifdef GRUB_UTIL
   /* Determine sectors available for embedding.  */
   grub_err_t (*fs_embed) (grub_device_t device, unsigned int *nsectors,
@@ -102,11 +132,12 @@ typedef struct grub_fs *grub_fs_t;
 /* This is special, because block lists are not files in usual sense.  */
 extern struct grub_fs grub_fs_blocklist;
 
-/* This hook is used to automatically load filesystem modules.
-   If this hook loads a module, return non-zero. Otherwise return zero.
-   The newly loaded filesystem is assumed to be inserted into the head of
-   the linked list GRUB_FS_LIST through the function grub_fs_register.  */
-typedef int (*grub_fs_autoload_hook_t) (void);
+/* This hook is used to automatically load filesystem modules that may be
+   on DISK.  If this hook loads a module, return non-zero. Otherwise return
+   zero.  The newly loaded filesystem is assumed to be inserted into the
+   head of the linked list GRUB_FS_LIST through the function
+   grub_fs_register.  */
+typedef int (*grub_fs_autoload_hook_t) (struct grub_disk *disk);
 extern grub_fs_autoload_hook_t EXPORT_VAR(grub_fs_autoload_hook);
 extern grub_fs_t EXPORT_VAR (grub_fs_list);
 
@@ -118,14 +149,22 @@ grub_fs_register (grub_fs_t fs)
 }
 #endif
 
+void EXPORT_FUNC(grub_fs_cache_invalidate) (struct grub_disk *disk);
+extern unsigned long EXPORT_VAR (grub_fs_cache_generation);
+
 static inline void
 grub_fs_unregister (grub_fs_t fs)
 {
+  grub_fs_cache_invalidate (0);
   grub_list_remove (GRUB_AS_LIST (fs));
 }
 
 #define FOR_FILESYSTEMS(var) FOR_LIST_ELEMENTS((var), (grub_fs_list))
 
 grub_fs_t EXPORT_FUNC(grub_fs_probe) (grub_device_t device);
+int EXPORT_FUNC(grub_fs_signatures_match) (struct grub_disk *disk,
+					   const struct grub_fs_signature *sigs);
+void *EXPORT_FUNC(grub_fs_mount) (grub_fs_t fs, grub_device_t *device);
+void EXPORT_FUNC(grub_fs_unmount) (void *data);
 
 #endif /* ! GRUB_FS_HEADER */
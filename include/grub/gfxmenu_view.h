@@ -55,12 +55,21 @@ void
 grub_gfxmenu_view_redraw (grub_gfxmenu_view_t view,
 			  const grub_video_rect_t *region);
 
+void
+grub_gfxmenu_view_invalidate (grub_gfxmenu_view_t view,
+			      const grub_video_rect_t *region);
+
+void
+grub_gfxmenu_view_present (grub_gfxmenu_view_t view, int force);
+
 void 
 grub_gfxmenu_clear_timeout (void *data);
 void 
 grub_gfxmenu_print_timeout (int timeout, void *data);
 void
 grub_gfxmenu_set_chosen_entry (int entry, void *data);
+void
+grub_gfxmenu_idle (void *data);
 
 grub_err_t grub_font_draw_string (const char *str,
 				  grub_font_t font,
@@ -68,6 +77,7 @@ grub_err_t grub_font_draw_string (const char *str,
 				  int left_x, int baseline_y);
 int grub_font_get_string_width (grub_font_t font,
 				const char *str);
+void grub_font_flush_shaped_runs (void);
 
 
 /* Implementation details -- this should not be used outside of the
@@ -80,6 +90,28 @@ int grub_font_get_string_width (grub_font_t font,
 #include <grub/gfxwidgets.h>
 #include <grub/icon_manager.h>
 
+grub_err_t
+grub_gfxmenu_bitmap_cache_load (struct grub_video_bitmap **bitmap,
+				const char *path, int width, int height,
+				grub_video_bitmap_selection_method_t
+				selection_method,
+				grub_video_bitmap_v_align_t v_align,
+				grub_video_bitmap_h_align_t h_align);
+grub_err_t
+grub_gfxmenu_bitmap_cache_scale (struct grub_video_bitmap **bitmap,
+				 struct grub_video_bitmap *src,
+				 int width, int height);
+void grub_gfxmenu_bitmap_cache_release (struct grub_video_bitmap *bitmap);
+void grub_gfxmenu_bitmap_cache_flush (void);
+void grub_gfxmenu_bitmap_cache_init (void);
+void grub_gfxmenu_bitmap_cache_fini (void);
+
+/* Most regions a view keeps apart while they wait to be presented.  */
+#define GRUB_GFXMENU_MAX_DAMAGE	8
+
+/* Default for $gfxmenu_fps.  */
+#define GRUB_GFXMENU_DEFAULT_FPS	60
+
 /* Definition of the private representation of the view.  */
 struct grub_gfxmenu_view
 {
@@ -95,7 +127,7 @@ struct grub_gfxmenu_view
   grub_video_rgba_color_t title_color;
   grub_video_rgba_color_t message_color;
   grub_video_rgba_color_t message_bg_color;
-  struct grub_video_bitmap *raw_desktop_image;
+  char *desktop_image_path;
   struct grub_video_bitmap *scaled_desktop_image;
   grub_video_bitmap_selection_method_t desktop_image_scale_method;
   grub_video_bitmap_h_align_t desktop_image_h_align;
@@ -108,8 +140,21 @@ struct grub_gfxmenu_view
 
   grub_gui_container_t canvas;
 
+  /* Background, title and every component that doesn't change while the
+     menu is shown, pre-rendered.  NULL if it couldn't be allocated.  */
+  struct grub_video_render_target *static_layer;
+
   int double_repaint;
 
+  /* Regions changed since the last frame, see
+     grub_gfxmenu_view_invalidate.  */
+  grub_video_rect_t damage[GRUB_GFXMENU_MAX_DAMAGE];
+  int n_damage;
+
+  /* Shortest time between two frames in milliseconds, 0 for no limit.  */
+  grub_uint32_t frame_interval;
+  grub_uint64_t last_frame;
+
   int selected;
 
   grub_video_rect_t progress_message_frame;
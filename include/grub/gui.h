@@ -117,6 +117,17 @@ grub_gfxmenu_timeout_unregister (grub_gui_component_t self)
       }
 }
 
+/* Which components containers paint.  The view uses this to compose its
+   cached static layer and to draw the dynamic components over it.  */
+typedef enum
+  {
+    GRUB_GUI_PAINT_ALL,
+    GRUB_GUI_PAINT_STATIC,
+    GRUB_GUI_PAINT_DYNAMIC
+  } grub_gui_paint_layer_t;
+
+extern grub_gui_paint_layer_t grub_gui_paint_layer;
+
 typedef signed grub_fixed_signed_t;
 #define GRUB_FIXED_1 0x10000
 
@@ -279,4 +290,29 @@ grub_video_bounds_inside_region (const grub_video_rect_t *b,
   return 1;
 }
 
+/* Components whose look changes while the menu is shown: the menu list
+   and everything that follows the timeout.  */
+static inline int
+grub_gui_component_is_dynamic (grub_gui_component_t comp)
+{
+  struct grub_gfxmenu_timeout_notify *cur;
+
+  if (comp->ops->is_instance (comp, "list"))
+    return 1;
+  for (cur = grub_gfxmenu_timeout_notifications; cur; cur = cur->next)
+    if (cur->self == comp)
+      return 1;
+  return 0;
+}
+
+static inline int
+grub_gui_should_paint (grub_gui_component_t comp)
+{
+  if (grub_gui_paint_layer == GRUB_GUI_PAINT_ALL
+      || comp->ops->is_instance (comp, "container"))
+    return 1;
+  return grub_gui_component_is_dynamic (comp)
+    == (grub_gui_paint_layer == GRUB_GUI_PAINT_DYNAMIC);
+}
+
 #endif /* ! GRUB_GUI_H */
@@ -20,6 +20,8 @@
 #ifndef GRUB_MENU_HEADER
 #define GRUB_MENU_HEADER 1
 
+struct grub_script;
+
 struct grub_menu_entry_class
 {
   char *name;
@@ -50,6 +52,10 @@ struct grub_menu_entry
   /* The sourcecode of the menu entry, used by the editor.  */
   const char *sourcecode;
 
+  /* The body as it was parsed with the configuration file, run instead of
+     the sourcecode if set.  */
+  struct grub_script *script;
+
   /* Parameters to be passed to menu definition.  */
   int argc;
   char **args;
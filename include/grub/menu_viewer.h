@@ -33,6 +33,8 @@ struct grub_menu_viewer
   void (*set_chosen_entry) (int entry, void *data);
   void (*print_timeout) (int timeout, void *data);
   void (*clear_timeout) (void *data);
+  /* Optional, called repeatedly while the menu waits for a key.  */
+  void (*idle) (void *data);
   void (*fini) (void *fini);
 };
 
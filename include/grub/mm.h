@@ -38,6 +38,48 @@ void *EXPORT_FUNC(grub_realloc) (void *ptr, grub_size_t size);
 void *EXPORT_FUNC(grub_memalign) (grub_size_t align, grub_size_t size);
 #endif
 
+/* Every allocation is charged to the current tag and to all its parents,
+   up to the root tag which holds the whole heap.  Tags are never freed,
+   so that allocations which outlive the module that tagged them can still
+   be accounted for when they are freed.  */
+struct grub_mm_tag
+{
+  struct grub_mm_tag *next;
+  struct grub_mm_tag *parent;
+  char *name;
+  /* Bytes allocated, headers included.  */
+  grub_size_t live;
+  grub_size_t peak;
+  grub_size_t count;
+  /* Allocations beyond it fail, after the evictors of the tag had their
+     chance.  0 for no limit.  */
+  grub_size_t limit;
+};
+typedef struct grub_mm_tag *grub_mm_tag_t;
+
+/* Caches register an evictor to free what they hold when memory runs out,
+   before allocations fail.  EVICT must not allocate memory, and must not
+   free anything its callers may still be using.  */
+struct grub_mm_evictor
+{
+  struct grub_mm_evictor *next;
+  struct grub_mm_evictor **prev;
+  /* Tag of the memory the evictor frees.  */
+  grub_mm_tag_t tag;
+  void (*evict) (void);
+};
+typedef struct grub_mm_evictor *grub_mm_evictor_t;
+
+grub_mm_tag_t EXPORT_FUNC(grub_mm_tag_get) (const char *name,
+					    grub_mm_tag_t parent);
+grub_mm_tag_t EXPORT_FUNC(grub_mm_tag_set) (grub_mm_tag_t tag);
+void EXPORT_FUNC(grub_mm_evictor_register) (grub_mm_evictor_t evictor);
+void EXPORT_FUNC(grub_mm_evictor_unregister) (grub_mm_evictor_t evictor);
+#ifndef GRUB_MACHINE_EMU
+/* All the tags, the root first and parents before their children.  */
+extern grub_mm_tag_t EXPORT_VAR(grub_mm_tags);
+#endif
+
 void grub_mm_check_real (const char *file, int line);
 #define grub_mm_check() grub_mm_check_real (GRUB_FILE, __LINE__);
 
@@ -20,23 +20,23 @@
 #define GRUB_MM_PRIVATE_H	1
 
 #include <grub/mm.h>
+#include <grub/err.h>
 
 /* Magic words.  */
 #define GRUB_MM_FREE_MAGIC	0x2d3c2808
 #define GRUB_MM_ALLOC_MAGIC	0x6db08fa4
+/* A block in pages of its own, outside of the heap.  Its NEXT is the
+   start of the pages and its size runs up to their end.  */
+#define GRUB_MM_HUGE_MAGIC	0x4c50a3d6
 
 typedef struct grub_mm_header
 {
   struct grub_mm_header *next;
   grub_size_t size;
   grub_size_t magic;
-#if GRUB_CPU_SIZEOF_VOID_P == 4
-  char padding[4];
-#elif GRUB_CPU_SIZEOF_VOID_P == 8
-  char padding[8];
-#else
-# error "unknown word size"
-#endif
+  /* What the block is charged to, NULL if it is not accounted for.  Free
+     blocks don't use it.  */
+  grub_mm_tag_t tag;
 }
 *grub_mm_header_t;
 
@@ -44,6 +44,8 @@ typedef struct grub_mm_header
 # define GRUB_MM_ALIGN_LOG2	4
 #elif GRUB_CPU_SIZEOF_VOID_P == 8
 # define GRUB_MM_ALIGN_LOG2	5
+#else
+# error "unknown word size"
 #endif
 
 #define GRUB_MM_ALIGN	(1 << GRUB_MM_ALIGN_LOG2)
@@ -59,6 +61,34 @@ typedef struct grub_mm_region
 
 #ifndef GRUB_MACHINE_EMU
 extern grub_mm_region_t EXPORT_VAR (grub_mm_base);
+
+/* Flags for grub_mm_add_region_fn.  */
+#define GRUB_MM_ADD_REGION_NONE		0
+/* All the memory must be in one region.  */
+#define GRUB_MM_ADD_REGION_CONSECUTIVE	(1 << 0)
+
+/* Set by the platforms which can get more memory when the heap runs out:
+   pass at least BYTES more to grub_mm_init_region.  */
+typedef grub_err_t (*grub_mm_add_region_func_t) (grub_size_t bytes,
+						 unsigned int flags);
+extern grub_mm_add_region_func_t EXPORT_VAR (grub_mm_add_region_fn);
+
+/* Allocations of GRUB_MM_HUGE_SIZE bytes or more get pages of their own
+   from the platform if it sets these, so that they don't fragment the
+   heap.  Sizes are multiples of GRUB_MM_HUGE_PAGE_SIZE, and the pages
+   must be aligned to it.  */
+#define GRUB_MM_HUGE_SIZE	(2 << 20)
+#define GRUB_MM_HUGE_PAGE_SIZE	0x1000
+
+typedef void *(*grub_mm_alloc_pages_func_t) (grub_size_t bytes);
+typedef void (*grub_mm_free_pages_func_t) (void *addr, grub_size_t bytes);
+extern grub_mm_alloc_pages_func_t EXPORT_VAR (grub_mm_alloc_pages_fn);
+extern grub_mm_free_pages_func_t EXPORT_VAR (grub_mm_free_pages_fn);
+
+/* The allocator keeps an index of the free blocks besides the rings.  Code
+   which changes the rings or the regions behind its back must call this,
+   and the index is rebuilt from the rings when it is needed next.  */
+void EXPORT_FUNC (grub_mm_invalidate_index) (void);
 #endif
 
 #endif
@@ -37,7 +37,9 @@ enum
     GRUB_NET_OUR_MAX_IP_HEADER_SIZE = 40,
     GRUB_NET_TCP_RESERVE_SIZE = GRUB_NET_TCP_HEADER_SIZE 
     + GRUB_NET_OUR_IPV4_HEADER_SIZE
-    + GRUB_NET_MAX_LINK_HEADER_SIZE
+    + GRUB_NET_MAX_LINK_HEADER_SIZE,
+    /* Number of preallocated receive buffers per card.  */
+    GRUB_NET_RX_POOL_SIZE = 64
   };
 
 typedef enum grub_link_level_protocol_id 
@@ -132,6 +134,7 @@ struct grub_net_card
   grub_size_t rcvbufsize;
   grub_size_t txbufsize;
   int txbusy;
+  struct grub_net_buff_pool *rx_pool;
   union
   {
 #ifdef GRUB_MACHINE_EFI
@@ -250,6 +253,9 @@ grub_net_remove_packet (grub_net_packet_t *pkt)
 
 typedef struct grub_net_app_protocol *grub_net_app_level_t;
 
+grub_err_t
+grub_net_deliver_packet (struct grub_file *file, struct grub_net_buff *nb);
+
 typedef struct grub_net_socket *grub_net_socket_t;
 
 struct grub_net_app_protocol 
@@ -262,6 +268,11 @@ struct grub_net_app_protocol
 				  const struct grub_dirhook_info *info));
   grub_err_t (*open) (struct grub_file *file, const char *filename);
   grub_err_t (*seek) (struct grub_file *file, grub_off_t off);
+  /* Optional.  Read directly into BUF at the current offset, bypassing
+     the packet queue.  Returns the number of bytes read, 0 if the request
+     should go through the queue instead or -1 on error.  Called with BUF
+     NULL for data that is skipped, which must go through the queue.  */
+  grub_ssize_t (*read) (struct grub_file *file, char *buf, grub_size_t len);
   grub_err_t (*close) (struct grub_file *file);
   grub_err_t (*packets_pulled) (struct grub_file *file);
 };
@@ -276,6 +287,13 @@ typedef struct grub_net
   grub_fs_t fs;
   int eof;
   int stall;
+  /* Destination of the read in progress, if any.  In-order payload
+     arriving while a read is pending is copied straight to it instead of
+     being queued on packs.  read_buf is NULL when the data is being
+     skipped.  */
+  int read_pending;
+  char *read_buf;
+  grub_size_t read_len;
 } *grub_net_t;
 
 extern grub_net_t (*EXPORT_VAR (grub_net_open)) (const char *name);
@@ -381,6 +399,14 @@ grub_net_card_register (struct grub_net_card *card)
 void
 grub_net_card_unregister (struct grub_net_card *card);
 
+/* Get a buffer for an incoming packet, from the card receive pool when
+   possible.  */
+static inline struct grub_net_buff *
+grub_net_card_rx_alloc (struct grub_net_card *card, grub_size_t len)
+{
+  return grub_netbuff_pool_alloc (card->rx_pool, len);
+}
+
 #define FOR_NET_CARDS(var) for (var = grub_net_cards; var; var = var->next)
 #define FOR_NET_CARDS_SAFE(var, next) for (var = grub_net_cards, next = (var ? var->next : 0); var; var = next, next = (var ? var->next : 0))
 
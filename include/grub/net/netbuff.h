@@ -5,6 +5,9 @@
 
 #define NETBUFF_ALIGN 2048
 #define NETBUFFMINLEN 64
+#define NETBUFF_POOL_ALIGN 64
+
+struct grub_net_buff_pool;
 
 struct grub_net_buff
 {
@@ -16,6 +19,22 @@ struct grub_net_buff
   grub_uint8_t *tail;
   /* Pointer to the end of the buffer.  */
   grub_uint8_t *end;
+  /* Pool this buffer was taken from or NULL if it's heap-allocated.  */
+  struct grub_net_buff_pool *pool;
+  /* Next entry on the pool free list.  */
+  struct grub_net_buff *next_free;
+};
+
+/* Fixed set of equally sized buffers carved out of a single allocation
+   and recycled through a free list.  */
+struct grub_net_buff_pool
+{
+  void *mem;
+  struct grub_net_buff *free_list;
+  grub_size_t bufsize;
+  unsigned count;
+  unsigned in_use;
+  int dead;
 };
 
 grub_err_t grub_netbuff_put (struct grub_net_buff *net_buff, grub_size_t len);
@@ -28,4 +47,10 @@ struct grub_net_buff * grub_netbuff_alloc (grub_size_t len);
 struct grub_net_buff * grub_netbuff_make_pkt (grub_size_t len);
 void grub_netbuff_free (struct grub_net_buff *net_buff);
 
+struct grub_net_buff_pool *grub_netbuff_pool_create (grub_size_t bufsize,
+						     unsigned count);
+void grub_netbuff_pool_destroy (struct grub_net_buff_pool *pool);
+struct grub_net_buff *grub_netbuff_pool_alloc (struct grub_net_buff_pool *pool,
+					       grub_size_t len);
+
 #endif
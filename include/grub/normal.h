@@ -66,6 +66,15 @@ void grub_menu_init_page (int nested, int edit,
 			  struct grub_term_output *term);
 void grub_normal_init_page (struct grub_term_output *term, int y);
 char *grub_file_getline (grub_file_t file);
+
+/* Reads the lines of a file a block at a time, rather than a byte at a
+   time like grub_file_getline.  */
+struct grub_linereader;
+typedef struct grub_linereader *grub_linereader_t;
+
+grub_linereader_t grub_linereader_open (grub_file_t file);
+char *grub_linereader_getline (grub_linereader_t reader);
+void grub_linereader_close (grub_linereader_t reader);
 void grub_cmdline_run (int nested, int force_auth);
 
 /* Defined in `cmdline.c'.  */
@@ -121,6 +130,7 @@ void free_handler_list (void);
 
 /* Defined in `dyncmd.c'.  */
 void read_command_list (const char *prefix);
+void grub_dyncmd_preload (const char *names);
 
 /* Defined in `autofs.c'.  */
 void read_fs_list (const char *prefix);
@@ -145,7 +155,7 @@ grub_normal_add_menu_entry (int argc, const char **args, char **classes,
 			    const char *id,
 			    const char *users, const char *hotkey,
 			    const char *prefix, const char *sourcecode,
-			    int submenu);
+			    struct grub_script *script, int submenu);
 
 grub_err_t
 grub_normal_set_password (const char *user, const char *password);
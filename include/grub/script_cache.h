@@ -0,0 +1,129 @@
+/* script_cache.h - parsed configuration files */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_SCRIPT_CACHE_HEADER
+#define GRUB_SCRIPT_CACHE_HEADER	1
+
+#include <grub/types.h>
+#include <grub/err.h>
+#include <grub/script_sh.h>
+
+/* A configuration file FILE may come with FILE.bin, written by
+   grub-script-check --output: what parsing FILE gives, so that reading it
+   needs neither the lexer nor the parser.  It is only used while the size
+   and the hash of FILE are those it was made from.
+
+   The format is little-endian: the header, then records which start with
+   their kind, up to GRUB_SCRIPT_CACHE_END.  A statement is the command of
+   one grub_script_parse of the file, to be executed.  A function is the
+   name and the command of a function that parse defined, to be defined
+   before the statement is executed.
+
+   Everything else is 32-bit words and strings.  A string is its length,
+   counting its terminating zero, then its bytes.  A command is its kind,
+   then:
+     LINE: its argument list.
+     LIST: the number of its commands, then the commands.
+     IF: the condition, the command if true, the command if false.
+     FOR: the name of the variable, the word list, the body.
+     WHILE, UNTIL: the condition, the body.
+   An argument list is the number of its arguments, then the arguments.  An
+   argument is the number of its parts, then the type and the string of
+   each, followed by the command of the block for blocks.  */
+
+#define GRUB_SCRIPT_CACHE_MAGIC		"GRUBSCRC"
+#define GRUB_SCRIPT_CACHE_VERSION	1
+#define GRUB_SCRIPT_CACHE_SUFFIX	".bin"
+
+struct grub_script_cache_header
+{
+  char magic[8];
+  grub_uint32_t version;
+  grub_uint32_t reserved;
+  /* The configuration file the cache was made from.  */
+  grub_uint64_t source_size;
+  grub_uint64_t source_hash;
+} GRUB_PACKED;
+
+enum grub_script_cache_record
+  {
+    GRUB_SCRIPT_CACHE_END,
+    GRUB_SCRIPT_CACHE_STATEMENT,
+    GRUB_SCRIPT_CACHE_FUNCTION
+  };
+
+enum grub_script_cache_cmd
+  {
+    GRUB_SCRIPT_CACHE_CMD_NONE,
+    GRUB_SCRIPT_CACHE_CMD_LINE,
+    GRUB_SCRIPT_CACHE_CMD_LIST,
+    GRUB_SCRIPT_CACHE_CMD_IF,
+    GRUB_SCRIPT_CACHE_CMD_FOR,
+    GRUB_SCRIPT_CACHE_CMD_WHILE,
+    GRUB_SCRIPT_CACHE_CMD_UNTIL
+  };
+
+/* A record of a loaded cache.  */
+struct grub_script_cache_entry
+{
+  struct grub_script_cache_entry *next;
+
+  /* The name of the function SCRIPT is the body of, NULL for a
+     statement.  */
+  char *name;
+
+  struct grub_script *script;
+};
+
+/* The hash is 64-bit FNV-1a, which is cheap to compute while the file is
+   read.  */
+#define GRUB_SCRIPT_CACHE_HASH_INIT	0xcbf29ce484222325ULL
+
+grub_uint64_t grub_script_cache_hash (grub_uint64_t hash, const void *buf,
+				      grub_size_t size);
+
+struct grub_script_cache_entry *
+grub_script_cache_load (const void *buf, grub_size_t size,
+			grub_uint64_t source_size, grub_uint64_t source_hash);
+grub_err_t grub_script_cache_execute (struct grub_script_cache_entry *entry);
+void grub_script_cache_free (struct grub_script_cache_entry *entries);
+
+#ifdef GRUB_UTIL
+struct grub_script_cache_writer
+{
+  char *buf;
+  grub_size_t size;
+  grub_size_t allocated;
+};
+
+grub_err_t
+grub_script_cache_write_header (struct grub_script_cache_writer *writer,
+				grub_uint64_t source_size,
+				grub_uint64_t source_hash);
+grub_err_t
+grub_script_cache_write_statement (struct grub_script_cache_writer *writer,
+				   struct grub_script *script);
+grub_err_t
+grub_script_cache_write_function (struct grub_script_cache_writer *writer,
+				  const char *name, struct grub_script *script);
+grub_err_t
+grub_script_cache_write_end (struct grub_script_cache_writer *writer);
+#endif
+
+#endif /* ! GRUB_SCRIPT_CACHE_HEADER */
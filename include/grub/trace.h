@@ -0,0 +1,138 @@
+/* trace.h - boot time tracing */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_TRACE_HEADER
+#define GRUB_TRACE_HEADER	1
+
+#include <grub/types.h>
+#include <grub/symbol.h>
+
+/* With --enable-boot-time, spans (a begin and an end event) around the
+   slow operations and the grub_boot_time checkpoints are kept in a ring
+   buffer, and counters add up what happened.  Names must stay valid for
+   the rest of the session: the kernel may use static strings, modules
+   which may be unloaded pass theirs through grub_trace_intern.  */
+
+enum grub_trace_category
+  {
+    GRUB_TRACE_MARK,
+    GRUB_TRACE_DISK,
+    GRUB_TRACE_FS,
+    GRUB_TRACE_FILE,
+    GRUB_TRACE_DECOMPRESS,
+    GRUB_TRACE_MODULE,
+    GRUB_TRACE_CRYPTO,
+    GRUB_TRACE_VIDEO,
+    GRUB_TRACE_NCATEGORIES
+  };
+
+#define GRUB_TRACE_CATEGORY_NAMES \
+  { "mark", "disk", "fs", "file", "decompress", "module", "crypto", "video" }
+
+enum grub_trace_type
+  {
+    GRUB_TRACE_BEGIN,
+    GRUB_TRACE_END,
+    /* A point in time, like a grub_boot_time checkpoint.  */
+    GRUB_TRACE_INSTANT
+  };
+
+enum grub_trace_counter
+  {
+    GRUB_TRACE_DISK_READS,
+    GRUB_TRACE_DISK_READ_BYTES,
+    GRUB_TRACE_DISK_CACHE_HITS,
+    GRUB_TRACE_DISK_CACHE_MISSES,
+    GRUB_TRACE_FS_CACHE_HITS,
+    GRUB_TRACE_FILE_READ_BYTES,
+    GRUB_TRACE_DECOMPRESSED_BYTES,
+    GRUB_TRACE_ALLOCATIONS,
+    GRUB_TRACE_ALLOCATED_BYTES,
+    GRUB_TRACE_NCOUNTERS
+  };
+
+#define GRUB_TRACE_COUNTER_NAMES \
+  { "disk_reads", "disk_read_bytes", "disk_cache_hits", "disk_cache_misses", \
+    "fs_cache_hits", "file_read_bytes", "decompressed_bytes", "allocations", \
+    "allocated_bytes" }
+
+/* grub_trace_export writes the trace in this format, little-endian: the
+   header, the counters, the events in the order they happened and the
+   strings they refer to by their offset from the start of the string
+   table.  */
+
+#define GRUB_TRACE_MAGIC	"GRUBTRCE"
+#define GRUB_TRACE_VERSION	1
+
+struct grub_trace_header
+{
+  char magic[8];
+  grub_uint32_t version;
+  grub_uint32_t size;
+  grub_uint32_t ncounters;
+  grub_uint32_t nevents;
+  /* Events lost because the ring buffer was full.  */
+  grub_uint32_t dropped;
+  /* Offset of the string table from the start of the header.  */
+  grub_uint32_t strings;
+} GRUB_PACKED;
+
+struct grub_trace_counter_record
+{
+  grub_uint32_t name;
+  grub_uint32_t reserved;
+  grub_uint64_t value;
+} GRUB_PACKED;
+
+struct grub_trace_record
+{
+  /* In microseconds, on the clock of grub_get_time_ms.  */
+  grub_uint64_t time;
+  /* What the operation was about, like the sector or the size.  */
+  grub_uint64_t value;
+  grub_uint32_t name;
+  grub_uint8_t type;
+  grub_uint8_t category;
+  grub_uint16_t reserved;
+} GRUB_PACKED;
+
+#if BOOT_TIME_STATS
+
+extern grub_uint64_t EXPORT_VAR(grub_trace_counters)[GRUB_TRACE_NCOUNTERS];
+
+void EXPORT_FUNC(grub_real_trace) (enum grub_trace_type type,
+				   enum grub_trace_category category,
+				   const char *name, grub_uint64_t value);
+const char *EXPORT_FUNC(grub_trace_intern) (const char *name);
+void *EXPORT_FUNC(grub_trace_export) (grub_size_t *size);
+
+#define grub_trace_begin(category, name, value) \
+  grub_real_trace (GRUB_TRACE_BEGIN, category, name, value)
+#define grub_trace_end(category, name, value) \
+  grub_real_trace (GRUB_TRACE_END, category, name, value)
+#define grub_trace_count(counter, n) \
+  (grub_trace_counters[counter] += (n))
+#else
+#define grub_trace_intern(name) (name)
+#define grub_trace_begin(category, name, value) do { } while (0)
+#define grub_trace_end(category, name, value) do { } while (0)
+#define grub_trace_count(counter, n) do { } while (0)
+#endif
+
+#endif /* ! GRUB_TRACE_HEADER */
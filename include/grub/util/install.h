@@ -142,6 +142,12 @@ void
 grub_install_copy_files (const char *src,
 			 const char *dst,
 			 enum grub_install_plat platid);
+void
+grub_install_make_module_pack (const char *dst,
+			       enum grub_install_plat platid);
+void
+grub_install_make_command_index (const char *dst,
+				 enum grub_install_plat platid);
 char *
 grub_install_get_platform_name (enum grub_install_plat platid);
 
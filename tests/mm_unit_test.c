@@ -0,0 +1,247 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026 Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* grub-emu and the utilities allocate with the host's malloc, so the
+   allocator of the other platforms is built here under other names, and
+   run on an arena of its own.  */
+#define grub_calloc mm_test_calloc
+#define grub_malloc mm_test_malloc
+#define grub_zalloc mm_test_zalloc
+#define grub_free mm_test_free
+#define grub_realloc mm_test_realloc
+#define grub_memalign mm_test_memalign
+#define grub_mm_init_region mm_test_init_region
+#define grub_mm_tag_get mm_test_tag_get
+#define grub_mm_tag_set mm_test_tag_set
+#define grub_mm_evictor_register mm_test_evictor_register
+#define grub_mm_evictor_unregister mm_test_evictor_unregister
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <grub/test.h>
+
+#include "../grub-core/kern/mm.c"
+
+#define ARENA_SIZE	(32 << 20)
+#define MAX_LIVE	65536
+
+struct block
+{
+  unsigned char *ptr;
+  grub_size_t size;
+};
+
+static struct block live[MAX_LIVE];
+static unsigned int nlive, nallocs;
+static grub_uint32_t seed = 1;
+
+static grub_uint32_t
+rnd (grub_uint32_t n)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % n;
+}
+
+/* Sizes are mostly small, like the sizes of the strings and the structures
+   GRUB allocates, with a few big buffers.  */
+static grub_size_t
+rnd_size (grub_size_t small, grub_size_t big)
+{
+  return rnd (8) ? 8 + rnd (small) : small + rnd (big);
+}
+
+static unsigned int
+alloc (grub_size_t align, grub_size_t size)
+{
+  struct block *b;
+
+  if (nlive == MAX_LIVE)
+    return nlive;
+
+  b = &live[nlive];
+  b->size = size;
+  b->ptr = align ? mm_test_memalign (align, size) : mm_test_malloc (size);
+  grub_test_assert (b->ptr != NULL, "allocating %lu bytes failed",
+		    (unsigned long) size);
+  if (! b->ptr)
+    return nlive;
+  grub_test_assert (! align || ((grub_addr_t) b->ptr & (align - 1)) == 0,
+		    "%p is not aligned to %lu", b->ptr, (unsigned long) align);
+
+  /* Blocks which overlap would overwrite each other's marks.  */
+  b->ptr[0] = nlive;
+  b->ptr[size - 1] = ~nlive;
+  nallocs++;
+  return nlive++;
+}
+
+static void
+release (unsigned int i)
+{
+  struct block *b = &live[i];
+
+  if (i >= nlive)
+    return;
+
+  grub_test_assert (b->ptr[0] == (unsigned char) i
+		    && b->ptr[b->size - 1] == (unsigned char) ~i,
+		    "block %p was overwritten", b->ptr);
+  mm_test_free (b->ptr);
+
+  /* Keep the marks of the block moved into the hole right.  */
+  *b = live[--nlive];
+  if (i < nlive)
+    {
+      b->ptr[0] = i;
+      b->ptr[b->size - 1] = ~i;
+    }
+}
+
+/* Check the index of the subtree T against the rings: return the number
+   of blocks in it.  */
+static unsigned int
+check_subtree (grub_mm_header_t t, grub_mm_header_t lo, grub_mm_header_t hi)
+{
+  grub_size_t max;
+
+  if (! t)
+    return 0;
+
+  grub_test_assert (t->magic == GRUB_MM_FREE_MAGIC && t->size >= 2,
+		    "%p should not be in the index", t);
+  grub_test_assert ((! lo || t > lo) && (! hi || t < hi),
+		    "%p is out of order", t);
+
+  max = t->size;
+  if (index_max (FREE_NODE (t)->left) > max)
+    max = index_max (FREE_NODE (t)->left);
+  if (index_max (FREE_NODE (t)->right) > max)
+    max = index_max (FREE_NODE (t)->right);
+  grub_test_assert (FREE_NODE (t)->max == max, "wrong maximum at %p", t);
+
+  return 1 + check_subtree (FREE_NODE (t)->left, lo, t)
+    + check_subtree (FREE_NODE (t)->right, t, hi);
+}
+
+static void
+check_heap (void)
+{
+  grub_mm_region_t r;
+  grub_mm_header_t p;
+  unsigned int n = 0;
+
+  if (! free_index_valid)
+    return;
+
+  for (r = grub_mm_base; r; r = r->next)
+    if (r->first->magic != GRUB_MM_ALLOC_MAGIC)
+      {
+	p = r->first;
+	do
+	  {
+	    grub_test_assert (p->magic == GRUB_MM_FREE_MAGIC,
+			      "free magic is broken at %p", p);
+	    grub_test_assert (in_region (r, p), "%p is out of its region", p);
+	    if (p->size >= 2)
+	      n++;
+	    p = p->next;
+	  }
+	while (p != r->first);
+      }
+
+  grub_test_assert (check_subtree (free_index, 0, 0) == n,
+		    "the index and the rings differ");
+}
+
+static void
+mm_test (void)
+{
+  grub_mm_region_t r;
+  void *arena;
+  unsigned int i, j, first;
+  clock_t start;
+
+  arena = malloc (ARENA_SIZE);
+  grub_test_assert (arena != NULL, "no arena");
+  if (! arena)
+    return;
+
+  /* Two regions, like the heaps of the firmware platforms.  */
+  mm_test_init_region (arena, ARENA_SIZE / 4);
+  mm_test_init_region ((char *) arena + ARENA_SIZE / 4 + 4096,
+		       ARENA_SIZE - ARENA_SIZE / 4 - 4096);
+
+  start = clock ();
+
+  /* Loading modules: the module, its aligned segments, its symbols, and
+     the file buffer which goes away once it is loaded.  */
+  for (i = 0; i < 200; i++)
+    {
+      alloc (0, 160);
+      alloc (1 << (4 + rnd (9)), 512 + rnd (60000));
+      for (j = rnd (200); j; j--)
+	alloc (0, 16 + rnd (48));
+      release (alloc (0, 8192 + rnd (100000)));
+    }
+  check_heap ();
+
+  /* Rendering glyphs, with the cache flushed now and then.  */
+  first = nlive;
+  for (i = 0; i < 30000; i++)
+    {
+      alloc (0, 48 + rnd (400));
+      if (i % 3000 == 2999)
+	for (j = first; j < nlive; j++)
+	  if (rnd (2))
+	    release (j);
+    }
+  check_heap ();
+
+  /* The index may be thrown away, by the relocator for instance.  */
+  grub_mm_invalidate_index ();
+
+  /* Parsing and running scripts: mostly short-lived strings.  */
+  first = nlive;
+  for (i = 0; i < 200000; i++)
+    {
+      if (nlive > first && rnd (2))
+	release (first + rnd (nlive - first));
+      else
+	alloc (rnd (16) ? 0 : 64, rnd_size (256, 16384));
+    }
+  check_heap ();
+
+  while (nlive)
+    release (rnd (nlive));
+  check_heap ();
+
+  printf ("mm_test: %u allocations in %lu ms\n", nallocs,
+	  (unsigned long) ((clock () - start) * 1000 / CLOCKS_PER_SEC));
+
+  /* Everything is free again, in one block per region.  */
+  for (r = grub_mm_base; r; r = r->next)
+    grub_test_assert (r->first->next == r->first
+		      && r->first->size << GRUB_MM_ALIGN_LOG2 == r->size,
+		      "the heap is fragmented after freeing everything");
+
+  free (arena);
+}
+
+GRUB_UNIT_TEST ("mm_test", mm_test);
@@ -0,0 +1,287 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2026 Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <grub/test.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/script_sh.h>
+#include <grub/script_cache.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+/* Everything the parser makes, in the shape of a generated config.  */
+static const char config[] =
+  "set timeout=5\n"
+  "# A comment.\n"
+  "function load_video {\n"
+  "  insmod all_video\n"
+  "  if [ x$1 = x ]; then echo \"none\"; fi\n"
+  "}\n"
+  "menuentry 'Linux' --class gnu-linux $menuentry_id_option 'gnulinux' {\n"
+  "\tload_video\n"
+  "\tlinux /vmlinuz root=UUID=1234 ro quiet\n"
+  "\tinitrd /initrd.img\n"
+  "}\n"
+  "submenu 'Advanced' {\n"
+  "  menuentry 'Linux (recovery)' {\n"
+  "    linux /vmlinuz single\n"
+  "  }\n"
+  "  for i in 1 2 3; do echo $i; done\n"
+  "}\n"
+  "if [ -s $prefix/grubenv ]; then\n"
+  "  load_env\n"
+  "elif true; then\n"
+  "  echo \"${a}b\" $\"translated\"\n"
+  "else\n"
+  "  echo c\n"
+  "fi\n"
+  "while false; do echo x; done\n"
+  "until true; do echo y; done\n";
+
+#define MAX_RECORDS	32
+
+struct record
+{
+  char *name;
+  struct grub_script *script;
+};
+
+static struct record records[MAX_RECORDS];
+static int nrecords;
+
+static grub_err_t
+get_line (char **line, int cont __attribute__ ((unused)), void *data)
+{
+  const char **p = data;
+  const char *nl;
+
+  if (! **p)
+    {
+      *line = 0;
+      return GRUB_ERR_NONE;
+    }
+
+  nl = grub_strchr (*p, '\n');
+  *line = grub_strndup (*p, nl - *p);
+  *p = nl + 1;
+  return GRUB_ERR_NONE;
+}
+
+static int cmp_cmd (struct grub_script_cmd *a, struct grub_script_cmd *b);
+
+static int
+count_scripts (struct grub_script *s)
+{
+  int n = 0;
+
+  for (; s; s = s->next_siblings)
+    n += 1 + count_scripts (s->children);
+  return n;
+}
+
+static int
+cmp_arg (struct grub_script_arg *a, struct grub_script_arg *b)
+{
+  for (; a && b; a = a->next, b = b->next)
+    {
+      if (a->type != b->type || grub_strcmp (a->str, b->str) != 0
+	  || ! a->script != ! b->script)
+	return 1;
+      if (a->script
+	  && (cmp_cmd (a->script->cmd, b->script->cmd)
+	      || count_scripts (a->script->children)
+		 != count_scripts (b->script->children)))
+	return 1;
+    }
+
+  return a || b;
+}
+
+static int
+cmp_arglist (struct grub_script_arglist *a, struct grub_script_arglist *b)
+{
+  if (a && b && a->argcount != b->argcount)
+    return 1;
+
+  for (; a && b; a = a->next, b = b->next)
+    if (cmp_arg (a->arg, b->arg))
+      return 1;
+
+  return a || b;
+}
+
+static int
+cmp_cmd (struct grub_script_cmd *a, struct grub_script_cmd *b)
+{
+  if (! a || ! b)
+    return a != b;
+
+  if (a->exec != b->exec)
+    return 1;
+
+  if (a->exec == grub_script_execute_cmdlist)
+    {
+      for (a = a->next, b = b->next; a && b; a = a->next, b = b->next)
+	if (cmp_cmd (a, b))
+	  return 1;
+      return a || b;
+    }
+
+  if (a->exec == grub_script_execute_cmdline)
+    return cmp_arglist (((struct grub_script_cmdline *) a)->arglist,
+			((struct grub_script_cmdline *) b)->arglist);
+
+  if (a->exec == grub_script_execute_cmdif)
+    {
+      struct grub_script_cmdif *x = (struct grub_script_cmdif *) a;
+      struct grub_script_cmdif *y = (struct grub_script_cmdif *) b;
+
+      return cmp_cmd (x->exec_to_evaluate, y->exec_to_evaluate)
+	|| cmp_cmd (x->exec_on_true, y->exec_on_true)
+	|| cmp_cmd (x->exec_on_false, y->exec_on_false);
+    }
+
+  if (a->exec == grub_script_execute_cmdfor)
+    {
+      struct grub_script_cmdfor *x = (struct grub_script_cmdfor *) a;
+      struct grub_script_cmdfor *y = (struct grub_script_cmdfor *) b;
+
+      return cmp_arg (x->name, y->name) || cmp_arglist (x->words, y->words)
+	|| cmp_cmd (x->list, y->list);
+    }
+
+  {
+    struct grub_script_cmdwhile *x = (struct grub_script_cmdwhile *) a;
+    struct grub_script_cmdwhile *y = (struct grub_script_cmdwhile *) b;
+
+    return x->until != y->until || cmp_cmd (x->cond, y->cond)
+      || cmp_cmd (x->list, y->list);
+  }
+}
+
+/* Parse the config like grub-script-check --output does, keeping what it
+   writes to compare the cache with.  */
+static void
+write_cache (struct grub_script_cache_writer *writer, grub_uint64_t hash)
+{
+  const char *p = config;
+  struct grub_script *script;
+  grub_script_function_t func;
+  char *line;
+
+  grub_test_assert (grub_script_cache_write_header (writer,
+						    sizeof (config) - 1, hash)
+		    == GRUB_ERR_NONE, "writing the header failed");
+
+  while (*p)
+    {
+      get_line (&line, 0, &p);
+      script = grub_script_parse (line, get_line, &p);
+      grub_free (line);
+      grub_test_assert (script != NULL, "parsing failed before `%s'", p);
+      if (! script)
+	return;
+
+      /* Take the functions away from the list, they are compared later.  */
+      while ((func = grub_script_function_list))
+	{
+	  grub_test_assert (grub_script_cache_write_function (writer,
+							      func->name,
+							      func->func)
+			    == GRUB_ERR_NONE, "writing a function failed");
+	  records[nrecords].name = func->name;
+	  records[nrecords++].script = func->func;
+	  grub_script_function_list = func->next;
+	  grub_free (func);
+	}
+
+      if (! script->cmd)
+	{
+	  grub_script_free (script);
+	  continue;
+	}
+
+      grub_test_assert (grub_script_cache_write_statement (writer, script)
+			== GRUB_ERR_NONE, "writing a statement failed");
+      records[nrecords].name = NULL;
+      records[nrecords++].script = script;
+    }
+
+  grub_test_assert (grub_script_cache_write_end (writer) == GRUB_ERR_NONE,
+		    "writing the end failed");
+}
+
+static void
+script_cache_test (void)
+{
+  struct grub_script_cache_writer writer = { 0 };
+  struct grub_script_cache_entry *entries, *e;
+  grub_uint64_t hash;
+  grub_size_t size;
+  int i;
+
+  hash = grub_script_cache_hash (GRUB_SCRIPT_CACHE_HASH_INIT, config,
+				 sizeof (config) - 1);
+  write_cache (&writer, hash);
+  grub_test_assert (nrecords == 7, "%d records instead of 7", nrecords);
+
+  entries = grub_script_cache_load (writer.buf, writer.size,
+				    sizeof (config) - 1, hash);
+  grub_test_assert (entries != NULL, "loading the cache failed");
+
+  for (e = entries, i = 0; e && i < nrecords; e = e->next, i++)
+    {
+      grub_test_assert (! e->name == ! records[i].name
+			&& (! e->name
+			    || grub_strcmp (e->name, records[i].name) == 0),
+			"record %d is not the same kind", i);
+      grub_test_assert (! cmp_cmd (e->script->cmd, records[i].script->cmd),
+			"record %d is not the same script", i);
+      grub_test_assert (count_scripts (e->script->children)
+			== count_scripts (records[i].script->children),
+			"record %d doesn't have the same blocks", i);
+    }
+  grub_test_assert (! e && i == nrecords, "the number of records differs");
+  grub_script_cache_free (entries);
+
+  /* A cache made from another file, or broken, is refused.  */
+  grub_test_assert (grub_script_cache_load (writer.buf, writer.size,
+					    sizeof (config) - 1, hash + 1)
+		    == NULL, "a stale cache was loaded");
+  for (size = 0; size < writer.size; size++)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      entries = grub_script_cache_load (writer.buf, size,
+					sizeof (config) - 1, hash);
+      grub_test_assert (entries == NULL, "a cache cut at %lu was loaded",
+			(unsigned long) size);
+      grub_script_cache_free (entries);
+    }
+  grub_errno = GRUB_ERR_NONE;
+
+  for (i = 0; i < nrecords; i++)
+    {
+      grub_free (records[i].name);
+      grub_script_free (records[i].script);
+    }
+  grub_free (writer.buf);
+}
+
+GRUB_UNIT_TEST ("script_cache_test", script_cache_test);
@@ -35,10 +35,14 @@
 #include <grub/zfs/zfs.h>
 #include <grub/util/install.h>
 #include <grub/util/resolve.h>
+#include <grub/dl_pack.h>
+#include <grub/command_index.h>
+#include <grub/elf.h>
 #include <grub/emu/hostfile.h>
 #include <grub/emu/config.h>
 #include <grub/emu/hostfile.h>
 
+#include <stddef.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
@@ -200,6 +204,8 @@ clean_grub_dir (const char *di)
     {
       const char *ext = strrchr (de->d_name, '.');
       if ((ext && (strcmp (ext, ".mod") == 0
+		   || strcmp (ext, ".pack") == 0
+		   || strcmp (ext, ".idx") == 0
 		   || strcmp (ext, ".lst") == 0
 		   || strcmp (ext, ".img") == 0
 		   || strcmp (ext, ".mo") == 0)
@@ -828,6 +834,473 @@ grub_install_get_platform_platform (enum grub_install_plat platid)
 }
 
 
+struct pack_module
+{
+  char *name;
+  char *image;
+  size_t size;
+  grub_uint32_t *symmap;
+  grub_uint32_t nsymbols;
+  grub_uint32_t *deps;
+  grub_uint32_t ndeps;
+};
+
+struct pack_symbols
+{
+  char **names;
+  grub_uint32_t n;
+  grub_uint32_t n_alloc;
+};
+
+static grub_uint64_t
+elf_get (const struct pack_module *mod, grub_uint64_t off, size_t len, int be)
+{
+  const grub_uint8_t *p = (const grub_uint8_t *) mod->image + off;
+  grub_uint64_t v = 0;
+  size_t i;
+
+  if (off > mod->size || len > mod->size - off)
+    grub_util_error (_("%s is corrupt"), mod->name);
+  for (i = 0; i < len; i++)
+    v |= (grub_uint64_t) p[be ? i : len - 1 - i] << (8 * (len - 1 - i));
+  return v;
+}
+
+static char *
+pack_module_name (const char *path)
+{
+  const char *base = strrchr (path, '/');
+  size_t len;
+  char *name;
+
+  base = base ? base + 1 : path;
+  len = strlen (base);
+  if (len > sizeof (".mod") - 1
+      && strcmp (base + len - sizeof (".mod") + 1, ".mod") == 0)
+    len -= sizeof (".mod") - 1;
+  name = xmalloc (len + 1);
+  memcpy (name, base, len);
+  name[len] = '\0';
+  return name;
+}
+
+#define ELF_GET(base, type, field)					\
+  elf_get (mod, (base) + (is64 ? offsetof (Elf64_##type, field)		\
+			  : offsetof (Elf32_##type, field)),		\
+	   is64 ? sizeof (((Elf64_##type *) 0)->field)			\
+	   : sizeof (((Elf32_##type *) 0)->field), be)
+
+static grub_uint32_t
+pack_symbol_number (struct pack_symbols *syms, const char *name)
+{
+  grub_uint32_t i;
+
+  for (i = 0; i < syms->n; i++)
+    if (strcmp (syms->names[i], name) == 0)
+      return i;
+  if (syms->n == syms->n_alloc)
+    {
+      syms->n_alloc = syms->n_alloc ? 2 * syms->n_alloc : 256;
+      syms->names = xrealloc (syms->names,
+			      syms->n_alloc * sizeof (syms->names[0]));
+    }
+  syms->names[syms->n] = xstrdup (name);
+  return syms->n++;
+}
+
+/* Number the symbols MOD imports, see include/grub/dl_pack.h.  */
+static void
+pack_map_symbols (struct pack_module *mod, struct pack_symbols *syms)
+{
+  const unsigned char *ident = (const unsigned char *) mod->image;
+  grub_uint64_t shoff, symoff = 0, symsize = 0, symentsize = 0;
+  grub_uint64_t stroff = 0, strsize = 0;
+  unsigned shnum, shentsize, i;
+  int is64, be;
+
+  if (mod->size < EI_NIDENT || memcmp (ident, ELFMAG, SELFMAG) != 0)
+    grub_util_error (_("%s is corrupt"), mod->name);
+  is64 = ident[EI_CLASS] == ELFCLASS64;
+  be = ident[EI_DATA] == ELFDATA2MSB;
+
+  shoff = ELF_GET (0, Ehdr, e_shoff);
+  shnum = ELF_GET (0, Ehdr, e_shnum);
+  shentsize = ELF_GET (0, Ehdr, e_shentsize);
+
+  for (i = 0; i < shnum; i++)
+    {
+      grub_uint64_t s = shoff + (grub_uint64_t) i * shentsize;
+      grub_uint64_t link;
+
+      if (ELF_GET (s, Shdr, sh_type) != SHT_SYMTAB)
+	continue;
+      symoff = ELF_GET (s, Shdr, sh_offset);
+      symsize = ELF_GET (s, Shdr, sh_size);
+      symentsize = ELF_GET (s, Shdr, sh_entsize);
+      link = shoff + ELF_GET (s, Shdr, sh_link) * shentsize;
+      stroff = ELF_GET (link, Shdr, sh_offset);
+      strsize = ELF_GET (link, Shdr, sh_size);
+      break;
+    }
+
+  /* Modules without symbol table only pull in dependencies.  */
+  if (i == shnum || symentsize == 0)
+    return;
+
+  mod->nsymbols = symsize / symentsize;
+  mod->symmap = xcalloc (mod->nsymbols, sizeof (mod->symmap[0]));
+  for (i = 0; i < mod->nsymbols; i++)
+    {
+      grub_uint64_t sym = symoff + i * symentsize;
+      grub_uint64_t name = ELF_GET (sym, Sym, st_name);
+
+      mod->symmap[i] = grub_cpu_to_le32_compile_time (GRUB_DL_PACK_NO_SYMBOL);
+      if (name == 0 || ELF_GET (sym, Sym, st_shndx) != SHN_UNDEF)
+	continue;
+      if (name >= strsize || stroff + strsize > mod->size
+	  || ! memchr (mod->image + stroff + name, 0, strsize - name))
+	grub_util_error (_("%s is corrupt"), mod->name);
+      mod->symmap[i]
+	= grub_cpu_to_le32 (pack_symbol_number (syms,
+						mod->image + stroff + name));
+    }
+}
+
+#undef ELF_GET
+
+/* Write all the modules in DIR to GRUB_DL_PACK_NAME there, so that GRUB
+   can load a module and everything it needs with one open and one read,
+   and look up each imported symbol only once.  */
+static void
+make_module_pack (const char *dir)
+{
+  struct grub_util_path_list *path_list, *p;
+  struct pack_module *mods = 0;
+  struct pack_symbols syms = { 0, 0, 0 };
+  struct grub_dl_pack_header header;
+  grub_util_fd_dir_t d;
+  grub_util_fd_dirent_t de;
+  char **names = 0;
+  size_t nnames = 0, nmods = 0, i, j;
+  grub_uint64_t index_size, offset;
+  char *packname;
+  FILE *fp;
+
+  d = grub_util_fd_opendir (dir);
+  if (!d)
+    grub_util_error (_("cannot open directory `%s': %s"),
+		     dir, grub_util_fd_strerror ());
+  while ((de = grub_util_fd_readdir (d)))
+    {
+      const char *ext = strrchr (de->d_name, '.');
+      if (ext && strcmp (ext, ".mod") == 0)
+	{
+	  names = xrealloc (names, (nnames + 2) * sizeof (names[0]));
+	  names[nnames++] = pack_module_name (de->d_name);
+	  names[nnames] = 0;
+	}
+    }
+  grub_util_fd_closedir (d);
+  if (!nnames)
+    return;
+
+  /* This lists every module after its dependencies.  */
+  path_list = grub_util_resolve_dependencies (dir, "moddep.lst", names);
+  for (p = path_list; p; p = p->next)
+    if (grub_util_is_regular (p->name))
+      nmods++;
+  mods = xcalloc (nmods, sizeof (mods[0]));
+  for (p = path_list, i = 0; p; p = p->next)
+    {
+      if (!grub_util_is_regular (p->name))
+	continue;
+      mods[i].name = pack_module_name (p->name);
+      mods[i].size = grub_util_get_image_size (p->name);
+      mods[i].image = grub_util_read_image (p->name);
+      pack_map_symbols (&mods[i], &syms);
+      i++;
+    }
+  grub_util_free_path_list (path_list);
+
+  for (i = 0; i < nmods; i++)
+    {
+      char *one[2] = { mods[i].name, 0 };
+
+      path_list = grub_util_resolve_dependencies (dir, "moddep.lst", one);
+      mods[i].deps = xcalloc (nmods, sizeof (mods[i].deps[0]));
+      /* Collect the indexes in ascending order.  */
+      for (j = 0; j <= i; j++)
+	for (p = path_list; p; p = p->next)
+	  {
+	    char *name = pack_module_name (p->name);
+	    int found = strcmp (name, mods[j].name) == 0;
+
+	    free (name);
+	    if (found)
+	      {
+		mods[i].deps[mods[i].ndeps++] = grub_cpu_to_le32 (j);
+		break;
+	      }
+	  }
+      grub_util_free_path_list (path_list);
+    }
+
+  index_size = sizeof (header) + nmods * sizeof (struct grub_dl_pack_module);
+  for (i = 0; i < nmods; i++)
+    index_size += 4 * mods[i].ndeps + strlen (mods[i].name) + 1;
+
+  memcpy (header.magic, GRUB_DL_PACK_MAGIC, sizeof (header.magic));
+  header.version = grub_cpu_to_le32_compile_time (GRUB_DL_PACK_VERSION);
+  header.nmodules = grub_cpu_to_le32 (nmods);
+  header.nsymbols = grub_cpu_to_le32 (syms.n);
+  header.index_size = grub_cpu_to_le32 (index_size);
+
+  packname = grub_util_path_concat (2, dir, GRUB_DL_PACK_NAME);
+  grub_util_info ("writing `%s' with %lu modules", packname,
+		  (unsigned long) nmods);
+  fp = grub_util_fopen (packname, "wb");
+  if (!fp)
+    grub_util_error (_("cannot open `%s': %s"), packname, strerror (errno));
+  grub_util_write_image ((char *) &header, sizeof (header), fp, packname);
+
+  /* The module table, with the dependency lists and names after it.  */
+  offset = ALIGN_UP (index_size, GRUB_DL_PACK_ALIGN);
+  {
+    grub_uint64_t deps = sizeof (header)
+      + nmods * sizeof (struct grub_dl_pack_module);
+    grub_uint64_t name = deps;
+
+    for (i = 0; i < nmods; i++)
+      name += 4 * mods[i].ndeps;
+
+    for (i = 0; i < nmods; i++)
+      {
+	struct grub_dl_pack_module m;
+
+	m.name = grub_cpu_to_le32 (name);
+	m.offset = grub_cpu_to_le32 (offset);
+	m.size = grub_cpu_to_le32 (mods[i].size);
+	m.nsymbols = grub_cpu_to_le32 (mods[i].nsymbols);
+	m.deps = grub_cpu_to_le32 (deps);
+	m.ndeps = grub_cpu_to_le32 (mods[i].ndeps);
+	grub_util_write_image ((char *) &m, sizeof (m), fp, packname);
+
+	name += strlen (mods[i].name) + 1;
+	deps += 4 * mods[i].ndeps;
+	offset = ALIGN_UP (ALIGN_UP (offset + mods[i].size, 4)
+			   + 4 * mods[i].nsymbols, GRUB_DL_PACK_ALIGN);
+	if (offset > GRUB_UINT_MAX)
+	  grub_util_error (_("%s is too big"), packname);
+      }
+  }
+  for (i = 0; i < nmods; i++)
+    grub_util_write_image ((char *) mods[i].deps, 4 * mods[i].ndeps,
+			   fp, packname);
+  for (i = 0; i < nmods; i++)
+    grub_util_write_image (mods[i].name, strlen (mods[i].name) + 1,
+			   fp, packname);
+
+  /* The modules themselves.  */
+  offset = index_size;
+  for (i = 0; i < nmods; i++)
+    {
+      static const char zero[GRUB_DL_PACK_ALIGN];
+
+      grub_util_write_image (zero, ALIGN_UP (offset, GRUB_DL_PACK_ALIGN)
+			     - offset, fp, packname);
+      offset = ALIGN_UP (offset, GRUB_DL_PACK_ALIGN);
+      grub_util_write_image (mods[i].image, mods[i].size, fp, packname);
+      grub_util_write_image (zero, ALIGN_UP (offset + mods[i].size, 4)
+			     - (offset + mods[i].size), fp, packname);
+      offset = ALIGN_UP (offset + mods[i].size, 4);
+      grub_util_write_image ((char *) mods[i].symmap, 4 * mods[i].nsymbols,
+			     fp, packname);
+      offset += 4 * mods[i].nsymbols;
+    }
+
+  if (grub_util_file_sync (fp) < 0)
+    grub_util_error (_("cannot sync `%s': %s"), packname, strerror (errno));
+  fclose (fp);
+  free (packname);
+
+  for (i = 0; i < nmods; i++)
+    {
+      free (mods[i].name);
+      free (mods[i].image);
+      free (mods[i].symmap);
+      free (mods[i].deps);
+    }
+  free (mods);
+  for (i = 0; i < syms.n; i++)
+    free (syms.names[i]);
+  free (syms.names);
+  for (i = 0; i < nnames; i++)
+    free (names[i]);
+  free (names);
+}
+
+/* Pack the modules copied to DST for PLATID, see make_module_pack.  It
+   holds them all a second time, so only grub-install and grub-mknetdir
+   write it, not the tools making images.  */
+void
+grub_install_make_module_pack (const char *dst,
+			       enum grub_install_plat platid)
+{
+  char *platform, *dst_platform;
+
+  /* GRUB reads the modules from the pack directly, so it can't be
+     compressed.  */
+  if (compress_func)
+    return;
+
+  platform = xasprintf ("%s-%s", platforms[platid].cpu,
+			platforms[platid].platform);
+  dst_platform = grub_util_path_concat (2, dst, platform);
+  free (platform);
+  make_module_pack (dst_platform);
+  free (dst_platform);
+}
+
+struct index_command
+{
+  char *name;
+  grub_uint32_t module;
+  int prio;
+};
+
+/* Write command.lst in DIR again as GRUB_COMMAND_INDEX_NAME, which normal
+   mode reads in one go.  */
+static void
+make_command_index (const char *dir)
+{
+  struct grub_command_index_header header;
+  struct index_command *cmds = 0;
+  char **modnames = 0;
+  size_t nmodules = 0, ncommands = 0, i;
+  char *lstname, *idxname, *buf = 0;
+  size_t bufsize = 0;
+  grub_uint32_t offset;
+  FILE *in, *fp;
+
+  lstname = grub_util_path_concat (2, dir, "command.lst");
+  in = grub_util_fopen (lstname, "r");
+  free (lstname);
+  if (!in)
+    return;
+
+  /* Parse it the way read_command_list does.  */
+  while (getline (&buf, &bufsize, in) >= 0)
+    {
+      char *name = buf, *p, *end;
+      int prio = 0;
+
+      while (grub_isspace (*name))
+	name++;
+      if (*name == '*')
+	{
+	  name++;
+	  prio = 1;
+	}
+      if (!grub_isgraph (*name))
+	continue;
+      p = strchr (name, ':');
+      if (!p)
+	continue;
+      *p++ = '\0';
+      while (*p == ' ' || *p == '\t')
+	p++;
+      if (!grub_isgraph (*p))
+	continue;
+      for (end = p + strlen (p); grub_isspace (end[-1]); end--)
+	;
+      *end = '\0';
+
+      for (i = 0; i < nmodules; i++)
+	if (strcmp (modnames[i], p) == 0)
+	  break;
+      if (i == nmodules)
+	{
+	  if (nmodules > 0xffff)
+	    grub_util_error (_("too many modules in command.lst"));
+	  modnames = xrealloc (modnames, (nmodules + 1) * sizeof (modnames[0]));
+	  modnames[nmodules++] = xstrdup (p);
+	}
+
+      cmds = xrealloc (cmds, (ncommands + 1) * sizeof (cmds[0]));
+      cmds[ncommands].name = xstrdup (name);
+      cmds[ncommands].module = i;
+      cmds[ncommands].prio = prio;
+      ncommands++;
+    }
+  free (buf);
+  fclose (in);
+
+  memcpy (header.magic, GRUB_COMMAND_INDEX_MAGIC, sizeof (header.magic));
+  header.version = grub_cpu_to_le32_compile_time (GRUB_COMMAND_INDEX_VERSION);
+  header.nmodules = grub_cpu_to_le32 (nmodules);
+  header.ncommands = grub_cpu_to_le32 (ncommands);
+
+  idxname = grub_util_path_concat (2, dir, GRUB_COMMAND_INDEX_NAME);
+  fp = grub_util_fopen (idxname, "wb");
+  if (!fp)
+    grub_util_error (_("cannot open `%s': %s"), idxname, strerror (errno));
+  grub_util_write_image ((char *) &header, sizeof (header), fp, idxname);
+
+  /* The tables, then the module names and the command names.  */
+  offset = sizeof (header) + nmodules * 4
+    + ncommands * sizeof (struct grub_command_index_entry);
+  for (i = 0; i < nmodules; i++)
+    {
+      grub_uint32_t name = grub_cpu_to_le32 (offset);
+
+      grub_util_write_image ((char *) &name, sizeof (name), fp, idxname);
+      offset += strlen (modnames[i]) + 1;
+    }
+  for (i = 0; i < ncommands; i++)
+    {
+      struct grub_command_index_entry e;
+
+      e.name = grub_cpu_to_le32 (offset);
+      e.module = grub_cpu_to_le16 (cmds[i].module);
+      e.prio = grub_cpu_to_le16 (cmds[i].prio);
+      grub_util_write_image ((char *) &e, sizeof (e), fp, idxname);
+      offset += strlen (cmds[i].name) + 1;
+    }
+  for (i = 0; i < nmodules; i++)
+    grub_util_write_image (modnames[i], strlen (modnames[i]) + 1, fp, idxname);
+  for (i = 0; i < ncommands; i++)
+    grub_util_write_image (cmds[i].name, strlen (cmds[i].name) + 1,
+			   fp, idxname);
+
+  if (grub_util_file_sync (fp) < 0)
+    grub_util_error (_("cannot sync `%s': %s"), idxname, strerror (errno));
+  fclose (fp);
+  free (idxname);
+
+  for (i = 0; i < nmodules; i++)
+    free (modnames[i]);
+  free (modnames);
+  for (i = 0; i < ncommands; i++)
+    free (cmds[i].name);
+  free (cmds);
+}
+
+/* Write the command index for the files copied to DST for PLATID, see
+   make_command_index.  */
+void
+grub_install_make_command_index (const char *dst,
+				 enum grub_install_plat platid)
+{
+  char *platform, *dst_platform;
+
+  platform = xasprintf ("%s-%s", platforms[platid].cpu,
+			platforms[platid].platform);
+  dst_platform = grub_util_path_concat (2, dst, platform);
+  free (platform);
+  make_command_index (dst_platform);
+  free (dst_platform);
+}
+
 void
 grub_install_copy_files (const char *src,
 			 const char *dst,
@@ -1249,6 +1249,8 @@ main (int argc, char *argv[])
 
   grub_install_copy_files (grub_install_source_directory,
 			   grubdir, platform);
+  grub_install_make_module_pack (grubdir, platform);
+  grub_install_make_command_index (grubdir, platform);
 
   char *envfile = grub_util_path_concat (2, grubdir, "grubenv");
   if (!grub_util_is_regular (envfile))
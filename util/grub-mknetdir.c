@@ -124,6 +124,8 @@ process_input_dir (const char *input_dir, enum grub_install_plat platform)
   FILE *cfg;
 
   grub_install_copy_files (input_dir, base, platform);
+  grub_install_make_module_pack (base, platform);
+  grub_install_make_command_index (base, platform);
   grub_util_unlink (load_cfg);
 
   if (debug_image)
@@ -26,6 +26,7 @@
 #include <grub/i18n.h>
 #include <grub/parser.h>
 #include <grub/script_sh.h>
+#include <grub/script_cache.h>
 
 #define _GNU_SOURCE	1
 
@@ -46,10 +47,14 @@ struct arguments
 {
   int verbose;
   char *filename;
+  char *output;
 };
 
 static struct argp_option options[] = {
   {"verbose",     'v', 0,      0, N_("print verbose messages."), 0},
+  {"output",      'o', N_("FILE"), 0,
+   N_("save the parsed script to FILE, for GRUB to load instead of parsing"
+      " the script while it is unchanged."), 0},
   { 0, 0, 0, 0, 0, 0 }
 };
 
@@ -66,6 +71,11 @@ argp_parser (int key, char *arg, struct argp_state *state)
       arguments->verbose = 1;
       break;
 
+    case 'o':
+      free (arguments->output);
+      arguments->output = xstrdup (arg);
+      break;
+
     case ARGP_KEY_ARG:
       if (state->arg_num == 0)
 	arguments->filename = xstrdup (arg);
@@ -95,8 +105,49 @@ struct main_ctx
   int lineno;
   FILE *file;
   struct arguments arguments;
+
+  /* With --output, the whole script, read as GRUB reads it.  */
+  char *buf;
+  size_t size;
+  size_t pos;
 };
 
+/* Read the next line of CTX->buf like GRUB reads configuration files:
+   carriage returns are dropped and lines starting with '#' are skipped.  */
+static char *
+get_buffer_line (struct main_ctx *ctx)
+{
+  char *line, *end;
+  size_t i, len;
+
+  while (ctx->pos < ctx->size)
+    {
+      end = memchr (ctx->buf + ctx->pos, '\n', ctx->size - ctx->pos);
+      len = (end ? (size_t) (end - ctx->buf) : ctx->size) - ctx->pos;
+
+      line = xmalloc (len + 1);
+      for (i = 0; len--; ctx->pos++)
+	if (ctx->buf[ctx->pos] != '\r')
+	  line[i++] = ctx->buf[ctx->pos];
+      line[i] = '\0';
+
+      ctx->lineno++;
+      if (end)
+	ctx->pos++;
+      else if (i == 0)
+	{
+	  free (line);
+	  break;
+	}
+
+      if (line[0] != '#')
+	return line;
+      free (line);
+    }
+
+  return 0;
+}
+
 /* Helper for main.  */
 static grub_err_t
 get_config_line (char **line, int cont __attribute__ ((unused)), void *data)
@@ -107,6 +158,24 @@ get_config_line (char **line, int cont __attribute__ ((unused)), void *data)
   size_t len = 0;
   ssize_t curread;
 
+  if (ctx->buf)
+    {
+      cmdline = get_buffer_line (ctx);
+      if (! cmdline)
+	{
+	  *line = 0;
+	  grub_errno = GRUB_ERR_READ_ERROR;
+	  return grub_errno;
+	}
+
+      if (ctx->arguments.verbose)
+	grub_printf ("%s\n", cmdline);
+
+      *line = grub_strdup (cmdline);
+      free (cmdline);
+      return 0;
+    }
+
   curread = getline (&cmdline, &len, (ctx->file ?: stdin));
   if (curread == -1)
     {
@@ -139,6 +208,50 @@ get_config_line (char **line, int cont __attribute__ ((unused)), void *data)
   return 0;
 }
 
+/* Read all of the input into CTX->buf.  */
+static void
+read_input (struct main_ctx *ctx)
+{
+  FILE *in = ctx->file ?: stdin;
+  size_t allocated = 0, got;
+
+  do
+    {
+      if (ctx->size == allocated)
+	{
+	  allocated = allocated ? allocated * 2 : 65536;
+	  ctx->buf = xrealloc (ctx->buf, allocated);
+	}
+      got = fread (ctx->buf + ctx->size, 1, allocated - ctx->size, in);
+      ctx->size += got;
+    }
+  while (got);
+
+  if (ferror (in))
+    grub_util_error (_("cannot read `%s': %s"),
+		     ctx->arguments.filename ? : "stdin", strerror (errno));
+}
+
+/* Save SCRIPT to the cache, after the functions parsing it defined.  They
+   are forgotten, so that only the ones of the next script are left after
+   parsing it.  */
+static void
+save_script (struct grub_script_cache_writer *writer,
+	     struct grub_script *script)
+{
+  grub_script_function_t func;
+
+  FOR_SCRIPT_FUNCTIONS (func)
+    if (grub_script_cache_write_function (writer, func->name, func->func))
+      grub_util_error ("%s", grub_errmsg);
+
+  while (grub_script_function_list)
+    grub_script_function_remove (grub_script_function_list->name);
+
+  if (script->cmd && grub_script_cache_write_statement (writer, script))
+    grub_util_error ("%s", grub_errmsg);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -149,6 +262,8 @@ main (int argc, char *argv[])
   char *input;
   int found_input = 0, found_cmd = 0;
   struct grub_script *script = NULL;
+  struct grub_script_cache_writer writer = { 0 };
+  FILE *out;
 
   grub_util_host_init (&argc, &argv);
 
@@ -180,6 +295,16 @@ main (int argc, char *argv[])
 	}
     }
 
+  if (ctx.arguments.output)
+    {
+      read_input (&ctx);
+      if (grub_script_cache_write_header
+	  (&writer, ctx.size,
+	   grub_script_cache_hash (GRUB_SCRIPT_CACHE_HASH_INIT,
+				   ctx.buf, ctx.size)))
+	grub_util_error ("%s", grub_errmsg);
+    }
+
   do
     {
       input = 0;
@@ -193,6 +318,8 @@ main (int argc, char *argv[])
 	{
 	  if (script->cmd)
 	    found_cmd = 1;
+	  if (ctx.buf)
+	    save_script (&writer, script);
 	  grub_script_execute (script);
 	  grub_script_free (script);
 	}
@@ -214,5 +341,21 @@ main (int argc, char *argv[])
       return 1;
     }
 
+  if (ctx.arguments.output)
+    {
+      if (grub_script_cache_write_end (&writer))
+	grub_util_error ("%s", grub_errmsg);
+
+      out = grub_util_fopen (ctx.arguments.output, "wb");
+      if (! out)
+	grub_util_error (_("cannot open `%s': %s"), ctx.arguments.output,
+			 strerror (errno));
+      grub_util_write_image (writer.buf, writer.size, out,
+			     ctx.arguments.output);
+      if (fclose (out) != 0)
+	grub_util_error (_("cannot write to `%s': %s"), ctx.arguments.output,
+			 strerror (errno));
+    }
+
   return 0;
 }